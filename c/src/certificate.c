@@ -0,0 +1,265 @@
+#include <stdio.h> // fopen, fread, fclose, rename
+#include <unistd.h> // close, write
+#include <fcntl.h> // open, O_*
+#include <openssl/pem.h> // PEM_read_X509
+#include <openssl/x509.h> // X509_get_notAfter, X509_free
+#include <rawrtc.h>
+#include "helper/common.h"
+#include "certificate.h"
+#include "options.h"
+
+#define DEBUG_MODULE "rawrtc-terminal-certificate"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+enum {
+    CERTIFICATE_RENEWAL_MARGIN = 86400, // in seconds
+    CERTIFICATE_MAX_LENGTH = 65536,
+};
+
+/*
+ * Create a certificate from its PEM encoding containing both the
+ * certificate and the private key.
+ */
+enum rawrtc_code certificate_from_pem(
+        struct rawrtc_certificate** const certificatep, // de-referenced
+        char const* const pem,
+        size_t const length,
+        enum rawrtc_certificate_key_type const key_type
+) {
+    // Note: The PEM parser picks the corresponding section for the certificate and the key
+    return rawrtc_certificate_from_bytes(certificatep, pem, length, pem, length, key_type);
+}
+
+/*
+ * Generate a certificate as specified by the options.
+ */
+static enum rawrtc_code certificate_generate(
+        struct rawrtc_certificate** const certificatep, // de-referenced
+        struct terminal_options const* const options
+) {
+    struct rawrtc_certificate_options* certificate_options;
+    enum rawrtc_code error;
+
+    // Create certificate options
+    error = rawrtc_certificate_options_create(
+            &certificate_options, options->certificate_key_type, NULL,
+            options->certificate_validity, RAWRTC_CERTIFICATE_SIGN_ALGORITHM_SHA256, NULL,
+            options->certificate_modulus_length);
+    if (error) {
+        return error;
+    }
+
+    // Generate certificate
+    DEBUG_PRINTF("Generating %s certificate\n",
+                 options->certificate_key_type == RAWRTC_CERTIFICATE_KEY_TYPE_EC ? "EC" : "RSA");
+    error = rawrtc_certificate_generate(certificatep, certificate_options);
+
+    // Un-reference
+    mem_deref(certificate_options);
+    return error;
+}
+
+/*
+ * Check whether the persisted certificate is still valid for at least
+ * the renewal margin (according to its own expiry date).
+ */
+static bool certificate_file_is_fresh(
+        char const* const path,
+        uint32_t const validity
+) {
+    FILE* file;
+    X509* x509;
+    int days;
+    int seconds;
+    int64_t remaining;
+    int64_t margin = CERTIFICATE_RENEWAL_MARGIN;
+
+    // Read certificate
+    file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    x509 = PEM_read_X509(file, NULL, NULL, NULL);
+    fclose(file);
+    if (!x509) {
+        return false;
+    }
+
+    // Get remaining time until it expires
+    if (!ASN1_TIME_diff(&days, &seconds, NULL, X509_get_notAfter(x509))) {
+        X509_free(x509);
+        return false;
+    }
+    X509_free(x509);
+    remaining = (int64_t) days * 86400 + seconds;
+
+    // Use a smaller margin for short-lived certificates
+    if (margin >= (int64_t) validity) {
+        margin = (int64_t) validity / 2;
+    }
+
+    // Check expiry
+    return remaining > margin;
+}
+
+/*
+ * Load a persisted certificate.
+ */
+static enum rawrtc_code certificate_load(
+        struct rawrtc_certificate** const certificatep, // de-referenced
+        char const* const path,
+        enum rawrtc_certificate_key_type const key_type
+) {
+    FILE* file;
+    char* pem;
+    size_t length;
+    enum rawrtc_code error;
+
+    // Allocate
+    pem = mem_alloc(CERTIFICATE_MAX_LENGTH, NULL);
+    if (!pem) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Read file
+    file = fopen(path, "rb");
+    if (!file) {
+        error = rawrtc_error_to_code(errno);
+        goto out;
+    }
+    length = fread(pem, 1, CERTIFICATE_MAX_LENGTH, file);
+    fclose(file);
+    if (length == 0 || length == CERTIFICATE_MAX_LENGTH) {
+        error = RAWRTC_CODE_INVALID_ARGUMENT;
+        goto out;
+    }
+
+    // Create certificate
+    error = certificate_from_pem(certificatep, pem, length, key_type);
+
+out:
+    // Un-reference
+    mem_deref(pem);
+    return error;
+}
+
+/*
+ * Persist a certificate including its private key.
+ * Note: Written to a temporary file first which is then renamed, so a
+ *       concurrently starting process never sees a partial file.
+ */
+static enum rawrtc_code certificate_store(
+        struct rawrtc_certificate* const certificate,
+        char const* const path
+) {
+    char* pem = NULL;
+    size_t length;
+    char* temporary_path = NULL;
+    int fd = -1;
+    size_t offset = 0;
+    enum rawrtc_code error;
+
+    // Encode certificate & private key
+    error = rawrtc_certificate_to_pem(&pem, &length, certificate, RAWRTC_CERTIFICATE_ENCODE_BOTH);
+    if (error) {
+        goto out;
+    }
+
+    // Open temporary file (only accessible by the owner as it contains the private key)
+    error = rawrtc_sdprintf(&temporary_path, "%s.tmp", path);
+    if (error) {
+        goto out;
+    }
+    fd = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+        error = rawrtc_error_to_code(errno);
+        goto out;
+    }
+
+    // Write
+    while (offset < length) {
+        ssize_t const written = write(fd, pem + offset, length - offset);
+        if (written == -1) {
+            error = rawrtc_error_to_code(errno);
+            goto out;
+        }
+        offset += (size_t) written;
+    }
+
+    // Close & replace
+    if (close(fd) == -1) {
+        fd = -1;
+        error = rawrtc_error_to_code(errno);
+        goto out;
+    }
+    fd = -1;
+    if (rename(temporary_path, path) == -1) {
+        error = rawrtc_error_to_code(errno);
+        goto out;
+    }
+
+out:
+    if (fd != -1) {
+        close(fd);
+    }
+    if (error && temporary_path) {
+        unlink(temporary_path);
+    }
+
+    // Un-reference
+    mem_deref(temporary_path);
+    mem_deref(pem);
+    return error;
+}
+
+/*
+ * Get the certificate: Load it from the configured path (if any) if it
+ * is still valid. Otherwise, generate a new certificate and persist it
+ * to that path.
+ */
+enum rawrtc_code certificate_load_or_generate(
+        struct rawrtc_certificate** const certificatep, // de-referenced
+        struct terminal_options const* const options
+) {
+    char const* const path = options->certificate_path;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!certificatep || !options) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Not persisted?
+    if (!str_isset(path)) {
+        return certificate_generate(certificatep, options);
+    }
+
+    // Load (if still valid)
+    if (certificate_file_is_fresh(path, options->certificate_validity)) {
+        error = certificate_load(certificatep, path, options->certificate_key_type);
+        if (!error) {
+            DEBUG_INFO("Loaded certificate from %s\n", path);
+            return RAWRTC_CODE_SUCCESS;
+        }
+        DEBUG_WARNING("Could not load certificate from %s, reason: %s\n",
+                      path, rawrtc_code_to_str(error));
+    }
+
+    // Generate
+    error = certificate_generate(certificatep, options);
+    if (error) {
+        return error;
+    }
+
+    // Persist
+    // Note: Not fatal, the certificate will simply be generated again next time.
+    error = certificate_store(*certificatep, path);
+    if (error) {
+        DEBUG_WARNING("Could not store certificate to %s, reason: %s\n",
+                      path, rawrtc_code_to_str(error));
+    } else {
+        DEBUG_INFO("Stored certificate to %s\n", path);
+    }
+    return RAWRTC_CODE_SUCCESS;
+}
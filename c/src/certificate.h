@@ -0,0 +1,24 @@
+#pragma once
+#include <rawrtc.h>
+#include "options.h"
+
+/*
+ * Get the certificate: Load it from the configured path (if any) if it
+ * is still valid. Otherwise, generate a new certificate and persist it
+ * to that path.
+ */
+enum rawrtc_code certificate_load_or_generate(
+    struct rawrtc_certificate** const certificatep, // de-referenced
+    struct terminal_options const* const options
+);
+
+/*
+ * Create a certificate from its PEM encoding containing both the
+ * certificate and the private key.
+ */
+enum rawrtc_code certificate_from_pem(
+    struct rawrtc_certificate** const certificatep, // de-referenced
+    char const* const pem,
+    size_t const length,
+    enum rawrtc_certificate_key_type const key_type
+);
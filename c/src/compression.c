@@ -0,0 +1,101 @@
+#include <rawrtc.h>
+#include "compression.h"
+
+#define DEBUG_MODULE "rawrtc-terminal-compression"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+static void output_compressor_destroy(
+        void* arg
+) {
+    struct output_compressor* const compressor = arg;
+
+    // Free compression state
+    // Note: This is a no-op in case the stream has not been initialised.
+    deflateEnd(&compressor->stream);
+}
+
+/*
+ * Create a deflate compressor using compression level `level` (1-9).
+ */
+enum rawrtc_code output_compressor_create(
+        struct output_compressor** const compressorp, // de-referenced
+        int const level
+) {
+    struct output_compressor* compressor;
+    int ret;
+
+    // Check arguments
+    if (!compressorp || level < 1 || level > 9) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    compressor = mem_zalloc(sizeof(*compressor), output_compressor_destroy);
+    if (!compressor) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Initialise deflate stream
+    ret = deflateInit(&compressor->stream, level);
+    if (ret != Z_OK) {
+        DEBUG_WARNING("Cannot initialise deflate stream: %s\n", zError(ret));
+        mem_deref(compressor);
+        return ret == Z_MEM_ERROR ? RAWRTC_CODE_NO_MEMORY : RAWRTC_CODE_UNKNOWN_ERROR;
+    }
+
+    // Set pointer & done
+    *compressorp = compressor;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Compress the bytes left in `input` and append the compressed bytes to
+ * `output` until it contains `limit` bytes. The compressed bytes are
+ * flushed, so the remote peer can decompress all of `input` once it
+ * received them.
+ * `*completep` is set to `false` in case `output` has been filled and
+ * this function has to be called again with another output buffer.
+ */
+enum rawrtc_code output_compressor_write(
+        struct mbuf* const output,
+        size_t const limit,
+        bool* const completep, // de-referenced
+        struct output_compressor* const compressor,
+        struct mbuf* const input
+) {
+    z_stream* const stream = &compressor->stream;
+    size_t const input_length = mbuf_get_left(input);
+    size_t const output_length = limit - output->end;
+    size_t consumed;
+    size_t produced;
+    int ret;
+
+    // Check arguments
+    if (limit <= output->end || limit > output->size || input_length > UINT_MAX) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Compress & flush
+    stream->next_in = mbuf_buf(input);
+    stream->avail_in = (uInt) input_length;
+    stream->next_out = output->buf + output->end;
+    stream->avail_out = (uInt) output_length;
+    ret = deflate(stream, Z_SYNC_FLUSH);
+    if (ret != Z_OK && ret != Z_BUF_ERROR) { // Z_BUF_ERROR: Nothing left to flush
+        DEBUG_WARNING("Cannot compress: %s\n", zError(ret));
+        return RAWRTC_CODE_UNKNOWN_ERROR;
+    }
+
+    // Update buffers & counters
+    consumed = input_length - stream->avail_in;
+    produced = output_length - stream->avail_out;
+    mbuf_advance(input, (ssize_t) consumed);
+    output->end += produced;
+    compressor->n_input += consumed;
+    compressor->n_output += produced;
+
+    // Done once there was space left after flushing
+    *completep = stream->avail_out > 0;
+    return RAWRTC_CODE_SUCCESS;
+}
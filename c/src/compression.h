@@ -0,0 +1,45 @@
+#pragma once
+#include <zlib.h>
+#include <rawrtc.h>
+
+/*
+ * Compression algorithms of the output direction.
+ */
+enum compression_algorithm {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_DEFLATE = 1, // zlib format (RFC 1950), flushed after each message
+};
+
+/*
+ * Streaming compressor of a terminal's output. The compression window
+ * carries over from one message to the next.
+ */
+struct output_compressor {
+    z_stream stream;
+    uint64_t n_input; // in bytes
+    uint64_t n_output; // in bytes
+};
+
+/*
+ * Create a deflate compressor using compression level `level` (1-9).
+ */
+enum rawrtc_code output_compressor_create(
+    struct output_compressor** const compressorp, // de-referenced
+    int const level
+);
+
+/*
+ * Compress the bytes left in `input` and append the compressed bytes to
+ * `output` until it contains `limit` bytes. The compressed bytes are
+ * flushed, so the remote peer can decompress all of `input` once it
+ * received them.
+ * `*completep` is set to `false` in case `output` has been filled and
+ * this function has to be called again with another output buffer.
+ */
+enum rawrtc_code output_compressor_write(
+    struct mbuf* const output,
+    size_t const limit,
+    bool* const completep, // de-referenced
+    struct output_compressor* const compressor,
+    struct mbuf* const input
+);
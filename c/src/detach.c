@@ -0,0 +1,412 @@
+#include <string.h> // memcpy, strcmp
+#include <unistd.h> // close
+#include <signal.h> // SIGTERM, kill
+#include <sys/wait.h> // waitpid, WNOHANG
+#include <rawrtc.h>
+#include "helper/common.h"
+#include "detach.h"
+
+#define DEBUG_MODULE "rawrtc-terminal-detach"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+enum {
+    DETACHED_SHELLS_EXPIRY_INTERVAL = 1000, // in milliseconds
+};
+
+/*
+ * Process waiting to be reattached.
+ */
+struct detached_shell {
+    struct le le;
+    struct detached_shells* store; // borrowed
+    char token[SESSION_TOKEN_LENGTH + 1];
+    pid_t pid;
+    int pty;
+    struct output_ring* output;
+    uint64_t expires; // in jiffies
+};
+
+/*
+ * Terminated process waiting to be reaped.
+ */
+struct terminated_process {
+    struct le le;
+    pid_t pid;
+};
+
+static void output_ring_destroy(
+        void* arg
+) {
+    struct output_ring* const ring = arg;
+
+    // Un-reference
+    mem_deref(ring->buffer);
+}
+
+/*
+ * Create an output ring keeping the most recent `size` bytes.
+ */
+enum rawrtc_code output_ring_create(
+        struct output_ring** const ringp, // de-referenced
+        size_t const size
+) {
+    struct output_ring* ring;
+
+    // Check arguments
+    if (!ringp || size == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    ring = mem_zalloc(sizeof(*ring), output_ring_destroy);
+    if (!ring) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+    ring->buffer = mem_alloc(size, NULL);
+    if (!ring->buffer) {
+        mem_deref(ring);
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+    ring->size = size;
+
+    // Set pointer & done
+    *ringp = ring;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Append output.
+ */
+void output_ring_write(
+        struct output_ring* const ring,
+        uint8_t const* data,
+        size_t length
+) {
+    // Only the most recent bytes are kept
+    if (length > ring->size) {
+        ring->sequence += length - ring->size;
+        data += length - ring->size;
+        length = ring->size;
+    }
+
+    // Copy (in up to two parts)
+    while (length > 0) {
+        size_t const offset = (size_t) (ring->sequence % ring->size);
+        size_t const part = MIN(length, ring->size - offset);
+        memcpy(ring->buffer + offset, data, part);
+        ring->sequence += part;
+        data += part;
+        length -= part;
+    }
+}
+
+/*
+ * Read up to `length` bytes of output starting at `*sequencep`. If the
+ * requested output is no longer available, `*sequencep` is moved to the
+ * oldest available byte. Return the amount of bytes that have been
+ * copied.
+ */
+size_t output_ring_read(
+        uint8_t* data,
+        size_t const length,
+        uint64_t* const sequencep, // in/out
+        struct output_ring const* const ring
+) {
+    uint64_t const oldest = ring->sequence > ring->size ? ring->sequence - ring->size : 0;
+    uint64_t sequence = *sequencep;
+    size_t left;
+
+    // Clamp to available output
+    if (sequence < oldest) {
+        sequence = oldest;
+    } else if (sequence > ring->sequence) {
+        sequence = ring->sequence;
+    }
+    *sequencep = sequence;
+    left = (size_t) MIN(length, ring->sequence - sequence);
+
+    // Copy (in up to two parts)
+    while (left > 0) {
+        size_t const offset = (size_t) (sequence % ring->size);
+        size_t const part = MIN(left, ring->size - offset);
+        memcpy(data, ring->buffer + offset, part);
+        sequence += part;
+        data += part;
+        left -= part;
+    }
+    return (size_t) (sequence - *sequencep);
+}
+
+/*
+ * Generate a random session token (NUL-terminated).
+ */
+void session_token_generate(
+        char* const token // SESSION_TOKEN_LENGTH + 1
+) {
+    uint8_t random[SESSION_TOKEN_LENGTH / 2];
+    rand_bytes(random, sizeof(random));
+    re_snprintf(token, SESSION_TOKEN_LENGTH + 1, "%w", random, sizeof(random));
+}
+
+static void detached_shell_destroy(
+        void* arg
+) {
+    struct detached_shell* const shell = arg;
+
+    // Remove from list
+    list_unlink(&shell->le);
+
+    // Close PTY & terminate process (if not reattached)
+    if (shell->pty != -1) {
+        EOP(close(shell->pty));
+    }
+    if (shell->pid != -1) {
+        struct terminated_process* process;
+        EOP(kill(shell->pid, SIGTERM));
+
+        // Reap once it exited (unless it already did)
+        if (waitpid(shell->pid, NULL, WNOHANG) == 0) {
+            process = mem_zalloc(sizeof(*process), NULL);
+            if (!process) {
+                EOE(RAWRTC_CODE_NO_MEMORY);
+            } else {
+                process->pid = shell->pid;
+                list_append(&shell->store->terminated, &process->le, process);
+            }
+        }
+    }
+
+    // Un-reference
+    mem_deref(shell->output);
+}
+
+/*
+ * Reap terminated processes that exited in the meantime.
+ */
+static void reap_terminated(
+        struct detached_shells* const store
+) {
+    struct le* le = list_head(&store->terminated);
+    while (le) {
+        struct terminated_process* const process = le->data;
+        pid_t const reaped = waitpid(process->pid, NULL, WNOHANG);
+        le = le->next;
+
+        // Still running?
+        if (reaped == 0) {
+            continue;
+        }
+
+        // Reaped (or not a child of ours anymore)
+        if (reaped == -1) {
+            DEBUG_WARNING("Cannot reap process (pid=%d): %m\n", process->pid, errno);
+        }
+        list_unlink(&process->le);
+        mem_deref(process);
+    }
+}
+
+/*
+ * Terminate processes whose grace period expired, remove processes that
+ * exited by themselves and reap terminated processes.
+ */
+static void expiry_timer_handler(
+        void* arg
+) {
+    struct detached_shells* const store = arg;
+    uint64_t const now = tmr_jiffies();
+    struct list expired = LIST_INIT;
+    struct list exited = LIST_INIT;
+    struct le* le;
+
+    // Remove expired & exited (reaps them) processes
+    lock_write_get(store->lock);
+    le = list_head(&store->shells);
+    while (le) {
+        struct detached_shell* const shell = le->data;
+        le = le->next;
+        if (waitpid(shell->pid, NULL, WNOHANG) > 0) {
+            list_unlink(&shell->le);
+            list_append(&exited, &shell->le, shell);
+        } else if (shell->expires <= now) {
+            list_unlink(&shell->le);
+            list_append(&expired, &shell->le, shell);
+        }
+    }
+    lock_rel(store->lock);
+
+    // Terminate (outside of the lock)
+    for (le = list_head(&exited); le != NULL; le = le->next) {
+        struct detached_shell* const shell = le->data;
+        DEBUG_INFO("Detached process (pid=%d) exited\n", shell->pid);
+        shell->pid = -1;
+    }
+    list_flush(&exited);
+    for (le = list_head(&expired); le != NULL; le = le->next) {
+        struct detached_shell* const shell = le->data;
+        DEBUG_INFO("Grace period of detached process (pid=%d) expired\n", shell->pid);
+    }
+    list_flush(&expired);
+
+    // Reap terminated processes
+    reap_terminated(store);
+
+    // Restart timer
+    tmr_start(&store->expiry_timer, DETACHED_SHELLS_EXPIRY_INTERVAL, expiry_timer_handler, store);
+}
+
+static void detached_shells_destroy(
+        void* arg
+) {
+    struct detached_shells* const store = arg;
+
+    // Stop timer & terminate detached processes
+    // Note: Processes that did not exit right away are not being reaped as the application exits.
+    tmr_cancel(&store->expiry_timer);
+    list_flush(&store->shells);
+    reap_terminated(store);
+    list_flush(&store->terminated);
+
+    // Un-reference
+    mem_deref(store->lock);
+}
+
+/*
+ * Create a store for detached processes.
+ * The expiry timer runs on the calling thread.
+ */
+enum rawrtc_code detached_shells_create(
+        struct detached_shells** const storep // de-referenced
+) {
+    struct detached_shells* store;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!storep) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    store = mem_zalloc(sizeof(*store), detached_shells_destroy);
+    if (!store) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields
+    error = rawrtc_error_to_code(lock_alloc(&store->lock));
+    if (error) {
+        mem_deref(store);
+        return error;
+    }
+    list_init(&store->shells);
+    list_init(&store->terminated);
+
+    // Start expiry timer
+    tmr_init(&store->expiry_timer);
+    tmr_start(&store->expiry_timer, DETACHED_SHELLS_EXPIRY_INTERVAL, expiry_timer_handler, store);
+
+    // Set pointer & done
+    *storep = store;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Detach a process which will be terminated once it has been detached
+ * for `timeout` milliseconds. The store takes ownership of the process,
+ * its PTY and the output ring.
+ */
+void detached_shells_put(
+        struct detached_shells* const store,
+        char const* const token,
+        pid_t const pid,
+        int const pty,
+        struct output_ring* const output,
+        uint32_t const timeout
+) {
+    struct detached_shell* shell;
+
+    // Allocate
+    shell = mem_zalloc(sizeof(*shell), detached_shell_destroy);
+    if (!shell) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+
+    // Set fields
+    shell->store = store;
+    memcpy(shell->token, token, sizeof(shell->token));
+    shell->token[SESSION_TOKEN_LENGTH] = '\0';
+    shell->pid = pid;
+    shell->pty = pty;
+    shell->output = output;
+    shell->expires = tmr_jiffies() + timeout;
+
+    // Add to store
+    lock_write_get(store->lock);
+    list_append(&store->shells, &shell->le, shell);
+    lock_rel(store->lock);
+    DEBUG_INFO("Detached process (pid=%d), waiting %"PRIu32" ms to be reattached\n",
+               pid, timeout);
+}
+
+/*
+ * Reattach a process. Return `RAWRTC_CODE_NO_VALUE` in case no process
+ * has been detached with that token (or it expired).
+ * The caller owns the process, its PTY and the output ring.
+ */
+enum rawrtc_code detached_shells_take(
+        pid_t* const pidp, // de-referenced
+        int* const ptyp, // de-referenced
+        struct output_ring** const outputp, // de-referenced
+        struct detached_shells* const store,
+        char const* const token
+) {
+    struct detached_shell* shell = NULL;
+    struct le* le;
+
+    // Check arguments
+    if (!pidp || !ptyp || !outputp || !store || !token) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Find & remove
+    lock_write_get(store->lock);
+    for (le = list_head(&store->shells); le != NULL; le = le->next) {
+        struct detached_shell* const candidate = le->data;
+        if (strcmp(candidate->token, token) == 0) {
+            shell = candidate;
+            list_unlink(&shell->le);
+            break;
+        }
+    }
+    lock_rel(store->lock);
+    if (!shell) {
+        return RAWRTC_CODE_NO_VALUE;
+    }
+
+    // Hand over process, PTY & output
+    *pidp = shell->pid;
+    *ptyp = shell->pty;
+    *outputp = shell->output;
+    shell->pid = -1;
+    shell->pty = -1;
+    shell->output = NULL;
+    mem_deref(shell);
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Print the amount of detached processes.
+ */
+int detached_shells_debug(
+        struct re_printf* const pf,
+        struct detached_shells* const store
+) {
+    uint32_t n_shells;
+
+    lock_read_get(store->lock);
+    n_shells = list_count(&store->shells);
+    lock_rel(store->lock);
+    return re_hprintf(pf, "Detached processes: %"PRIu32"\n", n_shells);
+}
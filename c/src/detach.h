@@ -0,0 +1,111 @@
+#pragma once
+#include <sys/types.h> // pid_t
+#include <rawrtc.h>
+
+enum {
+    SESSION_TOKEN_LENGTH = 32, // hex characters
+};
+
+/*
+ * Output that has been sent on a data channel. The most recent `size`
+ * bytes are kept to be replayed after reattaching.
+ */
+struct output_ring {
+    uint8_t* buffer;
+    size_t size;
+    uint64_t sequence; // bytes written in total
+};
+
+/*
+ * Processes whose data channel has gone away. They wait to be
+ * reattached by a new data channel presenting the session token until
+ * their grace period expires. Shared by all threads.
+ * Note: The PTYs of detached processes are not being read from, so
+ *       their output stays buffered in the PTY until reattached.
+ */
+struct detached_shells {
+    struct lock* lock;
+    struct list shells; // guarded by lock
+    struct tmr expiry_timer; // owning thread only
+    struct list terminated; // owning thread only, waiting to be reaped
+};
+
+/*
+ * Create an output ring keeping the most recent `size` bytes.
+ */
+enum rawrtc_code output_ring_create(
+    struct output_ring** const ringp, // de-referenced
+    size_t const size
+);
+
+/*
+ * Append output.
+ */
+void output_ring_write(
+    struct output_ring* const ring,
+    uint8_t const* const data,
+    size_t const length
+);
+
+/*
+ * Read up to `length` bytes of output starting at `*sequencep`. If the
+ * requested output is no longer available, `*sequencep` is moved to the
+ * oldest available byte. Return the amount of bytes that have been
+ * copied.
+ */
+size_t output_ring_read(
+    uint8_t* const data,
+    size_t const length,
+    uint64_t* const sequencep, // in/out
+    struct output_ring const* const ring
+);
+
+/*
+ * Generate a random session token (NUL-terminated).
+ */
+void session_token_generate(
+    char* const token // SESSION_TOKEN_LENGTH + 1
+);
+
+/*
+ * Create a store for detached processes.
+ * The expiry timer runs on the calling thread.
+ */
+enum rawrtc_code detached_shells_create(
+    struct detached_shells** const storep // de-referenced
+);
+
+/*
+ * Detach a process which will be terminated once it has been detached
+ * for `timeout` milliseconds. The store takes ownership of the process,
+ * its PTY and the output ring.
+ */
+void detached_shells_put(
+    struct detached_shells* const store,
+    char const* const token,
+    pid_t const pid,
+    int const pty,
+    struct output_ring* const output,
+    uint32_t const timeout
+);
+
+/*
+ * Reattach a process. Return `RAWRTC_CODE_NO_VALUE` in case no process
+ * has been detached with that token (or it expired).
+ * The caller owns the process, its PTY and the output ring.
+ */
+enum rawrtc_code detached_shells_take(
+    pid_t* const pidp, // de-referenced
+    int* const ptyp, // de-referenced
+    struct output_ring** const outputp, // de-referenced
+    struct detached_shells* const store,
+    char const* const token
+);
+
+/*
+ * Print the amount of detached processes.
+ */
+int detached_shells_debug(
+    struct re_printf* const pf,
+    struct detached_shells* const store
+);
@@ -0,0 +1,181 @@
+#include <rawrtc.h>
+#include "common.h"
+#include "buffer_pool.h"
+
+#define DEBUG_MODULE "helper-buffer-pool"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+static void buffer_pool_destroy(
+        void* arg
+) {
+    struct buffer_pool* const pool = arg;
+    size_t i;
+
+    // Un-reference free buffers
+    for (i = 0; i < pool->n_free; ++i) {
+        mem_deref(pool->free[i]);
+    }
+
+    // Un-reference parked buffers
+    for (i = 0; i < pool->n_parked; ++i) {
+        mem_deref(pool->parked[i]);
+    }
+
+    // Un-reference
+    mem_deref(pool->parked);
+    mem_deref(pool->free);
+}
+
+/*
+ * Create a buffer pool holding up to `capacity` buffers of
+ * `buffer_size` bytes each. All buffers are allocated immediately.
+ */
+enum rawrtc_code buffer_pool_create(
+        struct buffer_pool** const poolp, // de-referenced
+        size_t const capacity,
+        size_t const buffer_size
+) {
+    struct buffer_pool* pool;
+    enum rawrtc_code error = RAWRTC_CODE_SUCCESS;
+
+    // Check arguments
+    if (!poolp || buffer_size == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    pool = mem_zalloc(sizeof(*pool), buffer_pool_destroy);
+    if (!pool) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields
+    pool->buffer_size = buffer_size;
+    pool->capacity = capacity;
+
+    // Allocate slots
+    pool->free = mem_zalloc(sizeof(*pool->free) * (capacity + 1), NULL);
+    pool->parked = mem_zalloc(sizeof(*pool->parked) * (capacity + 1), NULL);
+    if (!pool->free || !pool->parked) {
+        error = RAWRTC_CODE_NO_MEMORY;
+        goto out;
+    }
+
+    // Pre-allocate buffers
+    for (pool->n_free = 0; pool->n_free < capacity; ++pool->n_free) {
+        pool->free[pool->n_free] = mbuf_alloc(buffer_size);
+        if (!pool->free[pool->n_free]) {
+            error = RAWRTC_CODE_NO_MEMORY;
+            goto out;
+        }
+    }
+
+out:
+    if (error) {
+        mem_deref(pool);
+    } else {
+        // Set pointer
+        *poolp = pool;
+    }
+    return error;
+}
+
+/*
+ * Move parked buffers that are no longer referenced elsewhere back to
+ * the free list.
+ */
+static void buffer_pool_reclaim(
+        struct buffer_pool* const pool
+) {
+    size_t i = 0;
+
+    while (i < pool->n_parked) {
+        struct mbuf* const buffer = pool->parked[i];
+
+        // Still in use?
+        if (mem_nrefs(buffer) > 1) {
+            ++i;
+            continue;
+        }
+
+        // Move to free list (fill the gap with the last parked buffer)
+        pool->free[pool->n_free++] = buffer;
+        pool->parked[i] = pool->parked[--pool->n_parked];
+        ++pool->reclaimed;
+    }
+}
+
+/*
+ * Get an empty buffer from the pool. Allocates a new buffer in case
+ * the pool is exhausted.
+ * The caller owns the returned reference and MUST hand it back by
+ * calling `buffer_pool_release`.
+ */
+struct mbuf* buffer_pool_get(
+        struct buffer_pool* const pool
+) {
+    struct mbuf* buffer;
+
+    // Reclaim parked buffers (if exhausted)
+    if (pool->n_free == 0) {
+        buffer_pool_reclaim(pool);
+    }
+
+    // Exhausted?
+    if (pool->n_free == 0) {
+        ++pool->misses;
+        buffer = mbuf_alloc(pool->buffer_size);
+        if (!buffer) {
+            EOE(RAWRTC_CODE_NO_MEMORY);
+        }
+        return buffer;
+    }
+
+    // Take from free list
+    ++pool->hits;
+    buffer = pool->free[--pool->n_free];
+    mbuf_rewind(buffer);
+    return buffer;
+}
+
+/*
+ * Release a buffer that has been retrieved by `buffer_pool_get`.
+ * Takes over the caller's reference.
+ */
+void buffer_pool_release(
+        struct buffer_pool* const pool,
+        struct mbuf* const buffer
+) {
+    // Pool full or buffer has been resized? Drop it.
+    if (pool->n_free + pool->n_parked >= pool->capacity || buffer->size != pool->buffer_size) {
+        ++pool->dropped;
+        mem_deref(buffer);
+        return;
+    }
+
+    // Still referenced by someone else? Park it until released.
+    if (mem_nrefs(buffer) > 1) {
+        pool->parked[pool->n_parked++] = buffer;
+    } else {
+        pool->free[pool->n_free++] = buffer;
+    }
+}
+
+/*
+ * Print buffer pool statistics.
+ */
+int buffer_pool_debug(
+        struct re_printf* const pf,
+        struct buffer_pool const* const pool
+) {
+    if (!pool) {
+        return 0;
+    }
+
+    return re_hprintf(
+            pf, "buffer pool: size=%zu, capacity=%zu, free=%zu, parked=%zu, hits=%"PRIu64""
+                ", misses=%"PRIu64", reclaimed=%"PRIu64", dropped=%"PRIu64"",
+            pool->buffer_size, pool->capacity, pool->n_free, pool->n_parked, pool->hits,
+            pool->misses, pool->reclaimed, pool->dropped);
+}
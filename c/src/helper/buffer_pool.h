@@ -0,0 +1,62 @@
+#pragma once
+#include <rawrtc.h>
+#include "common.h"
+
+/*
+ * Buffer pool of fixed-size buffers.
+ *
+ * Buffers handed out by the pool are regular (referenced) `struct mbuf`
+ * instances, so they can be passed to functions that take another
+ * reference (e.g. `rawrtc_data_channel_send`). Once released, a buffer
+ * that is still referenced elsewhere is parked until the last foreign
+ * reference has been dropped and is then reused.
+ */
+struct buffer_pool {
+    size_t buffer_size;
+    size_t capacity;
+    struct mbuf** free;
+    size_t n_free;
+    struct mbuf** parked;
+    size_t n_parked;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t reclaimed;
+    uint64_t dropped;
+};
+
+/*
+ * Create a buffer pool holding up to `capacity` buffers of
+ * `buffer_size` bytes each. All buffers are allocated immediately.
+ */
+enum rawrtc_code buffer_pool_create(
+    struct buffer_pool** const poolp, // de-referenced
+    size_t const capacity,
+    size_t const buffer_size
+);
+
+/*
+ * Get an empty buffer from the pool. Allocates a new buffer in case
+ * the pool is exhausted.
+ * The caller owns the returned reference and MUST hand it back by
+ * calling `buffer_pool_release`.
+ */
+struct mbuf* buffer_pool_get(
+    struct buffer_pool* const pool
+);
+
+/*
+ * Release a buffer that has been retrieved by `buffer_pool_get`.
+ * Takes over the caller's reference.
+ */
+void buffer_pool_release(
+    struct buffer_pool* const pool,
+    struct mbuf* const buffer
+);
+
+/*
+ * Print buffer pool statistics.
+ */
+int buffer_pool_debug(
+    struct re_printf* const pf,
+    struct buffer_pool const* const pool
+);
@@ -0,0 +1,181 @@
+#include <string.h> // memcpy
+#include <rawrtc.h>
+#include "common.h"
+#include "buffer_queue.h"
+
+#define DEBUG_MODULE "helper-buffer-queue"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+static void buffer_queue_destroy(
+        void* arg
+) {
+    struct buffer_queue* const queue = arg;
+
+    // Un-reference queued buffers
+    while (queue->n_entries > 0) {
+        mem_deref(buffer_queue_pop(queue));
+    }
+
+    // Un-reference
+    mem_deref(queue->entries);
+}
+
+/*
+ * Create a buffer queue with an initial capacity of `capacity`
+ * buffers.
+ */
+enum rawrtc_code buffer_queue_create(
+        struct buffer_queue** const queuep, // de-referenced
+        size_t const capacity
+) {
+    struct buffer_queue* queue;
+
+    // Check arguments
+    if (!queuep || capacity == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    queue = mem_zalloc(sizeof(*queue), buffer_queue_destroy);
+    if (!queue) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Allocate entries
+    queue->entries = mem_zalloc(sizeof(*queue->entries) * capacity, NULL);
+    if (!queue->entries) {
+        mem_deref(queue);
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+    queue->capacity = capacity;
+
+    // Set pointer & done
+    *queuep = queue;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Double the capacity of the queue.
+ */
+static enum rawrtc_code buffer_queue_grow(
+        struct buffer_queue* const queue
+) {
+    size_t const capacity = queue->capacity * 2;
+    struct buffer_queue_entry* entries;
+    size_t i;
+
+    // Allocate entries
+    entries = mem_zalloc(sizeof(*entries) * capacity, NULL);
+    if (!entries) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Copy entries in order
+    for (i = 0; i < queue->n_entries; ++i) {
+        memcpy(&entries[i], &queue->entries[(queue->head + i) % queue->capacity],
+               sizeof(*entries));
+    }
+
+    // Replace entries
+    mem_deref(queue->entries);
+    queue->entries = entries;
+    queue->capacity = capacity;
+    queue->head = 0;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Append a buffer to the queue. The buffer will be referenced and its
+ * amount of bytes left will be accounted for.
+ */
+enum rawrtc_code buffer_queue_push(
+        struct buffer_queue* const queue,
+        struct mbuf* const buffer
+) {
+    struct buffer_queue_entry* entry;
+
+    // Check arguments
+    if (!queue || !buffer) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Grow (if full)
+    if (queue->n_entries == queue->capacity) {
+        enum rawrtc_code const error = buffer_queue_grow(queue);
+        if (error) {
+            return error;
+        }
+    }
+
+    // Append
+    entry = &queue->entries[(queue->head + queue->n_entries) % queue->capacity];
+    entry->buffer = mem_ref(buffer);
+    entry->length = mbuf_get_left(buffer);
+    ++queue->n_entries;
+    queue->length += entry->length;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Get the first buffer of the queue without removing it.
+ * Returns `NULL` in case the queue is empty.
+ */
+struct mbuf* buffer_queue_peek(
+        struct buffer_queue* const queue
+) {
+    if (queue->n_entries == 0) {
+        return NULL;
+    }
+    return queue->entries[queue->head].buffer;
+}
+
+/*
+ * Account for `size` bytes of the first buffer having been consumed.
+ * The caller is expected to have advanced the buffer's position itself.
+ * The buffer will be removed from the queue and un-referenced once no
+ * bytes are left.
+ */
+void buffer_queue_advance(
+        struct buffer_queue* const queue,
+        size_t const size
+) {
+    struct buffer_queue_entry* entry;
+
+    // Empty?
+    if (queue->n_entries == 0) {
+        return;
+    }
+
+    // Account (or remove if consumed completely)
+    entry = &queue->entries[queue->head];
+    if (size >= entry->length) {
+        mem_deref(buffer_queue_pop(queue));
+    } else {
+        entry->length -= size;
+        queue->length -= size;
+    }
+}
+
+/*
+ * Remove the first buffer from the queue.
+ * The caller owns the returned reference.
+ * Returns `NULL` in case the queue is empty.
+ */
+struct mbuf* buffer_queue_pop(
+        struct buffer_queue* const queue
+) {
+    struct buffer_queue_entry* entry;
+
+    // Empty?
+    if (queue->n_entries == 0) {
+        return NULL;
+    }
+
+    // Remove
+    entry = &queue->entries[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    --queue->n_entries;
+    queue->length -= entry->length;
+    return entry->buffer;
+}
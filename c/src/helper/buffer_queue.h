@@ -0,0 +1,69 @@
+#pragma once
+#include <rawrtc.h>
+#include "common.h"
+
+/*
+ * Buffer queue entry.
+ */
+struct buffer_queue_entry {
+    struct mbuf* buffer;
+    size_t length;
+};
+
+/*
+ * FIFO queue of referenced buffers. Keeps track of the amount of bytes
+ * that have been queued. Grows on demand.
+ */
+struct buffer_queue {
+    struct buffer_queue_entry* entries;
+    size_t capacity;
+    size_t head;
+    size_t n_entries;
+    size_t length;
+};
+
+/*
+ * Create a buffer queue with an initial capacity of `capacity`
+ * buffers.
+ */
+enum rawrtc_code buffer_queue_create(
+    struct buffer_queue** const queuep, // de-referenced
+    size_t const capacity
+);
+
+/*
+ * Append a buffer to the queue. The buffer will be referenced and its
+ * amount of bytes left will be accounted for.
+ */
+enum rawrtc_code buffer_queue_push(
+    struct buffer_queue* const queue,
+    struct mbuf* const buffer
+);
+
+/*
+ * Get the first buffer of the queue without removing it.
+ * Returns `NULL` in case the queue is empty.
+ */
+struct mbuf* buffer_queue_peek(
+    struct buffer_queue* const queue
+);
+
+/*
+ * Account for `size` bytes of the first buffer having been consumed.
+ * The caller is expected to have advanced the buffer's position itself.
+ * The buffer will be removed from the queue and un-referenced once no
+ * bytes are left.
+ */
+void buffer_queue_advance(
+    struct buffer_queue* const queue,
+    size_t const size
+);
+
+/*
+ * Remove the first buffer from the queue.
+ * The caller owns the returned reference.
+ * Returns `NULL` in case the queue is empty.
+ */
+struct mbuf* buffer_queue_pop(
+    struct buffer_queue* const queue
+);
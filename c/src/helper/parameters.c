@@ -34,6 +34,62 @@ void set_ice_parameters(
     mem_deref(username_fragment);
 }
 
+/*
+ * Set ICE candidate in dictionary.
+ */
+void set_ice_candidate(
+        struct rawrtc_ice_candidate* const candidate,
+        struct odict* const dict
+) {
+    enum rawrtc_code error;
+    char* foundation;
+    uint32_t priority;
+    char* ip;
+    enum rawrtc_ice_protocol protocol;
+    uint16_t port;
+    enum rawrtc_ice_candidate_type type;
+    enum rawrtc_ice_tcp_candidate_type tcp_type = RAWRTC_ICE_TCP_CANDIDATE_TYPE_ACTIVE;
+    char* related_address = NULL;
+    uint16_t related_port = 0;
+
+    // Get values
+    EOE(rawrtc_ice_candidate_get_foundation(&foundation, candidate));
+    EOE(rawrtc_ice_candidate_get_priority(&priority, candidate));
+    EOE(rawrtc_ice_candidate_get_ip(&ip, candidate));
+    EOE(rawrtc_ice_candidate_get_protocol(&protocol, candidate));
+    EOE(rawrtc_ice_candidate_get_port(&port, candidate));
+    EOE(rawrtc_ice_candidate_get_type(&type, candidate));
+    error = rawrtc_ice_candidate_get_tcp_type(&tcp_type, candidate);
+    EOE(error == RAWRTC_CODE_NO_VALUE ? RAWRTC_CODE_SUCCESS : error);
+    error = rawrtc_ice_candidate_get_related_address(&related_address, candidate);
+    EOE(error == RAWRTC_CODE_NO_VALUE ? RAWRTC_CODE_SUCCESS : error);
+    error = rawrtc_ice_candidate_get_related_port(&related_port, candidate);
+    EOE(error == RAWRTC_CODE_NO_VALUE ? RAWRTC_CODE_SUCCESS : error);
+
+    // Set ICE candidate values
+    EOR(odict_entry_add(dict, "foundation", ODICT_STRING, foundation));
+    EOR(odict_entry_add(dict, "priority", ODICT_INT, (int64_t) priority));
+    EOR(odict_entry_add(dict, "ip", ODICT_STRING, ip));
+    EOR(odict_entry_add(dict, "protocol", ODICT_STRING, rawrtc_ice_protocol_to_str(protocol)));
+    EOR(odict_entry_add(dict, "port", ODICT_INT, (int64_t) port));
+    EOR(odict_entry_add(dict, "type", ODICT_STRING, rawrtc_ice_candidate_type_to_str(type)));
+    if (protocol == RAWRTC_ICE_PROTOCOL_TCP) {
+        EOR(odict_entry_add(dict, "tcpType", ODICT_STRING,
+                            rawrtc_ice_tcp_candidate_type_to_str(tcp_type)));
+    }
+    if (related_address) {
+        EOR(odict_entry_add(dict, "relatedAddress", ODICT_STRING, related_address));
+    }
+    if (related_port) {
+        EOR(odict_entry_add(dict, "relatedPort", ODICT_INT, (int64_t) related_port));
+    }
+
+    // Un-reference values
+    mem_deref(related_address);
+    mem_deref(ip);
+    mem_deref(foundation);
+}
+
 /*
  * Set ICE candidates in dictionary.
  */
@@ -46,53 +102,13 @@ void set_ice_candidates(
 
     // Set ICE candidates
     for (i = 0; i < parameters->n_candidates; ++i) {
-        enum rawrtc_code error;
-        struct rawrtc_ice_candidate* const candidate = parameters->candidates[i];
-        char* foundation;
-        uint32_t priority;
-        char* ip;
-        enum rawrtc_ice_protocol protocol;
-        uint16_t port;
-        enum rawrtc_ice_candidate_type type;
-        enum rawrtc_ice_tcp_candidate_type tcp_type = RAWRTC_ICE_TCP_CANDIDATE_TYPE_ACTIVE;
-        char* related_address = NULL;
-        uint16_t related_port = 0;
         char* key;
 
         // Create object
         EOR(odict_alloc(&node, 16));
 
-        // Get values
-        EOE(rawrtc_ice_candidate_get_foundation(&foundation, candidate));
-        EOE(rawrtc_ice_candidate_get_priority(&priority, candidate));
-        EOE(rawrtc_ice_candidate_get_ip(&ip, candidate));
-        EOE(rawrtc_ice_candidate_get_protocol(&protocol, candidate));
-        EOE(rawrtc_ice_candidate_get_port(&port, candidate));
-        EOE(rawrtc_ice_candidate_get_type(&type, candidate));
-        error = rawrtc_ice_candidate_get_tcp_type(&tcp_type, candidate);
-        EOE(error == RAWRTC_CODE_NO_VALUE ? RAWRTC_CODE_SUCCESS : error);
-        error = rawrtc_ice_candidate_get_related_address(&related_address, candidate);
-        EOE(error == RAWRTC_CODE_NO_VALUE ? RAWRTC_CODE_SUCCESS : error);
-        error = rawrtc_ice_candidate_get_related_port(&related_port, candidate);
-        EOE(error == RAWRTC_CODE_NO_VALUE ? RAWRTC_CODE_SUCCESS : error);
-
-        // Set ICE candidate values
-        EOR(odict_entry_add(node, "foundation", ODICT_STRING, foundation));
-        EOR(odict_entry_add(node, "priority", ODICT_INT, (int64_t) priority));
-        EOR(odict_entry_add(node, "ip", ODICT_STRING, ip));
-        EOR(odict_entry_add(node, "protocol", ODICT_STRING, rawrtc_ice_protocol_to_str(protocol)));
-        EOR(odict_entry_add(node, "port", ODICT_INT, (int64_t) port));
-        EOR(odict_entry_add(node, "type", ODICT_STRING, rawrtc_ice_candidate_type_to_str(type)));
-        if (protocol == RAWRTC_ICE_PROTOCOL_TCP) {
-            EOR(odict_entry_add(node, "tcpType", ODICT_STRING,
-                                rawrtc_ice_tcp_candidate_type_to_str(tcp_type)));
-        }
-        if (related_address) {
-            EOR(odict_entry_add(node, "relatedAddress", ODICT_STRING, related_address));
-        }
-        if (related_port) {
-            EOR(odict_entry_add(node, "relatedPort", ODICT_INT, (int64_t) related_port));
-        }
+        // Set ICE candidate
+        set_ice_candidate(parameters->candidates[i], node);
 
         // Add to array
         EOE(rawrtc_sdprintf(&key, "%zu", i));
@@ -100,9 +116,6 @@ void set_ice_candidates(
 
         // Un-reference values
         mem_deref(key);
-        mem_deref(related_address);
-        mem_deref(ip);
-        mem_deref(foundation);
         mem_deref(node);
     }
 }
@@ -227,6 +240,72 @@ static void ice_candidates_destroy(
     }
 }
 
+/*
+ * Get ICE candidate from dictionary.
+ * Filter by enabled ICE candidate types if `client` argument is set to
+ * non-NULL. `*candidatep` will be set to NULL if the candidate has been
+ * filtered.
+ */
+enum rawrtc_code get_ice_candidate(
+        struct rawrtc_ice_candidate** const candidatep,
+        struct odict* const dict,
+        struct client* const client
+) {
+    enum rawrtc_code error = RAWRTC_CODE_SUCCESS;
+    char const* type_str = NULL;
+    enum rawrtc_ice_candidate_type type;
+    char* foundation;
+    uint32_t priority;
+    char* ip;
+    char const* protocol_str = NULL;
+    enum rawrtc_ice_protocol protocol;
+    uint16_t port;
+    char const* tcp_type_str = NULL;
+    enum rawrtc_ice_tcp_candidate_type tcp_type = RAWRTC_ICE_TCP_CANDIDATE_TYPE_ACTIVE;
+    char* related_address = NULL;
+    uint16_t related_port = 0;
+    struct rawrtc_ice_candidate* candidate;
+
+    // Get ICE candidate
+    error |= dict_get_entry(&type_str, dict, "type", ODICT_STRING, true);
+    error |= rawrtc_str_to_ice_candidate_type(&type, type_str);
+    error |= dict_get_entry(&foundation, dict, "foundation", ODICT_STRING, true);
+    error |= dict_get_uint32(&priority, dict, "priority", true);
+    error |= dict_get_entry(&ip, dict, "ip", ODICT_STRING, true);
+    error |= dict_get_entry(&protocol_str, dict, "protocol", ODICT_STRING, true);
+    error |= rawrtc_str_to_ice_protocol(&protocol, protocol_str);
+    error |= dict_get_uint16(&port, dict, "port", true);
+    if (protocol == RAWRTC_ICE_PROTOCOL_TCP) {
+        error |= dict_get_entry(&tcp_type_str, dict, "tcpType", ODICT_STRING, true);
+        error |= rawrtc_str_to_ice_tcp_candidate_type(&tcp_type, tcp_type_str);
+    }
+    dict_get_entry(&related_address, dict, "relatedAddress", ODICT_STRING, false);
+    dict_get_uint16(&related_port, dict, "relatedPort", false);
+    if (error) {
+        return error;
+    }
+
+    // Create ICE candidate
+    error = rawrtc_ice_candidate_create(
+            &candidate, foundation, priority, ip, protocol, port, type,
+            tcp_type, related_address, related_port);
+    if (error) {
+        return error;
+    }
+
+    // Print ICE candidate
+    print_ice_candidate(candidate, NULL, client);
+
+    // Set pointer (if ICE candidate type enabled)
+    if (ice_candidate_type_enabled(client, type)) {
+        *candidatep = candidate;
+    } else {
+        mem_deref(candidate);
+        *candidatep = NULL;
+    }
+    return RAWRTC_CODE_SUCCESS;
+}
+
 /*
  * Get ICE candidates from dictionary.
  * Filter by enabled ICE candidate types if `client` argument is set to
@@ -257,55 +336,17 @@ enum rawrtc_code get_ice_candidates(
     // Get ICE candidates
     for (le = list_head(&dict->lst); le != NULL; le = le->next) {
         struct odict* const node = ((struct odict_entry*) le->data)->u.odict;
-        char const* type_str = NULL;
-        enum rawrtc_ice_candidate_type type;
-        char* foundation;
-        uint32_t priority;
-        char* ip;
-        char const* protocol_str = NULL;
-        enum rawrtc_ice_protocol protocol;
-        uint16_t port;
-        char const* tcp_type_str = NULL;
-        enum rawrtc_ice_tcp_candidate_type tcp_type = RAWRTC_ICE_TCP_CANDIDATE_TYPE_ACTIVE;
-        char* related_address = NULL;
-        uint16_t related_port = 0;
         struct rawrtc_ice_candidate* candidate;
 
         // Get ICE candidate
-        error |= dict_get_entry(&type_str, node, "type", ODICT_STRING, true);
-        error |= rawrtc_str_to_ice_candidate_type(&type, type_str);
-        error |= dict_get_entry(&foundation, node, "foundation", ODICT_STRING, true);
-        error |= dict_get_uint32(&priority, node, "priority", true);
-        error |= dict_get_entry(&ip, node, "ip", ODICT_STRING, true);
-        error |= dict_get_entry(&protocol_str, node, "protocol", ODICT_STRING, true);
-        error |= rawrtc_str_to_ice_protocol(&protocol, protocol_str);
-        error |= dict_get_uint16(&port, node, "port", true);
-        if (protocol == RAWRTC_ICE_PROTOCOL_TCP) {
-            error |= dict_get_entry(&tcp_type_str, node, "tcpType", ODICT_STRING, true);
-            error |= rawrtc_str_to_ice_tcp_candidate_type(&tcp_type, tcp_type_str);
-        }
-        dict_get_entry(&related_address, node, "relatedAddress", ODICT_STRING, false);
-        dict_get_uint16(&related_port, node, "relatedPort", false);
-        if (error) {
-            goto out;
-        }
-
-        // Create and add ICE candidate
-        error = rawrtc_ice_candidate_create(
-                &candidate, foundation, priority, ip, protocol, port, type,
-                tcp_type, related_address, related_port);
+        error = get_ice_candidate(&candidate, node, client);
         if (error) {
             goto out;
         }
 
-        // Print ICE candidate
-        print_ice_candidate(candidate, NULL, client);
-
-        // Store if ICE candidate type enabled
-        if (ice_candidate_type_enabled(client, type)) {
+        // Store (if not filtered)
+        if (candidate) {
             candidates->candidates[candidates->n_candidates++] = candidate;
-        } else {
-            mem_deref(candidate);
         }
     }
 
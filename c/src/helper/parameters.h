@@ -10,6 +10,14 @@ void set_ice_parameters(
     struct odict* const dict
 );
 
+/*
+ * Set ICE candidate in dictionary.
+ */
+void set_ice_candidate(
+    struct rawrtc_ice_candidate* const candidate,
+    struct odict* const dict
+);
+
 /*
  * Set ICE candidates in dictionary.
  */
@@ -43,6 +51,18 @@ enum rawrtc_code get_ice_parameters(
     struct odict* const dict
 );
 
+/*
+ * Get ICE candidate from dictionary.
+ * Filter by enabled ICE candidate types if `client` argument is set to
+ * non-NULL. `*candidatep` will be set to NULL if the candidate has been
+ * filtered.
+ */
+enum rawrtc_code get_ice_candidate(
+    struct rawrtc_ice_candidate** const candidatep,
+    struct odict* const dict,
+    struct client* const client
+);
+
 /*
  * Get ICE candidates from dictionary.
  * Filter by enabled ICE candidate types if `client` argument is set to
@@ -1,6 +1,9 @@
 #include <stdlib.h> // strtol
 #include <string.h> // strlen
 #include <limits.h>
+#include <stdio.h> // fopen, fscanf
+#include <unistd.h> // sysconf
+#include <time.h> // clock_gettime, CLOCK_MONOTONIC
 #include <rawrtc.h>
 #include "common.h"
 #include "utils.h"
@@ -210,6 +213,49 @@ enum rawrtc_code get_ice_role(
     }
 }
 
+/*
+ * Get the resident memory of this process in bytes.
+ */
+enum rawrtc_code get_resident_memory(
+        size_t* const sizep // de-referenced
+) {
+    FILE* file;
+    unsigned long size;
+    unsigned long resident;
+    long page_size;
+    int n;
+
+    // Read statm (sizes are in pages)
+    file = fopen("/proc/self/statm", "r");
+    if (!file) {
+        return RAWRTC_CODE_NOT_IMPLEMENTED;
+    }
+    n = fscanf(file, "%lu %lu", &size, &resident);
+    fclose(file);
+    if (n != 2) {
+        return RAWRTC_CODE_UNKNOWN_ERROR;
+    }
+
+    // Get page size
+    page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) {
+        return RAWRTC_CODE_UNKNOWN_ERROR;
+    }
+
+    // Set size
+    *sizep = (size_t) resident * (size_t) page_size;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Get the monotonic time in microseconds.
+ */
+uint64_t get_monotonic_time_us(void) {
+    struct timespec now;
+    EOP(clock_gettime(CLOCK_MONOTONIC, &now));
+    return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+}
+
 static void data_channel_helper_destroy(
         void* arg
 ) {
@@ -276,3 +322,47 @@ void data_channel_helper_create_from_channel(
     // Un-reference & done
     mem_deref(parameters);
 }
+
+static void data_channel_helper_stream_destroy(
+        void* arg
+) {
+    struct data_channel_helper* const channel = arg;
+
+    // Remove from list
+    list_unlink(&channel->le);
+
+    // Un-reference
+    mem_deref(channel->arg);
+    mem_deref(channel->label);
+    mem_deref(channel->channel);
+}
+
+/*
+ * Create a data channel helper instance for a stream multiplexed on a
+ * data channel. Unlike the data channel's own helper, it does not unset
+ * the channel's handlers when being destroyed.
+ */
+void data_channel_helper_create_for_stream(
+        struct data_channel_helper** const channel_helperp, // de-referenced
+        struct rawrtc_data_channel* channel,
+        char const* const label,
+        struct client* const client,
+        void* const arg // nullable
+) {
+    // Allocate
+    struct data_channel_helper* const channel_helper =
+            mem_zalloc(sizeof(*channel_helper), data_channel_helper_stream_destroy);
+    if (!channel_helper) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+
+    // Set fields
+    EOE(rawrtc_strdup(&channel_helper->label, label));
+    channel_helper->client = client;
+    channel_helper->channel = channel;
+    channel_helper->arg = mem_ref(arg);
+
+    // Set pointer
+    *channel_helperp = channel_helper;
+}
@@ -56,6 +56,18 @@ enum rawrtc_code get_ice_role(
     char const* const str
 );
 
+/*
+ * Get the resident memory of this process in bytes.
+ */
+enum rawrtc_code get_resident_memory(
+    size_t* const sizep // de-referenced
+);
+
+/*
+ * Get the monotonic time in microseconds.
+ */
+uint64_t get_monotonic_time_us(void);
+
 /*
  * Create a data channel helper instance from parameters.
  */
@@ -65,3 +77,16 @@ void data_channel_helper_create_from_channel(
     struct client* const client,
     void* const arg // nullable
 );
+
+/*
+ * Create a data channel helper instance for a stream multiplexed on a
+ * data channel. Unlike the data channel's own helper, it does not unset
+ * the channel's handlers when being destroyed.
+ */
+void data_channel_helper_create_for_stream(
+    struct data_channel_helper** const channel_helperp, // de-referenced
+    struct rawrtc_data_channel* channel,
+    char const* const label,
+    struct client* const client,
+    void* const arg // nullable
+);
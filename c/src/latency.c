@@ -0,0 +1,268 @@
+#include <rawrtc.h>
+#include "helper/common.h"
+#include "helper/utils.h"
+#include "latency.h"
+
+#define DEBUG_MODULE "rawrtc-terminal-latency"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+static char const* const stage_names[LATENCY_STAGE_MAX] = {
+    "input",
+    "process",
+    "output",
+    "total",
+};
+
+static struct {
+    char const* name;
+    double value;
+} const percentiles[] = {
+    {"p50", 50.0},
+    {"p90", 90.0},
+    {"p99", 99.0},
+    {"p99.9", 99.9},
+};
+
+/*
+ * Get the bucket index of a value.
+ */
+static size_t get_bucket_index(
+        uint64_t value
+) {
+    uint_fast8_t shift = 0;
+
+    // Linear part
+    if (value < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        return (size_t) value;
+    }
+
+    // Clamp
+    if (value >= ((uint64_t) LATENCY_HISTOGRAM_SUB_BUCKETS << LATENCY_HISTOGRAM_MAX_SHIFT)) {
+        value = ((uint64_t) LATENCY_HISTOGRAM_SUB_BUCKETS << LATENCY_HISTOGRAM_MAX_SHIFT) - 1;
+    }
+
+    // Logarithmic part: Each further power of two is split into half the amount of sub-buckets
+    while ((value >> shift) >= LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        ++shift;
+    }
+    return LATENCY_HISTOGRAM_SUB_BUCKETS + (size_t) (shift - 1) * LATENCY_HISTOGRAM_SUB_BUCKETS / 2
+           + (size_t) ((value >> shift) - LATENCY_HISTOGRAM_SUB_BUCKETS / 2);
+}
+
+/*
+ * Get the highest value that falls into a bucket.
+ */
+static uint64_t get_bucket_value(
+        size_t const index
+) {
+    size_t shift;
+    uint64_t sub_bucket;
+
+    // Linear part
+    if (index < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        return (uint64_t) index;
+    }
+
+    // Logarithmic part
+    shift = (index - LATENCY_HISTOGRAM_SUB_BUCKETS) / (LATENCY_HISTOGRAM_SUB_BUCKETS / 2) + 1;
+    sub_bucket = (index - LATENCY_HISTOGRAM_SUB_BUCKETS) % (LATENCY_HISTOGRAM_SUB_BUCKETS / 2)
+                 + LATENCY_HISTOGRAM_SUB_BUCKETS / 2;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+/*
+ * Record a value (in microseconds).
+ */
+void latency_histogram_record(
+        struct latency_histogram* const histogram,
+        uint64_t const value
+) {
+    ++histogram->counts[get_bucket_index(value)];
+    if (histogram->n == 0 || value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+    ++histogram->n;
+}
+
+/*
+ * Get the value at a percentile (0 to 100) of the recorded values.
+ */
+uint64_t latency_histogram_percentile(
+        struct latency_histogram const* const histogram,
+        double const percentile
+) {
+    uint64_t target;
+    uint64_t count = 0;
+    size_t i;
+
+    // Empty?
+    if (histogram->n == 0) {
+        return 0;
+    }
+
+    // Get amount of values up to the percentile
+    target = (uint64_t) ((double) histogram->n * percentile / 100.0 + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+
+    // Find bucket
+    for (i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i) {
+        count += histogram->counts[i];
+        if (count >= target) {
+            return MIN(get_bucket_value(i), histogram->max);
+        }
+    }
+    return histogram->max;
+}
+
+/*
+ * Create a latency tracker.
+ */
+enum rawrtc_code latency_tracker_create(
+        struct latency_tracker** const trackerp // de-referenced
+) {
+    struct latency_tracker* tracker;
+
+    // Check arguments
+    if (!trackerp) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    tracker = mem_zalloc(sizeof(*tracker), NULL);
+    if (!tracker) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set pointer & done
+    *trackerp = tracker;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Track an input message that arrived at `arrival` (unless another one
+ * is being tracked). `queued` is the amount of bytes that still need to
+ * be written before the message is entirely in the PTY.
+ */
+void latency_tracker_input_received(
+        struct latency_tracker* const tracker,
+        uint64_t const arrival, // in microseconds
+        size_t const queued
+) {
+    // Already tracking?
+    if (tracker->state != LATENCY_PROBE_IDLE) {
+        return;
+    }
+    tracker->arrival = arrival;
+
+    // Written already?
+    if (queued == 0) {
+        tracker->written = get_monotonic_time_us();
+        tracker->state = LATENCY_PROBE_WAITING;
+        latency_histogram_record(
+                &tracker->histograms[LATENCY_STAGE_INPUT], tracker->written - arrival);
+    } else {
+        tracker->pending_input = queued;
+        tracker->state = LATENCY_PROBE_WRITING;
+    }
+}
+
+/*
+ * Account input that has been written into the PTY from the queue.
+ */
+void latency_tracker_input_written(
+        struct latency_tracker* const tracker,
+        size_t const length
+) {
+    // Waiting for the input to be written?
+    if (tracker->state != LATENCY_PROBE_WRITING) {
+        return;
+    }
+
+    // Entirely written?
+    if (length < tracker->pending_input) {
+        tracker->pending_input -= length;
+        return;
+    }
+    tracker->written = get_monotonic_time_us();
+    tracker->state = LATENCY_PROBE_WAITING;
+    latency_histogram_record(
+            &tracker->histograms[LATENCY_STAGE_INPUT], tracker->written - tracker->arrival);
+}
+
+/*
+ * Stop tracking the input message as queued input has been discarded.
+ */
+void latency_tracker_input_discarded(
+        struct latency_tracker* const tracker
+) {
+    if (tracker->state == LATENCY_PROBE_WRITING) {
+        tracker->state = LATENCY_PROBE_IDLE;
+    }
+}
+
+/*
+ * Output has been read from the PTY.
+ */
+void latency_tracker_output_read(
+        struct latency_tracker* const tracker
+) {
+    // Waiting for output?
+    if (tracker->state != LATENCY_PROBE_WAITING) {
+        return;
+    }
+    tracker->read = get_monotonic_time_us();
+    tracker->state = LATENCY_PROBE_READ;
+    latency_histogram_record(
+            &tracker->histograms[LATENCY_STAGE_PROCESS], tracker->read - tracker->written);
+}
+
+/*
+ * Output has been handed to the data channel.
+ */
+void latency_tracker_output_sent(
+        struct latency_tracker* const tracker
+) {
+    uint64_t now;
+
+    // Waiting for the output to be sent?
+    if (tracker->state != LATENCY_PROBE_READ) {
+        return;
+    }
+    now = get_monotonic_time_us();
+    tracker->state = LATENCY_PROBE_IDLE;
+    latency_histogram_record(&tracker->histograms[LATENCY_STAGE_OUTPUT], now - tracker->read);
+    latency_histogram_record(&tracker->histograms[LATENCY_STAGE_TOTAL], now - tracker->arrival);
+}
+
+/*
+ * Print the percentiles of each stage.
+ */
+int latency_tracker_debug(
+        struct re_printf* const pf,
+        struct latency_tracker const* const tracker
+) {
+    int err = 0;
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < LATENCY_STAGE_MAX; ++i) {
+        struct latency_histogram const* const histogram = &tracker->histograms[i];
+        err |= re_hprintf(pf, "  %s: n=%"PRIu64, stage_names[i], histogram->n);
+        if (histogram->n > 0) {
+            err |= re_hprintf(pf, " min=%"PRIu64"us", histogram->min);
+            for (j = 0; j < ARRAY_SIZE(percentiles); ++j) {
+                err |= re_hprintf(pf, " %s=%"PRIu64"us", percentiles[j].name,
+                                  latency_histogram_percentile(histogram, percentiles[j].value));
+            }
+            err |= re_hprintf(pf, " max=%"PRIu64"us", histogram->max);
+        }
+        err |= re_hprintf(pf, "\n");
+    }
+    return err;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <rawrtc.h>
+
+enum {
+    LATENCY_HISTOGRAM_SUB_BUCKETS = 32,
+    LATENCY_HISTOGRAM_MAX_SHIFT = 32, // values up to ~2^36 us (~19 hours)
+    LATENCY_HISTOGRAM_BUCKETS = LATENCY_HISTOGRAM_SUB_BUCKETS
+                                + LATENCY_HISTOGRAM_MAX_SHIFT * LATENCY_HISTOGRAM_SUB_BUCKETS / 2,
+};
+
+/*
+ * Log-linear (HDR-style) histogram of latencies in microseconds. Values
+ * are recorded with a relative error of less than 1/16.
+ */
+struct latency_histogram {
+    uint64_t counts[LATENCY_HISTOGRAM_BUCKETS];
+    uint64_t n;
+    uint64_t min;
+    uint64_t max;
+};
+
+/*
+ * Stages of a keystroke's way through the terminal:
+ *
+ * - input: from arrival on the data channel until written into the PTY,
+ * - process: from being written until the process' next output has been
+ *   read from the PTY,
+ * - output: from being read until handed to the data channel, and
+ * - total: from arrival until the output has been handed to the data
+ *   channel.
+ */
+enum latency_stage {
+    LATENCY_STAGE_INPUT,
+    LATENCY_STAGE_PROCESS,
+    LATENCY_STAGE_OUTPUT,
+    LATENCY_STAGE_TOTAL,
+    LATENCY_STAGE_MAX,
+};
+
+enum latency_probe_state {
+    LATENCY_PROBE_IDLE,
+    LATENCY_PROBE_WRITING, // waiting for the input to be written
+    LATENCY_PROBE_WAITING, // waiting for output
+    LATENCY_PROBE_READ, // waiting for the output to be sent
+};
+
+/*
+ * Tracks one input message at a time through the stages and records the
+ * time spent in each stage.
+ */
+struct latency_tracker {
+    enum latency_probe_state state;
+    uint64_t arrival;
+    uint64_t written;
+    uint64_t read;
+    size_t pending_input; // bytes to be written until the input is in the PTY
+    struct latency_histogram histograms[LATENCY_STAGE_MAX];
+};
+
+/*
+ * Record a value (in microseconds).
+ */
+void latency_histogram_record(
+    struct latency_histogram* const histogram,
+    uint64_t const value
+);
+
+/*
+ * Get the value at a percentile (0 to 100) of the recorded values.
+ */
+uint64_t latency_histogram_percentile(
+    struct latency_histogram const* const histogram,
+    double const percentile
+);
+
+/*
+ * Create a latency tracker.
+ */
+enum rawrtc_code latency_tracker_create(
+    struct latency_tracker** const trackerp // de-referenced
+);
+
+/*
+ * Track an input message that arrived at `arrival` (unless another one
+ * is being tracked). `queued` is the amount of bytes that still need to
+ * be written before the message is entirely in the PTY.
+ */
+void latency_tracker_input_received(
+    struct latency_tracker* const tracker,
+    uint64_t const arrival, // in microseconds
+    size_t const queued
+);
+
+/*
+ * Account input that has been written into the PTY from the queue.
+ */
+void latency_tracker_input_written(
+    struct latency_tracker* const tracker,
+    size_t const length
+);
+
+/*
+ * Stop tracking the input message as queued input has been discarded.
+ */
+void latency_tracker_input_discarded(
+    struct latency_tracker* const tracker
+);
+
+/*
+ * Output has been read from the PTY.
+ */
+void latency_tracker_output_read(
+    struct latency_tracker* const tracker
+);
+
+/*
+ * Output has been handed to the data channel.
+ */
+void latency_tracker_output_sent(
+    struct latency_tracker* const tracker
+);
+
+/*
+ * Print the percentiles of each stage.
+ */
+int latency_tracker_debug(
+    struct re_printf* const pf,
+    struct latency_tracker const* const tracker
+);
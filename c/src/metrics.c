@@ -0,0 +1,528 @@
+#include <stddef.h> // offsetof
+#include <string.h> // memcpy
+#include <rawrtc.h>
+#include "helper/common.h"
+#include "metrics.h"
+
+#define DEBUG_MODULE "rawrtc-terminal-metrics"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+enum {
+    METRICS_SAMPLES_SIZE = 4096,
+    METRICS_BODY_SIZE = 16384,
+};
+
+static char const metrics_path[] = "/metrics";
+static char const metrics_content_type[] = "text/plain; version=0.0.4";
+
+enum session_metric {
+    SESSION_METRIC_UPTIME,
+    SESSION_METRIC_ICE_STATE,
+    SESSION_METRIC_DTLS_STATE,
+    SESSION_METRIC_SCTP_STATE,
+    SESSION_METRIC_CANDIDATE_PAIR,
+};
+
+static struct {
+    enum session_metric metric;
+    char const* name;
+    char const* type;
+    char const* help;
+} const session_families[] = {
+    {SESSION_METRIC_UPTIME, "rawrtc_terminal_session_uptime_seconds", "gauge",
+     "Time since the session has been created"},
+    {SESSION_METRIC_ICE_STATE, "rawrtc_terminal_ice_transport_state", "gauge",
+     "Current state of the ICE transport"},
+    {SESSION_METRIC_DTLS_STATE, "rawrtc_terminal_dtls_transport_state", "gauge",
+     "Current state of the DTLS transport"},
+    {SESSION_METRIC_SCTP_STATE, "rawrtc_terminal_sctp_transport_state", "gauge",
+     "Current state of the SCTP transport"},
+    {SESSION_METRIC_CANDIDATE_PAIR, "rawrtc_terminal_ice_candidate_pair_info", "gauge",
+     "Candidate types of the selected ICE candidate pair"},
+};
+
+// Note: The offset refers to a `uint64_t` field of `struct metrics_channel`.
+static struct {
+    size_t offset;
+    char const* name;
+    char const* type;
+    char const* help;
+} const channel_families[] = {
+    {offsetof(struct metrics_channel, counters.received_bytes),
+     "rawrtc_terminal_channel_received_bytes_total", "counter",
+     "Bytes received on the data channel"},
+    {offsetof(struct metrics_channel, counters.received_messages),
+     "rawrtc_terminal_channel_received_messages_total", "counter",
+     "Messages received on the data channel"},
+    {offsetof(struct metrics_channel, counters.sent_bytes),
+     "rawrtc_terminal_channel_sent_bytes_total", "counter",
+     "Bytes sent on the data channel"},
+    {offsetof(struct metrics_channel, counters.sent_messages),
+     "rawrtc_terminal_channel_sent_messages_total", "counter",
+     "Messages sent on the data channel"},
+    {offsetof(struct metrics_channel, counters.pty_reads),
+     "rawrtc_terminal_pty_reads_total", "counter",
+     "Successful reads from the PTY"},
+    {offsetof(struct metrics_channel, counters.floods),
+     "rawrtc_terminal_channel_floods_total", "counter",
+     "Times output exceeded the flood limit"},
+    {offsetof(struct metrics_channel, counters.flood_dropped_bytes),
+     "rawrtc_terminal_channel_flood_dropped_bytes_total", "counter",
+     "Bytes of output dropped by flood control"},
+    {offsetof(struct metrics_channel, counters.credit_exhaustions),
+     "rawrtc_terminal_channel_credit_exhaustions_total", "counter",
+     "Times reading from the PTY stopped as the remote peer's credit ran out"},
+    {offsetof(struct metrics_channel, buffered_amount),
+     "rawrtc_terminal_channel_buffered_amount_bytes", "gauge",
+     "Bytes sent but still buffered by the data channel"},
+    {offsetof(struct metrics_channel, scheduled),
+     "rawrtc_terminal_channel_scheduled_total", "counter",
+     "Times the PTY has been served by the output scheduler"},
+    {offsetof(struct metrics_channel, scheduling_delay),
+     "rawrtc_terminal_channel_scheduling_delay_microseconds_total", "counter",
+     "Time readable PTY output waited for the output scheduler"},
+    {offsetof(struct metrics_channel, scheduling_delay_max),
+     "rawrtc_terminal_channel_scheduling_delay_max_microseconds", "gauge",
+     "Longest time readable PTY output waited for the output scheduler"},
+};
+
+/*
+ * A scrape waiting for the collection to complete.
+ */
+struct metrics_scrape {
+    struct le le;
+    struct http_conn* connection;
+};
+
+/*
+ * Copy a label value. Characters that would need to be escaped are
+ * replaced.
+ */
+void metrics_copy_label(
+        char* const destination, // METRICS_LABEL_SIZE
+        char const* const source // nullable
+) {
+    size_t i;
+
+    for (i = 0; source && source[i] != '\0' && i < METRICS_LABEL_SIZE - 1; ++i) {
+        switch (source[i]) {
+            case '"':
+            case '\\':
+            case '\n':
+                destination[i] = '_';
+                break;
+            default:
+                destination[i] = source[i];
+                break;
+        }
+    }
+    destination[i] = '\0';
+}
+
+/*
+ * Write a session snapshot into a samples buffer.
+ */
+enum rawrtc_code metrics_write_session(
+        struct mbuf* const samples,
+        struct metrics_session const* const session
+) {
+    return rawrtc_error_to_code(mbuf_write_mem(
+            samples, (uint8_t const*) session, sizeof(*session)));
+}
+
+/*
+ * Write a data channel snapshot into a samples buffer (after its
+ * session's snapshot).
+ */
+enum rawrtc_code metrics_write_channel(
+        struct mbuf* const samples,
+        struct metrics_channel const* const channel
+) {
+    return rawrtc_error_to_code(mbuf_write_mem(
+            samples, (uint8_t const*) channel, sizeof(*channel)));
+}
+
+/*
+ * Read the next session snapshot. Return `false` once all sessions have
+ * been read.
+ */
+static bool read_session(
+        struct metrics_session* const session,
+        struct mbuf* const samples
+) {
+    if (mbuf_get_left(samples) < sizeof(*session)) {
+        return false;
+    }
+    memcpy(session, mbuf_buf(samples), sizeof(*session));
+    mbuf_advance(samples, sizeof(*session));
+    return true;
+}
+
+/*
+ * Read the next data channel snapshot of a session.
+ */
+static bool read_channel(
+        struct metrics_channel* const channel,
+        struct mbuf* const samples
+) {
+    if (mbuf_get_left(samples) < sizeof(*channel)) {
+        return false;
+    }
+    memcpy(channel, mbuf_buf(samples), sizeof(*channel));
+    mbuf_advance(samples, sizeof(*channel));
+    return true;
+}
+
+/*
+ * Skip the data channel snapshots of a session.
+ */
+static void skip_channels(
+        struct mbuf* const samples,
+        struct metrics_session const* const session
+) {
+    size_t const length = MIN(session->n_channels * sizeof(struct metrics_channel),
+                              mbuf_get_left(samples));
+    mbuf_advance(samples, (ssize_t) length);
+}
+
+/*
+ * Print the labels identifying a session.
+ */
+static int print_session_labels(
+        struct re_printf* const pf,
+        struct metrics_session const* const session
+) {
+    int err = re_hprintf(pf, "session=\"%s\"", session->name);
+    if (session->worker >= 0) {
+        err |= re_hprintf(pf, ",worker=\"%"PRId32"\"", session->worker);
+    }
+    return err;
+}
+
+/*
+ * Encode a metric family whose samples belong to sessions.
+ */
+static int encode_session_family(
+        struct mbuf* const body,
+        struct mbuf* const samples,
+        enum session_metric const metric,
+        char const* const name
+) {
+    struct metrics_session session;
+    int err = 0;
+
+    mbuf_set_pos(samples, 0);
+    while (read_session(&session, samples)) {
+        skip_channels(samples, &session);
+
+        switch (metric) {
+            case SESSION_METRIC_UPTIME:
+                err |= mbuf_printf(body, "%s{%H} %"PRIu64".%06"PRIu64"\n", name,
+                                   print_session_labels, &session,
+                                   session.uptime / 1000000, session.uptime % 1000000);
+                break;
+            case SESSION_METRIC_ICE_STATE:
+                err |= mbuf_printf(body, "%s{%H,state=\"%s\"} 1\n", name,
+                                   print_session_labels, &session,
+                                   rawrtc_ice_transport_state_to_name(session.ice_state));
+                break;
+            case SESSION_METRIC_DTLS_STATE:
+                err |= mbuf_printf(body, "%s{%H,state=\"%s\"} 1\n", name,
+                                   print_session_labels, &session,
+                                   rawrtc_dtls_transport_state_to_name(session.dtls_state));
+                break;
+            case SESSION_METRIC_SCTP_STATE:
+                err |= mbuf_printf(body, "%s{%H,state=\"%s\"} 1\n", name,
+                                   print_session_labels, &session,
+                                   rawrtc_sctp_transport_state_to_name(session.sctp_state));
+                break;
+            case SESSION_METRIC_CANDIDATE_PAIR:
+                if (!session.candidate_pair_selected) {
+                    break;
+                }
+                err |= mbuf_printf(
+                        body, "%s{%H,local_type=\"%s\",remote_type=\"%s\",protocol=\"%s\"} 1\n",
+                        name, print_session_labels, &session,
+                        rawrtc_ice_candidate_type_to_str(session.local_candidate_type),
+                        rawrtc_ice_candidate_type_to_str(session.remote_candidate_type),
+                        rawrtc_ice_protocol_to_str(session.candidate_protocol));
+                break;
+            default:
+                break;
+        }
+    }
+    return err;
+}
+
+/*
+ * Encode a metric family whose samples belong to data channels. If
+ * `offset` is `SIZE_MAX`, the process ID will be encoded.
+ */
+static int encode_channel_family(
+        struct mbuf* const body,
+        struct mbuf* const samples,
+        size_t const offset,
+        char const* const name
+) {
+    struct metrics_session session;
+    struct metrics_channel channel;
+    int err = 0;
+    uint32_t i;
+
+    mbuf_set_pos(samples, 0);
+    while (read_session(&session, samples)) {
+        for (i = 0; i < session.n_channels && read_channel(&channel, samples); ++i) {
+            uint64_t value;
+
+            // Get value
+            if (offset == SIZE_MAX) {
+                if (channel.pid == -1) {
+                    continue;
+                }
+                value = (uint64_t) channel.pid;
+            } else {
+                memcpy(&value, (uint8_t const*) &channel + offset, sizeof(value));
+            }
+
+            err |= mbuf_printf(body, "%s{session=\"%s\",channel=\"%s\"} %"PRIu64"\n",
+                               name, session.name, channel.label, value);
+        }
+    }
+    return err;
+}
+
+/*
+ * Encode the collected samples in the Prometheus text format.
+ */
+static int encode_metrics(
+        struct mbuf* const body,
+        struct mbuf* const samples
+) {
+    struct metrics_session session;
+    uint32_t n_sessions = 0;
+    int err = 0;
+    size_t i;
+
+    // Count sessions
+    mbuf_set_pos(samples, 0);
+    while (read_session(&session, samples)) {
+        skip_channels(samples, &session);
+        ++n_sessions;
+    }
+    err |= mbuf_printf(body, "# HELP rawrtc_terminal_sessions Current amount of sessions\n"
+                             "# TYPE rawrtc_terminal_sessions gauge\n"
+                             "rawrtc_terminal_sessions %"PRIu32"\n", n_sessions);
+
+    // Per session
+    for (i = 0; i < ARRAY_SIZE(session_families); ++i) {
+        err |= mbuf_printf(body, "# HELP %s %s\n# TYPE %s %s\n",
+                           session_families[i].name, session_families[i].help,
+                           session_families[i].name, session_families[i].type);
+        err |= encode_session_family(
+                body, samples, session_families[i].metric, session_families[i].name);
+    }
+
+    // Per data channel
+    err |= mbuf_printf(body, "# HELP rawrtc_terminal_channel_process_id "
+                             "Process ID of the data channel's shell\n"
+                             "# TYPE rawrtc_terminal_channel_process_id gauge\n");
+    err |= encode_channel_family(body, samples, SIZE_MAX, "rawrtc_terminal_channel_process_id");
+    for (i = 0; i < ARRAY_SIZE(channel_families); ++i) {
+        err |= mbuf_printf(body, "# HELP %s %s\n# TYPE %s %s\n",
+                           channel_families[i].name, channel_families[i].help,
+                           channel_families[i].name, channel_families[i].type);
+        err |= encode_channel_family(
+                body, samples, channel_families[i].offset, channel_families[i].name);
+    }
+    return err;
+}
+
+/*
+ * Answer all waiting scrapes with the collected samples.
+ */
+static void exporter_reply(
+        struct metrics_exporter* const exporter
+) {
+    struct mbuf* const samples = exporter->samples;
+    struct mbuf* body;
+    struct le* le;
+
+    // Collection complete
+    exporter->samples = NULL;
+
+    // Encode
+    body = mbuf_alloc(METRICS_BODY_SIZE);
+    if (!body) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        goto out;
+    }
+    EOR(encode_metrics(body, samples));
+
+    // Reply
+    while ((le = list_head(&exporter->scrapes))) {
+        struct metrics_scrape* const scrape = le->data;
+        int const err = http_creply(scrape->connection, 200, "OK", metrics_content_type,
+                                    "%b", body->buf, body->end);
+        if (err) {
+            DEBUG_NOTICE("Could not reply to scrape, reason: %m\n", err);
+        }
+        mem_deref(scrape);
+    }
+
+out:
+    // Un-reference
+    mem_deref(body);
+    mem_deref(samples);
+}
+
+static void metrics_scrape_destroy(
+        void* arg
+) {
+    struct metrics_scrape* const scrape = arg;
+
+    // Remove from list & un-reference
+    list_unlink(&scrape->le);
+    mem_deref(scrape->connection);
+}
+
+/*
+ * Queue a scrape and start a collection (unless one is in progress).
+ */
+static void exporter_http_request_handler(
+        struct http_conn* const connection,
+        struct http_msg const* const message,
+        void* arg
+) {
+    struct metrics_exporter* const exporter = arg;
+    struct metrics_scrape* scrape;
+    bool start = false;
+
+    // Check path
+    if (pl_strcmp(&message->path, metrics_path)) {
+        http_ereply(connection, 404, "Not Found");
+        return;
+    }
+
+    // Allocate samples (unless a collection is in progress)
+    // Note: Allocated before queueing the scrape, so it is never left waiting for a collection
+    //       that could not be started.
+    if (!exporter->samples) {
+        exporter->samples = mbuf_alloc(METRICS_SAMPLES_SIZE);
+        if (!exporter->samples) {
+            http_ereply(connection, 500, "Internal Server Error");
+            return;
+        }
+        start = true;
+    }
+
+    // Queue scrape
+    scrape = mem_zalloc(sizeof(*scrape), metrics_scrape_destroy);
+    if (!scrape) {
+        if (start) {
+            exporter->samples = mem_deref(exporter->samples);
+        }
+        http_ereply(connection, 500, "Internal Server Error");
+        return;
+    }
+    scrape->connection = mem_ref(connection);
+    list_append(&exporter->scrapes, &scrape->le, scrape);
+
+    // Collection in progress?
+    if (!start) {
+        return;
+    }
+
+    // Start collection
+    exporter->n_pending = exporter->collect_handler(exporter->samples, exporter->arg);
+
+    // Reply (if complete)
+    if (exporter->n_pending == 0) {
+        exporter_reply(exporter);
+    }
+}
+
+static void metrics_exporter_destroy(
+        void* arg
+) {
+    struct metrics_exporter* const exporter = arg;
+
+    // Drop waiting scrapes & un-reference
+    list_flush(&exporter->scrapes);
+    mem_deref(exporter->samples);
+    mem_deref(exporter->socket);
+}
+
+/*
+ * Listen for scrapes on localhost.
+ */
+enum rawrtc_code metrics_exporter_create(
+        struct metrics_exporter** const exporterp, // de-referenced
+        uint16_t const port,
+        metrics_collect_handler* const collect_handler,
+        void* const arg
+) {
+    struct metrics_exporter* exporter;
+    struct sa address;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!exporterp || !collect_handler) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    exporter = mem_zalloc(sizeof(*exporter), metrics_exporter_destroy);
+    if (!exporter) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields
+    exporter->collect_handler = collect_handler;
+    exporter->arg = arg;
+    list_init(&exporter->scrapes);
+
+    // Listen on localhost
+    error = rawrtc_error_to_code(sa_set_str(&address, "127.0.0.1", port));
+    if (error) {
+        goto out;
+    }
+    error = rawrtc_error_to_code(http_listen(
+            &exporter->socket, &address, exporter_http_request_handler, exporter));
+    if (error) {
+        goto out;
+    }
+    DEBUG_INFO("Exposing metrics on http://%J%s\n", &address, metrics_path);
+
+out:
+    if (error) {
+        mem_deref(exporter);
+    } else {
+        // Set pointer
+        *exporterp = exporter;
+    }
+    return error;
+}
+
+/*
+ * Add a sample buffer that has been collected asynchronously. Waiting
+ * scrapes will be answered once all sample buffers have been added.
+ */
+void metrics_exporter_add_samples(
+        struct metrics_exporter* const exporter,
+        struct mbuf* const samples
+) {
+    // Collection in progress?
+    if (!exporter->samples || exporter->n_pending == 0) {
+        return;
+    }
+
+    // Append samples
+    EOR(mbuf_write_mem(exporter->samples, samples->buf, samples->end));
+
+    // Reply (if complete)
+    --exporter->n_pending;
+    if (exporter->n_pending == 0) {
+        exporter_reply(exporter);
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <sys/types.h> // pid_t
+#include <rawrtc.h>
+
+enum {
+    METRICS_LABEL_SIZE = 32,
+};
+
+/*
+ * Counters of a data channel.
+ */
+struct metrics_channel_counters {
+    uint64_t received_bytes;
+    uint64_t received_messages;
+    uint64_t sent_bytes;
+    uint64_t sent_messages;
+    uint64_t pty_reads;
+    uint64_t floods;
+    uint64_t flood_dropped_bytes;
+    uint64_t credit_exhaustions;
+};
+
+/*
+ * Snapshot of a session. Written into a samples buffer, followed by one
+ * `struct metrics_channel` per data channel.
+ * Note: Snapshots are plain data so they can be handed across threads.
+ */
+struct metrics_session {
+    char name[METRICS_LABEL_SIZE];
+    int32_t worker; // -1: none
+    uint64_t uptime; // in microseconds
+    enum rawrtc_ice_transport_state ice_state;
+    enum rawrtc_dtls_transport_state dtls_state;
+    enum rawrtc_sctp_transport_state sctp_state;
+    bool candidate_pair_selected;
+    enum rawrtc_ice_candidate_type local_candidate_type;
+    enum rawrtc_ice_candidate_type remote_candidate_type;
+    enum rawrtc_ice_protocol candidate_protocol;
+    uint32_t n_channels;
+};
+
+/*
+ * Snapshot of a data channel.
+ */
+struct metrics_channel {
+    char label[METRICS_LABEL_SIZE];
+    pid_t pid; // -1: no process
+    uint64_t buffered_amount;
+    struct metrics_channel_counters counters;
+    uint64_t scheduled; // times served by the output scheduler
+    uint64_t scheduling_delay; // in total, in microseconds
+    uint64_t scheduling_delay_max; // in microseconds
+};
+
+/*
+ * Collect snapshots of all sessions handled by the calling thread into
+ * `samples`. Return the amount of further sample buffers that will be
+ * handed to the exporter asynchronously (by other threads) via
+ * `metrics_exporter_add_samples`.
+ */
+typedef uint32_t (metrics_collect_handler)(
+    struct mbuf* const samples,
+    void* const arg
+);
+
+/*
+ * Exposes the metrics of all sessions in the Prometheus text format on
+ * `http://127.0.0.1:<port>/metrics`. Concurrent scrapes share the same
+ * collection.
+ */
+struct metrics_exporter {
+    struct http_sock* socket;
+    metrics_collect_handler* collect_handler;
+    void* arg;
+    struct list scrapes; // waiting for the collection to complete
+    struct mbuf* samples; // nullable, collection in progress
+    uint32_t n_pending; // sample buffers that have not been added, yet
+};
+
+/*
+ * Copy a label value. Characters that would need to be escaped are
+ * replaced.
+ */
+void metrics_copy_label(
+    char* const destination, // METRICS_LABEL_SIZE
+    char const* const source // nullable
+);
+
+/*
+ * Write a session snapshot into a samples buffer.
+ */
+enum rawrtc_code metrics_write_session(
+    struct mbuf* const samples,
+    struct metrics_session const* const session
+);
+
+/*
+ * Write a data channel snapshot into a samples buffer (after its
+ * session's snapshot).
+ */
+enum rawrtc_code metrics_write_channel(
+    struct mbuf* const samples,
+    struct metrics_channel const* const channel
+);
+
+/*
+ * Listen for scrapes on localhost.
+ */
+enum rawrtc_code metrics_exporter_create(
+    struct metrics_exporter** const exporterp, // de-referenced
+    uint16_t const port,
+    metrics_collect_handler* const collect_handler,
+    void* const arg
+);
+
+/*
+ * Add a sample buffer that has been collected asynchronously. Waiting
+ * scrapes will be answered once all sample buffers have been added.
+ */
+void metrics_exporter_add_samples(
+    struct metrics_exporter* const exporter,
+    struct mbuf* const samples
+);
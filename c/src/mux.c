@@ -0,0 +1,67 @@
+#include <rawrtc.h>
+#include "mux.h"
+
+/*
+ * Append a frame to a buffer.
+ */
+enum rawrtc_code mux_frame_write(
+        struct mbuf* const buffer,
+        uint16_t const stream_id,
+        enum mux_frame_type const type,
+        uint8_t const* const payload, // nullable if length is 0
+        size_t const length
+) {
+    int err;
+
+    // Check arguments
+    if (!buffer || (!payload && length > 0) || length > UINT32_MAX) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Write header & payload
+    err = mbuf_write_u16(buffer, htons(stream_id));
+    err |= mbuf_write_u8(buffer, (uint8_t) type);
+    err |= mbuf_write_u32(buffer, htonl((uint32_t) length));
+    if (length > 0) {
+        err |= mbuf_write_mem(buffer, payload, length);
+    }
+    return rawrtc_error_to_code(err);
+}
+
+/*
+ * Read the next frame from a buffer. `payload` will point into the
+ * buffer's memory and is only valid as long as the buffer is.
+ * Return `RAWRTC_CODE_INVALID_MESSAGE` in case the frame is truncated.
+ */
+enum rawrtc_code mux_frame_read(
+        uint16_t* const stream_idp, // de-referenced
+        uint8_t* const typep, // de-referenced
+        struct mbuf* const payload, // de-referenced
+        struct mbuf* const buffer
+) {
+    size_t length;
+
+    // Check arguments
+    if (!stream_idp || !typep || !payload || !buffer) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Read header
+    if (mbuf_get_left(buffer) < MUX_FRAME_HEADER_LENGTH) {
+        return RAWRTC_CODE_INVALID_MESSAGE;
+    }
+    *stream_idp = ntohs(mbuf_read_u16(buffer));
+    *typep = mbuf_read_u8(buffer);
+    length = ntohl(mbuf_read_u32(buffer));
+    if (mbuf_get_left(buffer) < length) {
+        return RAWRTC_CODE_INVALID_MESSAGE;
+    }
+
+    // Point payload into the buffer
+    payload->buf = mbuf_buf(buffer);
+    payload->size = length;
+    payload->pos = 0;
+    payload->end = length;
+    mbuf_advance(buffer, (ssize_t) length);
+    return RAWRTC_CODE_SUCCESS;
+}
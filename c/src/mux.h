@@ -0,0 +1,44 @@
+#pragma once
+#include <rawrtc.h>
+
+/*
+ * Data channel protocol negotiating a multiplexed data channel.
+ */
+#define MUX_PROTOCOL "mux"
+
+enum {
+    MUX_FRAME_HEADER_LENGTH = 7, // stream id (2), type (1), length (4)
+};
+
+/*
+ * Frame types of a multiplexed data channel.
+ */
+enum mux_frame_type {
+    MUX_FRAME_DATA = 0, // payload: terminal input/output (UTF-8)
+    MUX_FRAME_CONTROL = 1, // payload: control message
+    MUX_FRAME_OPEN = 2, // payload: optional attach request
+    MUX_FRAME_CLOSE = 3, // no payload
+};
+
+/*
+ * Append a frame to a buffer.
+ */
+enum rawrtc_code mux_frame_write(
+    struct mbuf* const buffer,
+    uint16_t const stream_id,
+    enum mux_frame_type const type,
+    uint8_t const* const payload, // nullable if length is 0
+    size_t const length
+);
+
+/*
+ * Read the next frame from a buffer. `payload` will point into the
+ * buffer's memory and is only valid as long as the buffer is.
+ * Return `RAWRTC_CODE_INVALID_MESSAGE` in case the frame is truncated.
+ */
+enum rawrtc_code mux_frame_read(
+    uint16_t* const stream_idp, // de-referenced
+    uint8_t* const typep, // de-referenced
+    struct mbuf* const payload, // de-referenced
+    struct mbuf* const buffer
+);
@@ -0,0 +1,247 @@
+#include <stdlib.h> // getenv
+#include <rawrtc.h>
+#include "helper/common.h"
+#include "options.h"
+
+#define DEBUG_MODULE "rawrtc-terminal-options"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+static char const config_path_variable[] = "RAWRTC_TERMINAL_CONFIG";
+
+// Defaults
+enum {
+    DEFAULT_BUFFER_POOL_SIZE = 32,
+    DEFAULT_BUFFER_SIZE = 16384,
+    DEFAULT_OUTPUT_COALESCE_DELAY = 0,
+    DEFAULT_OUTPUT_DRAIN_LIMIT = 262144,
+    DEFAULT_OUTPUT_HIGH_WATERMARK = 1048576,
+    DEFAULT_OUTPUT_LOW_WATERMARK = 262144,
+    DEFAULT_INPUT_QUEUE_LIMIT = 1048576,
+    DEFAULT_SERVER_MAX_SESSIONS = 4096,
+    DEFAULT_SERVER_WORKERS = 0,
+    MAX_SERVER_WORKERS = 256,
+    DEFAULT_SHELL_POOL_SIZE = 0,
+    MAX_SHELL_POOL_SIZE = 1024,
+    DEFAULT_CERTIFICATE_MODULUS_LENGTH = 2048,
+    DEFAULT_CERTIFICATE_VALIDITY = 2592000, // 30 days
+    DEFAULT_LATENCY_TRACKING = 0,
+    DEFAULT_METRICS_PORT = 0,
+    DEFAULT_TRACE_RING_SIZE = 0,
+    MAX_TRACE_RING_SIZE = 16777216,
+    DEFAULT_DETACH_TIMEOUT = 0,
+    MAX_DETACH_TIMEOUT = 86400, // 1 day
+    DEFAULT_DETACH_REPLAY_SIZE = 262144,
+    MAX_DETACH_REPLAY_SIZE = 67108864,
+    DEFAULT_ICE_RESTART_TIMEOUT = 0,
+    MAX_ICE_RESTART_TIMEOUT = 3600,
+    DEFAULT_SCREEN_SYNC = 0,
+    DEFAULT_OUTPUT_COMPRESSION_LEVEL = 6,
+    DEFAULT_OUTPUT_INTERACTIVE_WINDOW = 1000,
+    MAX_OUTPUT_INTERACTIVE_WINDOW = 60000,
+    DEFAULT_OUTPUT_FLOOD_LIMIT = 0,
+    DEFAULT_OUTPUT_FLOOD_WINDOW = 1000,
+    MAX_OUTPUT_FLOOD_WINDOW = 60000,
+    DEFAULT_OUTPUT_FLOOD_TAIL_SIZE = 4096,
+    MAX_OUTPUT_FLOOD_TAIL_SIZE = 1048576,
+};
+
+/*
+ * Get a uint32 option and ensure it is within bounds.
+ */
+static void get_uint32(
+        uint32_t* const valuep, // not checked
+        struct conf* const conf,
+        char const* const key,
+        uint32_t const min,
+        uint32_t const max
+) {
+    uint32_t value;
+
+    // Get value (if any)
+    if (conf_get_u32(conf, key, &value)) {
+        return;
+    }
+
+    // Check bounds
+    if (value < min || value > max) {
+        EWE("Option '%s' out of bounds (%"PRIu32" not in [%"PRIu32", %"PRIu32"])\n",
+            key, value, min, max);
+    }
+
+    // Set value
+    *valuep = value;
+}
+
+/*
+ * Get the certificate key type option.
+ */
+static void get_certificate_key_type(
+        enum rawrtc_certificate_key_type* const typep, // not checked
+        struct conf* const conf
+) {
+    char value[8];
+
+    // Get value (if any)
+    if (conf_get_str(conf, "certificate_key_type", value, sizeof(value))) {
+        return;
+    }
+
+    // Parse
+    if (str_casecmp(value, "ec") == 0) {
+        *typep = RAWRTC_CERTIFICATE_KEY_TYPE_EC;
+    } else if (str_casecmp(value, "rsa") == 0) {
+        *typep = RAWRTC_CERTIFICATE_KEY_TYPE_RSA;
+    } else {
+        EWE("Option 'certificate_key_type' must be 'ec' or 'rsa'\n");
+    }
+}
+
+/*
+ * Load the terminal options. Values that have not been configured will
+ * be set to their default value.
+ */
+void terminal_options_load(
+        struct terminal_options* const options // de-referenced
+) {
+    char const* const path = getenv(config_path_variable);
+    struct conf* conf;
+
+    // Set defaults
+    options->buffer_pool_size = DEFAULT_BUFFER_POOL_SIZE;
+    options->buffer_size = DEFAULT_BUFFER_SIZE;
+    options->output_coalesce_delay = DEFAULT_OUTPUT_COALESCE_DELAY;
+    options->output_drain_limit = DEFAULT_OUTPUT_DRAIN_LIMIT;
+    options->output_high_watermark = DEFAULT_OUTPUT_HIGH_WATERMARK;
+    options->output_low_watermark = DEFAULT_OUTPUT_LOW_WATERMARK;
+    options->input_queue_limit = DEFAULT_INPUT_QUEUE_LIMIT;
+    options->server_max_sessions = DEFAULT_SERVER_MAX_SESSIONS;
+    options->server_workers = DEFAULT_SERVER_WORKERS;
+    options->shell_pool_size = DEFAULT_SHELL_POOL_SIZE;
+    options->certificate_path[0] = '\0';
+    options->certificate_key_type = RAWRTC_CERTIFICATE_KEY_TYPE_EC; // ECDSA P-256
+    options->certificate_modulus_length = DEFAULT_CERTIFICATE_MODULUS_LENGTH;
+    options->certificate_validity = DEFAULT_CERTIFICATE_VALIDITY;
+    options->setup_record_path[0] = '\0';
+    options->setup_trace_path[0] = '\0';
+    options->latency_tracking = DEFAULT_LATENCY_TRACKING;
+    options->metrics_port = DEFAULT_METRICS_PORT;
+    options->trace_ring_size = DEFAULT_TRACE_RING_SIZE;
+    options->detach_timeout = DEFAULT_DETACH_TIMEOUT;
+    options->detach_replay_size = DEFAULT_DETACH_REPLAY_SIZE;
+    options->ice_restart_timeout = DEFAULT_ICE_RESTART_TIMEOUT;
+    options->screen_sync = DEFAULT_SCREEN_SYNC;
+    options->output_compression_level = DEFAULT_OUTPUT_COMPRESSION_LEVEL;
+    options->output_interactive_window = DEFAULT_OUTPUT_INTERACTIVE_WINDOW;
+    options->output_flood_limit = DEFAULT_OUTPUT_FLOOD_LIMIT;
+    options->output_flood_window = DEFAULT_OUTPUT_FLOOD_WINDOW;
+    options->output_flood_tail_size = DEFAULT_OUTPUT_FLOOD_TAIL_SIZE;
+
+    // Configuration file provided?
+    if (!path) {
+        return;
+    }
+
+    // Load configuration file
+    DEBUG_PRINTF("Loading configuration file: %s\n", path);
+    EOR(conf_alloc(&conf, path));
+
+    // Get options
+    get_uint32(&options->buffer_pool_size, conf, "buffer_pool_size", 0, 65536);
+    get_uint32(&options->buffer_size, conf, "buffer_size", 1, 1048576);
+    get_uint32(&options->output_coalesce_delay, conf, "output_coalesce_delay", 0, 1000);
+    get_uint32(&options->output_drain_limit, conf, "output_drain_limit", 1, UINT32_MAX);
+    get_uint32(&options->output_high_watermark, conf, "output_high_watermark", 0, UINT32_MAX);
+    get_uint32(&options->output_low_watermark, conf, "output_low_watermark", 0, UINT32_MAX);
+    get_uint32(&options->input_queue_limit, conf, "input_queue_limit", 1, UINT32_MAX / 2);
+    get_uint32(&options->server_max_sessions, conf, "server_max_sessions", 1, UINT32_MAX);
+    get_uint32(&options->server_workers, conf, "server_workers", 0, MAX_SERVER_WORKERS);
+    get_uint32(&options->shell_pool_size, conf, "shell_pool_size", 0, MAX_SHELL_POOL_SIZE);
+    if (conf_get_str(conf, "certificate_path", options->certificate_path,
+                     sizeof(options->certificate_path))) {
+        options->certificate_path[0] = '\0';
+    }
+    get_certificate_key_type(&options->certificate_key_type, conf);
+    get_uint32(&options->certificate_modulus_length, conf, "certificate_modulus_length",
+               1024, 16384);
+    get_uint32(&options->certificate_validity, conf, "certificate_validity", 60, UINT32_MAX);
+    if (conf_get_str(conf, "setup_record_path", options->setup_record_path,
+                     sizeof(options->setup_record_path))) {
+        options->setup_record_path[0] = '\0';
+    }
+    if (conf_get_str(conf, "setup_trace_path", options->setup_trace_path,
+                     sizeof(options->setup_trace_path))) {
+        options->setup_trace_path[0] = '\0';
+    }
+    get_uint32(&options->latency_tracking, conf, "latency_tracking", 0, 1);
+    get_uint32(&options->metrics_port, conf, "metrics_port", 0, UINT16_MAX);
+    get_uint32(&options->trace_ring_size, conf, "trace_ring_size", 0, MAX_TRACE_RING_SIZE);
+    get_uint32(&options->detach_timeout, conf, "detach_timeout", 0, MAX_DETACH_TIMEOUT);
+    get_uint32(&options->detach_replay_size, conf, "detach_replay_size",
+               1, MAX_DETACH_REPLAY_SIZE);
+    get_uint32(&options->ice_restart_timeout, conf, "ice_restart_timeout",
+               0, MAX_ICE_RESTART_TIMEOUT);
+    get_uint32(&options->screen_sync, conf, "screen_sync", 0, 1);
+    get_uint32(&options->output_compression_level, conf, "output_compression_level", 0, 9);
+    get_uint32(&options->output_interactive_window, conf, "output_interactive_window",
+               0, MAX_OUTPUT_INTERACTIVE_WINDOW);
+    get_uint32(&options->output_flood_limit, conf, "output_flood_limit", 0, UINT32_MAX);
+    get_uint32(&options->output_flood_window, conf, "output_flood_window",
+               10, MAX_OUTPUT_FLOOD_WINDOW);
+    get_uint32(&options->output_flood_tail_size, conf, "output_flood_tail_size",
+               1, MAX_OUTPUT_FLOOD_TAIL_SIZE);
+
+    // Un-reference
+    mem_deref(conf);
+
+    // Check watermarks
+    if (options->output_low_watermark > options->output_high_watermark) {
+        EWE("Option 'output_low_watermark' must not exceed 'output_high_watermark'\n");
+    }
+}
+
+/*
+ * Print the terminal options.
+ */
+int terminal_options_debug(
+        struct re_printf* const pf,
+        struct terminal_options const* const options
+) {
+    int err = 0;
+
+    err |= re_hprintf(pf, "buffer_pool_size=%"PRIu32"\n", options->buffer_pool_size);
+    err |= re_hprintf(pf, "buffer_size=%"PRIu32"\n", options->buffer_size);
+    err |= re_hprintf(pf, "output_coalesce_delay=%"PRIu32"\n", options->output_coalesce_delay);
+    err |= re_hprintf(pf, "output_drain_limit=%"PRIu32"\n", options->output_drain_limit);
+    err |= re_hprintf(pf, "output_high_watermark=%"PRIu32"\n", options->output_high_watermark);
+    err |= re_hprintf(pf, "output_low_watermark=%"PRIu32"\n", options->output_low_watermark);
+    err |= re_hprintf(pf, "input_queue_limit=%"PRIu32"\n", options->input_queue_limit);
+    err |= re_hprintf(pf, "server_max_sessions=%"PRIu32"\n", options->server_max_sessions);
+    err |= re_hprintf(pf, "server_workers=%"PRIu32"\n", options->server_workers);
+    err |= re_hprintf(pf, "shell_pool_size=%"PRIu32"\n", options->shell_pool_size);
+    err |= re_hprintf(pf, "certificate_path=%s\n", options->certificate_path);
+    err |= re_hprintf(pf, "certificate_key_type=%s\n",
+                      options->certificate_key_type == RAWRTC_CERTIFICATE_KEY_TYPE_EC
+                      ? "ec" : "rsa");
+    err |= re_hprintf(pf, "certificate_modulus_length=%"PRIu32"\n",
+                      options->certificate_modulus_length);
+    err |= re_hprintf(pf, "certificate_validity=%"PRIu32"\n", options->certificate_validity);
+    err |= re_hprintf(pf, "setup_record_path=%s\n", options->setup_record_path);
+    err |= re_hprintf(pf, "setup_trace_path=%s\n", options->setup_trace_path);
+    err |= re_hprintf(pf, "latency_tracking=%"PRIu32"\n", options->latency_tracking);
+    err |= re_hprintf(pf, "metrics_port=%"PRIu32"\n", options->metrics_port);
+    err |= re_hprintf(pf, "trace_ring_size=%"PRIu32"\n", options->trace_ring_size);
+    err |= re_hprintf(pf, "detach_timeout=%"PRIu32"\n", options->detach_timeout);
+    err |= re_hprintf(pf, "detach_replay_size=%"PRIu32"\n", options->detach_replay_size);
+    err |= re_hprintf(pf, "ice_restart_timeout=%"PRIu32"\n", options->ice_restart_timeout);
+    err |= re_hprintf(pf, "screen_sync=%"PRIu32"\n", options->screen_sync);
+    err |= re_hprintf(pf, "output_compression_level=%"PRIu32"\n",
+                      options->output_compression_level);
+    err |= re_hprintf(pf, "output_interactive_window=%"PRIu32"\n",
+                      options->output_interactive_window);
+    err |= re_hprintf(pf, "output_flood_limit=%"PRIu32"\n", options->output_flood_limit);
+    err |= re_hprintf(pf, "output_flood_window=%"PRIu32"\n", options->output_flood_window);
+    err |= re_hprintf(pf, "output_flood_tail_size=%"PRIu32"\n",
+                      options->output_flood_tail_size);
+    return err;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <limits.h> // PATH_MAX
+#include <rawrtc.h>
+
+/*
+ * Terminal options.
+ * Can be tuned by a configuration file referenced by the
+ * `RAWRTC_TERMINAL_CONFIG` environment variable.
+ */
+struct terminal_options {
+    uint32_t buffer_pool_size;
+    uint32_t buffer_size;
+    uint32_t output_coalesce_delay; // in milliseconds
+    uint32_t output_drain_limit; // per scheduling round
+    uint32_t output_high_watermark;
+    uint32_t output_low_watermark;
+    uint32_t input_queue_limit;
+    uint32_t server_max_sessions;
+    uint32_t server_workers; // 0: sessions run on the main thread
+    uint32_t shell_pool_size; // 0: disabled
+    char certificate_path[PATH_MAX]; // empty: not persisted
+    enum rawrtc_certificate_key_type certificate_key_type;
+    uint32_t certificate_modulus_length; // RSA only
+    uint32_t certificate_validity; // in seconds
+    char setup_record_path[PATH_MAX]; // empty: disabled
+    char setup_trace_path[PATH_MAX]; // empty: disabled
+    uint32_t latency_tracking; // 0: disabled
+    uint32_t metrics_port; // 0: disabled
+    uint32_t trace_ring_size; // in events, 0: disabled
+    uint32_t detach_timeout; // in seconds, 0: disabled
+    uint32_t detach_replay_size; // in bytes
+    uint32_t ice_restart_timeout; // in seconds, 0: disabled
+    uint32_t screen_sync; // 0: disabled
+    uint32_t output_compression_level; // 0: disabled
+    uint32_t output_interactive_window; // in milliseconds, 0: disabled
+    uint32_t output_flood_limit; // in bytes per flood window, 0: disabled
+    uint32_t output_flood_window; // in milliseconds
+    uint32_t output_flood_tail_size; // in bytes
+};
+
+/*
+ * Load the terminal options. Values that have not been configured will
+ * be set to their default value.
+ */
+void terminal_options_load(
+    struct terminal_options* const options // de-referenced
+);
+
+/*
+ * Print the terminal options.
+ */
+int terminal_options_debug(
+    struct re_printf* const pf,
+    struct terminal_options const* const options
+);
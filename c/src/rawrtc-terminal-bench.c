@@ -0,0 +1,963 @@
+/*
+ * In-process loopback benchmark of the terminal pipeline.
+ *
+ * Runs a terminal peer ("T") and a driver peer ("D") standing in for the
+ * web terminal within one process. Both peers use the terminal's client
+ * code, exchange their parameters directly and connect over host
+ * candidates only. The driver opens one data channel per scenario, so the
+ * terminal starts the scenario's command and its output goes through the
+ * real PTY read and data channel message handlers. The last scenario
+ * restarts ICE (replacing the transports of both peers), reattaches the
+ * echo process to a new data channel by its session token and measures
+ * the time until a keystroke is echoed by that same process. Before, the
+ * output compressor's ratio and CPU cost and the UTF-8 validators'
+ * throughput are measured on synthetic output.
+ */
+#include <stdio.h> // printf, fprintf, FILE, fdopen
+#include <inttypes.h> // SCNu32
+#include <errno.h> // errno
+#include <sys/stat.h> // fchmod
+#include <time.h> // clock_gettime, CLOCK_PROCESS_CPUTIME_ID
+
+// Use the terminal's client code (without its entry point)
+#define RAWRTC_TERMINAL_NO_MAIN
+#include "rawrtc-terminal.c"
+
+enum {
+    BENCH_DEFAULT_DURATION = 3000, // in milliseconds
+    BENCH_DEFAULT_FILE_SIZE = 32, // in MiB
+    BENCH_DEFAULT_KEYSTROKES = 1000,
+    BENCH_POLL_INTERVAL = 10, // in milliseconds
+    BENCH_ECHO_SETTLE_DELAY = 200, // in milliseconds
+    BENCH_SCENARIO_DELAY = 100, // in milliseconds
+    BENCH_LINE_LENGTH = 80,
+    BENCH_UTF8_SAMPLE_SIZE = 1048576,
+    BENCH_UTF8_VOLUME = 268435456, // bytes validated per validator and chunk size
+};
+
+enum bench_scenario_type {
+    BENCH_SCENARIO_STREAM_TIMED, // run for the configured duration
+    BENCH_SCENARIO_STREAM_UNTIL_EXIT, // run until the command exits
+    BENCH_SCENARIO_ECHO, // measure keystroke round-trips
+    BENCH_SCENARIO_ICE_RESTART, // measure the time until a process recovered from an ICE restart
+};
+
+enum bench_restart_stage {
+    BENCH_RESTART_IDLE,
+    BENCH_RESTART_TERMINAL_GATHERING,
+    BENCH_RESTART_DRIVER_GATHERING,
+    BENCH_RESTART_CONNECTING,
+    BENCH_RESTART_REOPENING,
+};
+
+struct bench_scenario {
+    char const* name;
+    enum bench_scenario_type type;
+    char command[PATH_MAX];
+    struct rawrtc_data_channel* channel;
+    struct tmr timer;
+    bool open;
+    bool measuring;
+    bool finished;
+    char const* failure; // nullable
+    enum bench_restart_stage restart_stage;
+    char token[SESSION_TOKEN_LENGTH + 1]; // empty: none handed out
+    uint64_t received; // bytes of output received in total
+    pid_t pid; // process to be reattached
+    uint64_t start; // in microseconds
+    uint64_t end; // in microseconds
+    uint64_t n_bytes;
+    uint64_t n_messages;
+    uint64_t keystroke_sent; // in microseconds
+    uint64_t* latencies; // in microseconds
+    size_t n_latencies;
+};
+
+struct bench {
+    struct terminal_client terminal;
+    struct terminal_client driver;
+    struct bench_scenario scenarios[4];
+    size_t current;
+    struct tmr timer;
+    uint32_t duration;
+    uint32_t file_size;
+    uint32_t keystrokes;
+    char file_path[PATH_MAX];
+    char cat_script_path[PATH_MAX];
+    char echo_script_path[PATH_MAX];
+};
+
+static struct bench bench;
+
+static void bench_start_scenario(
+    void* arg
+);
+
+static void bench_open_channel(
+    struct bench_scenario* const scenario
+);
+
+/*
+ * Create a temporary file from a template (ending with `XXXXXX`) and
+ * return a stream to write into it.
+ */
+static FILE* bench_create_file(
+        char* const path, // template, replaced with the path
+        mode_t const mode
+) {
+    int fd;
+    FILE* file;
+
+    // Create file
+    fd = mkstemp(path);
+    if (fd == -1) {
+        EWE("Cannot create '%s': %m\n", path, errno);
+    }
+    EOP(fchmod(fd, mode));
+
+    // Open stream
+    file = fdopen(fd, "w");
+    if (!file) {
+        EWE("Cannot open '%s': %m\n", path, errno);
+    }
+    return file;
+}
+
+/*
+ * Create the file to be dumped by `cat` and the scripts of the
+ * scenarios that need arguments or terminal settings.
+ */
+static void bench_create_files(void) {
+    char line[BENCH_LINE_LENGTH];
+    uint64_t const size = (uint64_t) bench.file_size * 1024 * 1024;
+    uint64_t written;
+    FILE* file;
+    size_t i;
+
+    // Create file of printable lines
+    for (i = 0; i < BENCH_LINE_LENGTH - 1; ++i) {
+        line[i] = (char) ('!' + i % ('~' - '!' + 1));
+    }
+    line[BENCH_LINE_LENGTH - 1] = '\n';
+    strcpy(bench.file_path, "/tmp/rawrtc-terminal-bench-XXXXXX");
+    file = bench_create_file(bench.file_path, 0600);
+    for (written = 0; written < size; written += BENCH_LINE_LENGTH) {
+        if (fwrite(line, BENCH_LINE_LENGTH, 1, file) != 1) {
+            EWE("Cannot write '%s'\n", bench.file_path);
+        }
+    }
+    EOP(fclose(file));
+
+    // Create script dumping the file
+    strcpy(bench.cat_script_path, "/tmp/rawrtc-terminal-bench-cat-XXXXXX");
+    file = bench_create_file(bench.cat_script_path, 0700);
+    fprintf(file, "#!/bin/sh\nexec cat '%s'\n", bench.file_path);
+    EOP(fclose(file));
+
+    // Create script echoing each keystroke through a process (like a shell in raw mode)
+    strcpy(bench.echo_script_path, "/tmp/rawrtc-terminal-bench-echo-XXXXXX");
+    file = bench_create_file(bench.echo_script_path, 0700);
+    fprintf(file, "#!/bin/sh\nstty raw -echo\nexec cat\n");
+    EOP(fclose(file));
+}
+
+/*
+ * Remove the files created for the scenarios.
+ */
+static void bench_remove_files(void) {
+    unlink(bench.file_path);
+    unlink(bench.cat_script_path);
+    unlink(bench.echo_script_path);
+}
+
+/*
+ * Get the CPU time consumed by the process in nanoseconds.
+ */
+static uint64_t bench_cpu_time(void) {
+    struct timespec now;
+    EOP(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now));
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * Fill a buffer with lines of coloured log output (with varying numbers,
+ * so it does not compress as well as a repeated line).
+ */
+static void bench_generate_log_output(
+        struct mbuf* const sample,
+        size_t const size
+) {
+    static char const* const levels[] = {
+        "\x1b[32mINFO\x1b[0m ", "\x1b[1;33mWARN\x1b[0m ", "\x1b[1;31mERROR\x1b[0m"};
+    uint32_t state = 1;
+
+    while (sample->end < size) {
+        // Pseudo-random (but reproducible) values
+        state = state * 1103515245 + 12345;
+        EOR(mbuf_printf(sample, "\x1b[2m2026-10-16 12:%02u:%02u.%03u\x1b[0m %s "
+                        "\x1b[36mworker-%u\x1b[0m request \x1b[1m%08x\x1b[0m completed in "
+                        "%u ms\r\n", (state >> 8) % 60, (state >> 14) % 60, (state >> 4) % 1000,
+                        levels[(state >> 20) % ARRAY_SIZE(levels)], (state >> 24) % 8, state,
+                        (state >> 10) % 5000));
+    }
+    sample->end = size;
+}
+
+/*
+ * Compress a sample in messages of the buffer size (like the terminal
+ * does) and print the compression ratio and the CPU time per MB.
+ */
+static void bench_compression(
+        char const* const name,
+        struct mbuf* const sample,
+        struct terminal_options const* const options
+) {
+    struct output_compressor* compressor;
+    struct mbuf* output;
+    struct mbuf input = {0};
+    uint64_t n_messages = 0;
+    uint64_t start;
+    double milliseconds;
+
+    // Enabled?
+    if (options->output_compression_level == 0) {
+        printf("%-6s compression disabled\n", name);
+        return;
+    }
+
+    // Create compressor & output buffer
+    EOE(output_compressor_create(&compressor, (int) options->output_compression_level));
+    output = mbuf_alloc(options->buffer_size);
+    if (!output) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+    }
+
+    // Compress
+    start = bench_cpu_time();
+    input.buf = sample->buf;
+    input.size = sample->end;
+    for (input.pos = 0; input.pos < sample->end; input.pos = input.end) {
+        bool complete = false;
+        input.end = MIN(input.pos + options->buffer_size, sample->end);
+        while (!complete) {
+            mbuf_rewind(output);
+            EOE(output_compressor_write(output, output->size, &complete, compressor, &input));
+            ++n_messages;
+        }
+    }
+    milliseconds = (double) (bench_cpu_time() - start) / 1000000.0;
+
+    // Report
+    printf("%-6s ratio %8.2f %12.2f ms CPU/MB (%"PRIu64" bytes into %"PRIu64" bytes, %"PRIu64
+           " messages, level %"PRIu32")\n",
+           name, (double) compressor->n_input / (double) compressor->n_output,
+           milliseconds / ((double) compressor->n_input / 1000000.0), compressor->n_input,
+           compressor->n_output, n_messages, options->output_compression_level);
+    fflush(stdout);
+
+    // Un-reference
+    mem_deref(output);
+    mem_deref(compressor);
+}
+
+/*
+ * Measure output compression on the file dumped by `cat` and on
+ * coloured log output of the same size.
+ */
+static void bench_compression_samples(
+        struct terminal_options const* const options
+) {
+    size_t const size = (size_t) bench.file_size * 1024 * 1024;
+    struct mbuf* sample;
+    FILE* file;
+
+    // Read file dumped by `cat`
+    sample = mbuf_alloc(size);
+    if (!sample) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+    }
+    file = fopen(bench.file_path, "r");
+    if (!file) {
+        EWE("Cannot open '%s': %m\n", bench.file_path, errno);
+    }
+    sample->end = fread(sample->buf, 1, size, file);
+    EOP(fclose(file));
+    bench_compression("z-cat", sample, options);
+
+    // Generate log output
+    mbuf_rewind(sample);
+    bench_generate_log_output(sample, size);
+    bench_compression("z-log", sample, options);
+
+    // Un-reference
+    mem_deref(sample);
+}
+
+/*
+ * Measure the throughput of each supported UTF-8 validator on mixed
+ * output (ASCII, accented letters, box drawing and emoji) depending on
+ * the chunk size. Chunks are split like text output: An incomplete
+ * character at the end is carried over to the next chunk.
+ */
+static void bench_utf8_validation(void) {
+    static size_t const chunk_sizes[] = {64, 256, 1024, 4096, 16384};
+    static enum utf8_validator const validators[] = {
+        UTF8_VALIDATOR_SCALAR, UTF8_VALIDATOR_SSSE3, UTF8_VALIDATOR_AVX2};
+    struct mbuf* sample;
+    size_t i;
+    size_t j;
+
+    // Generate sample
+    sample = mbuf_alloc(BENCH_UTF8_SAMPLE_SIZE);
+    if (!sample) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+    }
+    while (sample->end < BENCH_UTF8_SAMPLE_SIZE) {
+        EOR(mbuf_write_str(sample, "\xe2\x94\x9c\xe2\x94\x80\xe2\x94\x80 caf\xc3\xa9.txt "
+                                   "\x1b[32m\xe2\x9c\x93\x1b[0m 4.2 KiB \xf0\x9f\x93\x84 "
+                                   "modified 3 minutes ago\r\n"));
+    }
+    sample->end -= utf8_incomplete_length(sample->buf, sample->end);
+
+    for (i = 0; i < ARRAY_SIZE(validators); ++i) {
+        enum utf8_validator const validator = validators[i];
+
+        // Supported?
+        if (!utf8_validator_supported(validator)) {
+            printf("%-6s %-6s not supported\n", "utf8", utf8_validator_name(validator));
+            continue;
+        }
+
+        for (j = 0; j < ARRAY_SIZE(chunk_sizes); ++j) {
+            uint64_t validated = 0;
+            uint64_t invalid = 0;
+            uint64_t start = bench_cpu_time();
+            double seconds;
+
+            // Validate in chunks
+            while (validated < BENCH_UTF8_VOLUME) {
+                size_t position = 0;
+                while (position < sample->end) {
+                    size_t length = MIN(chunk_sizes[j], sample->end - position);
+                    length -= utf8_incomplete_length(sample->buf + position, length);
+                    invalid += !utf8_validate(validator, sample->buf + position, length);
+                    position += length;
+                }
+                validated += sample->end;
+            }
+            seconds = (double) (bench_cpu_time() - start) / 1000000000.0;
+
+            // Report
+            printf("%-6s %-6s chunk %5zu B %10.2f MB/s%s\n",
+                   "utf8", utf8_validator_name(validator), chunk_sizes[j],
+                   (double) validated / 1000000.0 / seconds,
+                   invalid > 0 ? " (invalid chunks!)" : "");
+        }
+    }
+    fflush(stdout);
+
+    // Un-reference
+    mem_deref(sample);
+}
+
+/*
+ * Compare latencies (for sorting).
+ */
+static int bench_compare_latencies(
+        void const* a,
+        void const* b
+) {
+    uint64_t const x = *(uint64_t const*) a;
+    uint64_t const y = *(uint64_t const*) b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Get a percentile of the sorted latencies.
+ */
+static uint64_t bench_percentile(
+        struct bench_scenario const* const scenario,
+        unsigned const percentile
+) {
+    size_t index = scenario->n_latencies * percentile / 100;
+    if (index >= scenario->n_latencies) {
+        index = scenario->n_latencies - 1;
+    }
+    return scenario->latencies[index];
+}
+
+/*
+ * Print the results of a scenario.
+ */
+static void bench_report(
+        struct bench_scenario* const scenario
+) {
+    double const seconds = (double) (scenario->end - scenario->start) / 1000000.0;
+
+    switch (scenario->type) {
+        case BENCH_SCENARIO_STREAM_TIMED:
+        case BENCH_SCENARIO_STREAM_UNTIL_EXIT:
+            printf("%-6s %10.2f MB/s %12.0f messages/s (%"PRIu64" bytes in %"PRIu64
+                   " messages, %.3f s)\n",
+                   scenario->name, (double) scenario->n_bytes / 1000000.0 / seconds,
+                   (double) scenario->n_messages / seconds, scenario->n_bytes,
+                   scenario->n_messages, seconds);
+            break;
+        case BENCH_SCENARIO_ECHO:
+            if (scenario->n_latencies == 0) {
+                printf("%-6s no keystrokes echoed\n", scenario->name);
+                break;
+            }
+            qsort(scenario->latencies, scenario->n_latencies, sizeof(*scenario->latencies),
+                  bench_compare_latencies);
+            printf("%-6s p50 %8"PRIu64" us    p99 %8"PRIu64" us    max %8"PRIu64
+                   " us (%zu keystrokes)\n",
+                   scenario->name, bench_percentile(scenario, 50),
+                   bench_percentile(scenario, 99),
+                   scenario->latencies[scenario->n_latencies - 1], scenario->n_latencies);
+            break;
+        case BENCH_SCENARIO_ICE_RESTART:
+            if (scenario->failure) {
+                printf("%-6s %s\n", scenario->name, scenario->failure);
+                break;
+            }
+            printf("%-6s recovered after %8"PRIu64" us (process %d reattached, ICE restart T %"
+                   PRIu64" us, D %"PRIu64" us)\n",
+                   scenario->name, scenario->end - scenario->start, (int) scenario->pid,
+                   bench.terminal.ice_restart_duration, bench.driver.ice_restart_duration);
+            break;
+    }
+    fflush(stdout);
+}
+
+/*
+ * Finish the current scenario: Close its data channel, print the results
+ * and continue with the next scenario (or stop).
+ */
+static void bench_finish_scenario(
+        struct bench_scenario* const scenario
+) {
+    // Already finished?
+    if (scenario->finished) {
+        return;
+    }
+    scenario->finished = true;
+    tmr_cancel(&scenario->timer);
+    if (scenario->measuring) {
+        scenario->end = get_monotonic_time_us();
+        scenario->measuring = false;
+    }
+
+    // Close data channel
+    if (scenario->open) {
+        scenario->open = false;
+        EOE(rawrtc_data_channel_close(scenario->channel));
+    }
+
+    // Print results
+    bench_report(scenario);
+
+    // Next scenario (or stop)
+    ++bench.current;
+    if (bench.current < ARRAY_SIZE(bench.scenarios)) {
+        tmr_start(&bench.timer, BENCH_SCENARIO_DELAY, bench_start_scenario, NULL);
+    } else {
+        re_cancel();
+    }
+}
+
+/*
+ * Send a keystroke to the echo process.
+ */
+static void bench_send_keystroke(
+        struct bench_scenario* const scenario
+) {
+    struct mbuf* const buffer = mbuf_alloc(1);
+    if (!buffer) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+    EOR(mbuf_write_u8(buffer, 'x'));
+    mbuf_set_pos(buffer, 0);
+    scenario->keystroke_sent = get_monotonic_time_us();
+    EOE(rawrtc_data_channel_send(scenario->channel, buffer, false));
+    mem_deref(buffer);
+}
+
+/*
+ * Stop a timed scenario once its duration has passed.
+ */
+static void bench_duration_timer_handler(
+        void* arg
+) {
+    bench_finish_scenario(arg);
+}
+
+/*
+ * Start measuring keystroke round-trips once the echo process had the
+ * chance to switch the terminal into raw mode.
+ */
+static void bench_echo_settle_timer_handler(
+        void* arg
+) {
+    struct bench_scenario* const scenario = arg;
+    scenario->measuring = true;
+    scenario->start = get_monotonic_time_us();
+    bench_send_keystroke(scenario);
+}
+
+/*
+ * Hand the new parameters of one peer to the other (which replaces its
+ * transports as well, if not done already). Return whether the restart
+ * has been applied.
+ */
+static bool bench_exchange_restart_parameters(
+        struct terminal_client* const from,
+        struct terminal_client* const to
+) {
+    struct odict* dict;
+    bool applied;
+
+    // Encode & handle
+    dict = client_encode_parameters(from);
+    applied = client_handle_signalling(to, dict);
+    mem_deref(dict);
+    return applied;
+}
+
+/*
+ * Get the process of the terminal's data channel of a scenario (or -1).
+ */
+static pid_t bench_get_terminal_pid(
+        struct bench_scenario const* const scenario
+) {
+    struct le* le;
+    for (le = list_head(&bench.terminal.data_channels); le != NULL; le = le->next) {
+        struct data_channel_helper* const channel = le->data;
+        struct terminal_client_channel* const client_channel = channel->arg;
+        if (str_cmp(channel->label, scenario->name) == 0) {
+            return client_channel->pid;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Drive the ICE restart: Exchange the new parameters once each peer
+ * completed gathering and reattach the process to a new data channel
+ * once both SCTP transports are connected again.
+ */
+static void bench_restart_timer_handler(
+        void* arg
+) {
+    struct bench_scenario* const scenario = arg;
+
+    switch (scenario->restart_stage) {
+        case BENCH_RESTART_TERMINAL_GATHERING:
+            if (!bench.terminal.gathering_complete) {
+                break;
+            }
+            if (!bench_exchange_restart_parameters(&bench.terminal, &bench.driver)) {
+                scenario->failure = "restart failed";
+                bench_finish_scenario(scenario);
+                return;
+            }
+
+            // The driver's data channel went away along with its transports
+            scenario->channel = mem_deref(scenario->channel);
+            scenario->restart_stage = BENCH_RESTART_DRIVER_GATHERING;
+            break;
+        case BENCH_RESTART_DRIVER_GATHERING:
+            if (!bench.driver.gathering_complete) {
+                break;
+            }
+            if (!bench_exchange_restart_parameters(&bench.driver, &bench.terminal)) {
+                scenario->failure = "restart failed";
+                bench_finish_scenario(scenario);
+                return;
+            }
+            scenario->restart_stage = BENCH_RESTART_CONNECTING;
+            break;
+        case BENCH_RESTART_CONNECTING:
+            if (bench.terminal.sctp_state != RAWRTC_SCTP_TRANSPORT_STATE_CONNECTED
+                    || bench.driver.sctp_state != RAWRTC_SCTP_TRANSPORT_STATE_CONNECTED) {
+                break;
+            }
+            scenario->restart_stage = BENCH_RESTART_REOPENING;
+            bench_open_channel(scenario);
+            return;
+        default:
+            return;
+    }
+
+    // Poll
+    tmr_start(&scenario->timer, BENCH_POLL_INTERVAL, bench_restart_timer_handler, scenario);
+}
+
+/*
+ * Restart ICE (initiated by the terminal) once the echo process had the
+ * chance to switch the terminal into raw mode.
+ * Note: The terminal replaces its transports first (detaching the
+ *       process), so the driver's transports going away do not stop the
+ *       process.
+ */
+static void bench_restart_settle_timer_handler(
+        void* arg
+) {
+    struct bench_scenario* const scenario = arg;
+
+    // Remember the process to be reattached
+    scenario->pid = bench_get_terminal_pid(scenario);
+    if (scenario->token[0] == '\0' || scenario->pid == -1) {
+        scenario->failure = "no detachable process";
+        bench_finish_scenario(scenario);
+        return;
+    }
+
+    // Restart
+    scenario->start = get_monotonic_time_us();
+    scenario->restart_stage = BENCH_RESTART_TERMINAL_GATHERING;
+    client_restart_ice(&bench.terminal);
+    tmr_start(&scenario->timer, BENCH_POLL_INTERVAL, bench_restart_timer_handler, scenario);
+}
+
+/*
+ * Start measuring once the data channel is open.
+ */
+static void bench_channel_open_handler(
+        void* const arg
+) {
+    struct bench_scenario* const scenario = arg;
+    scenario->open = true;
+
+    switch (scenario->type) {
+        case BENCH_SCENARIO_STREAM_TIMED:
+            tmr_start(&scenario->timer, bench.duration, bench_duration_timer_handler, scenario);
+            // Fallthrough
+        case BENCH_SCENARIO_STREAM_UNTIL_EXIT:
+            scenario->measuring = true;
+            scenario->start = get_monotonic_time_us();
+            break;
+        case BENCH_SCENARIO_ECHO:
+            tmr_start(&scenario->timer, BENCH_ECHO_SETTLE_DELAY,
+                      bench_echo_settle_timer_handler, scenario);
+            break;
+        case BENCH_SCENARIO_ICE_RESTART:
+            // Reattached after restarting? Send a keystroke right away.
+            if (scenario->restart_stage == BENCH_RESTART_REOPENING) {
+                scenario->measuring = true;
+                bench_send_keystroke(scenario);
+                break;
+            }
+            tmr_start(&scenario->timer, BENCH_ECHO_SETTLE_DELAY,
+                      bench_restart_settle_timer_handler, scenario);
+            break;
+    }
+}
+
+/*
+ * Account output of the terminal and echo the next keystroke (if
+ * measuring round-trips).
+ */
+static void bench_channel_message_handler(
+        struct mbuf* const buffer,
+        enum rawrtc_data_channel_message_flag const flags,
+        void* const arg
+) {
+    struct bench_scenario* const scenario = arg;
+    uint64_t const now = get_monotonic_time_us();
+
+    // Remember the session token (ignore other control messages)
+    if (flags & RAWRTC_DATA_CHANNEL_MESSAGE_FLAG_IS_BINARY) {
+        if (mbuf_get_left(buffer) == CONTROL_MESSAGE_SESSION_TOKEN_LENGTH
+                && mbuf_buf(buffer)[0] == CONTROL_MESSAGE_SESSION_TOKEN_TYPE) {
+            memcpy(scenario->token, mbuf_buf(buffer) + 1, SESSION_TOKEN_LENGTH);
+            scenario->token[SESSION_TOKEN_LENGTH] = '\0';
+        }
+        return;
+    }
+    scenario->received += mbuf_get_left(buffer);
+
+    // Ignore output outside of the measurement
+    if (!scenario->measuring) {
+        return;
+    }
+
+    // Account
+    scenario->n_bytes += mbuf_get_left(buffer);
+    ++scenario->n_messages;
+
+    // Keystroke echoed after restarting ICE? (by the same process)
+    if (scenario->type == BENCH_SCENARIO_ICE_RESTART && scenario->keystroke_sent != 0) {
+        if (bench_get_terminal_pid(scenario) != scenario->pid) {
+            scenario->failure = "process not reattached";
+        }
+        bench_finish_scenario(scenario);
+        return;
+    }
+
+    // Keystroke echoed?
+    if (scenario->type == BENCH_SCENARIO_ECHO && scenario->keystroke_sent != 0) {
+        scenario->latencies[scenario->n_latencies++] = now - scenario->keystroke_sent;
+        scenario->keystroke_sent = 0;
+        if (scenario->n_latencies < bench.keystrokes) {
+            bench_send_keystroke(scenario);
+        } else {
+            bench_finish_scenario(scenario);
+        }
+    }
+}
+
+/*
+ * Finish the scenario once the command exited (the terminal closes the
+ * data channel).
+ */
+static void bench_channel_close_handler(
+        void* const arg
+) {
+    struct bench_scenario* const scenario = arg;
+    scenario->open = false;
+
+    // Closed by restarting ICE? A new data channel will be opened.
+    if (scenario->type == BENCH_SCENARIO_ICE_RESTART
+            && scenario->restart_stage != BENCH_RESTART_IDLE
+            && scenario->restart_stage != BENCH_RESTART_REOPENING) {
+        return;
+    }
+    bench_finish_scenario(scenario);
+}
+
+/*
+ * Print data channel errors.
+ */
+static void bench_channel_error_handler(
+        void* const arg
+) {
+    struct bench_scenario* const scenario = arg;
+    DEBUG_WARNING("(%s) Data channel error\n", scenario->name);
+}
+
+/*
+ * Open a data channel for the scenario. The terminal starts the
+ * scenario's command once the channel is open (or reattaches its process
+ * after restarting ICE).
+ */
+static void bench_open_channel(
+        struct bench_scenario* const scenario
+) {
+    struct rawrtc_data_channel_parameters* parameters;
+    char* protocol = NULL;
+
+    // Request to reattach (if restarting ICE)
+    if (scenario->restart_stage == BENCH_RESTART_REOPENING) {
+        EOE(rawrtc_sdprintf(&protocol, "attach:%s:%"PRIu64, scenario->token, scenario->received));
+    }
+
+    // Create data channel
+    EOE(rawrtc_data_channel_parameters_create(
+            &parameters, scenario->name, RAWRTC_DATA_CHANNEL_TYPE_RELIABLE_ORDERED, 0, protocol,
+            false, 0));
+    mem_deref(protocol);
+    EOE(rawrtc_data_channel_create(
+            &scenario->channel, bench.driver.data_transport, parameters, NULL,
+            bench_channel_open_handler, NULL, bench_channel_error_handler,
+            bench_channel_close_handler, bench_channel_message_handler, scenario));
+    mem_deref(parameters);
+}
+
+/*
+ * Start the current scenario.
+ */
+static void bench_start_scenario(
+        void* arg
+) {
+    struct bench_scenario* const scenario = &bench.scenarios[bench.current];
+    (void) arg;
+
+    // Set the command the terminal will start
+    bench.terminal.shell = mem_deref(bench.terminal.shell);
+    EOE(rawrtc_sdprintf(&bench.terminal.shell, "%s", scenario->command));
+
+    // Open data channel
+    bench_open_channel(scenario);
+}
+
+/*
+ * Hand the parameters of one peer to the other and start its transports.
+ */
+static void bench_exchange_parameters(
+        struct terminal_client* const from,
+        struct terminal_client* const to
+) {
+    struct odict* dict;
+
+    // Encode & decode
+    dict = client_encode_parameters(from);
+    EOE(client_decode_parameters(&to->remote_parameters, dict, to));
+    mem_deref(dict);
+
+    // Add candidates & start transports
+    to->remote_parameters_received = true;
+    client_apply_parameters(to);
+    client_start_transports(to);
+}
+
+/*
+ * Exchange parameters once both peers completed gathering and start the
+ * first scenario.
+ */
+static void bench_gathering_timer_handler(
+        void* arg
+) {
+    (void) arg;
+
+    // Gathering complete?
+    if (!bench.terminal.gathering_complete || !bench.driver.gathering_complete) {
+        tmr_start(&bench.timer, BENCH_POLL_INTERVAL, bench_gathering_timer_handler, NULL);
+        return;
+    }
+
+    // Exchange parameters
+    bench_exchange_parameters(&bench.terminal, &bench.driver);
+    bench_exchange_parameters(&bench.driver, &bench.terminal);
+
+    // Start first scenario
+    // Note: The data channel is opened once the SCTP association has been established.
+    bench_start_scenario(NULL);
+}
+
+/*
+ * Set up a peer that gathers host candidates only.
+ */
+static void bench_init_peer(
+        struct terminal_client* const client,
+        char* const name,
+        enum rawrtc_ice_role const role,
+        struct terminal_options const* const options,
+        struct rawrtc_ice_gather_options* const gather_options,
+        struct rawrtc_certificate* const certificate,
+        char** const ice_candidate_types,
+        size_t const n_ice_candidate_types
+) {
+    client->name = name;
+    client->ice_candidate_types = ice_candidate_types;
+    client->n_ice_candidate_types = n_ice_candidate_types;
+    client->gather_options = mem_ref(gather_options);
+    client->certificate = mem_ref(certificate);
+    client->role = role;
+    client->options = options;
+    EOE(buffer_pool_create(&client->buffer_pool, options->buffer_pool_size, options->buffer_size));
+    EOE(output_scheduler_create(
+            &client->scheduler, options->output_drain_limit, options->output_interactive_window));
+    list_init(&client->data_channels);
+    list_init(&client->mux_channels);
+    list_init(&client->control_channels);
+    tmr_init(&client->teardown_timer);
+    setup_timing_start(&client->timing, 0);
+    client_init(client);
+    client_start_gathering(client);
+}
+
+static void exit_with_usage(char* program) {
+    DEBUG_WARNING("Usage: %s [<duration-ms>] [<file-size-mib>] [<keystrokes>]", program);
+    exit(1);
+}
+
+int main(int argc, char* argv[argc + 1]) {
+    char* ice_candidate_types[] = {"host"};
+    struct terminal_options options;
+    struct rawrtc_ice_gather_options* gather_options;
+    struct rawrtc_certificate* certificate;
+    size_t i;
+
+    // Initialise
+    EOE(rawrtc_init(true));
+
+    // Debug (only warnings, printing would dominate the results)
+    dbg_init(DBG_WARNING, DBG_ALL);
+
+    // Load options
+    terminal_options_load(&options);
+
+    // Get arguments (optional)
+    bench.duration = BENCH_DEFAULT_DURATION;
+    bench.file_size = BENCH_DEFAULT_FILE_SIZE;
+    bench.keystrokes = BENCH_DEFAULT_KEYSTROKES;
+    if (argc >= 2 && (sscanf(argv[1], "%"SCNu32, &bench.duration) != 1 || bench.duration == 0)) {
+        exit_with_usage(argv[0]);
+    }
+    if (argc >= 3 && (sscanf(argv[2], "%"SCNu32, &bench.file_size) != 1
+                      || bench.file_size == 0)) {
+        exit_with_usage(argv[0]);
+    }
+    if (argc >= 4 && (sscanf(argv[3], "%"SCNu32, &bench.keystrokes) != 1
+                      || bench.keystrokes == 0)) {
+        exit_with_usage(argv[0]);
+    }
+
+    // Create scenario files
+    bench_create_files();
+
+    // Measure output compression & UTF-8 validation
+    bench_compression_samples(&options);
+    bench_utf8_validation();
+
+    // Set up scenarios
+    bench.scenarios[0].name = "yes";
+    bench.scenarios[0].type = BENCH_SCENARIO_STREAM_TIMED;
+    strcpy(bench.scenarios[0].command, "yes");
+    bench.scenarios[1].name = "cat";
+    bench.scenarios[1].type = BENCH_SCENARIO_STREAM_UNTIL_EXIT;
+    strcpy(bench.scenarios[1].command, bench.cat_script_path);
+    bench.scenarios[2].name = "echo";
+    bench.scenarios[2].type = BENCH_SCENARIO_ECHO;
+    strcpy(bench.scenarios[2].command, bench.echo_script_path);
+    bench.scenarios[3].name = "ice";
+    bench.scenarios[3].type = BENCH_SCENARIO_ICE_RESTART;
+    strcpy(bench.scenarios[3].command, bench.echo_script_path);
+    bench.scenarios[2].latencies = mem_zalloc(sizeof(uint64_t) * bench.keystrokes, NULL);
+    if (!bench.scenarios[2].latencies) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+    }
+    for (i = 0; i < ARRAY_SIZE(bench.scenarios); ++i) {
+        tmr_init(&bench.scenarios[i].timer);
+    }
+
+    // Create ICE gather options (no STUN or TURN servers)
+    EOE(rawrtc_ice_gather_options_create(&gather_options, RAWRTC_ICE_GATHER_POLICY_ALL));
+
+    // Load or generate certificate (shared by both peers)
+    EOE(certificate_load_or_generate(&certificate, &options));
+
+    // Set up peers & start gathering
+    bench_init_peer(&bench.terminal, "T", RAWRTC_ICE_ROLE_CONTROLLED, &options, gather_options,
+                    certificate, ice_candidate_types, ARRAY_SIZE(ice_candidate_types));
+    bench_init_peer(&bench.driver, "D", RAWRTC_ICE_ROLE_CONTROLLING, &options, gather_options,
+                    certificate, ice_candidate_types, ARRAY_SIZE(ice_candidate_types));
+    mem_deref(certificate);
+    mem_deref(gather_options);
+
+    // Create store for detached processes (terminal only)
+    EOE(detached_shells_create(&bench.terminal.detached_shells));
+
+    // Wait for gathering to complete
+    tmr_init(&bench.timer);
+    tmr_start(&bench.timer, BENCH_POLL_INTERVAL, bench_gathering_timer_handler, NULL);
+
+    // Run scenarios
+    EOR(re_main(default_signal_handler));
+
+    // Stop peers & bye
+    tmr_cancel(&bench.timer);
+    for (i = 0; i < ARRAY_SIZE(bench.scenarios); ++i) {
+        tmr_cancel(&bench.scenarios[i].timer);
+        bench.scenarios[i].channel = mem_deref(bench.scenarios[i].channel);
+    }
+    mem_deref(bench.scenarios[2].latencies);
+    client_stop(&bench.driver);
+    client_stop(&bench.terminal);
+    bench.terminal.detached_shells = mem_deref(bench.terminal.detached_shells);
+    bench_remove_files();
+    before_exit();
+    return 0;
+}
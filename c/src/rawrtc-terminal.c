@@ -1,43 +1,124 @@
-#include <string.h> // memcpy
-#include <unistd.h> // STDIN_FILENO, STDOUT_FILENO, close, execvp, read, write
+#include <string.h> // memcpy, strcmp
+#include <unistd.h> // STDIN_FILENO, STDOUT_FILENO, close, read, write, pipe, tcgetpgrp
+#include <fcntl.h> // fcntl, F_GETFL, F_SETFL, F_SETFD, O_NONBLOCK, FD_CLOEXEC
 #include <limits.h> // USHRT_MAX
-#include <signal.h> // SIGTERM, kill
-#include <stdlib.h> // setenv
-#include <termios.h> // ioctl, struct winsize
-#include <pty.h> // forkpty
+#include <signal.h> // SIGTERM, SIGUSR1, SIGINT, SIGQUIT, SIGTSTP, kill, sigaction
+#include <stdlib.h> // exit
+#include <termios.h> // ioctl, struct winsize, tcgetattr, ISIG, NOFLSH, VINTR, VQUIT, VSUSP
+#include <sys/ioctl.h> // TIOCSWINSZ
+#include <sys/resource.h> // getrlimit, setrlimit, RLIMIT_NOFILE
+#include <pthread.h> // pthread_*
 #include <rawrtc.h>
 #include "helper/utils.h"
 #include "helper/handler.h"
 #include "helper/parameters.h"
+#include "helper/buffer_pool.h"
+#include "helper/buffer_queue.h"
+#include "options.h"
+#include "shell_pool.h"
+#include "certificate.h"
+#include "setup_timing.h"
+#include "latency.h"
+#include "metrics.h"
+#include "trace.h"
+#include "detach.h"
+#include "mux.h"
+#include "vt.h"
+#include "compression.h"
+#include "utf8.h"
+#include "scheduler.h"
 
 #define DEBUG_MODULE "rawrtc-terminal"
 #define DEBUG_LEVEL 7
 #include <re_dbg.h>
 
 enum {
-    PIPE_READ_BUFFER = 4096
+    BACKPRESSURE_POLL_INTERVAL = 100, // in milliseconds
+    OUTPUT_QUEUE_CAPACITY = 16,
+    INPUT_QUEUE_CAPACITY = 4,
+    WORKER_STATISTICS_INTERVAL = 5000, // in milliseconds
+    WINDOW_SIZE_TIMEOUT = 500, // in milliseconds
+    ICE_RESTART_DETACH_TIMEOUT = 60000, // in milliseconds
+};
+
+// Messages exchanged between the acceptor thread and the worker threads
+enum worker_message_type {
+    WORKER_MESSAGE_SESSION_START, // to worker
+    WORKER_MESSAGE_REMOTE_SIGNALLING, // to worker
+    WORKER_MESSAGE_WS_CLOSED, // to worker
+    WORKER_MESSAGE_SESSION_RELEASE, // to worker
+    WORKER_MESSAGE_STOP, // to worker
+    WORKER_MESSAGE_DUMP, // to worker
+    WORKER_MESSAGE_COLLECT_METRICS, // to worker
+    WORKER_MESSAGE_LOCAL_SIGNALLING, // to acceptor
+    WORKER_MESSAGE_LOCAL_SIGNALLING_LAST, // to acceptor
+    WORKER_MESSAGE_REMOTE_COMPLETE, // to acceptor
+    WORKER_MESSAGE_SESSION_STOPPED, // to acceptor
+    WORKER_MESSAGE_METRICS, // to acceptor
 };
 
 // Control message types
 enum {
-    CONTROL_MESSAGE_WINDOW_SIZE_TYPE = 0
+    CONTROL_MESSAGE_WINDOW_SIZE_TYPE = 0,
+    CONTROL_MESSAGE_PAUSE_INPUT_TYPE = 1,
+    CONTROL_MESSAGE_RESUME_INPUT_TYPE = 2,
+    CONTROL_MESSAGE_SESSION_TOKEN_TYPE = 3,
+    CONTROL_MESSAGE_REPLAY_TYPE = 4,
+    CONTROL_MESSAGE_SIGNAL_TYPE = 5,
+    CONTROL_MESSAGE_COMPRESSION_TYPE = 6,
+    CONTROL_MESSAGE_COMPRESSED_OUTPUT_TYPE = 7,
+    CONTROL_MESSAGE_OUTPUT_FORMAT_TYPE = 8,
+    CONTROL_MESSAGE_OUTPUT_TYPE = 9,
+    CONTROL_MESSAGE_CREDIT_TYPE = 10,
 };
 
 // Control message lengths
 enum {
-    CONTROL_MESSAGE_WINDOW_SIZE_LENGTH = 5
+    CONTROL_MESSAGE_WINDOW_SIZE_LENGTH = 5,
+    CONTROL_MESSAGE_PAUSE_INPUT_LENGTH = 1,
+    CONTROL_MESSAGE_RESUME_INPUT_LENGTH = 1,
+    CONTROL_MESSAGE_SESSION_TOKEN_LENGTH = 1 + SESSION_TOKEN_LENGTH,
+    CONTROL_MESSAGE_REPLAY_LENGTH = 9,
+    CONTROL_MESSAGE_SIGNAL_LENGTH = 2,
+    CONTROL_MESSAGE_COMPRESSION_LENGTH = 2,
+    CONTROL_MESSAGE_COMPRESSED_OUTPUT_LENGTH = 1, // followed by the compressed output
+    CONTROL_MESSAGE_OUTPUT_FORMAT_LENGTH = 2,
+    CONTROL_MESSAGE_OUTPUT_LENGTH = 1, // followed by the output
+    CONTROL_MESSAGE_CREDIT_LENGTH = 5,
+};
+
+// Formats of uncompressed output
+enum output_format {
+    OUTPUT_FORMAT_TEXT = 0, // text messages
+    OUTPUT_FORMAT_BINARY = 1, // output control messages
+};
+
+// Signals that can be requested by a signal control message
+enum {
+    CONTROL_SIGNAL_INTERRUPT = 0,
+    CONTROL_SIGNAL_QUIT = 1,
+    CONTROL_SIGNAL_SUSPEND = 2,
 };
 
 static char const ws_uri_regex[] = "ws:[^]*";
+static char const listen_regex[] = "listen:[^]+";
+static char const attach_regex[] = "attach:[0-9a-f]+:[0-9]+";
+static char const restart_path_prefix[] = "/restart/";
+static char const control_protocol[] = "control";
 
 struct parameters {
     struct rawrtc_ice_parameters* ice_parameters;
     struct rawrtc_ice_candidates* ice_candidates;
     struct rawrtc_dtls_parameters* dtls_parameters;
     struct sctp_parameters sctp_parameters;
+    bool trickle; // more candidates follow
 };
 
-// Note: Shadows struct client
+// Note: Shadows struct client. Sessions of a worker are being handled by
+//       two threads: Fields annotated with "acceptor" are only touched by
+//       the acceptor thread (which owns the WS connection), all others by
+//       the worker thread once the session has been handed off. Changes
+//       are handed over via the message queues.
 struct terminal_client {
     char* name;
     char** ice_candidate_types;
@@ -55,29 +136,204 @@ struct terminal_client {
     struct rawrtc_dtls_transport* dtls_transport;
     struct rawrtc_sctp_transport* sctp_transport;
     struct rawrtc_data_transport* data_transport;
-    struct websock_conn* ws_connection;
-    struct list data_channels;
+    struct websock_conn* ws_connection; // acceptor
+    struct list data_channels; // including multiplexed streams
+    struct list mux_channels;
+    struct list control_channels;
     struct parameters local_parameters;
     struct parameters remote_parameters;
+    struct terminal_options const* options;
+    struct buffer_pool* buffer_pool; // shared
+    struct shell_pool* shell_pool; // shared, nullable
+    struct trace_ring* trace; // shared, nullable
+    struct output_scheduler* scheduler; // shared
+    struct detached_shells* detached_shells; // borrowed, nullable
+    struct setup_timing_log* setup_log; // borrowed, nullable
+    struct setup_timing timing;
+    struct terminal_server* server; // nullable
+    struct terminal_worker* worker; // nullable
+    struct le le;
+    struct le worker_le;
+    struct tmr teardown_timer;
+    enum rawrtc_ice_transport_state ice_state;
+    enum rawrtc_dtls_transport_state dtls_state;
+    enum rawrtc_sctp_transport_state sctp_state;
+    bool candidate_pair_selected;
+    enum rawrtc_ice_candidate_type local_candidate_type;
+    enum rawrtc_ice_candidate_type remote_candidate_type;
+    enum rawrtc_ice_protocol candidate_protocol;
+    char restart_token[SESSION_TOKEN_LENGTH + 1]; // server mode only
+    uint32_t n_ice_restarts;
+    uint64_t ice_restart_start; // in microseconds, 0: not restarting
+    uint64_t ice_restart_duration; // most recent, in microseconds
+    bool ice_restart_pending; // awaiting the remote peer's new parameters
+    bool replacing_transports; // previous transports are being stopped (ICE restart)
+    bool awaiting_ice_restart; // teardown scheduled unless ICE is being restarted
+    bool gathering_complete;
+    bool local_parameters_sent;
+    bool remote_parameters_received; // worker
+    bool remote_candidates_complete; // worker
+    bool ws_remote_started; // acceptor
+    bool ws_local_done; // acceptor
+    bool ws_remote_done; // acceptor
+    bool stopping; // worker
+};
+
+/*
+ * Server mode: Serves many sessions (one client instance per session)
+ * whose remote parameters are received via WebSocket connections.
+ */
+struct terminal_server {
+    struct terminal_client const* prototype;
+    struct http_sock* http_socket;
+    struct websock* ws_socket;
+    struct rawrtc_certificate* certificate;
+    char* certificate_pem; // for workers
+    size_t certificate_pem_length;
+    struct list sessions;
+    uint32_t n_created;
+    size_t baseline_memory;
+    struct terminal_worker* workers;
+    uint32_t n_workers;
+    struct mqueue* mqueue; // to acceptor
+    struct tmr statistics_timer;
+    struct metrics_exporter* metrics; // borrowed, nullable
+    pthread_mutex_t ready_mutex;
+    pthread_cond_t ready_condition;
+    uint32_t n_ready;
+};
+
+/*
+ * Worker: Runs sessions on an event loop in its own thread. Sessions are
+ * handed off by the acceptor thread which also does the signalling.
+ * Note: Settings are not shared across threads as reference counting is
+ *       not thread-safe.
+ */
+struct terminal_worker {
+    struct terminal_server* server;
+    uint32_t id;
+    pthread_t thread;
+    struct mqueue* mqueue; // to worker
+    struct rawrtc_ice_gather_options* gather_options;
+    struct rawrtc_certificate* certificate;
+    struct buffer_pool* buffer_pool;
+    struct shell_pool* shell_pool; // nullable
+    struct trace_ring* trace; // nullable
+    struct output_scheduler* scheduler;
+    struct list sessions;
+    uint32_t n_sessions; // acceptor thread only
+    struct lock* lock;
+    uint64_t output_bytes; // guarded by lock
+    uint64_t last_output_bytes; // acceptor thread only
+};
+
+/*
+ * Message exchanged between the acceptor thread and a worker thread.
+ */
+struct worker_message {
+    struct terminal_client* client; // nullable
+    struct mbuf* buffer; // nullable, owned by the receiving thread
 };
 
 struct terminal_client_channel {
     pid_t pid;
     int pty;
+    size_t message_size;
+    struct buffer_pool* buffer_pool;
+    struct output_scheduler* scheduler;
+    struct output_scheduler_entry scheduling; // of the PTY's output
+    struct mbuf* output; // pending, nullable
+    struct tmr flush_timer;
+    struct buffer_queue* output_queue; // sent but still buffered by the data channel
+    bool throttled;
+    struct tmr backpressure_timer;
+    uint64_t throttle_start;
+    uint64_t throttle_count;
+    uint64_t throttle_duration; // in milliseconds
+    size_t max_buffered_amount;
+    struct buffer_queue* input_queue; // not yet written into the PTY
+    bool input_paused;
+    uint64_t input_discarded;
+    bool awaiting_window_size; // warm shell's output is held back until resized
+    struct tmr window_size_timer;
+    struct latency_tracker* latency; // nullable
+    struct metrics_channel_counters counters;
+    struct detached_shells* detached_shells; // borrowed, nullable
+    uint32_t detach_timeout; // in milliseconds, 0: stopped once closed
+    char token[SESSION_TOKEN_LENGTH + 1]; // empty: not detachable
+    char attach_token[SESSION_TOKEN_LENGTH + 1]; // empty: no reattach requested
+    uint64_t attach_sequence; // first byte of output the remote peer is missing
+    struct output_ring* output_ring; // nullable
+    struct data_channel_helper* mux; // borrowed, nullable (multiplexed stream)
+    uint16_t stream_id;
+    struct vt_screen* screen; // nullable
+    struct vt_screen* shadow; // screen of the remote peer while output is skipped, nullable
+    uint64_t output_skipped;
+    struct output_compressor* compressor; // nullable
+    enum output_format output_format;
+    struct output_ring* flood_tail; // most recent output while flooding, nullable
+    struct tmr flood_timer;
+    uint64_t flood_window_start; // in milliseconds
+    uint64_t flood_window_bytes;
+    uint64_t flood_diverted; // bytes of output read during the current flood
+    bool credit_enabled; // once the remote peer granted credit
+    int64_t credit; // bytes of output the remote peer is ready to process
+    bool credit_exhausted;
+    uint64_t credit_exhausted_start;
+    uint64_t credit_exhausted_duration; // in milliseconds
 };
 
+/*
+ * Data channel multiplexing the streams of many terminals (negotiated by
+ * the data channel protocol `mux`). Frames of several streams are
+ * batched into a single message.
+ */
+struct terminal_mux {
+    size_t message_size;
+    struct buffer_pool* buffer_pool;
+    struct mbuf* batch; // pending frames, nullable
+    struct tmr batch_timer;
+    struct buffer_queue* output_queue; // sent but still buffered by the data channel
+    uint64_t n_frames;
+    uint64_t n_messages;
+};
+
+static void client_init(
+    struct terminal_client* const client
+);
+
+static void client_create_transports(
+    struct terminal_client* const client
+);
+
+static void client_start_gathering(
+    struct terminal_client* const client
+);
+
 static void client_start_transports(
     struct terminal_client* const client
 );
 
+static void client_restart_ice(
+    struct terminal_client* const client
+);
+
 static void client_stop(
     struct terminal_client* const client
 );
 
+static void parameters_destroy(
+    struct parameters* const parameters
+);
+
 static void client_apply_parameters(
     struct terminal_client* const client
 );
 
+static size_t client_get_max_message_size(
+    struct terminal_client* const client
+);
+
 static enum rawrtc_code client_decode_parameters(
     struct parameters* const parametersp,
     struct odict* const dict,
@@ -88,8 +344,49 @@ static struct odict* client_encode_parameters(
     struct terminal_client* const client
 );
 
+static void client_schedule_teardown(
+    struct terminal_client* const client
+);
+
+static void client_schedule_teardown_after(
+    struct terminal_client* const client,
+    uint32_t const delay
+);
+
+static void worker_message_push(
+    struct mqueue* const queue,
+    enum worker_message_type const type,
+    struct terminal_client* const client,
+    struct mbuf* const buffer // nullable, ownership is transferred
+);
+
+/*
+ * Emit the session's setup timing record (once).
+ */
+static void client_emit_setup_timing(
+        struct terminal_client* const client,
+        bool const complete
+) {
+    setup_timing_emit(
+            client->setup_log, &client->timing, client->name,
+            client->worker ? (int32_t) client->worker->id : -1, complete);
+}
+
+/*
+ * Record a per-message event into the trace ring of the client's
+ * thread (if enabled).
+ */
+static void client_trace(
+        struct terminal_client* const client,
+        enum trace_event_type const type,
+        uint64_t const value
+) {
+    trace_ring_record(client->trace, client->timing.id, type, value);
+}
+
 /*
- * Print the WS close event.
+ * Print the WS close event. Tear down the session in server mode if the
+ * remote peer never sent anything.
  */
 static void ws_close_handler(
         int err,
@@ -97,10 +394,201 @@ static void ws_close_handler(
 ) {
     struct terminal_client* const client = arg;
     DEBUG_PRINTF("(%s) WS connection closed, reason: %m\n", client->name, err);
+    client->ws_connection = mem_deref(client->ws_connection);
+
+    // Remote peer gave up?
+    if (!client->ws_remote_started) {
+        if (client->worker) {
+            worker_message_push(
+                    client->worker->mqueue, WORKER_MESSAGE_WS_CLOSED, client, NULL);
+        } else {
+            client_schedule_teardown(client);
+        }
+    }
+}
+
+/*
+ * Close the WS connection once both peers have sent all of their
+ * candidates.
+ */
+static void client_close_ws_if_done(
+        struct terminal_client* const client
+) {
+    if (client->ws_connection && client->ws_local_done && client->ws_remote_done) {
+        DEBUG_PRINTF("(%s) Signalling complete, closing WS connection\n", client->name);
+        EOR(websock_close(client->ws_connection, WEBSOCK_NORMAL_CLOSURE, NULL));
+        client->ws_connection = mem_deref(client->ws_connection);
+    }
+}
+
+/*
+ * Add a remote ICE candidate (or the end-of-candidates indication if
+ * `candidate` is NULL).
+ */
+static void client_add_remote_candidate(
+        struct terminal_client* const client,
+        struct rawrtc_ice_candidate* const candidate // nullable
+) {
+    if (!candidate) {
+        DEBUG_PRINTF("(%s) Remote candidates complete\n", client->name);
+        client->remote_candidates_complete = true;
+        setup_timing_mark(&client->timing, SETUP_PHASE_REMOTE_CANDIDATES_COMPLETE);
+    }
+    EOE(rawrtc_ice_transport_add_remote_candidate(client->ice_transport, candidate));
+}
+
+/*
+ * Restart ICE with the remote peer's new parameters (and replace the
+ * local transports as well unless the restart has been initiated
+ * locally). The data channels are gone, detachable processes can be
+ * reattached by the remote peer.
+ * Return whether the restart has been applied.
+ */
+static bool client_handle_ice_restart(
+        struct terminal_client* const client,
+        struct odict* const dict
+) {
+    struct parameters parameters = {0};
+
+    // Established sessions only
+    if (!client->remote_parameters_received) {
+        DEBUG_WARNING("(%s) Unexpected ICE restart before remote parameters\n", client->name);
+        return false;
+    }
+
+    // Decode parameters
+    // Note: Nothing is being replaced unless the parameters are valid.
+    if (client_decode_parameters(&parameters, dict, client)) {
+        return false;
+    }
+
+    // Replace local transports (unless initiated locally)
+    if (!client->ice_restart_pending) {
+        client_restart_ice(client);
+    }
+    client->ice_restart_pending = false;
+
+    // Replace remote parameters
+    parameters_destroy(&client->remote_parameters);
+    memcpy(&client->remote_parameters, &parameters, sizeof(parameters));
+
+    // Start transports & add candidates
+    client_start_transports(client);
+    client_apply_parameters(client);
+    return true;
+}
+
+/*
+ * Handle a decoded signalling message which is one of:
+ *
+ * - the remote parameters (`iceParameters` etc.) with the candidates
+ *   gathered so far, more candidates follow if `trickle` is set,
+ * - the remote peer's new parameters after restarting ICE (`iceRestart`),
+ * - an additional remote candidate (`iceCandidate`), or
+ * - the end of remote candidates (`iceCandidatesComplete`).
+ *
+ * Return whether the message was valid.
+ */
+static bool client_handle_signalling(
+        struct terminal_client* const client,
+        struct odict* const dict
+) {
+    struct odict* node;
+    bool complete = false;
+    bool restart = false;
+
+    // ICE restart
+    if (dict_get_entry(&restart, dict, "iceRestart", ODICT_BOOL, false) == RAWRTC_CODE_SUCCESS
+            && restart) {
+        return client_handle_ice_restart(client, dict);
+    }
+
+    // Remote parameters
+    if (odict_lookup(dict, "iceParameters")) {
+        // Already received?
+        if (client->remote_parameters_received) {
+            DEBUG_NOTICE("(%s) Remote parameters already received, ignoring\n", client->name);
+            return true;
+        }
+
+        // Decode parameters
+        if (client_decode_parameters(&client->remote_parameters, dict, client)) {
+            return false;
+        }
+        setup_timing_mark(&client->timing, SETUP_PHASE_REMOTE_PARAMETERS_RECEIVED);
+
+        // Start transports & add candidates
+        // Note: ICE checks start right away, further candidates are added once received
+        client->remote_parameters_received = true;
+        client_start_transports(client);
+        client_apply_parameters(client);
+        return true;
+    }
+
+    // Remote parameters required for anything else
+    if (!client->remote_parameters_received) {
+        DEBUG_WARNING("(%s) Unexpected signalling message before remote parameters\n",
+                      client->name);
+        return false;
+    }
+
+    // Remote candidate
+    if (dict_get_entry(&node, dict, "iceCandidate", ODICT_OBJECT, false) == RAWRTC_CODE_SUCCESS) {
+        struct rawrtc_ice_candidate* candidate;
+
+        // Decode & add candidate (unless filtered)
+        if (get_ice_candidate(&candidate, node, (struct client*) client)) {
+            DEBUG_WARNING("(%s) Invalid remote candidate\n", client->name);
+            return false;
+        }
+        if (candidate) {
+            client_add_remote_candidate(client, candidate);
+            mem_deref(candidate);
+        }
+        return true;
+    }
+
+    // End of remote candidates
+    if (dict_get_entry(&complete, dict, "iceCandidatesComplete", ODICT_BOOL, false) == RAWRTC_CODE_SUCCESS) {
+        if (complete && !client->remote_candidates_complete) {
+            client_add_remote_candidate(client, NULL);
+        }
+        return true;
+    }
+
+    // Unknown
+    DEBUG_WARNING("(%s) Unknown signalling message\n", client->name);
+    return false;
+}
+
+/*
+ * Parse a JSON encoded signalling message and handle it.
+ */
+static bool client_handle_signalling_buffer(
+        struct terminal_client* const client,
+        struct mbuf* const buffer
+) {
+    struct odict* dict;
+    bool valid;
+
+    // Decode JSON
+    if (rawrtc_error_to_code(json_decode_odict(
+            &dict, 16, (char*) mbuf_buf(buffer), mbuf_get_left(buffer), 3))) {
+        DEBUG_WARNING("(%s) Invalid signalling message\n", client->name);
+        return false;
+    }
+
+    // Handle
+    valid = client_handle_signalling(client, dict);
+
+    // Un-reference
+    mem_deref(dict);
+    return valid;
 }
 
 /*
- * Receive the JSON encoded remote parameters, parse and apply them.
+ * Receive a JSON encoded signalling message and handle it (or hand it to
+ * the session's worker).
  */
 static void ws_receive_handler(
         struct websock_hdr const* header,
@@ -108,8 +596,7 @@ static void ws_receive_handler(
         void* arg
 ) {
     struct terminal_client* const client = arg;
-    enum rawrtc_code error;
-    struct odict* dict;
+    struct mbuf* copy;
     (void) header;
     DEBUG_PRINTF("(%s) WS message of %zu bytes received\n", client->name, mbuf_get_left(buffer));
 
@@ -118,49 +605,212 @@ static void ws_receive_handler(
         DEBUG_NOTICE("(%s) Unexpected opcode (%u) in WS message\n", client->name, header->opcode);
         return;
     }
+    client->ws_remote_started = true;
+
+    // Hand over to worker?
+    // Note: The buffer is copied as it belongs to the WS connection. The worker reports back
+    //       once the remote candidates are complete.
+    if (client->worker) {
+        copy = mbuf_alloc(mbuf_get_left(buffer));
+        if (!copy) {
+            EOE(RAWRTC_CODE_NO_MEMORY);
+            return;
+        }
+        EOR(mbuf_write_mem(copy, mbuf_buf(buffer), mbuf_get_left(buffer)));
+        mbuf_set_pos(copy, 0);
+        worker_message_push(
+                client->worker->mqueue, WORKER_MESSAGE_REMOTE_SIGNALLING, client, copy);
+        return;
+    }
 
-    // Decode JSON
-    error = rawrtc_error_to_code(json_decode_odict(
-            &dict, 16, (char*) mbuf_buf(buffer), mbuf_get_left(buffer), 3));
-    if (error) {
-        DEBUG_WARNING("(%s) Invalid remote parameters\n", client->name);
+    // Handle
+    client_handle_signalling_buffer(client, buffer);
+
+    // Close WS connection (if signalling is complete)
+    client->ws_remote_done = client->remote_candidates_complete;
+    client_close_ws_if_done(client);
+}
+
+/*
+ * Encode a dictionary as JSON.
+ */
+static struct mbuf* encode_json(
+        struct odict* const dict
+) {
+    struct mbuf* buffer;
+
+    // Allocate
+    buffer = mbuf_alloc(PARAMETERS_MAX_LENGTH);
+    if (!buffer) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return NULL;
+    }
+
+    // Encode as JSON
+    EOR(mbuf_printf(buffer, "%H", json_encode_odict, dict));
+    mbuf_set_pos(buffer, 0);
+    return buffer;
+}
+
+/*
+ * Send a JSON encoded signalling message via the WS connection. `last`
+ * indicates that no further local messages follow.
+ */
+static void client_ws_send(
+        struct terminal_client* const client,
+        struct mbuf* const buffer,
+        bool const last
+) {
+    // Connection still open?
+    if (!client->ws_connection) {
+        DEBUG_NOTICE("(%s) WS connection closed, cannot send signalling message\n", client->name);
         return;
     }
 
-    // Decode parameters
-    if (client_decode_parameters(&client->remote_parameters, dict, client) == RAWRTC_CODE_SUCCESS) {
-        // Set parameters & start transports
-        client_apply_parameters(client);
-        client_start_transports(client);
+    // Send
+    EOR(websock_send(client->ws_connection, WEBSOCK_TEXT, "%b",
+                     mbuf_buf(buffer), mbuf_get_left(buffer)));
 
-        // Close WS connection
-        EOR(websock_close(client->ws_connection, WEBSOCK_NORMAL_CLOSURE, NULL));
-        client->ws_connection = mem_deref(client->ws_connection);
+    // Close WS connection (if signalling is complete)
+    if (last) {
+        client->ws_local_done = true;
+        client_close_ws_if_done(client);
+    }
+}
+
+/*
+ * Send a signalling message to the other peer (or hand it to the
+ * acceptor thread in case the session runs on a worker).
+ */
+static void client_send_signalling(
+        struct terminal_client* const client,
+        struct odict* const dict,
+        bool const last
+) {
+    struct mbuf* const buffer = encode_json(dict);
+
+    // Hand over to acceptor (or send)
+    if (client->worker) {
+        worker_message_push(
+                client->server->mqueue,
+                last ? WORKER_MESSAGE_LOCAL_SIGNALLING_LAST : WORKER_MESSAGE_LOCAL_SIGNALLING,
+                client, buffer);
+        return;
     }
+    client_ws_send(client, buffer, last);
+
+    // Un-reference
+    mem_deref(buffer);
+}
+
+/*
+ * Send the end of local candidates indication.
+ */
+static void client_send_local_candidates_complete(
+        struct terminal_client* const client
+) {
+    struct odict* dict;
+
+    // Create dict
+    EOR(odict_alloc(&dict, 1));
+    EOR(odict_entry_add(dict, "iceCandidatesComplete", ODICT_BOOL, true));
+
+    // Send
+    DEBUG_PRINTF("(%s) Sending end of local candidates\n", client->name);
+    client_send_signalling(client, dict, true);
 
     // Un-reference
     mem_deref(dict);
 }
 
 /*
- * Send the JSON encoded local parameters to the other peer.
+ * Send a local candidate.
  */
-static void ws_established_handler(
-        void* arg
+static void client_send_local_candidate(
+        struct terminal_client* const client,
+        struct rawrtc_ice_candidate* const candidate
+) {
+    struct odict* dict;
+    struct odict* node;
+
+    // Create dict
+    EOR(odict_alloc(&dict, 1));
+    EOR(odict_alloc(&node, 16));
+    set_ice_candidate(candidate, node);
+    EOR(odict_entry_add(dict, "iceCandidate", ODICT_OBJECT, node));
+    mem_deref(node);
+
+    // Send
+    DEBUG_PRINTF("(%s) Sending local candidate\n", client->name);
+    client_send_signalling(client, dict, false);
+
+    // Un-reference
+    mem_deref(dict);
+}
+
+/*
+ * Send the local parameters including the candidates gathered so far.
+ * Further candidates will be sent as soon as they have been gathered.
+ */
+static void client_send_local_parameters(
+        struct terminal_client* const client
 ) {
-    struct terminal_client* const client = arg;
     struct odict* dict;
-    DEBUG_PRINTF("(%s) WS connection established\n", client->name);
 
     // Encode parameters
     dict = client_encode_parameters(client);
+    EOR(odict_entry_add(dict, "trickle", ODICT_BOOL, true));
+
+    // Hand out the token needed to restart ICE (server mode)
+    if (client->server && client->n_ice_restarts == 0) {
+        EOR(odict_entry_add(dict, "restartToken", ODICT_STRING, client->restart_token));
+    }
 
-    // Send as JSON
+    // Send
     DEBUG_INFO("(%s) Sending local parameters\n", client->name);
-    EOR(websock_send(client->ws_connection, WEBSOCK_TEXT, "%H", json_encode_odict, dict));
+    client_send_signalling(client, dict, false);
+    client->local_parameters_sent = true;
+    setup_timing_mark(&client->timing, SETUP_PHASE_LOCAL_PARAMETERS_SENT);
 
     // Un-reference
     mem_deref(dict);
+
+    // Gathering already complete?
+    if (client->gathering_complete) {
+        client_send_local_candidates_complete(client);
+    }
+}
+
+/*
+ * Send the local parameters to the other peer.
+ */
+static void ws_established_handler(
+        void* arg
+) {
+    struct terminal_client* const client = arg;
+    DEBUG_PRINTF("(%s) WS connection established\n", client->name);
+
+    // Send local parameters
+    client_send_local_parameters(client);
+}
+
+/*
+ * Start signalling once gathering has been started: Send the local
+ * parameters right away (server mode) or connect to the WS server.
+ * Copy & paste mode prints the parameters once gathering is complete.
+ */
+static void client_start_signalling(
+        struct terminal_client* const client
+) {
+    if (client->server) {
+        client_send_local_parameters(client);
+    } else if (client->ws_socket) {
+        EOR(websock_connect(
+            &client->ws_connection, client->ws_socket, client->http_client,
+            client->ws_uri, 30000,
+            ws_established_handler, ws_receive_handler, ws_close_handler,
+            client, NULL));
+    }
 }
 
 /*
@@ -181,12 +831,8 @@ static void stdin_receive_handler(
         goto out;
     }
 
-    // Decode parameters
-    if (client_decode_parameters(&client->remote_parameters, dict, client) == RAWRTC_CODE_SUCCESS) {
-        // Set parameters & start transports
-        client_apply_parameters(client);
-        client_start_transports(client);
-    }
+    // Handle parameters
+    client_handle_signalling(client, dict);
 
 out:
     // Un-reference
@@ -196,7 +842,8 @@ out:
     if (error == RAWRTC_CODE_NO_VALUE) {
         DEBUG_NOTICE("Exiting\n");
 
-        // Stop client & bye
+        // Stop listening on STDIN, stop client & bye
+        fd_close(STDIN_FILENO);
         client_stop(client);
         before_exit();
         exit(0);
@@ -216,14 +863,16 @@ static void print_local_parameters(
 
     // Print as JSON
     DEBUG_INFO("Local Parameters:\n%H\n", json_encode_odict, dict);
+    setup_timing_mark(&client->timing, SETUP_PHASE_LOCAL_PARAMETERS_SENT);
 
     // Un-reference
     mem_deref(dict);
 }
 
 /*
- * Print the local candidate. Open a connection to the WS server in
- * case all candidates have been gathered.
+ * Print the local candidate and trickle it to the other peer (if the
+ * local parameters have been sent already). Print the local parameters
+ * in copy & paste mode once all candidates have been gathered.
  */
 static void ice_gatherer_local_candidate_handler(
         struct rawrtc_ice_candidate* const candidate,
@@ -235,565 +884,4178 @@ static void ice_gatherer_local_candidate_handler(
     // Print local candidate
     default_ice_gatherer_local_candidate_handler(candidate, url, arg);
 
-    // Print or send local parameters (if last candidate)
-    if (!candidate) {
-        if (client->ws_socket) {
-            EOR(websock_connect(
-                &client->ws_connection, client->ws_socket, client->http_client,
-                client->ws_uri, 30000,
-                ws_established_handler, ws_receive_handler, ws_close_handler,
-                client, NULL));
-        } else {
+    // Gathering complete?
+    if (candidate) {
+        setup_timing_mark(&client->timing, SETUP_PHASE_FIRST_LOCAL_CANDIDATE);
+    } else {
+        client->gathering_complete = true;
+        setup_timing_mark(&client->timing, SETUP_PHASE_GATHERING_COMPLETE);
+
+        // Print local parameters (copy & paste mode)
+        if (!client->server && !client->ws_socket) {
             print_local_parameters(client);
+            return;
+        }
+    }
+
+    // Send candidate or end of candidates (if local parameters have been sent)
+    if (client->local_parameters_sent) {
+        if (candidate) {
+            client_send_local_candidate(client, candidate);
+        } else {
+            client_send_local_candidates_complete(client);
         }
     }
 }
 
+static void pty_update_listen(
+    struct data_channel_helper* const channel
+);
+
 /*
- * Write the received data channel message's data to the PTY (or handle
- * a control message).
+ * Hand a sent buffer back to the pool unless it is still being tracked
+ * by an output queue. In that case, the queue becomes its only owner and
+ * the buffer is handed back to the pool once the data channel dropped
+ * its reference (see `pty_get_buffered_amount`).
  */
-void data_channel_message_handler(
-        struct mbuf* const buffer,
-        enum rawrtc_data_channel_message_flag const flags,
-        void* const arg // will be casted to `struct data_channel_helper*`
+static void output_buffer_release(
+        struct buffer_pool* const pool,
+        struct mbuf* const buffer
+) {
+    // Note: Sent buffers are being queued if referenced by the data channel after sending.
+    if (mem_nrefs(buffer) > 1) {
+        mem_deref(buffer);
+    } else {
+        buffer_pool_release(pool, buffer);
+    }
+}
+
+/*
+ * Send the pending batch of frames on the multiplexed data channel (if
+ * any).
+ */
+static void mux_flush(
+        struct data_channel_helper* const mux_channel
+) {
+    struct terminal_mux* const mux = mux_channel->arg;
+    struct mbuf* const buffer = mux->batch;
+
+    // Cancel pending flush
+    tmr_cancel(&mux->batch_timer);
+
+    // Anything to send?
+    if (!buffer) {
+        return;
+    }
+    mux->batch = NULL;
+
+    // Send the batch
+    mbuf_set_pos(buffer, 0);
+    EOE(rawrtc_data_channel_send(mux_channel->channel, buffer, true));
+    ++mux->n_messages;
+
+    // Still buffered by the data channel? Keep track of it.
+    if (mem_nrefs(buffer) > 1) {
+        EOE(buffer_queue_push(mux->output_queue, buffer));
+    }
+
+    // Hand buffer back to pool (or leave it to the output queue)
+    output_buffer_release(mux->buffer_pool, buffer);
+}
+
+/*
+ * Send the pending batch once the streams had a chance to add frames.
+ */
+static void mux_batch_timer_handler(
+        void* arg
+) {
+    struct data_channel_helper* const mux_channel = arg;
+    mux_flush(mux_channel);
+}
+
+/*
+ * Add a frame to the pending batch of the multiplexed data channel.
+ * The batch is being sent once the frame would exceed the maximum
+ * message size or on the next event loop iteration.
+ */
+static void mux_send_frame(
+        struct data_channel_helper* const mux_channel,
+        uint16_t const stream_id,
+        enum mux_frame_type const type,
+        uint8_t const* const payload, // nullable if length is 0
+        size_t const length
+) {
+    struct terminal_mux* const mux = mux_channel->arg;
+
+    // Send pending batch first (if the frame does not fit)
+    if (mux->batch && mux->batch->end + MUX_FRAME_HEADER_LENGTH + length > mux->message_size) {
+        mux_flush(mux_channel);
+    }
+
+    // Get buffer from pool (if no batch pending)
+    if (!mux->batch) {
+        mux->batch = buffer_pool_get(mux->buffer_pool);
+    }
+
+    // Append frame
+    EOE(mux_frame_write(mux->batch, stream_id, type, payload, length));
+    ++mux->n_frames;
+
+    // Wait for frames of other streams
+    if (!tmr_isrunning(&mux->batch_timer)) {
+        tmr_start(&mux->batch_timer, 0, mux_batch_timer_handler, mux_channel);
+    }
+}
+
+/*
+ * Send a message on the data channel (or as a frame in case of a
+ * multiplexed stream).
+ */
+static void channel_send(
+        struct data_channel_helper* const channel,
+        struct mbuf* const buffer,
+        bool const is_binary
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    if (client_channel->mux) {
+        mux_send_frame(client_channel->mux, client_channel->stream_id,
+                       is_binary ? MUX_FRAME_CONTROL : MUX_FRAME_DATA,
+                       mbuf_buf(buffer), mbuf_get_left(buffer));
+    } else {
+        EOE(rawrtc_data_channel_send(channel->channel, buffer, is_binary));
+    }
+}
+
+/*
+ * Close the data channel (or the stream in case of a multiplexed
+ * stream).
+ */
+static void channel_close(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    if (client_channel->mux) {
+        mux_send_frame(client_channel->mux, client_channel->stream_id, MUX_FRAME_CLOSE, NULL, 0);
+    } else {
+        EOE(rawrtc_data_channel_close(channel->channel));
+    }
+}
+
+/*
+ * Send an encoded control message.
+ */
+static void send_control_buffer(
+        struct data_channel_helper* const channel,
+        struct mbuf* const buffer
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    mbuf_set_pos(buffer, 0);
+    channel_send(channel, buffer, true);
+    client_channel->counters.sent_bytes += mbuf_get_left(buffer);
+    ++client_channel->counters.sent_messages;
+}
+
+/*
+ * Send a control message that consists of the type only.
+ */
+static void send_control_message(
+        struct data_channel_helper* const channel,
+        uint_fast8_t const type
+) {
+    struct mbuf* const buffer = mbuf_alloc(1);
+    if (!buffer) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+
+    // Write type & send
+    EOR(mbuf_write_u8(buffer, (uint8_t) type));
+    send_control_buffer(channel, buffer);
+    mem_deref(buffer);
+}
+
+/*
+ * Send the session token the remote peer can reattach with.
+ */
+static void send_session_token(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct mbuf* const buffer = mbuf_alloc(CONTROL_MESSAGE_SESSION_TOKEN_LENGTH);
+    if (!buffer) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+
+    // Write type, token & send
+    EOR(mbuf_write_u8(buffer, CONTROL_MESSAGE_SESSION_TOKEN_TYPE));
+    EOR(mbuf_write_mem(buffer, (uint8_t const*) client_channel->token, SESSION_TOKEN_LENGTH));
+    send_control_buffer(channel, buffer);
+    mem_deref(buffer);
+}
+
+/*
+ * Send the sequence number of the output that is being replayed next.
+ */
+static void send_replay_message(
+        struct data_channel_helper* const channel,
+        uint64_t const sequence
+) {
+    struct mbuf* const buffer = mbuf_alloc(CONTROL_MESSAGE_REPLAY_LENGTH);
+    if (!buffer) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+
+    // Write type, sequence number & send
+    EOR(mbuf_write_u8(buffer, CONTROL_MESSAGE_REPLAY_TYPE));
+    EOR(mbuf_write_u64(buffer, sys_htonll(sequence)));
+    send_control_buffer(channel, buffer);
+    mem_deref(buffer);
+}
+
+/*
+ * Send the compression algorithm that is being applied to the output
+ * from now on.
+ */
+static void send_compression_message(
+        struct data_channel_helper* const channel,
+        enum compression_algorithm const algorithm
+) {
+    struct mbuf* const buffer = mbuf_alloc(CONTROL_MESSAGE_COMPRESSION_LENGTH);
+    if (!buffer) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+
+    // Write type, algorithm & send
+    EOR(mbuf_write_u8(buffer, CONTROL_MESSAGE_COMPRESSION_TYPE));
+    EOR(mbuf_write_u8(buffer, (uint8_t) algorithm));
+    send_control_buffer(channel, buffer);
+    mem_deref(buffer);
+}
+
+/*
+ * Send the format uncompressed output is being sent in from now on.
+ */
+static void send_output_format_message(
+        struct data_channel_helper* const channel,
+        enum output_format const format
+) {
+    struct mbuf* const buffer = mbuf_alloc(CONTROL_MESSAGE_OUTPUT_FORMAT_LENGTH);
+    if (!buffer) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+
+    // Write type, format & send
+    EOR(mbuf_write_u8(buffer, CONTROL_MESSAGE_OUTPUT_FORMAT_TYPE));
+    EOR(mbuf_write_u8(buffer, (uint8_t) format));
+    send_control_buffer(channel, buffer);
+    mem_deref(buffer);
+}
+
+/*
+ * Send uncompressed output as an output control message.
+ * If the output is preceded by (at least) the header's length, the
+ * header is written in front of it and the buffer is sent as is (and
+ * queued, including the header, while still buffered by the data
+ * channel). Otherwise, the output is copied into a new message.
+ */
+static void channel_send_binary_output(
+        struct data_channel_helper* const channel,
+        struct mbuf* const buffer
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    size_t const position = buffer->pos;
+    struct mbuf* message;
+
+    // Prepend header (without copying)
+    if (position >= CONTROL_MESSAGE_OUTPUT_LENGTH) {
+        buffer->pos -= CONTROL_MESSAGE_OUTPUT_LENGTH;
+        buffer->buf[buffer->pos] = CONTROL_MESSAGE_OUTPUT_TYPE;
+        channel_send(channel, buffer, true);
+        if (mem_nrefs(buffer) > 1) {
+            // Note: The queue owns the buffer once the caller handed it back by
+            //       `output_buffer_release`.
+            EOE(buffer_queue_push(client_channel->output_queue, buffer));
+        }
+        buffer->pos = position;
+        return;
+    }
+
+    // Copy into a new message
+    message = mbuf_alloc(CONTROL_MESSAGE_OUTPUT_LENGTH + mbuf_get_left(buffer));
+    if (!message) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+    EOR(mbuf_write_u8(message, CONTROL_MESSAGE_OUTPUT_TYPE));
+    EOR(mbuf_write_mem(message, mbuf_buf(buffer), mbuf_get_left(buffer)));
+    mbuf_set_pos(message, 0);
+    channel_send(channel, message, true);
+    if (mem_nrefs(message) > 1) {
+        EOE(buffer_queue_push(client_channel->output_queue, message));
+    }
+    mem_deref(message);
+}
+
+/*
+ * Send output on the data channel (compressed or as binary messages, if
+ * negotiated) and keep track of the messages still buffered by the data
+ * channel.
+ * Note: The buffer's position is left untouched. Pooled buffers must be
+ *       handed back by `output_buffer_release` since the buffer may have
+ *       been queued.
+ */
+static void channel_send_output(
+        struct data_channel_helper* const channel,
+        struct mbuf* const buffer
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    size_t const position = buffer->pos;
+    bool complete = false;
+
+    // Charge the remote peer's credit (if any)
+    if (client_channel->credit_enabled) {
+        client_channel->credit -= (int64_t) mbuf_get_left(buffer);
+    }
+
+    // Send as output control message (if requested)
+    if (!client_channel->compressor && client_channel->output_format == OUTPUT_FORMAT_BINARY) {
+        channel_send_binary_output(channel, buffer);
+        return;
+    }
+
+    // Send as is (if not compressed)
+    if (!client_channel->compressor) {
+        channel_send(channel, buffer, false);
+        if (mem_nrefs(buffer) > 1) {
+            EOE(buffer_queue_push(client_channel->output_queue, buffer));
+        }
+        return;
+    }
+
+    // Compress into messages of up to the maximum message size
+    while (!complete) {
+        struct mbuf* const message = buffer_pool_get(client_channel->buffer_pool);
+        if (!message) {
+            break;
+        }
+        EOR(mbuf_write_u8(message, CONTROL_MESSAGE_COMPRESSED_OUTPUT_TYPE));
+        EOE(output_compressor_write(
+                message, MIN(message->size, client_channel->message_size), &complete,
+                client_channel->compressor, buffer));
+
+        // Send (unless there was nothing left to be flushed)
+        if (message->end > CONTROL_MESSAGE_COMPRESSED_OUTPUT_LENGTH) {
+            mbuf_set_pos(message, 0);
+            channel_send(channel, message, true);
+            if (mem_nrefs(message) > 1) {
+                EOE(buffer_queue_push(client_channel->output_queue, message));
+            }
+        }
+        output_buffer_release(client_channel->buffer_pool, message);
+    }
+    buffer->pos = position;
+}
+
+/*
+ * Write a buffer into the PTY until it would block.
+ * Return `false` in case the PTY has been closed by the process.
+ */
+static bool pty_write_buffer(
+        struct terminal_client_channel* const client_channel,
+        struct mbuf* const buffer
+) {
+    while (mbuf_get_left(buffer) > 0) {
+        ssize_t const length = write(
+                client_channel->pty, mbuf_buf(buffer), mbuf_get_left(buffer));
+        if (length == -1) {
+            switch (errno) {
+                case EAGAIN:
+#if (EAGAIN != EWOULDBLOCK)
+                case EWOULDBLOCK:
+#endif
+                    return true;
+                case EINTR:
+                    continue;
+                case EIO:
+                    // Process is gone
+                    return false;
+                default:
+                    EOR(errno);
+                    return false;
+            }
+        }
+        mbuf_advance(buffer, length);
+    }
+    return true;
+}
+
+/*
+ * Write queued input into the PTY until it would block.
+ */
+static void pty_write_input(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    struct buffer_queue* const queue = client_channel->input_queue;
+    struct mbuf* buffer;
+
+    // Write queued buffers
+    while ((buffer = buffer_queue_peek(queue))) {
+        size_t const left = mbuf_get_left(buffer);
+        bool const open = pty_write_buffer(client_channel, buffer);
+        size_t const written = left - mbuf_get_left(buffer);
+
+        // Account written bytes
+        // Note: The buffer is gone once it has been written completely.
+        buffer_queue_advance(queue, written);
+        client_trace(client, TRACE_EVENT_INPUT_WRITTEN, written);
+        if (client_channel->latency) {
+            latency_tracker_input_written(client_channel->latency, written);
+        }
+
+        // Process is gone? Discard queued input.
+        if (!open) {
+            client_trace(client, TRACE_EVENT_INPUT_DISCARDED, queue->length);
+            while (queue->n_entries > 0) {
+                mem_deref(buffer_queue_pop(queue));
+            }
+            if (client_channel->latency) {
+                latency_tracker_input_discarded(client_channel->latency);
+            }
+            break;
+        }
+
+        // Would block?
+        if (written < left) {
+            break;
+        }
+    }
+
+    // Resume sender (if paused and the queue has been drained sufficiently)
+    if (client_channel->input_paused && queue->length <= client->options->input_queue_limit / 2) {
+        DEBUG_PRINTF("(%s.%s) Resuming input\n", client->name, channel->label);
+        client_trace(client, TRACE_EVENT_INPUT_RESUMED, queue->length);
+        send_control_message(channel, CONTROL_MESSAGE_RESUME_INPUT_TYPE);
+        client_channel->input_paused = false;
+    }
+}
+
+/*
+ * Write the received data into the PTY without blocking. Data that
+ * cannot be written immediately will be queued.
+ */
+static void pty_handle_input(
+        struct data_channel_helper* const channel,
+        struct mbuf* const buffer
 ) {
-    struct data_channel_helper* const channel = arg;
     struct terminal_client_channel* const client_channel = channel->arg;
     struct terminal_client* const client =
             (struct terminal_client* const) channel->client;
+    struct buffer_queue* const queue = client_channel->input_queue;
+    size_t const limit = client->options->input_queue_limit;
     size_t const length = mbuf_get_left(buffer);
-    (void) flags;
-    DEBUG_PRINTF("(%s.%s) Received %zu bytes\n", client->name, channel->label, length);
 
-    if (flags & RAWRTC_DATA_CHANNEL_MESSAGE_FLAG_IS_BINARY) {
-        uint_fast8_t type;
+    // The process' response should be read ahead of bulk output
+    output_scheduler_input(&client_channel->scheduling);
+
+    // Discard if the sender ignored the pause request for too long
+    if (queue->length + length > limit * 2) {
+        DEBUG_WARNING("(%s.%s) Input queue overflow, discarding %zu bytes\n",
+                      client->name, channel->label, length);
+        client_channel->input_discarded += length;
+        client_trace(client, TRACE_EVENT_INPUT_DISCARDED, length);
+        return;
+    }
+
+    // Write directly (if nothing is queued)
+    if (queue->n_entries == 0) {
+        bool const open = pty_write_buffer(client_channel, buffer);
+        client_trace(client, TRACE_EVENT_INPUT_WRITTEN, length - mbuf_get_left(buffer));
+        if (!open) {
+            // Process is gone
+            return;
+        }
+    }
+
+    // Queue remaining data
+    // Note: The data is being copied as the data channel may reuse its buffer
+    if (mbuf_get_left(buffer) > 0) {
+        struct mbuf* const remaining = mbuf_alloc(mbuf_get_left(buffer));
+        if (!remaining) {
+            EOE(RAWRTC_CODE_NO_MEMORY);
+            return;
+        }
+        EOR(mbuf_write_mem(remaining, mbuf_buf(buffer), mbuf_get_left(buffer)));
+        mbuf_set_pos(remaining, 0);
+        EOE(buffer_queue_push(queue, remaining));
+        mem_deref(remaining);
+        HOT_PATH_DEBUG_PRINTF("(%s.%s) Queued %zu bytes of input (%zu bytes in total)\n",
+                              client->name, channel->label, mbuf_get_left(remaining),
+                              queue->length);
+        client_trace(client, TRACE_EVENT_INPUT_QUEUED, queue->length);
+    }
+
+    // Pause sender (if the queue is full)
+    if (!client_channel->input_paused && queue->length >= limit) {
+        DEBUG_PRINTF("(%s.%s) Input queue full, pausing input\n", client->name, channel->label);
+        client_trace(client, TRACE_EVENT_INPUT_PAUSED, queue->length);
+        send_control_message(channel, CONTROL_MESSAGE_PAUSE_INPUT_TYPE);
+        client_channel->input_paused = true;
+    }
+
+    // Wait for the PTY to become writable (if needed)
+    pty_update_listen(channel);
+}
+
+/*
+ * Start reading the output of an adopted warm shell.
+ */
+static void pty_release_output(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
 
-        // Check size
-        if (length < 1) {
-            DEBUG_WARNING("(%s.%s) Invalid control message of size %zu\n",
-                    client->name, channel->label, length);
+    // Stop waiting for the window size
+    tmr_cancel(&client_channel->window_size_timer);
+    client_channel->awaiting_window_size = false;
+
+    // Listen on PTY
+    pty_update_listen(channel);
+}
+
+/*
+ * Release the adopted warm shell's output even though the window size
+ * has not been received.
+ */
+static void pty_window_size_timer_handler(
+        void* arg
+) {
+    struct data_channel_helper* const channel = arg;
+    DEBUG_NOTICE("(%s.%s) No window size received, releasing output\n",
+                 channel->client->name, channel->label);
+    pty_release_output(channel);
+}
+
+/*
+ * Deliver a signal requested by the remote peer to the foreground process
+ * group of the PTY, bypassing input that is still queued. Queued input is
+ * discarded like the terminal driver flushes its queues. If the process
+ * disabled signal generation (e.g. an editor in raw mode), the signal's
+ * control character is written into the PTY instead.
+ */
+static void pty_signal(
+        struct data_channel_helper* const channel,
+        uint_fast8_t const type
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    struct buffer_queue* const queue = client_channel->input_queue;
+    struct termios attributes;
+    int signal_number;
+    size_t character_index;
+    pid_t group;
+
+    // Map signal
+    switch (type) {
+        case CONTROL_SIGNAL_INTERRUPT:
+            signal_number = SIGINT;
+            character_index = VINTR;
+            break;
+        case CONTROL_SIGNAL_QUIT:
+            signal_number = SIGQUIT;
+            character_index = VQUIT;
+            break;
+        case CONTROL_SIGNAL_SUSPEND:
+            signal_number = SIGTSTP;
+            character_index = VSUSP;
+            break;
+        default:
+            DEBUG_WARNING("(%s.%s) Unknown signal %"PRIuFAST8"\n",
+                          client->name, channel->label, type);
             return;
+    }
+
+    // Process running?
+    if (client_channel->pty == -1) {
+        DEBUG_NOTICE("(%s.%s) No process, discarding signal\n", client->name, channel->label);
+        return;
+    }
+
+    // Signal generation disabled? Pass on the control character as input.
+    if (tcgetattr(client_channel->pty, &attributes) == -1) {
+        DEBUG_WARNING("(%s.%s) Unable to get terminal attributes, discarding signal: %m\n",
+                      client->name, channel->label, errno);
+        return;
+    }
+    if (!(attributes.c_lflag & ISIG)) {
+        uint8_t character = attributes.c_cc[character_index];
+        struct mbuf input = {.buf = &character, .size = 1, .pos = 0, .end = 1};
+        pty_handle_input(channel, &input);
+        return;
+    }
+
+    // Discard queued input
+    if (!(attributes.c_lflag & NOFLSH) && queue->n_entries > 0) {
+        client_channel->input_discarded += queue->length;
+        client_trace(client, TRACE_EVENT_INPUT_DISCARDED, queue->length);
+        while (queue->n_entries > 0) {
+            mem_deref(buffer_queue_pop(queue));
+        }
+        if (client_channel->latency) {
+            latency_tracker_input_discarded(client_channel->latency);
         }
+        pty_update_listen(channel);
+    }
+
+    // Signal the foreground process group (or the shell's group)
+    // Note: The shell is a session leader, so its group ID is its process ID.
+    group = tcgetpgrp(client_channel->pty);
+    if (group == -1) {
+        group = client_channel->pid;
+    }
+    DEBUG_PRINTF("(%s.%s) Sending signal %d to process group %d\n",
+                 client->name, channel->label, signal_number, group);
+    // Note: The process group may be gone by now.
+    if (kill(-group, signal_number) == -1) {
+        DEBUG_WARNING("(%s.%s) Unable to signal process group %d: %m\n",
+                      client->name, channel->label, group, errno);
+    }
+
+    // Resume sender (if paused)
+    if (client_channel->input_paused && queue->length == 0) {
+        DEBUG_PRINTF("(%s.%s) Resuming input\n", client->name, channel->label);
+        client_trace(client, TRACE_EVENT_INPUT_RESUMED, queue->length);
+        send_control_message(channel, CONTROL_MESSAGE_RESUME_INPUT_TYPE);
+        client_channel->input_paused = false;
+    }
+}
+
+/*
+ * Apply the requested compression algorithm to the output (if supported
+ * and enabled) and tell the remote peer the outcome.
+ */
+static void channel_negotiate_compression(
+        struct data_channel_helper* const channel,
+        enum compression_algorithm const algorithm
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    int const level = (int) client->options->output_compression_level;
+
+    // Already compressing? Cannot be changed for the lifetime of the data channel.
+    if (client_channel->compressor) {
+        send_compression_message(channel, COMPRESSION_DEFLATE);
+        return;
+    }
+
+    // Supported & enabled?
+    if (algorithm != COMPRESSION_DEFLATE || level == 0
+            || output_compressor_create(&client_channel->compressor, level)
+               != RAWRTC_CODE_SUCCESS) {
+        DEBUG_INFO("(%s.%s) Declined output compression (algorithm: %d)\n",
+                   client->name, channel->label, algorithm);
+        send_compression_message(channel, COMPRESSION_NONE);
+        return;
+    }
+
+    // Compress output from now on
+    DEBUG_PRINTF("(%s.%s) Compressing output (level: %d)\n",
+                 client->name, channel->label, level);
+    send_compression_message(channel, COMPRESSION_DEFLATE);
+}
+
+/*
+ * Apply the requested format to uncompressed output and tell the remote
+ * peer the outcome.
+ */
+static void channel_negotiate_output_format(
+        struct data_channel_helper* const channel,
+        enum output_format const format
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+
+    // Supported?
+    if (format == OUTPUT_FORMAT_TEXT || format == OUTPUT_FORMAT_BINARY) {
+        DEBUG_PRINTF("(%s.%s) Sending output as %s messages\n", channel->client->name,
+                     channel->label, format == OUTPUT_FORMAT_BINARY ? "binary" : "text");
+        client_channel->output_format = format;
+    } else {
+        DEBUG_INFO("(%s.%s) Declined output format %d\n",
+                   channel->client->name, channel->label, format);
+    }
+    send_output_format_message(channel, client_channel->output_format);
+}
+
+/*
+ * Return the amount of bytes that may be read from the PTY without
+ * exceeding the credit granted by the remote peer (taking output into
+ * account that is pending but has not been sent, yet).
+ */
+static size_t pty_get_credit(
+        struct terminal_client_channel const* const client_channel
+) {
+    int64_t credit = client_channel->credit;
+
+    // Not enabled?
+    if (!client_channel->credit_enabled) {
+        return SIZE_MAX;
+    }
+
+    // Subtract pending output
+    if (client_channel->output) {
+        credit -= (int64_t) mbuf_get_left(client_channel->output);
+    }
+    return credit > 0 ? (size_t) credit : 0;
+}
+
+/*
+ * Add credit granted by the remote peer and resume reading from the PTY
+ * (if it ran out of credit). The first grant enables credit-based flow
+ * control.
+ */
+static void channel_add_credit(
+        struct data_channel_helper* const channel,
+        uint32_t const credit
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+
+    // Enable (if not already enabled)
+    if (!client_channel->credit_enabled) {
+        DEBUG_PRINTF("(%s.%s) Output is limited by credit (initially %"PRIu32" bytes)\n",
+                     channel->client->name, channel->label, credit);
+        client_channel->credit_enabled = true;
+    }
+
+    // Add credit
+    client_channel->credit += credit;
+
+    // Resume reading (if any credit is available)
+    if (pty_get_credit(client_channel) > 0) {
+        if (client_channel->credit_exhausted) {
+            client_channel->credit_exhausted = false;
+            client_channel->credit_exhausted_duration +=
+                    tmr_jiffies() - client_channel->credit_exhausted_start;
+        }
+        pty_update_listen(channel);
+    }
+}
+
+/*
+ * Handle a control message.
+ */
+static void handle_control_message(
+        struct data_channel_helper* const channel,
+        struct mbuf* const buffer
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    size_t const length = mbuf_get_left(buffer);
+    uint_fast8_t type;
+
+    // Check size
+    if (length < 1) {
+        DEBUG_WARNING("(%s.%s) Invalid control message of size %zu\n",
+                client->name, channel->label, length);
+        return;
+    }
+
+    // Get type
+    type = mbuf_read_u8(buffer);
+    client_trace(client, TRACE_EVENT_CONTROL_RECEIVED, type);
+
+    // Handle control message
+    switch (type) {
+        case CONTROL_MESSAGE_WINDOW_SIZE_TYPE:
+            // Check size
+            if (length < CONTROL_MESSAGE_WINDOW_SIZE_LENGTH) {
+                DEBUG_WARNING("(%s.%s) Invalid window size message of size %zu\n",
+                        client->name, channel->label, length);
+                return;
+            }
+            {
+                uint_fast16_t columns;
+                uint_fast16_t rows;
+                struct winsize window_size = {0};
+
+                // Get window size
+                columns = ntohs(mbuf_read_u16(buffer));
+                rows = ntohs(mbuf_read_u16(buffer));
+
+                // Check window size
+#if (UINT16_MAX > USHRT_MAX)
+                if (columns > USHRT_MAX || rows > USHRT_MAX) {
+                    DEBUG_WARNING("(%s.%s) Invalid window size value\n",
+                                  client->name, channel->label);
+                    return;
+                }
+#endif
+
+                // Process running?
+                if (client_channel->pty == -1) {
+                    DEBUG_NOTICE("(%s.%s) No process, discarding window size\n",
+                                 client->name, channel->label);
+                    return;
+                }
+
+                // Set window size
+                window_size.ws_col = (unsigned short) columns;
+                window_size.ws_row = (unsigned short) rows;
+
+                // Apply window size
+                DEBUG_PRINTF("(%s.%s) Resizing terminal to %"PRIuFAST16" columns and "
+                        "%"PRIuFAST16" rows\n", client->name, channel->label, columns, rows);
+                if (ioctl(client_channel->pty, TIOCSWINSZ, &window_size) == -1) {
+                    DEBUG_WARNING("(%s.%s) Unable to resize terminal: %m\n",
+                                  client->name, channel->label, errno);
+                    return;
+                }
+                if (client_channel->screen) {
+                    EOE(vt_screen_resize(client_channel->screen, (uint16_t) columns,
+                                         (uint16_t) rows));
+                }
+            }
+
+            // Release held back output (if any)
+            if (client_channel->awaiting_window_size) {
+                pty_release_output(channel);
+            }
+
+            break;
+        case CONTROL_MESSAGE_SIGNAL_TYPE:
+            // Check size
+            if (length < CONTROL_MESSAGE_SIGNAL_LENGTH) {
+                DEBUG_WARNING("(%s.%s) Invalid signal message of size %zu\n",
+                        client->name, channel->label, length);
+                return;
+            }
+
+            // Deliver signal
+            pty_signal(channel, mbuf_read_u8(buffer));
+            break;
+        case CONTROL_MESSAGE_COMPRESSION_TYPE:
+            // Check size
+            if (length < CONTROL_MESSAGE_COMPRESSION_LENGTH) {
+                DEBUG_WARNING("(%s.%s) Invalid compression message of size %zu\n",
+                        client->name, channel->label, length);
+                return;
+            }
+
+            // Negotiate compression
+            channel_negotiate_compression(channel, mbuf_read_u8(buffer));
+            break;
+        case CONTROL_MESSAGE_OUTPUT_FORMAT_TYPE:
+            // Check size
+            if (length < CONTROL_MESSAGE_OUTPUT_FORMAT_LENGTH) {
+                DEBUG_WARNING("(%s.%s) Invalid output format message of size %zu\n",
+                        client->name, channel->label, length);
+                return;
+            }
+
+            // Negotiate output format
+            channel_negotiate_output_format(channel, mbuf_read_u8(buffer));
+            break;
+        case CONTROL_MESSAGE_CREDIT_TYPE:
+            // Check size
+            if (length < CONTROL_MESSAGE_CREDIT_LENGTH) {
+                DEBUG_WARNING("(%s.%s) Invalid credit message of size %zu\n",
+                        client->name, channel->label, length);
+                return;
+            }
+
+            // Add credit
+            channel_add_credit(channel, ntohl(mbuf_read_u32(buffer)));
+            break;
+        default:
+            DEBUG_WARNING("(%s.%s) Unknown control message %"PRIuFAST8"\n",
+                          client->name, channel->label, type);
+            break;
+    }
+}
+
+/*
+ * Write the received data channel message's data to the PTY (or handle
+ * a control message).
+ */
+void data_channel_message_handler(
+        struct mbuf* const buffer,
+        enum rawrtc_data_channel_message_flag const flags,
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    struct data_channel_helper* const channel = arg;
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    size_t const length = mbuf_get_left(buffer);
+    uint64_t arrival;
+    (void) flags;
+    HOT_PATH_DEBUG_PRINTF("(%s.%s) Received %zu bytes\n", client->name, channel->label, length);
+    client_channel->counters.received_bytes += length;
+    ++client_channel->counters.received_messages;
+
+    if (flags & RAWRTC_DATA_CHANNEL_MESSAGE_FLAG_IS_BINARY) {
+        // Handle control message
+        handle_control_message(channel, buffer);
+    } else {
+        // Process running?
+        if (client_channel->pty == -1) {
+            DEBUG_NOTICE("(%s.%s) No process, discarding %zu bytes\n",
+                         client->name, channel->label, length);
+            return;
+        }
+
+        // Write into PTY
+        HOT_PATH_DEBUG_PRINTF("(%s.%s) Piping %zu bytes into process...\n",
+                              client->name, channel->label, length);
+        client_trace(client, TRACE_EVENT_INPUT_RECEIVED, length);
+        arrival = client_channel->latency ? get_monotonic_time_us() : 0;
+        pty_handle_input(channel, buffer);
+        HOT_PATH_DEBUG_PRINTF("(%s.%s) ... completed!\n", client->name, channel->label);
+
+        // Track latency (once written, until the process' output has been sent)
+        if (client_channel->latency) {
+            latency_tracker_input_received(
+                    client_channel->latency, arrival, client_channel->input_queue->length);
+        }
+    }
+}
+
+/*
+ * Stop the PTY.
+ */
+static void stop_process(
+        struct terminal_client_channel* const channel
+) {
+    // Stop pending flush of PTY output, backpressure checks, waiting for the window size & flooding
+    tmr_cancel(&channel->flush_timer);
+    tmr_cancel(&channel->backpressure_timer);
+    tmr_cancel(&channel->window_size_timer);
+    if (channel->flood_tail) {
+        tmr_cancel(&channel->flood_timer);
+        channel->counters.flood_dropped_bytes += channel->flood_diverted;
+        channel->flood_tail = mem_deref(channel->flood_tail);
+    }
+    if (channel->throttled) {
+        channel->throttled = false;
+        channel->throttle_duration += tmr_jiffies() - channel->throttle_start;
+    }
+    if (channel->credit_exhausted) {
+        channel->credit_exhausted = false;
+        channel->credit_exhausted_duration += tmr_jiffies() - channel->credit_exhausted_start;
+    }
+
+    // Close PTY (if not already closed)
+    if (channel->pty != -1) {
+        // Stop listening on PTY & remove from the scheduler's run queue
+        fd_close(channel->pty);
+        output_scheduler_remove(&channel->scheduling);
+        EOP(close(channel->pty));
+
+        // Invalidate PTY
+        channel->pty = -1;
+    }
+
+    // Stop process (if not already stopped)
+    if (channel->pid != -1) {
+        // Terminate process
+        EOP(kill(channel->pid, SIGTERM));
+
+        // Invalidate process
+        channel->pid = -1;
+    }
+}
+
+/*
+ * Return whether the process will be detached once the data channel
+ * goes away.
+ */
+static bool is_detachable(
+        struct terminal_client_channel const* const channel
+) {
+    return channel->output_ring && channel->detach_timeout > 0;
+}
+
+/*
+ * Detach the process from the data channel so it can be reattached
+ * until the grace period expires (if detachable). Otherwise, stop the
+ * process.
+ */
+static void detach_or_stop_process(
+        struct terminal_client_channel* const channel
+) {
+    // Detachable & process running?
+    if (is_detachable(channel) && channel->pid != -1 && channel->pty != -1) {
+        // Keep output that has not been sent, yet
+        // Note: The remote peer will miss it, so it's going to be replayed.
+        if (channel->output) {
+            output_ring_write(channel->output_ring, mbuf_buf(channel->output),
+                              mbuf_get_left(channel->output));
+        }
+
+        // Stop listening on PTY & hand over process
+        fd_close(channel->pty);
+        output_scheduler_remove(&channel->scheduling);
+        detached_shells_put(channel->detached_shells, channel->token, channel->pid, channel->pty,
+                            channel->output_ring, channel->detach_timeout);
+        channel->output_ring = NULL;
+        channel->pty = -1;
+        channel->pid = -1;
+    }
+
+    // Stop process (if not detached)
+    stop_process(channel);
+}
+
+/*
+ * Print the latency histograms of a data channel (if tracked).
+ */
+static void print_latency(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    if (client_channel->latency) {
+        DEBUG_INFO("(%s.%s) Keystroke latency:\n%H", channel->client->name, channel->label,
+                   latency_tracker_debug, client_channel->latency);
+    }
+}
+
+/*
+ * Print the latency histograms of all data channels of a client.
+ */
+static void client_print_latency(
+        struct terminal_client* const client
+) {
+    struct le* le;
+    for (le = list_head(&client->data_channels); le != NULL; le = le->next) {
+        print_latency(le->data);
+    }
+}
+
+/*
+ * Print the output statistics of a data channel.
+ */
+static void print_output_statistics(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    DEBUG_INFO("(%s.%s) Output throttled %"PRIu64" times for %"PRIu64" ms in total, "
+               "max buffered amount: %zu bytes, discarded input: %"PRIu64" bytes, "
+               "skipped output: %"PRIu64" bytes\n",
+               channel->client->name, channel->label, client_channel->throttle_count,
+               client_channel->throttle_duration, client_channel->max_buffered_amount,
+               client_channel->input_discarded, client_channel->output_skipped);
+    DEBUG_INFO("(%s.%s) Output %H\n", channel->client->name, channel->label,
+               output_scheduler_entry_debug, &client_channel->scheduling);
+    if (client_channel->credit_enabled) {
+        DEBUG_INFO("(%s.%s) Output ran out of credit %"PRIu64" times for %"PRIu64" ms in "
+                   "total\n", channel->client->name, channel->label,
+                   client_channel->counters.credit_exhaustions,
+                   client_channel->credit_exhausted_duration);
+    }
+    if (client_channel->counters.floods > 0) {
+        DEBUG_INFO("(%s.%s) Output flooded %"PRIu64" times, dropped %"PRIu64" bytes\n",
+                   channel->client->name, channel->label, client_channel->counters.floods,
+                   client_channel->counters.flood_dropped_bytes);
+    }
+    if (client_channel->compressor) {
+        DEBUG_INFO("(%s.%s) Compressed %"PRIu64" bytes of output into %"PRIu64" bytes\n",
+                   channel->client->name, channel->label, client_channel->compressor->n_input,
+                   client_channel->compressor->n_output);
+    }
+    print_latency(channel);
+}
+
+/*
+ * Stop the forked process on error event.
+ */
+static void data_channel_error_handler(
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    struct data_channel_helper* const channel = arg;
+    struct terminal_client_channel* const client_channel = channel->arg;
+
+    // Print error event
+    default_data_channel_error_handler(arg);
+
+    // Detach or stop forked process
+    if (client_channel->pid != -1) {
+        DEBUG_INFO("(%s.%s) %s process\n", channel->client->name, channel->label,
+                   is_detachable(client_channel) ? "Detaching" : "Stopping");
+    }
+    detach_or_stop_process(client_channel);
+    print_output_statistics(channel);
+}
+
+/*
+ * Stop the forked process on close event.
+ */
+void data_channel_close_handler(
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    struct data_channel_helper* const channel = arg;
+    struct terminal_client_channel* const client_channel = channel->arg;
+
+    // Print close event
+    default_data_channel_close_handler(arg);
+
+    // Detach or stop forked process
+    if (client_channel->pid != -1) {
+        DEBUG_INFO("(%s.%s) %s process\n", channel->client->name, channel->label,
+                   is_detachable(client_channel) ? "Detaching" : "Stopping");
+    }
+    detach_or_stop_process(client_channel);
+    print_output_statistics(channel);
+}
+
+/*
+ * Release sent buffers that are no longer buffered by the data channel
+ * and return the amount of bytes that are still buffered.
+ */
+static size_t pty_get_buffered_amount(
+        struct terminal_client_channel* const client_channel
+) {
+    // Note: Streams share the buffered amount of the multiplexed data channel
+    struct buffer_queue* const queue = client_channel->mux ?
+            ((struct terminal_mux*) client_channel->mux->arg)->output_queue :
+            client_channel->output_queue;
+    struct mbuf* buffer;
+
+    // Note: Messages are being sent in order, so it's sufficient to look at the head. A buffer
+    //       only referenced by the queue has been dropped by the data channel.
+    while ((buffer = buffer_queue_peek(queue)) && mem_nrefs(buffer) == 1) {
+        buffer_pool_release(client_channel->buffer_pool, buffer_queue_pop(queue));
+    }
+
+    // Update gauge
+    if (queue->length > client_channel->max_buffered_amount) {
+        client_channel->max_buffered_amount = queue->length;
+    }
+    return queue->length;
+}
+
+/*
+ * Return the amount of bytes that are still buffered by the data channel
+ * without releasing sent buffers (see `pty_get_buffered_amount`).
+ */
+static size_t pty_peek_buffered_amount(
+        struct terminal_client_channel* const client_channel
+) {
+    // Note: Streams share the buffered amount of the multiplexed data channel
+    struct buffer_queue const* const queue = client_channel->mux ?
+            ((struct terminal_mux*) client_channel->mux->arg)->output_queue :
+            client_channel->output_queue;
+    size_t length = queue->length;
+    size_t i;
+
+    // Skip buffers that have been dropped by the data channel
+    for (i = 0; i < queue->n_entries; ++i) {
+        struct buffer_queue_entry const* const entry =
+                &queue->entries[(queue->head + i) % queue->capacity];
+        if (mem_nrefs(entry->buffer) != 1) {
+            break;
+        }
+        length -= entry->length;
+    }
+    return length;
+}
+
+static void pty_backpressure_timer_handler(
+    void* arg
+);
+
+static void pty_send_screen_diff(
+    struct data_channel_helper* const channel
+);
+
+/*
+ * Suspend reading from the PTY once the data channel's buffered amount
+ * exceeds the high watermark and resume once it dropped below the low
+ * watermark.
+ * If the screen is being tracked, reading continues and output is
+ * skipped instead. Once resumed, the changes of the screen are being
+ * sent.
+ * Return whether reading is suspended.
+ */
+static bool pty_update_backpressure(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    struct terminal_options const* const options = client->options;
+    size_t const buffered_amount = pty_get_buffered_amount(client_channel);
+
+    // PTY closed?
+    if (client_channel->pty == -1) {
+        return true;
+    }
+
+    if (!client_channel->throttled) {
+        // Above high watermark?
+        if (buffered_amount <= options->output_high_watermark) {
+            return false;
+        }
+
+        // Suspend reading
+        DEBUG_PRINTF("(%s.%s) Buffered amount (%zu bytes) above high watermark, suspending "
+                     "reading\n", client->name, channel->label, buffered_amount);
+        client_channel->throttled = true;
+        client_trace(client, TRACE_EVENT_OUTPUT_THROTTLED, buffered_amount);
+        pty_update_listen(channel);
+        client_channel->throttle_start = tmr_jiffies();
+        ++client_channel->throttle_count;
+
+        // Remember the screen the remote peer will end up with (if tracked)
+        if (client_channel->screen) {
+            EOE(vt_screen_copy(&client_channel->shadow, client_channel->screen));
+        }
+    } else {
+        // Below low watermark?
+        if (buffered_amount > options->output_low_watermark) {
+            return !client_channel->screen;
+        }
+
+        // Resume reading
+        DEBUG_PRINTF("(%s.%s) Buffered amount (%zu bytes) below low watermark, resuming "
+                     "reading\n", client->name, channel->label, buffered_amount);
+        tmr_cancel(&client_channel->backpressure_timer);
+        client_channel->throttled = false;
+        client_trace(client, TRACE_EVENT_OUTPUT_RESUMED, buffered_amount);
+        client_channel->throttle_duration += tmr_jiffies() - client_channel->throttle_start;
+        pty_update_listen(channel);
+
+        // Send the changes of the screen (if output has been skipped)
+        if (client_channel->shadow) {
+            pty_send_screen_diff(channel);
+        }
+        return false;
+    }
+
+    // Check periodically in case no buffered amount low event is being raised
+    tmr_start(&client_channel->backpressure_timer, BACKPRESSURE_POLL_INTERVAL,
+              pty_backpressure_timer_handler, channel);
+    return !client_channel->screen;
+}
+
+/*
+ * Re-check the buffered amount of a throttled data channel.
+ */
+static void pty_backpressure_timer_handler(
+        void* arg
+) {
+    struct data_channel_helper* const channel = arg;
+    struct terminal_client_channel* const client_channel = channel->arg;
+
+    // Re-check (and restart the timer if still throttled)
+    pty_update_backpressure(channel);
+    if (client_channel->throttled && client_channel->pty != -1) {
+        tmr_start(&client_channel->backpressure_timer, BACKPRESSURE_POLL_INTERVAL,
+                  pty_backpressure_timer_handler, channel);
+    }
+}
+
+/*
+ * Resume reading from the PTY (if throttled) once the data channel's
+ * buffered amount is low.
+ */
+static void data_channel_buffered_amount_low_handler(
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    struct data_channel_helper* const channel = arg;
+
+    // Print buffered amount low event
+    default_data_channel_buffered_amount_low_handler(arg);
+
+    // Update backpressure
+    pty_update_backpressure(channel);
+}
+
+/*
+ * Send the changes of the screen since output is being skipped, once
+ * the parser is not within a control sequence (otherwise, the remainder
+ * of that sequence would be sent as regular output).
+ */
+static void pty_send_screen_diff(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct mbuf* diff;
+    size_t length;
+
+    // Within a control sequence? Wait for more output.
+    if (!vt_screen_idle(client_channel->screen)) {
+        return;
+    }
+
+    // Encode changes
+    diff = mbuf_alloc(client_channel->message_size);
+    if (!diff) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+    EOE(vt_screen_diff(diff, client_channel->shadow, client_channel->screen));
+    DEBUG_PRINTF("(%s.%s) Skipped %"PRIu64" bytes of output in total, sending %zu bytes of "
+                 "screen changes\n", channel->client->name, channel->label,
+                 client_channel->output_skipped, diff->end);
+    if (client_channel->output_ring) {
+        output_ring_write(client_channel->output_ring, diff->buf, diff->end);
+    }
+    client_channel->shadow = mem_deref(client_channel->shadow);
+
+    // Send in messages of up to the maximum message size
+    // Note: Characters must not be split across messages.
+    mbuf_set_pos(diff, 0);
+    while ((length = mbuf_get_left(diff)) > 0) {
+        struct mbuf* buffer;
+        if (length > client_channel->message_size) {
+            length = client_channel->message_size;
+            while (length > 1 && (mbuf_buf(diff)[length] & 0xC0) == 0x80) {
+                --length;
+            }
+        }
+        buffer = mbuf_alloc(length);
+        if (!buffer) {
+            EOE(RAWRTC_CODE_NO_MEMORY);
+            break;
+        }
+        EOE(rawrtc_error_to_code(mbuf_write_mem(buffer, mbuf_buf(diff), length)));
+        mbuf_set_pos(buffer, 0);
+        channel_send_output(channel, buffer);
+        client_channel->counters.sent_bytes += length;
+        ++client_channel->counters.sent_messages;
+        mem_deref(buffer);
+        mbuf_advance(diff, (ssize_t) length);
+    }
+
+    // Un-reference
+    mem_deref(diff);
+}
+
+/*
+ * Feed PTY output into the screen (if tracked).
+ * Return whether the output has to be skipped because the data channel
+ * is congested (or the changes of the screen have not been sent yet).
+ */
+static bool pty_screen_update(
+        struct data_channel_helper* const channel,
+        struct mbuf* const buffer
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+
+    // Screen tracked?
+    if (!client_channel->screen) {
+        return false;
+    }
+    vt_screen_write(client_channel->screen, mbuf_buf(buffer), mbuf_get_left(buffer));
+
+    // Skipping output?
+    if (!client_channel->shadow) {
+        return false;
+    }
+    client_channel->output_skipped += mbuf_get_left(buffer);
+
+    // Send the changes of the screen (if no longer throttled)
+    if (!client_channel->throttled) {
+        pty_send_screen_diff(channel);
+    }
+    return true;
+}
+
+/*
+ * Return whether output is being sent as text messages (which must
+ * consist of valid UTF-8).
+ */
+static bool pty_sends_text(
+        struct terminal_client_channel const* const client_channel
+) {
+    return !client_channel->mux && !client_channel->compressor
+           && client_channel->output_format == OUTPUT_FORMAT_TEXT;
+}
+
+/*
+ * Prepare output to be sent as a text message: Hold back a character
+ * that has not been completed by the end of the buffer (it is moved into
+ * the next pending buffer) and replace invalid bytes.
+ * Return `false` in case nothing is left to be sent.
+ */
+static bool pty_prepare_text_output(
+        struct data_channel_helper* const channel,
+        struct mbuf* const buffer
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    size_t const incomplete = utf8_incomplete_length(mbuf_buf(buffer), mbuf_get_left(buffer));
+    size_t replaced;
+
+    // Carry incomplete character over to the next message (unless that's all there is)
+    if (incomplete > 0) {
+        if (incomplete == mbuf_get_left(buffer)) {
+            return false;
+        }
+        client_channel->output = buffer_pool_get(client_channel->buffer_pool);
+        buffer->end -= incomplete;
+        EOR(mbuf_write_mem(client_channel->output, buffer->buf + buffer->end, incomplete));
+    }
+
+    // Replace invalid bytes
+    replaced = utf8_sanitize(mbuf_buf(buffer), mbuf_get_left(buffer));
+    if (replaced > 0) {
+        HOT_PATH_DEBUG_PRINTF("(%s.%s) Replaced %zu invalid bytes of output\n",
+                              channel->client->name, channel->label, replaced);
+    }
+    return true;
+}
+
+/*
+ * Send pending PTY output on the data channel (if any).
+ */
+static void pty_flush_output(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    struct mbuf* const buffer = client_channel->output;
+
+    // Cancel pending flush
+    tmr_cancel(&client_channel->flush_timer);
+
+    // Anything to send?
+    if (!buffer) {
+        return;
+    }
+    client_channel->output = NULL;
+
+    // Text messages must not split a character (keep it pending in that case)
+    if (pty_sends_text(client_channel) && mbuf_get_left(buffer) > 0
+            && !pty_prepare_text_output(channel, buffer)) {
+        client_channel->output = buffer;
+        return;
+    }
+
+    // Send the buffer (unless skipped)
+    if (mbuf_get_left(buffer) > 0 && !pty_screen_update(channel, buffer)) {
+        HOT_PATH_DEBUG_PRINTF("(%s.%s) Sending %zu bytes\n",
+                              client->name, channel->label, mbuf_get_left(buffer));
+        channel_send_output(channel, buffer);
+        client_trace(client, TRACE_EVENT_OUTPUT_SENT, mbuf_get_left(buffer));
+        if (client_channel->output_ring) {
+            output_ring_write(client_channel->output_ring, mbuf_buf(buffer), mbuf_get_left(buffer));
+        }
+        client_channel->counters.sent_bytes += mbuf_get_left(buffer);
+        ++client_channel->counters.sent_messages;
+        if (client_channel->latency) {
+            latency_tracker_output_sent(client_channel->latency);
+        }
+
+        // Account output of the worker
+        if (client->worker) {
+            lock_write_get(client->worker->lock);
+            client->worker->output_bytes += mbuf_get_left(buffer);
+            lock_rel(client->worker->lock);
+        }
+
+        // Setup is complete once the first output has been sent
+        if (!client->timing.emitted) {
+            setup_timing_mark(&client->timing, SETUP_PHASE_FIRST_OUTPUT_SENT);
+            client_emit_setup_timing(client, true);
+        }
+    }
+
+    // Hand buffer back to pool
+    // Note: If the buffer is still buffered by the data channel, the output queue owns it and
+    //       hands it back once the data channel has dropped its reference.
+    output_buffer_release(client_channel->buffer_pool, buffer);
+}
+
+/*
+ * Send coalesced PTY output once the coalescing delay expired.
+ */
+static void pty_flush_timer_handler(
+        void* arg
+) {
+    struct data_channel_helper* const channel = arg;
+    pty_flush_output(channel);
+    pty_update_backpressure(channel);
+}
+
+/*
+ * Get the pending output buffer (or a new one from the pool).
+ * Note: Binary output reserves space for the header, so it can be sent as is.
+ */
+static struct mbuf* pty_get_output_buffer(
+        struct terminal_client_channel* const client_channel
+) {
+    if (!client_channel->output) {
+        client_channel->output = buffer_pool_get(client_channel->buffer_pool);
+        if (client_channel->output_format == OUTPUT_FORMAT_BINARY) {
+            client_channel->output->pos = CONTROL_MESSAGE_OUTPUT_LENGTH;
+            client_channel->output->end = CONTROL_MESSAGE_OUTPUT_LENGTH;
+        }
+    }
+    return client_channel->output;
+}
+
+/*
+ * Append output that has not been read from the PTY to the pending
+ * output. Buffers are being sent once full.
+ */
+static void pty_append_output(
+        struct data_channel_helper* const channel,
+        uint8_t const* data,
+        size_t length
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+
+    while (length > 0) {
+        struct mbuf* const buffer = pty_get_output_buffer(client_channel);
+        size_t const limit = MIN(buffer->size, client_channel->message_size);
+        size_t const n = MIN(length, limit - buffer->end);
+
+        // Copy
+        memcpy(buffer->buf + buffer->end, data, n);
+        buffer->end += n;
+        data += n;
+        length -= n;
+
+        // Send if the buffer is full
+        if (buffer->end >= limit) {
+            pty_flush_output(channel);
+        }
+    }
+}
+
+/*
+ * End the flood: Send a notice on how much output has been dropped,
+ * followed by the most recent output.
+ */
+static void pty_end_flood(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct output_ring* const tail = client_channel->flood_tail;
+    uint64_t sequence = 0;
+    uint8_t* data;
+    uint8_t const* start;
+    size_t length;
+    uint64_t dropped;
+    char notice[128];
+    int notice_length;
+
+    // Stop flooding
+    tmr_cancel(&client_channel->flood_timer);
+    client_channel->flood_tail = NULL;
+
+    // Read the tail
+    data = mem_alloc(tail->size, NULL);
+    if (!data) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        goto out;
+    }
+    length = output_ring_read(data, tail->size, &sequence, tail);
+
+    // Start at a line (so the tail does not begin amid a control sequence or a character)
+    start = memchr(data, '\n', length);
+    if (start) {
+        ++start;
+    } else {
+        for (start = data; start < data + length && (*start & 0xC0) == 0x80; ++start) {}
+    }
+    length -= (size_t) (start - data);
+
+    // Account dropped output
+    dropped = client_channel->flood_diverted - length;
+    client_channel->counters.flood_dropped_bytes += dropped;
+    DEBUG_INFO("(%s.%s) Output flood ended, dropped %"PRIu64" bytes\n",
+               channel->client->name, channel->label, dropped);
+
+    // Send notice & tail
+    notice_length = re_snprintf(notice, sizeof(notice),
+                                "\r\n\x1b[0m[%"PRIu64" bytes of output skipped]\r\n", dropped);
+    if (notice_length > 0) {
+        pty_append_output(channel, (uint8_t const*) notice, (size_t) notice_length);
+    }
+    pty_append_output(channel, start, length);
+    pty_flush_output(channel);
+
+out:
+    // Un-reference
+    mem_deref(data);
+    mem_deref(tail);
+}
+
+/*
+ * Check whether the flood ended once a flood window passed.
+ */
+static void pty_flood_timer_handler(
+        void* arg
+) {
+    struct data_channel_helper* const channel = arg;
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    struct terminal_options const* const options = client->options;
+
+    // Still flooding? Check again after the next window.
+    if (client_channel->flood_window_bytes > options->output_flood_limit) {
+        client_channel->flood_window_start = tmr_jiffies();
+        client_channel->flood_window_bytes = 0;
+        tmr_start(&client_channel->flood_timer, options->output_flood_window,
+                  pty_flood_timer_handler, channel);
+        return;
+    }
+
+    // End flood
+    pty_end_flood(channel);
+    pty_update_backpressure(channel);
+}
+
+/*
+ * Account `length` bytes of output that have just been read into the
+ * buffer against the flood limit. Once the limit has been exceeded
+ * within a flood window, these bytes are diverted into the flood tail
+ * instead of being sent until a window passes without exceeding the
+ * limit.
+ * Return whether the bytes have been diverted.
+ */
+static bool pty_flood_control(
+        struct data_channel_helper* const channel,
+        struct mbuf* const buffer,
+        size_t const length
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    struct terminal_options const* const options = client->options;
+    uint64_t const now = tmr_jiffies();
+
+    if (!client_channel->flood_tail) {
+        // Start a new window (if the previous one passed)
+        if (now - client_channel->flood_window_start >= options->output_flood_window) {
+            client_channel->flood_window_start = now;
+            client_channel->flood_window_bytes = 0;
+        }
+
+        // Limit exceeded?
+        client_channel->flood_window_bytes += length;
+        if (client_channel->flood_window_bytes <= options->output_flood_limit) {
+            return false;
+        }
+
+        // Start flooding
+        DEBUG_INFO("(%s.%s) Output exceeded %"PRIu32" bytes within %"PRIu32" ms, dropping "
+                   "output\n", client->name, channel->label, options->output_flood_limit,
+                   options->output_flood_window);
+        EOE(output_ring_create(&client_channel->flood_tail, options->output_flood_tail_size));
+        ++client_channel->counters.floods;
+        client_channel->flood_diverted = 0;
+        client_channel->flood_window_start = now;
+        client_channel->flood_window_bytes = 0;
+        tmr_start(&client_channel->flood_timer, options->output_flood_window,
+                  pty_flood_timer_handler, channel);
+    } else {
+        client_channel->flood_window_bytes += length;
+    }
+
+    // Divert what has just been read into the tail
+    // Note: Output that was pending before is still being sent.
+    buffer->end -= length;
+    output_ring_write(client_channel->flood_tail, buffer->buf + buffer->end, length);
+    client_channel->flood_diverted += length;
+    return true;
+}
+
+/*
+ * Drain the PTY and send its data on the data channel once the output
+ * scheduler served it. Read no more than `budget` bytes and return
+ * whether more output is pending.
+ * Data will be coalesced into messages of up to the maximum message
+ * size.
+ */
+static bool pty_read_handler(
+        size_t* const drainedp, // de-referenced
+        size_t const budget,
+        void* const arg
+) {
+    struct data_channel_helper* const channel = arg;
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    struct terminal_options const* const options = client->options;
+    size_t drained = 0;
+    bool terminated = false;
+    client_trace(client, TRACE_EVENT_OUTPUT_SCHEDULED, client_channel->scheduling.last_delay);
+
+    // Drain PTY until it would block (or the budget has been exhausted)
+    HOT_PATH_DEBUG_PRINTF("(%s.%s) Reading from process...\n", client->name, channel->label);
+    while (drained < budget) {
+        struct mbuf* buffer;
+        size_t limit;
+        size_t credit;
+        ssize_t length;
+
+        // Get buffer
+        buffer = pty_get_output_buffer(client_channel);
+        limit = MIN(buffer->size, client_channel->message_size);
+
+        // Out of credit? Stop reading until the remote peer granted more.
+        credit = pty_get_credit(client_channel);
+        if (credit == 0) {
+            if (!client_channel->credit_exhausted) {
+                client_channel->credit_exhausted = true;
+                client_channel->credit_exhausted_start = tmr_jiffies();
+                ++client_channel->counters.credit_exhaustions;
+            }
+            break;
+        }
+
+        // Read from PTY into buffer
+        length = read(client_channel->pty, buffer->buf + buffer->end,
+                      MIN(limit - buffer->end, credit));
+        if (length == -1) {
+            switch (errno) {
+                case EAGAIN:
+#if (EAGAIN != EWOULDBLOCK)
+                case EWOULDBLOCK:
+#endif
+                    // Drained
+                    break;
+                case EINTR:
+                    continue;
+                case EIO:
+                    // This happens when invoking 'exit' or similar commands
+                    terminated = true;
+                    break;
+                default:
+                    EOR(errno);
+                    break;
+            }
+            break;
+        }
+
+        // Process terminated?
+        if (length == 0) {
+            terminated = true;
+            break;
+        }
+
+        // Update buffer
+        buffer->end += (size_t) length;
+        drained += (size_t) length;
+        ++client_channel->counters.pty_reads;
+        if (client_channel->latency) {
+            latency_tracker_output_read(client_channel->latency);
+        }
+
+        // Drop output while flooding (but keep draining the PTY)
+        // Note: Not when synchronising the screen state, as the screen model must see all output
+        //       (and congestion is being handled by sending the screen's state instead).
+        if (options->output_flood_limit > 0 && !client_channel->screen
+                && pty_flood_control(channel, buffer, (size_t) length)) {
+            continue;
+        }
+
+        // Send if the buffer is full (and stop reading if the data channel is backed up)
+        if (buffer->end >= limit) {
+            pty_flush_output(channel);
+            if (pty_update_backpressure(channel)) {
+                break;
+            }
+        }
+    }
+    HOT_PATH_DEBUG_PRINTF("(%s.%s) ... read %zu bytes\n", client->name, channel->label, drained);
+    client_trace(client, TRACE_EVENT_OUTPUT_READ, drained);
+    *drainedp = drained;
+
+    // Process terminated?
+    if (terminated) {
+        // Send remaining output (including the tail of a flood)
+        if (client_channel->flood_tail) {
+            pty_end_flood(channel);
+        }
+        pty_flush_output(channel);
+
+        // Stop listening
+        if (client_channel->pid != -1) {
+            DEBUG_INFO("(%s.%s) Stopping process\n", channel->client->name, channel->label);
+        }
+        stop_process(client_channel);
+        print_output_statistics(channel);
+
+        // Close data channel (or stream)
+        channel_close(channel);
+
+        // Unreference helper
+        mem_deref(channel);
+        return false;
+    }
+
+    // Send now or wait for more data to be coalesced
+    if (client_channel->output && mbuf_get_left(client_channel->output) > 0) {
+        if (options->output_coalesce_delay == 0 || client_channel->throttled) {
+            pty_flush_output(channel);
+            pty_update_backpressure(channel);
+        } else if (!tmr_isrunning(&client_channel->flush_timer)) {
+            tmr_start(&client_channel->flush_timer, options->output_coalesce_delay,
+                      pty_flush_timer_handler, channel);
+        }
+    }
+
+    // Drained or suspended? Listen again.
+    // Note: Otherwise, the budget has been exhausted and the PTY is served again next round.
+    if (drained < budget || client_channel->pty == -1
+            || (client_channel->throttled && !client_channel->screen)) {
+        pty_update_listen(channel);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Write queued input into the PTY once writable and queue the PTY for
+ * sending its data once readable.
+ */
+static void pty_event_handler(
+        int flags,
+        void* arg
+) {
+    struct data_channel_helper* const channel = arg;
+
+    // Write queued input
+    if (flags & FD_WRITE) {
+        pty_write_input(channel);
+        pty_update_listen(channel);
+    }
+
+    // Queue for reading output (which stops listening for readability until served)
+    if (flags & FD_READ) {
+        struct terminal_client_channel* const client_channel = channel->arg;
+        output_scheduler_ready(client_channel->scheduler, &client_channel->scheduling);
+        pty_update_listen(channel);
+    }
+}
+
+/*
+ * Listen on the PTY for events depending on whether output is being
+ * throttled and whether input is pending.
+ */
+static void pty_update_listen(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    int flags = 0;
+
+    // PTY closed?
+    if (client_channel->pty == -1) {
+        return;
+    }
+
+    // Determine events
+    // Note: Output is being skipped instead of throttled in case the screen is being tracked.
+    if ((!client_channel->throttled || client_channel->screen)
+            && !client_channel->awaiting_window_size && !client_channel->scheduling.queued
+            && pty_get_credit(client_channel) > 0) {
+        flags |= FD_READ;
+    }
+    if (client_channel->input_queue->n_entries > 0) {
+        flags |= FD_WRITE;
+    }
+
+    // Update
+    if (flags) {
+        EOR(fd_listen(client_channel->pty, flags, pty_event_handler, channel));
+    } else {
+        fd_close(client_channel->pty);
+    }
+}
+
+/*
+ * Replay output that has been sent before the process has been detached,
+ * starting at `sequence` (or the oldest output still available).
+ */
+static void pty_replay_output(
+        struct data_channel_helper* const channel,
+        uint64_t sequence
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct output_ring* const ring = client_channel->output_ring;
+    uint64_t const requested = sequence;
+
+    // Tell the remote peer where the replay starts
+    output_ring_read(NULL, 0, &sequence, ring);
+    DEBUG_INFO("(%s.%s) Replaying %"PRIu64" bytes of output (requested: %"PRIu64", "
+               "available: %"PRIu64")\n", channel->client->name, channel->label,
+               ring->sequence - sequence, requested, sequence);
+    send_replay_message(channel, sequence);
+
+    // Send in messages of up to the maximum message size
+    while (sequence < ring->sequence) {
+        struct mbuf* const buffer = mbuf_alloc(client_channel->message_size);
+        if (!buffer) {
+            EOE(RAWRTC_CODE_NO_MEMORY);
+            return;
+        }
+        buffer->end = output_ring_read(buffer->buf, buffer->size, &sequence, ring);
+        sequence += buffer->end;
+        if (client_channel->screen) {
+            vt_screen_write(client_channel->screen, buffer->buf, buffer->end);
+        }
+        channel_send_output(channel, buffer);
+        client_channel->counters.sent_bytes += buffer->end;
+        ++client_channel->counters.sent_messages;
+        mem_deref(buffer);
+    }
+}
+
+/*
+ * Fork and start the process on open event.
+ */
+static void data_channel_open_handler(
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    struct data_channel_helper* const channel = arg;
+    struct terminal_client_channel* const client_channel = channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) channel->client;
+    bool reattached = false;
+    pid_t pid;
+    int pty;
+
+    // Print open event
+    default_data_channel_open_handler(arg);
+    setup_timing_mark(&client->timing, SETUP_PHASE_DATA_CHANNEL_OPEN);
+
+    // Reattach a detached process (if requested and not yet expired)
+    if (client_channel->attach_token[0] != '\0' && detached_shells_take(
+            &pid, &pty, &client_channel->output_ring, client_channel->detached_shells,
+            client_channel->attach_token) == RAWRTC_CODE_SUCCESS) {
+        DEBUG_INFO("(%s) Reattached process (pid=%d) to data channel %s\n",
+                   channel->client->name, pid, channel->label);
+        memcpy(client_channel->token, client_channel->attach_token, sizeof(client_channel->token));
+        reattached = true;
+    } else if (client->shell_pool && shell_pool_take(&pid, &pty, client->shell_pool) == 0) {
+        // Adopt a warm shell
+        // Note: Its output (e.g. the prompt) is held back until the window size has been
+        //       applied.
+        DEBUG_INFO("(%s) Adopted warm process (pid=%d) for data channel %s\n",
+                   channel->client->name, pid, channel->label);
+        client_channel->awaiting_window_size = true;
+        tmr_start(&client_channel->window_size_timer, WINDOW_SIZE_TIMEOUT,
+                  pty_window_size_timer_handler, channel);
+    } else {
+        // Fork to pseudo-terminal
+        // TODO: Fix leaking FDs
+        DEBUG_INFO("(%s) Starting process for data channel %s\n",
+                   channel->client->name, channel->label);
+        EOE(shell_start(&pid, &pty, client->shell));
+    }
+
+    // Set fields
+    client_channel->pid = pid;
+    client_channel->pty = pty;
+    output_scheduler_entry_init(&client_channel->scheduling, pty_read_handler, channel);
+
+    // Make PTY non-blocking
+    EOP(fcntl(pty, F_SETFL, fcntl(pty, F_GETFL) | O_NONBLOCK));
+
+    // Coalesce PTY output into messages of up to the negotiated maximum message size
+    // Note: Limited by the buffer size
+    client_channel->message_size = client_get_max_message_size(client);
+    if (client_channel->message_size == 0
+            || client_channel->message_size > client->options->buffer_size) {
+        client_channel->message_size = client->options->buffer_size;
+    }
+    if (client_channel->mux) {
+        client_channel->message_size -= MUX_FRAME_HEADER_LENGTH;
+    }
+    DEBUG_PRINTF("(%s.%s) Maximum output message size: %zu bytes\n",
+                 client->name, channel->label, client_channel->message_size);
+
+    // Track the screen (until the window size is known, assume the default size)
+    if (client->options->screen_sync) {
+        EOE(vt_screen_create(&client_channel->screen, 80, 24));
+    }
+
+    // Hand out session token (and replay the output the remote peer missed)
+    if (client_channel->detached_shells) {
+        if (!reattached) {
+            session_token_generate(client_channel->token);
+            EOE(output_ring_create(
+                    &client_channel->output_ring, client->options->detach_replay_size));
+        }
+        send_session_token(channel);
+        if (reattached) {
+            pty_replay_output(channel, client_channel->attach_sequence);
+        }
+    }
+
+    // Listen on PTY
+    pty_update_listen(channel);
+}
+
+static void terminal_client_channel_destroy(
+        void* arg
+) {
+    struct terminal_client_channel* const client_channel = arg;
+
+    // Detach or stop process
+    detach_or_stop_process(client_channel);
+
+    // Discard pending output
+    if (client_channel->output) {
+        buffer_pool_release(client_channel->buffer_pool, client_channel->output);
+    }
+
+    // Un-reference
+    mem_deref(client_channel->flood_tail);
+    mem_deref(client_channel->compressor);
+    mem_deref(client_channel->shadow);
+    mem_deref(client_channel->screen);
+    mem_deref(client_channel->output_ring);
+    mem_deref(client_channel->latency);
+    mem_deref(client_channel->input_queue);
+    mem_deref(client_channel->output_queue);
+    mem_deref(client_channel->scheduler);
+    mem_deref(client_channel->buffer_pool);
+}
+
+/*
+ * Parse the session token and the sequence number of the output to be
+ * replayed from an attach request formatted as
+ * `attach:<token>:<sequence>`.
+ */
+static void parse_attach_request(
+        struct terminal_client_channel* const client_channel,
+        char const* const request,
+        size_t const length
+) {
+    struct pl token;
+    struct pl sequence;
+
+    // Parse
+    if (re_regex(request, length, attach_regex, &token, &sequence) == 0
+            && token.l == SESSION_TOKEN_LENGTH) {
+        EOR(pl_strcpy(&token, client_channel->attach_token, sizeof(client_channel->attach_token)));
+        client_channel->attach_sequence = pl_u64(&sequence);
+    }
+}
+
+/*
+ * Create a terminal client channel instance. A detached process will
+ * be reattached on open in case an attach request is present.
+ */
+static struct terminal_client_channel* client_channel_create(
+        struct terminal_client* const client,
+        char const* const attach_request, // nullable
+        size_t const attach_request_length
+) {
+    struct terminal_client_channel* client_channel;
+
+    // Allocate
+    client_channel = mem_zalloc(sizeof(*client_channel), terminal_client_channel_destroy);
+    if (!client_channel) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return NULL;
+    }
+
+    // Set fields
+    client_channel->pid = -1;
+    client_channel->pty = -1;
+    client_channel->buffer_pool = mem_ref(client->buffer_pool);
+    client_channel->scheduler = mem_ref(client->scheduler);
+    tmr_init(&client_channel->flush_timer);
+    tmr_init(&client_channel->backpressure_timer);
+    tmr_init(&client_channel->window_size_timer);
+    tmr_init(&client_channel->flood_timer);
+    EOE(buffer_queue_create(&client_channel->output_queue, OUTPUT_QUEUE_CAPACITY));
+    EOE(buffer_queue_create(&client_channel->input_queue, INPUT_QUEUE_CAPACITY));
+    if (client->options->latency_tracking) {
+        EOE(latency_tracker_create(&client_channel->latency));
+    }
+    if (client->detached_shells) {
+        client_channel->detached_shells = client->detached_shells;
+        client_channel->detach_timeout = client->options->detach_timeout * 1000;
+        if (attach_request) {
+            parse_attach_request(client_channel, attach_request, attach_request_length);
+        }
+    }
+    return client_channel;
+}
+
+/*
+ * Find a stream of a multiplexed data channel.
+ */
+static struct data_channel_helper* mux_get_stream(
+        struct data_channel_helper* const mux_channel,
+        uint16_t const stream_id
+) {
+    struct terminal_client* const client =
+            (struct terminal_client* const) mux_channel->client;
+    struct le* le;
+
+    for (le = list_head(&client->data_channels); le != NULL; le = le->next) {
+        struct data_channel_helper* const channel = le->data;
+        struct terminal_client_channel* const client_channel = channel->arg;
+        if (client_channel->mux == mux_channel && client_channel->stream_id == stream_id) {
+            return channel;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Open a stream on a multiplexed data channel and fork (or reattach) its
+ * process. The payload of the open frame may contain an attach request.
+ */
+static void mux_open_stream(
+        struct data_channel_helper* const mux_channel,
+        uint16_t const stream_id,
+        struct mbuf* const payload
+) {
+    struct terminal_client* const client =
+            (struct terminal_client* const) mux_channel->client;
+    struct terminal_client_channel* client_channel;
+    struct data_channel_helper* channel_helper;
+    char* label;
+
+    // Create terminal client channel instance
+    client_channel = client_channel_create(
+            client, mbuf_get_left(payload) > 0 ? (char const*) mbuf_buf(payload) : NULL,
+            mbuf_get_left(payload));
+    if (!client_channel) {
+        return;
+    }
+    client_channel->mux = mux_channel;
+    client_channel->stream_id = stream_id;
+
+    // Create data channel helper instance
+    EOE(rawrtc_sdprintf(&label, "%s/%"PRIu16, mux_channel->label, stream_id));
+    data_channel_helper_create_for_stream(
+            &channel_helper, mem_ref(mux_channel->channel), label, mux_channel->client,
+            client_channel);
+    mem_deref(label);
+    mem_deref(client_channel);
+
+    // Add to list
+    list_append(&client->data_channels, &channel_helper->le, channel_helper);
+
+    // Open (the multiplexed data channel is already open)
+    data_channel_open_handler(channel_helper);
+}
+
+/*
+ * Detach or stop the process of a multiplexed stream and remove the
+ * stream.
+ */
+static void mux_remove_stream(
+        struct data_channel_helper* const channel
+) {
+    struct terminal_client_channel* const client_channel = channel->arg;
+
+    // Detach or stop forked process
+    if (client_channel->pid != -1) {
+        DEBUG_INFO("(%s.%s) %s process\n", channel->client->name, channel->label,
+                   is_detachable(client_channel) ? "Detaching" : "Stopping");
+    }
+    detach_or_stop_process(client_channel);
+    print_output_statistics(channel);
+
+    // Unreference helper
+    mem_deref(channel);
+}
+
+/*
+ * Remove all streams of a multiplexed data channel and discard pending
+ * frames.
+ */
+static void mux_close_streams(
+        struct data_channel_helper* const mux_channel
+) {
+    struct terminal_client* const client =
+            (struct terminal_client* const) mux_channel->client;
+    struct terminal_mux* const mux = mux_channel->arg;
+    struct le* le = list_head(&client->data_channels);
+
+    // Remove streams
+    while (le) {
+        struct data_channel_helper* const channel = le->data;
+        struct terminal_client_channel* const client_channel = channel->arg;
+        le = le->next;
+        if (client_channel->mux == mux_channel) {
+            mux_remove_stream(channel);
+        }
+    }
+
+    // Discard pending frames
+    tmr_cancel(&mux->batch_timer);
+    if (mux->batch) {
+        buffer_pool_release(mux->buffer_pool, mux->batch);
+        mux->batch = NULL;
+    }
+    DEBUG_INFO("(%s.%s) Sent %"PRIu64" frames in %"PRIu64" messages\n",
+               client->name, mux_channel->label, mux->n_frames, mux->n_messages);
+}
+
+/*
+ * Determine the maximum message size on open event.
+ */
+static void mux_open_handler(
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    struct data_channel_helper* const mux_channel = arg;
+    struct terminal_mux* const mux = mux_channel->arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) mux_channel->client;
+
+    // Print open event
+    default_data_channel_open_handler(arg);
+    setup_timing_mark(&client->timing, SETUP_PHASE_DATA_CHANNEL_OPEN);
+
+    // Batch frames into messages of up to the negotiated maximum message size
+    // Note: Limited by the buffer size
+    mux->message_size = client_get_max_message_size(client);
+    if (mux->message_size == 0 || mux->message_size > client->options->buffer_size) {
+        mux->message_size = client->options->buffer_size;
+    }
+    DEBUG_PRINTF("(%s.%s) Maximum batch size: %zu bytes\n",
+                 client->name, mux_channel->label, mux->message_size);
+}
+
+/*
+ * Remove all streams on error event.
+ */
+static void mux_error_handler(
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    // Print error event
+    default_data_channel_error_handler(arg);
+
+    // Remove streams
+    mux_close_streams(arg);
+}
+
+/*
+ * Remove all streams on close event.
+ */
+static void mux_close_handler(
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    // Print close event
+    default_data_channel_close_handler(arg);
+
+    // Remove streams
+    mux_close_streams(arg);
+}
+
+/*
+ * Resume reading from the PTYs of all streams (if throttled) once the
+ * multiplexed data channel's buffered amount is low.
+ */
+static void mux_buffered_amount_low_handler(
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    struct data_channel_helper* const mux_channel = arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) mux_channel->client;
+    struct le* le;
+
+    // Print buffered amount low event
+    default_data_channel_buffered_amount_low_handler(arg);
+
+    // Update backpressure of each stream
+    for (le = list_head(&client->data_channels); le != NULL; le = le->next) {
+        struct data_channel_helper* const channel = le->data;
+        struct terminal_client_channel* const client_channel = channel->arg;
+        if (client_channel->mux == mux_channel) {
+            pty_update_backpressure(channel);
+        }
+    }
+}
+
+/*
+ * Dispatch the frames of a received message to their streams.
+ */
+static void mux_message_handler(
+        struct mbuf* const buffer,
+        enum rawrtc_data_channel_message_flag const flags,
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    struct data_channel_helper* const mux_channel = arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) mux_channel->client;
+
+    // Frames are binary
+    if (!(flags & RAWRTC_DATA_CHANNEL_MESSAGE_FLAG_IS_BINARY)) {
+        DEBUG_WARNING("(%s.%s) Discarding non-binary message of size %zu\n",
+                      client->name, mux_channel->label, mbuf_get_left(buffer));
+        return;
+    }
+
+    // Handle each frame
+    while (mbuf_get_left(buffer) > 0) {
+        uint16_t stream_id;
+        uint8_t type;
+        struct mbuf payload;
+        struct data_channel_helper* channel;
+
+        // Read frame
+        enum rawrtc_code const error = mux_frame_read(&stream_id, &type, &payload, buffer);
+        if (error) {
+            DEBUG_WARNING("(%s.%s) Invalid frame, discarding message: %s\n",
+                          client->name, mux_channel->label, rawrtc_code_to_str(error));
+            return;
+        }
+
+        // Handle frame
+        channel = mux_get_stream(mux_channel, stream_id);
+        switch (type) {
+            case MUX_FRAME_DATA:
+            case MUX_FRAME_CONTROL:
+                if (!channel) {
+                    DEBUG_NOTICE("(%s.%s) Discarding frame of unknown stream %"PRIu16"\n",
+                                 client->name, mux_channel->label, stream_id);
+                    break;
+                }
+                data_channel_message_handler(
+                        &payload, type == MUX_FRAME_CONTROL ?
+                        RAWRTC_DATA_CHANNEL_MESSAGE_FLAG_IS_BINARY :
+                        RAWRTC_DATA_CHANNEL_MESSAGE_FLAG_NONE, channel);
+                break;
+            case MUX_FRAME_OPEN:
+                if (channel) {
+                    DEBUG_WARNING("(%s.%s) Stream %"PRIu16" already open\n",
+                                  client->name, mux_channel->label, stream_id);
+                    break;
+                }
+                mux_open_stream(mux_channel, stream_id, &payload);
+                break;
+            case MUX_FRAME_CLOSE:
+                if (channel) {
+                    DEBUG_INFO("(%s.%s) Stream closed\n", client->name, channel->label);
+                    mux_remove_stream(channel);
+                }
+                break;
+            default:
+                DEBUG_WARNING("(%s.%s) Unknown frame type %"PRIu8"\n",
+                              client->name, mux_channel->label, type);
+                break;
+        }
+    }
+}
+
+static void terminal_mux_destroy(
+        void* arg
+) {
+    struct terminal_mux* const mux = arg;
+
+    // Stop pending flush & discard pending frames
+    tmr_cancel(&mux->batch_timer);
+    if (mux->batch) {
+        buffer_pool_release(mux->buffer_pool, mux->batch);
+    }
+
+    // Un-reference
+    mem_deref(mux->output_queue);
+    mem_deref(mux->buffer_pool);
+}
+
+/*
+ * Handle a newly created multiplexed data channel. Its streams will be
+ * opened by the remote peer.
+ */
+static void mux_channel_handler(
+        struct rawrtc_data_channel* const channel, // read-only, MUST be referenced when used
+        struct terminal_client* const client
+) {
+    struct terminal_mux* mux;
+    struct data_channel_helper* channel_helper;
+
+    // Create terminal mux instance
+    mux = mem_zalloc(sizeof(*mux), terminal_mux_destroy);
+    if (!mux) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+
+    // Set fields
+    mux->message_size = client->options->buffer_size;
+    mux->buffer_pool = mem_ref(client->buffer_pool);
+    tmr_init(&mux->batch_timer);
+    EOE(buffer_queue_create(&mux->output_queue, OUTPUT_QUEUE_CAPACITY));
+
+    // Create data channel helper instance
+    // Note: In this case we need to reference the channel because we have not created it
+    data_channel_helper_create_from_channel(
+            &channel_helper, mem_ref(channel), (struct client*) client, mux);
+    mem_deref(mux);
+
+    // Add to list
+    list_append(&client->mux_channels, &channel_helper->le, channel_helper);
+
+    // Set handler argument & handlers
+    EOE(rawrtc_data_channel_set_arg(channel, channel_helper));
+    EOE(rawrtc_data_channel_set_open_handler(channel, mux_open_handler));
+    EOE(rawrtc_data_channel_set_buffered_amount_low_handler(
+            channel, mux_buffered_amount_low_handler));
+    EOE(rawrtc_data_channel_set_error_handler(channel, mux_error_handler));
+    EOE(rawrtc_data_channel_set_close_handler(channel, mux_close_handler));
+    EOE(rawrtc_data_channel_set_message_handler(channel, mux_message_handler));
+}
+
+/*
+ * Find a data channel (or multiplexed stream) with a running process by
+ * its label.
+ */
+static struct data_channel_helper* client_get_channel(
+        struct terminal_client* const client,
+        struct pl const* const label
+) {
+    struct le* le;
+    for (le = list_head(&client->data_channels); le != NULL; le = le->next) {
+        struct data_channel_helper* const channel = le->data;
+        struct terminal_client_channel* const client_channel = channel->arg;
+
+        // Note: Closed or detached channels may linger with the same label, skip them.
+        if (client_channel->pty == -1) {
+            continue;
+        }
+        if (pl_strcmp(label, channel->label) == 0) {
+            return channel;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Handle a message received on the control channel: A control message
+ * preceded by the length-prefixed label of the data channel it applies
+ * to.
+ */
+static void control_channel_message_handler(
+        struct mbuf* const buffer,
+        enum rawrtc_data_channel_message_flag const flags,
+        void* const arg // will be casted to `struct data_channel_helper*`
+) {
+    struct data_channel_helper* const control_channel = arg;
+    struct terminal_client* const client =
+            (struct terminal_client* const) control_channel->client;
+    struct data_channel_helper* channel;
+    struct pl label;
+
+    // Check type & size
+    if (!(flags & RAWRTC_DATA_CHANNEL_MESSAGE_FLAG_IS_BINARY) || mbuf_get_left(buffer) < 1) {
+        DEBUG_WARNING("(%s.%s) Invalid control message of size %zu\n",
+                      client->name, control_channel->label, mbuf_get_left(buffer));
+        return;
+    }
+
+    // Get label
+    label.l = mbuf_read_u8(buffer);
+    if (mbuf_get_left(buffer) < label.l) {
+        DEBUG_WARNING("(%s.%s) Invalid label length %zu\n",
+                      client->name, control_channel->label, label.l);
+        return;
+    }
+    label.p = (char const*) mbuf_buf(buffer);
+    mbuf_advance(buffer, (ssize_t) label.l);
+
+    // Find data channel
+    channel = client_get_channel(client, &label);
+    if (!channel) {
+        DEBUG_NOTICE("(%s.%s) Discarding control message for unknown data channel %r\n",
+                     client->name, control_channel->label, &label);
+        return;
+    }
+
+    // Handle control message
+    handle_control_message(channel, buffer);
+}
+
+/*
+ * Handle a newly created control channel. Control messages arriving on
+ * it are not stuck behind the output of the data channels.
+ */
+static void control_channel_handler(
+        struct rawrtc_data_channel* const channel, // read-only, MUST be referenced when used
+        struct terminal_client* const client
+) {
+    struct data_channel_helper* channel_helper;
+
+    // Create data channel helper instance
+    // Note: In this case we need to reference the channel because we have not created it
+    data_channel_helper_create_from_channel(
+            &channel_helper, mem_ref(channel), (struct client*) client, NULL);
+
+    // Add to list
+    list_append(&client->control_channels, &channel_helper->le, channel_helper);
+
+    // Set handler argument & handlers
+    EOE(rawrtc_data_channel_set_arg(channel, channel_helper));
+    EOE(rawrtc_data_channel_set_open_handler(channel, default_data_channel_open_handler));
+    EOE(rawrtc_data_channel_set_buffered_amount_low_handler(
+            channel, default_data_channel_buffered_amount_low_handler));
+    EOE(rawrtc_data_channel_set_error_handler(channel, default_data_channel_error_handler));
+    EOE(rawrtc_data_channel_set_close_handler(channel, default_data_channel_close_handler));
+    EOE(rawrtc_data_channel_set_message_handler(channel, control_channel_message_handler));
+}
+
+/*
+ * Handle the newly created data channel.
+ */
+static void data_channel_handler(
+        struct rawrtc_data_channel* const channel, // read-only, MUST be referenced when used
+        void* const arg // will be casted to `struct client*`
+) {
+    struct terminal_client* const client = arg;
+    struct rawrtc_data_channel_parameters* parameters;
+    enum rawrtc_code const ignore[] = {RAWRTC_CODE_NO_VALUE};
+    char* protocol = NULL;
+    struct terminal_client_channel* client_channel;
+    struct data_channel_helper* channel_helper;
+
+    // Print channel
+    default_data_channel_handler(channel, arg);
+
+    // Get protocol
+    EOE(rawrtc_data_channel_get_parameters(&parameters, channel));
+    EOEIGN(rawrtc_data_channel_parameters_get_protocol(&protocol, parameters), ignore);
+    mem_deref(parameters);
+
+    // Multiplexed data channel?
+    if (protocol && strcmp(protocol, MUX_PROTOCOL) == 0) {
+        mux_channel_handler(channel, client);
+        goto out;
+    }
+
+    // Control channel?
+    if (protocol && strcmp(protocol, control_protocol) == 0) {
+        control_channel_handler(channel, client);
+        goto out;
+    }
+
+    // Create terminal client channel instance
+    // Note: The protocol may contain an attach request
+    client_channel = client_channel_create(client, protocol, protocol ? strlen(protocol) : 0);
+    if (!client_channel) {
+        goto out;
+    }
+
+    // Create data channel helper instance
+    // Note: In this case we need to reference the channel because we have not created it
+    data_channel_helper_create_from_channel(&channel_helper, mem_ref(channel), arg, client_channel);
+    mem_deref(client_channel);
+
+    // Add to list
+    list_append(&client->data_channels, &channel_helper->le, channel_helper);
+
+    // Set handler argument & handlers
+    EOE(rawrtc_data_channel_set_arg(channel, channel_helper));
+    EOE(rawrtc_data_channel_set_open_handler(channel, data_channel_open_handler));
+    EOE(rawrtc_data_channel_set_buffered_amount_low_handler(
+            channel, data_channel_buffered_amount_low_handler));
+    EOE(rawrtc_data_channel_set_error_handler(channel, data_channel_error_handler));
+    EOE(rawrtc_data_channel_set_close_handler(channel, data_channel_close_handler));
+    EOE(rawrtc_data_channel_set_message_handler(channel, data_channel_message_handler));
+
+out:
+    // Un-reference
+    mem_deref(protocol);
+}
+
+/*
+ * Print the ICE gatherer's state and record when gathering is complete.
+ */
+static void ice_gatherer_state_change_handler(
+        enum rawrtc_ice_gatherer_state const state, // read-only
+        void* const arg // will be casted to `struct client*`
+) {
+    struct terminal_client* const client = arg;
+
+    // Print state
+    default_ice_gatherer_state_change_handler(state, arg);
+
+    // Record setup phase
+    if (state == RAWRTC_ICE_GATHERER_COMPLETE) {
+        setup_timing_mark(&client->timing, SETUP_PHASE_GATHERING_COMPLETE);
+    }
+}
+
+/*
+ * Print the ICE transport's state. Tear down the session in server mode
+ * once the transport failed or has been closed.
+ */
+static void ice_transport_state_change_handler(
+        enum rawrtc_ice_transport_state const state,
+        void* const arg // will be casted to `struct client*`
+) {
+    struct terminal_client* const client = arg;
+
+    // Print state
+    default_ice_transport_state_change_handler(state, arg);
+    client->ice_state = state;
+
+    // Record setup phase
+    switch (state) {
+        case RAWRTC_ICE_TRANSPORT_STATE_CHECKING:
+            setup_timing_mark(&client->timing, SETUP_PHASE_ICE_CHECKING);
+            break;
+        case RAWRTC_ICE_TRANSPORT_STATE_CONNECTED:
+        case RAWRTC_ICE_TRANSPORT_STATE_COMPLETED:
+            setup_timing_mark(&client->timing, SETUP_PHASE_ICE_CONNECTED);
+            break;
+        default:
+            break;
+    }
+
+    // ICE restart completed?
+    if ((state == RAWRTC_ICE_TRANSPORT_STATE_CONNECTED
+            || state == RAWRTC_ICE_TRANSPORT_STATE_COMPLETED)
+            && client->ice_restart_start != 0 && !client->ice_restart_pending) {
+        client->ice_restart_duration = get_monotonic_time_us() - client->ice_restart_start;
+        client->ice_restart_start = 0;
+        DEBUG_INFO("(%s) ICE restart completed after %"PRIu64" ms\n",
+                   client->name, client->ice_restart_duration / 1000);
+
+        // Keep session
+        if (client->awaiting_ice_restart) {
+            client->awaiting_ice_restart = false;
+            tmr_cancel(&client->teardown_timer);
+        }
+    }
+
+    // Tear down session (if failed or closed)
+    switch (state) {
+        case RAWRTC_ICE_TRANSPORT_STATE_FAILED:
+            // Give the remote peer the chance to restart ICE (if enabled and established)
+            if (client->options->ice_restart_timeout > 0
+                    && client->dtls_state == RAWRTC_DTLS_TRANSPORT_STATE_CONNECTED) {
+                DEBUG_INFO("(%s) Waiting %"PRIu32" seconds for ICE to be restarted\n",
+                           client->name, client->options->ice_restart_timeout);
+                client->awaiting_ice_restart = true;
+                client_schedule_teardown_after(client, client->options->ice_restart_timeout * 1000);
+                break;
+            }
+            // Fallthrough
+        case RAWRTC_ICE_TRANSPORT_STATE_CLOSED:
+            client_schedule_teardown(client);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Print the ICE candidate pair change event and remember the selected
+ * pair's candidate types.
+ */
+static void ice_transport_candidate_pair_change_handler(
+        struct rawrtc_ice_candidate* const local, // read-only
+        struct rawrtc_ice_candidate* const remote, // read-only
+        void* const arg // will be casted to `struct client*`
+) {
+    struct terminal_client* const client = arg;
+
+    // Print candidate pair change
+    default_ice_transport_candidate_pair_change_handler(local, remote, arg);
+
+    // Get candidate types
+    EOE(rawrtc_ice_candidate_get_type(&client->local_candidate_type, local));
+    EOE(rawrtc_ice_candidate_get_type(&client->remote_candidate_type, remote));
+    EOE(rawrtc_ice_candidate_get_protocol(&client->candidate_protocol, local));
+    client->candidate_pair_selected = true;
+}
+
+/*
+ * Print the DTLS transport's state. Tear down the session in server
+ * mode once the transport failed or has been closed.
+ */
+static void dtls_transport_state_change_handler(
+        enum rawrtc_dtls_transport_state const state, // read-only
+        void* const arg // will be casted to `struct client*`
+) {
+    struct terminal_client* const client = arg;
+
+    // Print state
+    default_dtls_transport_state_change_handler(state, arg);
+    client->dtls_state = state;
+
+    // Record setup phase
+    switch (state) {
+        case RAWRTC_DTLS_TRANSPORT_STATE_CONNECTING:
+            setup_timing_mark(&client->timing, SETUP_PHASE_DTLS_CONNECTING);
+            break;
+        case RAWRTC_DTLS_TRANSPORT_STATE_CONNECTED:
+            setup_timing_mark(&client->timing, SETUP_PHASE_DTLS_CONNECTED);
+            break;
+        default:
+            break;
+    }
+
+    // Tear down session (if failed or closed)
+    switch (state) {
+        case RAWRTC_DTLS_TRANSPORT_STATE_FAILED:
+        case RAWRTC_DTLS_TRANSPORT_STATE_CLOSED:
+            client_schedule_teardown(client);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Print the SCTP transport's state. Tear down the session in server
+ * mode once the transport has been closed.
+ */
+static void sctp_transport_state_change_handler(
+        enum rawrtc_sctp_transport_state const state,
+        void* const arg // will be casted to `struct client*`
+) {
+    struct terminal_client* const client = arg;
+
+    // Print state
+    default_sctp_transport_state_change_handler(state, arg);
+    client->sctp_state = state;
+
+    // Record setup phase
+    switch (state) {
+        case RAWRTC_SCTP_TRANSPORT_STATE_CONNECTING:
+            setup_timing_mark(&client->timing, SETUP_PHASE_SCTP_CONNECTING);
+            break;
+        case RAWRTC_SCTP_TRANSPORT_STATE_CONNECTED:
+            setup_timing_mark(&client->timing, SETUP_PHASE_SCTP_CONNECTED);
+            break;
+        default:
+            break;
+    }
+
+    // Tear down session (if closed)
+    if (state == RAWRTC_SCTP_TRANSPORT_STATE_CLOSED) {
+        client_schedule_teardown(client);
+    }
+}
+
+static void client_init(
+        struct terminal_client* const client
+) {
+    if (client->ws_uri) {
+        // Create DNS client
+        EOR(dnsc_alloc(&client->dns_client, NULL, NULL, 0));
+
+        // Create HTTP client
+        EOR(http_client_alloc(&client->http_client, client->dns_client));
+
+        // Create WS Socket
+        EOR(websock_alloc(&client->ws_socket, NULL, client));
+    }
+
+    // Load or generate certificates (unless shared)
+    if (!client->certificate) {
+        setup_timing_mark(&client->timing, SETUP_PHASE_CERTIFICATE_START);
+        EOE(certificate_load_or_generate(&client->certificate, client->options));
+        setup_timing_mark(&client->timing, SETUP_PHASE_CERTIFICATE_READY);
+    }
+
+    // Create transports
+    client_create_transports(client);
+}
+
+/*
+ * Create the ICE gatherer and the ICE, DTLS and SCTP transports.
+ */
+static void client_create_transports(
+        struct terminal_client* const client
+) {
+    struct rawrtc_certificate* certificates[1];
+    certificates[0] = client->certificate;
+
+    // Create ICE gatherer
+    EOE(rawrtc_ice_gatherer_create(
+            &client->gatherer, client->gather_options,
+            ice_gatherer_state_change_handler, default_ice_gatherer_error_handler,
+            ice_gatherer_local_candidate_handler, client));
+
+    // Create ICE transport
+    EOE(rawrtc_ice_transport_create(
+            &client->ice_transport, client->gatherer,
+            ice_transport_state_change_handler,
+            ice_transport_candidate_pair_change_handler, client));
+
+    // Create DTLS transport
+    EOE(rawrtc_dtls_transport_create(
+            &client->dtls_transport, client->ice_transport, certificates, ARRAY_SIZE(certificates),
+            dtls_transport_state_change_handler, default_dtls_transport_error_handler,
+            client));
+
+    // Create SCTP transport
+    EOE(rawrtc_sctp_transport_create(
+            &client->sctp_transport, client->dtls_transport,
+            client->local_parameters.sctp_parameters.port,
+            data_channel_handler, sctp_transport_state_change_handler, client));
+
+    // Get data transport
+    EOE(rawrtc_sctp_transport_get_data_transport(
+            &client->data_transport, client->sctp_transport));
+}
+
+static void client_start_gathering(
+        struct terminal_client* const client
+) {
+    // Start gathering
+    setup_timing_mark(&client->timing, SETUP_PHASE_GATHERING_START);
+    EOE(rawrtc_ice_gatherer_gather(client->gatherer, NULL));
+}
+
+/*
+ * Remove all data channels (detaching detachable processes), stop the
+ * transports and close the gatherer.
+ * Note: While replacing the transports, all processes are being
+ *       detached for at least `ICE_RESTART_DETACH_TIMEOUT`.
+ */
+static void client_close_transports(
+        struct terminal_client* const client
+) {
+    // Keep processes until reattached (if replacing the transports)
+    if (client->replacing_transports) {
+        struct le* le;
+        for (le = list_head(&client->data_channels); le != NULL; le = le->next) {
+            struct data_channel_helper* const channel = le->data;
+            struct terminal_client_channel* const client_channel = channel->arg;
+            client_channel->detach_timeout =
+                    MAX(client_channel->detach_timeout, ICE_RESTART_DETACH_TIMEOUT);
+        }
+    }
+
+    // Clear data channels (streams first)
+    list_flush(&client->data_channels);
+    list_flush(&client->mux_channels);
+    list_flush(&client->control_channels);
+
+    // Stop all transports & gatherer
+    EOE(rawrtc_sctp_transport_stop(client->sctp_transport));
+    EOE(rawrtc_dtls_transport_stop(client->dtls_transport));
+    EOE(rawrtc_ice_transport_stop(client->ice_transport));
+    EOE(rawrtc_ice_gatherer_close(client->gatherer));
+
+    // Un-reference
+    client->data_transport = mem_deref(client->data_transport);
+    client->sctp_transport = mem_deref(client->sctp_transport);
+    client->dtls_transport = mem_deref(client->dtls_transport);
+    client->ice_transport = mem_deref(client->ice_transport);
+    client->gatherer = mem_deref(client->gatherer);
+}
+
+/*
+ * Restart ICE: Replace the gatherer and the transports and send the new
+ * local parameters (with a new username fragment and password) to the
+ * remote peer. The new transports are started once the remote peer's
+ * new parameters have been received.
+ * Note: rawrtc cannot start a transport more than once, so the DTLS and
+ *       SCTP transports (and thus the data channels) are being replaced
+ *       along with the ICE transport. The processes are being detached
+ *       (regardless of `detach_timeout`) and reattached by the remote
+ *       peer once connected again.
+ */
+static void client_restart_ice(
+        struct terminal_client* const client
+) {
+    DEBUG_INFO("(%s) Restarting ICE\n", client->name);
+    ++client->n_ice_restarts;
+    client->ice_restart_pending = true;
+    client->ice_restart_start = get_monotonic_time_us();
+
+    // Stop previous transports (without tearing down the session)
+    client->replacing_transports = true;
+    client_close_transports(client);
+    client->replacing_transports = false;
+
+    // Reset transport state
+    client->ice_state = RAWRTC_ICE_TRANSPORT_STATE_NEW;
+    client->dtls_state = RAWRTC_DTLS_TRANSPORT_STATE_NEW;
+    client->sctp_state = RAWRTC_SCTP_TRANSPORT_STATE_NEW;
+    client->candidate_pair_selected = false;
+    client->gathering_complete = false;
+    client->local_parameters_sent = false;
+    client->remote_candidates_complete = false;
+
+    // Create new transports & start gathering
+    client_create_transports(client);
+    EOE(rawrtc_ice_gatherer_gather(client->gatherer, NULL));
+
+    // Send local parameters (if there is a signalling channel)
+    // Note: Copy & paste mode prints them once gathering is complete.
+    if (client->server || client->ws_connection) {
+        client_send_local_parameters(client);
+    }
+}
+
+static void client_start_transports(
+        struct terminal_client* const client
+) {
+    struct parameters* const remote_parameters = &client->remote_parameters;
+    DEBUG_INFO("(%s) Starting transports\n", client->name);
+
+    // Start ICE transport
+    EOE(rawrtc_ice_transport_start(
+            client->ice_transport, client->gatherer, remote_parameters->ice_parameters,
+            client->role));
+
+    // Start DTLS transport
+    EOE(rawrtc_dtls_transport_start(
+            client->dtls_transport, remote_parameters->dtls_parameters));
+
+    // Start SCTP transport
+    EOE(rawrtc_sctp_transport_start(
+            client->sctp_transport, remote_parameters->sctp_parameters.capabilities,
+            remote_parameters->sctp_parameters.port));
+}
+
+static void parameters_destroy(
+        struct parameters* const parameters
+) {
+    // Un-reference
+    parameters->ice_parameters = mem_deref(parameters->ice_parameters);
+    parameters->ice_candidates = mem_deref(parameters->ice_candidates);
+    parameters->dtls_parameters = mem_deref(parameters->dtls_parameters);
+    if (parameters->sctp_parameters.capabilities) {
+        parameters->sctp_parameters.capabilities =
+                mem_deref(parameters->sctp_parameters.capabilities);
+    }
+}
+
+static void client_stop(
+        struct terminal_client* const client
+) {
+    DEBUG_INFO("(%s) Stopping transports\n", client->name);
+    client->stopping = true;
+
+    // Emit setup timing (if setup has not been completed)
+    client_emit_setup_timing(client, false);
+
+    // Remove data channels & stop transports
+    client_close_transports(client);
+
+    // Close WS connection (unless owned by the acceptor thread)
+    if (!client->worker) {
+        if (client->ws_connection) {
+            EOR(websock_close(client->ws_connection, WEBSOCK_GOING_AWAY, NULL));
+        }
+        client->ws_connection = mem_deref(client->ws_connection);
+    }
+
+    // Un-reference & close
+    parameters_destroy(&client->remote_parameters);
+    parameters_destroy(&client->local_parameters);
+    client->certificate = mem_deref(client->certificate);
+    client->ws_socket = mem_deref(client->ws_socket);
+    client->http_client = mem_deref(client->http_client);
+    client->dns_client = mem_deref(client->dns_client);
+    client->gather_options = mem_deref(client->gather_options);
+    client->ws_uri = mem_deref(client->ws_uri);
+    client->shell = mem_deref(client->shell);
+
+    // Print buffer pool statistics & un-reference
+    DEBUG_INFO("(%s) %H\n", client->name, buffer_pool_debug, client->buffer_pool);
+    client->buffer_pool = mem_deref(client->buffer_pool);
+    client->shell_pool = mem_deref(client->shell_pool);
+    client->trace = mem_deref(client->trace);
+    client->scheduler = mem_deref(client->scheduler);
+}
+
+static void client_apply_parameters(
+        struct terminal_client* const client
+) {
+    struct parameters* const remote_parameters = &client->remote_parameters;
+    DEBUG_INFO("(%s) Applying remote parameters\n", client->name);
+
+    // Add remote ICE candidates
+    for (size_t i = 0; i < remote_parameters->ice_candidates->n_candidates; ++i) {
+        client_add_remote_candidate(client, remote_parameters->ice_candidates->candidates[i]);
+    }
+
+    // Complete (unless more candidates follow)
+    if (!remote_parameters->trickle) {
+        client_add_remote_candidate(client, NULL);
+    }
+}
+
+/*
+ * Get the maximum message size both peers support.
+ * A return value of 0 indicates that messages of any size are supported.
+ */
+static size_t client_get_max_message_size(
+        struct terminal_client* const client
+) {
+    struct rawrtc_sctp_capabilities* const local_capabilities =
+            client->local_parameters.sctp_parameters.capabilities;
+    struct rawrtc_sctp_capabilities* const remote_capabilities =
+            client->remote_parameters.sctp_parameters.capabilities;
+    uint64_t local = 0;
+    uint64_t remote = 0;
+    uint64_t max_message_size;
+
+    // Get maximum message sizes
+    if (local_capabilities) {
+        EOE(rawrtc_sctp_capabilities_get_max_message_size(&local, local_capabilities));
+    }
+    if (remote_capabilities) {
+        EOE(rawrtc_sctp_capabilities_get_max_message_size(&remote, remote_capabilities));
+    }
+
+    // Use the smaller one (0 means 'any size')
+    if (local == 0) {
+        max_message_size = remote;
+    } else if (remote == 0) {
+        max_message_size = local;
+    } else {
+        max_message_size = MIN(local, remote);
+    }
+
+    // Ensure it fits into size_t
+#if (UINT64_MAX > SIZE_MAX)
+    if (max_message_size > SIZE_MAX) {
+        max_message_size = SIZE_MAX;
+    }
+#endif
+    return (size_t) max_message_size;
+}
+
+static enum rawrtc_code client_decode_parameters(
+        struct parameters* const parametersp,
+        struct odict* const dict,
+        struct terminal_client* const client
+) {
+    enum rawrtc_code error = RAWRTC_CODE_SUCCESS;
+    struct odict* node;
+    struct parameters parameters = {0};
+
+    // Decode nodes
+    error |= dict_get_entry(&node, dict, "iceParameters", ODICT_OBJECT, true);
+    error |= get_ice_parameters(&parameters.ice_parameters, node);
+    error |= dict_get_entry(&node, dict, "iceCandidates", ODICT_ARRAY, true);
+    error |= get_ice_candidates(&parameters.ice_candidates, node, (struct client* const) client);
+    error |= dict_get_entry(&node, dict, "dtlsParameters", ODICT_OBJECT, true);
+    error |= get_dtls_parameters(&parameters.dtls_parameters, node);
+    error |= dict_get_entry(&node, dict, "sctpParameters", ODICT_OBJECT, true);
+    error |= get_sctp_parameters(&parameters.sctp_parameters, node);
+    if (dict_get_entry(&parameters.trickle, dict, "trickle", ODICT_BOOL, false)) {
+        parameters.trickle = false;
+    }
+
+    // Ok?
+    if (error) {
+        DEBUG_WARNING("(%s) Invalid remote parameters\n", client->name);
+        goto out;
+    }
+
+out:
+    if (error) {
+        // Un-reference
+        mem_deref(parameters.sctp_parameters.capabilities);
+        mem_deref(parameters.dtls_parameters);
+        mem_deref(parameters.ice_candidates);
+        mem_deref(parameters.ice_parameters);
+    } else {
+        // Copy parameters
+        memcpy(parametersp, &parameters, sizeof(parameters));
+    }
+
+    return error;
+}
+
+static void client_get_parameters(
+        struct terminal_client* const client
+) {
+    struct parameters* const local_parameters = &client->local_parameters;
+
+    // Un-reference previously retrieved parameters
+    parameters_destroy(local_parameters);
+
+    // Get local ICE parameters
+    EOE(rawrtc_ice_gatherer_get_local_parameters(
+            &local_parameters->ice_parameters, client->gatherer));
+
+    // Get local ICE candidates
+    EOE(rawrtc_ice_gatherer_get_local_candidates(
+            &local_parameters->ice_candidates, client->gatherer));
+
+    // Get local DTLS parameters
+    EOE(rawrtc_dtls_transport_get_local_parameters(
+            &local_parameters->dtls_parameters, client->dtls_transport));
+
+    // Get local SCTP parameters
+    EOE(rawrtc_sctp_transport_get_capabilities(
+            &local_parameters->sctp_parameters.capabilities));
+    EOE(rawrtc_sctp_transport_get_port(
+            &local_parameters->sctp_parameters.port, client->sctp_transport));
+}
+
+static struct odict* client_encode_parameters(
+        struct terminal_client* const client
+) {
+    struct odict* dict;
+    struct odict* node;
+
+    // Get local parameters
+    client_get_parameters(client);
+
+    // Create dict
+    EOR(odict_alloc(&dict, 16));
+
+    // Create nodes
+    EOR(odict_alloc(&node, 16));
+    set_ice_parameters(client->local_parameters.ice_parameters, node);
+    EOR(odict_entry_add(dict, "iceParameters", ODICT_OBJECT, node));
+    mem_deref(node);
+    EOR(odict_alloc(&node, 16));
+    set_ice_candidates(client->local_parameters.ice_candidates, node);
+    EOR(odict_entry_add(dict, "iceCandidates", ODICT_ARRAY, node));
+    mem_deref(node);
+
+    EOR(odict_alloc(&node, 16));
+    set_dtls_parameters(client->local_parameters.dtls_parameters, node);
+    EOR(odict_entry_add(dict, "dtlsParameters", ODICT_OBJECT, node));
+    mem_deref(node);
+    EOR(odict_alloc(&node, 16));
+    set_sctp_parameters(client->sctp_transport, &client->local_parameters.sctp_parameters, node);
+    EOR(odict_entry_add(dict, "sctpParameters", ODICT_OBJECT, node));
+    mem_deref(node);
+
+    // ICE restart? The remote peer has to replace its transports as well.
+    if (client->n_ice_restarts > 0) {
+        EOR(odict_entry_add(dict, "iceRestart", ODICT_BOOL, true));
+    }
+
+    // Done
+    return dict;
+}
+
+/*
+ * Create the ICE gather options including the ICE servers.
+ */
+static void create_gather_options(
+        struct rawrtc_ice_gather_options** const optionsp // de-referenced
+) {
+    char* const stun_google_com_urls[] = {"stun:stun.l.google.com:19302",
+                                          "stun:stun1.l.google.com:19302"};
+    char* const turn_threema_ch_urls[] = {"turn:turn.threema.ch:443"};
+    struct rawrtc_ice_gather_options* options;
 
-        // Get type
-        type = mbuf_read_u8(buffer);
+    // Create ICE gather options
+    EOE(rawrtc_ice_gather_options_create(&options, RAWRTC_ICE_GATHER_POLICY_ALL));
 
-        // Handle control message
-        switch (type) {
-            case CONTROL_MESSAGE_WINDOW_SIZE_TYPE:
-                // Check size
-                if (length < CONTROL_MESSAGE_WINDOW_SIZE_LENGTH) {
-                    DEBUG_WARNING("(%s.%s) Invalid window size message of size %zu\n",
-                            client->name, channel->label, length);
-                    return;
-                }
-                {
-                    uint_fast16_t columns;
-                    uint_fast16_t rows;
-                    struct winsize window_size = {0};
+    // Add ICE servers to ICE gather options
+    EOE(rawrtc_ice_gather_options_add_server(
+            options, stun_google_com_urls, ARRAY_SIZE(stun_google_com_urls),
+            NULL, NULL, RAWRTC_ICE_CREDENTIAL_TYPE_NONE));
+    EOE(rawrtc_ice_gather_options_add_server(
+            options, turn_threema_ch_urls, ARRAY_SIZE(turn_threema_ch_urls),
+            "threema-angular", "Uv0LcCq3kyx6EiRwQW5jVigkhzbp70CjN2CJqzmRxG3UGIdJHSJV6tpo7Gj7YnGB",
+            RAWRTC_ICE_CREDENTIAL_TYPE_PASSWORD));
 
-                    // Get window size
-                    columns = ntohs(mbuf_read_u16(buffer));
-                    rows = ntohs(mbuf_read_u16(buffer));
+    // Set pointer
+    *optionsp = options;
+}
 
-                    // Check window size
-#if (UINT16_MAX > USHRT_MAX)
-                    if (columns > USHRT_MAX || rows > USHRT_MAX) {
-                        DEBUG_WARNING("(%s.%s) Invalid window size value\n",
-                                      client->name, channel->label);
-                        return;
-                    }
-#endif
+/*
+ * Write snapshots of the client and its data channels into a samples
+ * buffer.
+ */
+static void client_collect_metrics(
+        struct terminal_client* const client,
+        struct mbuf* const samples
+) {
+    struct metrics_session session = {0};
+    struct le* le;
+
+    // Session
+    metrics_copy_label(session.name, client->name);
+    session.worker = client->worker ? (int32_t) client->worker->id : -1;
+    session.uptime = get_monotonic_time_us() - client->timing.timestamps[SETUP_PHASE_SESSION_START];
+    session.ice_state = client->ice_state;
+    session.dtls_state = client->dtls_state;
+    session.sctp_state = client->sctp_state;
+    session.candidate_pair_selected = client->candidate_pair_selected;
+    session.local_candidate_type = client->local_candidate_type;
+    session.remote_candidate_type = client->remote_candidate_type;
+    session.candidate_protocol = client->candidate_protocol;
+    session.n_channels = list_count(&client->data_channels);
+    EOE(metrics_write_session(samples, &session));
+
+    // Data channels
+    for (le = list_head(&client->data_channels); le != NULL; le = le->next) {
+        struct data_channel_helper* const channel = le->data;
+        struct terminal_client_channel* const client_channel = channel->arg;
+        struct metrics_channel sample = {0};
+        metrics_copy_label(sample.label, channel->label);
+        sample.pid = client_channel->pid;
+        sample.buffered_amount = pty_peek_buffered_amount(client_channel);
+        sample.counters = client_channel->counters;
+        sample.scheduled = client_channel->scheduling.delays.n;
+        sample.scheduling_delay = client_channel->scheduling.total_delay;
+        sample.scheduling_delay_max = client_channel->scheduling.delays.max;
+        EOE(metrics_write_channel(samples, &sample));
+    }
+}
 
-                    // Set window size
-                    window_size.ws_col = (unsigned short) columns;
-                    window_size.ws_row = (unsigned short) rows;
+/*
+ * Print the amount of sessions and the estimated memory per session.
+ */
+static void server_print_statistics(
+        struct terminal_server* const server
+) {
+    uint32_t const n_sessions = list_count(&server->sessions);
+    size_t resident_memory;
+    size_t session_memory = 0;
 
-                    // Apply window size
-                    DEBUG_PRINTF("(%s.%s) Resizing terminal to %"PRIuFAST16" columns and "
-                            "%"PRIuFAST16" rows\n", client->name, channel->label, columns, rows);
-                    EOP(ioctl(client_channel->pty, TIOCSWINSZ, &window_size));
-                }
+    // Get resident memory
+    if (get_resident_memory(&resident_memory)) {
+        return;
+    }
 
-                break;
-            default:
-                DEBUG_WARNING("(%s.%s) Unknown control message %"PRIuFAST8"\n",
-                              client->name, channel->label, length);
-                break;
-        }
-    } else {
-        // Write into PTY
-        // TODO: Handle EAGAIN?
-        DEBUG_PRINTF("(%s.%s) Piping %zu bytes into process...\n",
-                     client->name, channel->label, length);
-        EOP(write(client_channel->pty, mbuf_buf(buffer), length));
-        DEBUG_PRINTF("(%s.%s) ... completed!\n", client->name, channel->label);
+    // Estimate memory per session
+    if (n_sessions > 0 && resident_memory > server->baseline_memory) {
+        session_memory = (resident_memory - server->baseline_memory) / n_sessions;
     }
+    DEBUG_INFO("Sessions: %"PRIu32", resident memory: %zu KiB, per session: ~%zu KiB\n",
+               n_sessions, resident_memory / 1024, session_memory / 1024);
+}
+
+static void session_destroy(
+        void* arg
+) {
+    struct terminal_client* const client = arg;
+
+    // Stop teardown timer & remove from lists
+    tmr_cancel(&client->teardown_timer);
+    list_unlink(&client->worker_le);
+    list_unlink(&client->le);
+
+    // Un-reference
+    // Note: Already done by `client_stop` unless the session never started.
+    mem_deref(client->scheduler);
+    mem_deref(client->trace);
+    mem_deref(client->shell_pool);
+    mem_deref(client->buffer_pool);
+    mem_deref(client->certificate);
+    mem_deref(client->gather_options);
+    mem_deref(client->shell);
+    mem_deref(client->name);
 }
 
 /*
- * Stop the PTY.
+ * Stop and remove a session.
  */
-static void stop_process(
-        struct terminal_client_channel* const channel
+static void client_teardown_handler(
+        void* arg
 ) {
-    // Close PTY (if not already closed)
-    if (channel->pty != -1) {
-        // Stop listening on PTY
-        fd_close(channel->pty);
-        EOP(close(channel->pty));
+    struct terminal_client* const client = arg;
+    struct terminal_server* const server = client->server;
+    DEBUG_INFO("(%s) Tearing down session\n", client->name);
 
-        // Invalidate PTY
-        channel->pty = -1;
+    // Stop client
+    client_stop(client);
+
+    // Worker session? Let the acceptor thread remove it.
+    if (client->worker) {
+        list_unlink(&client->worker_le);
+        worker_message_push(server->mqueue, WORKER_MESSAGE_SESSION_STOPPED, client, NULL);
+        return;
     }
 
-    // Stop process (if not already stopped)
-    if (channel->pid != -1) {
-        // Terminate process
-        EOP(kill(channel->pid, SIGTERM));
+    // Un-reference
+    mem_deref(client);
 
-        // Invalidate process
-        channel->pid = -1;
-    }
+    // Print statistics
+    server_print_statistics(server);
 }
 
 /*
- * Stop the forked process on error event.
+ * Tear down the session (server mode only).
+ * Note: Deferred as this is usually being called from within a handler
+ *       of the session's transports.
  */
-static void data_channel_error_handler(
-        void* const arg // will be casted to `struct data_channel_helper*`
+static void client_schedule_teardown(
+        struct terminal_client* const client
 ) {
-    struct data_channel_helper* const channel = arg;
-    struct terminal_client_channel* const client_channel = channel->arg;
-
-    // Print error event
-    default_data_channel_error_handler(arg);
+    client_schedule_teardown_after(client, 0);
+}
 
-    // Stop forked process
-    if (client_channel->pid != -1) {
-        DEBUG_INFO("(%s.%s) Stopping process\n", channel->client->name, channel->label);
+/*
+ * Tear down the session once `delay` milliseconds passed (server mode
+ * only).
+ */
+static void client_schedule_teardown_after(
+        struct terminal_client* const client,
+        uint32_t const delay
+) {
+    // Note: Transports being replaced by an ICE restart report to be closed as well.
+    if (!client->server || client->stopping || client->replacing_transports) {
+        return;
     }
-    stop_process(client_channel);
+    tmr_start(&client->teardown_timer, delay, client_teardown_handler, client);
 }
 
 /*
- * Stop the forked process on close event.
+ * Set the settings a session shares with other sessions of the same
+ * thread.
  */
-void data_channel_close_handler(
-        void* const arg // will be casted to `struct data_channel_helper*`
+static void client_set_shared_settings(
+        struct terminal_client* const client,
+        struct rawrtc_ice_gather_options* const gather_options,
+        struct rawrtc_certificate* const certificate,
+        struct buffer_pool* const buffer_pool,
+        struct shell_pool* const shell_pool, // nullable
+        struct trace_ring* const trace, // nullable
+        struct output_scheduler* const scheduler
 ) {
-    struct data_channel_helper* const channel = arg;
-    struct terminal_client_channel* const client_channel = channel->arg;
+    client->gather_options = mem_ref(gather_options);
+    client->certificate = mem_ref(certificate);
+    client->buffer_pool = mem_ref(buffer_pool);
+    client->shell_pool = mem_ref(shell_pool);
+    client->trace = mem_ref(trace);
+    client->scheduler = mem_ref(scheduler);
+}
 
-    // Print close event
-    default_data_channel_close_handler(arg);
+/*
+ * Create a new session based on the prototype client's settings.
+ */
+static struct terminal_client* server_create_session(
+        struct terminal_server* const server
+) {
+    struct terminal_client const* const prototype = server->prototype;
+    struct terminal_client* client;
 
-    // Stop forked process
-    if (client_channel->pid != -1) {
-        DEBUG_INFO("(%s.%s) Stopping process\n", channel->client->name, channel->label);
+    // Allocate
+    client = mem_zalloc(sizeof(*client), session_destroy);
+    if (!client) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return NULL;
     }
-    stop_process(client_channel);
+
+    // Set fields
+    // Note: The shell is being copied as the session may be handed off to another thread.
+    EOE(rawrtc_sdprintf(&client->name, "S%"PRIu32, ++server->n_created));
+    EOE(rawrtc_sdprintf(&client->shell, "%s", prototype->shell));
+    client->ice_candidate_types = prototype->ice_candidate_types;
+    client->n_ice_candidate_types = prototype->n_ice_candidate_types;
+    client->role = prototype->role;
+    client->local_parameters.sctp_parameters.port =
+            prototype->local_parameters.sctp_parameters.port;
+    client->options = prototype->options;
+    client->setup_log = prototype->setup_log;
+    client->detached_shells = prototype->detached_shells;
+    session_token_generate(client->restart_token);
+    client->server = server;
+    list_init(&client->data_channels);
+    list_init(&client->mux_channels);
+    list_init(&client->control_channels);
+    tmr_init(&client->teardown_timer);
+
+    // Start timing the setup
+    setup_timing_start(&client->timing, server->n_created);
+
+    // Add to sessions
+    list_append(&server->sessions, &client->le, client);
+    return client;
 }
 
 /*
- * Send the PTY's data on the data channel.
+ * Get the worker with the least amount of sessions.
  */
-static void pty_read_handler(
-        int flags,
-        void* arg
+static struct terminal_worker* server_get_least_loaded_worker(
+        struct terminal_server* const server
 ) {
-    struct data_channel_helper* const channel = arg;
-    struct terminal_client_channel* const client_channel = channel->arg;
-    struct terminal_client* const client =
-            (struct terminal_client* const) channel->client;
-    ssize_t length;
-    (void) flags;
+    struct terminal_worker* worker = &server->workers[0];
+    uint32_t i;
 
-    // Create buffer
-    struct mbuf* const buffer = mbuf_alloc(PIPE_READ_BUFFER);
-
-    // Read from PTY into buffer
-    // TODO: Handle EAGAIN?
-    DEBUG_PRINTF("(%s.%s) Reading from process...\n", client->name, channel->label);
-    length = read(client_channel->pty, mbuf_buf(buffer), mbuf_get_space(buffer));
-    if (length == -1) {
-        switch (errno) {
-            case EIO:
-                // This happens when invoking 'exit' or similar commands
-                length = 0;
-                break;
-            default:
-                EOR(errno);
-                break;
+    for (i = 1; i < server->n_workers; ++i) {
+        if (server->workers[i].n_sessions < worker->n_sessions) {
+            worker = &server->workers[i];
         }
     }
-    mbuf_set_end(buffer, (size_t) length);
-    DEBUG_PRINTF("(%s.%s) ... read %zu bytes\n",
-                 client->name, channel->label, mbuf_get_left(buffer));
+    return worker;
+}
 
-    // Process terminated?
-    if (length == 0) {
-        // Stop listening
-        if (client_channel->pid != -1) {
-            DEBUG_INFO("(%s.%s) Stopping process\n", channel->client->name, channel->label);
+/*
+ * Accept a WebSocket connection restarting ICE of an existing session.
+ * The session is identified by the token it handed out along with its
+ * local parameters.
+ */
+static void server_accept_ice_restart(
+        struct terminal_server* const server,
+        struct http_conn* const connection,
+        struct http_msg const* const message,
+        struct pl const* const token
+) {
+    struct terminal_client* client = NULL;
+    struct websock_conn* ws_connection;
+    struct le* le;
+    int err;
+
+    // Find session
+    for (le = list_head(&server->sessions); le != NULL; le = le->next) {
+        struct terminal_client* const session = le->data;
+        if (pl_strcmp(token, session->restart_token) == 0) {
+            client = session;
+            break;
         }
-        stop_process(client_channel);
+    }
+    if (!client) {
+        DEBUG_NOTICE("Unknown session to restart ICE for, rejecting\n");
+        http_ereply(connection, 404, "Not Found");
+        return;
+    }
 
-        // Close data channel
-        EOE(rawrtc_data_channel_close(channel->channel));
+    // Accept WS connection
+    err = websock_accept(
+            &ws_connection, server->ws_socket, connection, message, 30000,
+            ws_receive_handler, ws_close_handler, client);
+    if (err) {
+        DEBUG_NOTICE("(%s) Could not accept WS connection, reason: %m\n", client->name, err);
+        http_ereply(connection, 400, "Bad Request");
+        return;
+    }
+    DEBUG_INFO("(%s) Accepted WS connection to restart ICE\n", client->name);
 
-        // Unreference helper
-        mem_deref(channel);
-    } else {
-        // Send the buffer
-        DEBUG_PRINTF("(%s.%s) Sending %zu bytes\n", client->name, channel->label, length);
-        EOE(rawrtc_data_channel_send(channel->channel, buffer, false));
+    // Replace previous WS connection (if still open)
+    if (client->ws_connection) {
+        EOR(websock_close(client->ws_connection, WEBSOCK_GOING_AWAY, NULL));
+        mem_deref(client->ws_connection);
     }
+    client->ws_connection = ws_connection;
 
-    // Clean up
-    mem_deref(buffer);
+    // Signalling starts over (the session stays if the connection closes early)
+    client->ws_remote_started = true;
+    client->ws_local_done = false;
+    client->ws_remote_done = false;
 }
 
 /*
- * Fork and start the process on open event.
+ * Accept a WebSocket connection and create a new session for it (or
+ * restart ICE of an existing session).
  */
-static void data_channel_open_handler(
-        void* const arg // will be casted to `struct data_channel_helper*`
+static void server_http_request_handler(
+        struct http_conn* const connection,
+        struct http_msg const* const message,
+        void* arg
 ) {
-    struct data_channel_helper* const channel = arg;
-    struct terminal_client_channel* const client_channel = channel->arg;
-    struct terminal_client* const client =
-            (struct terminal_client* const) channel->client;
-    pid_t pid;
-    int pty;
-
-    // Print open event
-    default_data_channel_open_handler(arg);
-
-    // Fork to pseudo-terminal
-    // TODO: Check bounds (PID_MAX < INT_MAX...)
-    // TODO: Fix leaking FDs
-    DEBUG_INFO("(%s) Starting process for data channel %s\n",
-               channel->client->name, channel->label);
-    pid = (pid_t) forkpty(&pty, NULL, NULL, NULL);
-    EOP(pid);
-
-    // Child process
-    if (pid == 0) {
-        char* const args[] = {client->shell, NULL};
+    struct terminal_server* const server = arg;
+    struct terminal_client const* const prototype = server->prototype;
+    struct terminal_client* client;
+    struct terminal_worker* worker;
+    struct pl token;
+    int err;
+    DEBUG_PRINTF("HTTP request: %r %r\n", &message->met, &message->path);
+
+    // Restart ICE of an existing session?
+    // Note: The token is being compared exactly when looking up the session.
+    if (message->path.l > sizeof(restart_path_prefix) - 1
+            && memcmp(message->path.p, restart_path_prefix, sizeof(restart_path_prefix) - 1) == 0) {
+        token.p = message->path.p + sizeof(restart_path_prefix) - 1;
+        token.l = message->path.l - (sizeof(restart_path_prefix) - 1);
+        server_accept_ice_restart(server, connection, message, &token);
+        return;
+    }
 
-        // Make it colourful!
-        EOP(setenv("TERM", "xterm-256color", 1));
+    // Limit reached?
+    if (list_count(&server->sessions) >= prototype->options->server_max_sessions) {
+        DEBUG_NOTICE("Maximum amount of sessions reached, rejecting\n");
+        http_ereply(connection, 503, "Service Unavailable");
+        return;
+    }
 
-        // Run terminal
-        EOP(execvp(args[0], args));
-        EWE("Child process returned!\n");
+    // Create session
+    client = server_create_session(server);
+
+    // Accept WS connection
+    err = websock_accept(
+            &client->ws_connection, server->ws_socket, connection, message, 30000,
+            ws_receive_handler, ws_close_handler, client);
+    if (err) {
+        DEBUG_NOTICE("Could not accept WS connection, reason: %m\n", err);
+        http_ereply(connection, 400, "Bad Request");
+        mem_deref(client);
+        return;
     }
 
-    // Set fields
-    client_channel->pid = pid;
-    client_channel->pty = pty;
+    // Hand off to a worker (if any)
+    if (server->n_workers > 0) {
+        worker = server_get_least_loaded_worker(server);
+        client->worker = worker;
+        ++worker->n_sessions;
+        DEBUG_INFO("(%s) New session on worker %"PRIu32"\n", client->name, worker->id);
+        worker_message_push(worker->mqueue, WORKER_MESSAGE_SESSION_START, client, NULL);
+    } else {
+        DEBUG_INFO("(%s) New session\n", client->name);
+
+        // Setup client, start gathering & send local parameters
+        // Note: Candidates are trickled as they are being gathered
+        client_set_shared_settings(
+                client, prototype->gather_options, server->certificate, prototype->buffer_pool,
+                prototype->shell_pool, prototype->trace, prototype->scheduler);
+        client_init(client);
+        client_start_gathering(client);
+        client_start_signalling(client);
+    }
 
-    // Listen on PTY
-    EOR(fd_listen(client_channel->pty, FD_READ, pty_read_handler, channel));
+    // Print statistics
+    server_print_statistics(server);
 }
 
-static void terminal_client_channel_destroy(
+static void worker_message_destroy(
         void* arg
 ) {
-    struct terminal_client_channel* const client_channel = arg;
+    struct worker_message* const message = arg;
 
-    // Stop process
-    stop_process(client_channel);
+    // Un-reference
+    mem_deref(message->buffer);
 }
 
 /*
- * Handle the newly created data channel.
+ * Push a message to another thread's message queue.
+ * Note: The buffer's reference is handed over to the receiving thread,
+ *       so the caller must not touch the buffer afterwards. Reference
+ *       counting is not thread-safe.
  */
-static void data_channel_handler(
-        struct rawrtc_data_channel* const channel, // read-only, MUST be referenced when used
-        void* const arg // will be casted to `struct client*`
+static void worker_message_push(
+        struct mqueue* const queue,
+        enum worker_message_type const type,
+        struct terminal_client* const client, // nullable
+        struct mbuf* const buffer // nullable, ownership is transferred
 ) {
-    struct terminal_client* const client = arg;
-    struct terminal_client_channel* client_channel;
-    struct data_channel_helper* channel_helper;
+    struct worker_message* message;
 
-    // Print channel
-    default_data_channel_handler(channel, arg);
-
-    // Create terminal client channel instance
-    client_channel = mem_zalloc(sizeof(*client_channel), terminal_client_channel_destroy);
-    if (!client_channel) {
+    // Allocate
+    message = mem_zalloc(sizeof(*message), worker_message_destroy);
+    if (!message) {
         EOE(RAWRTC_CODE_NO_MEMORY);
+        mem_deref(buffer);
         return;
     }
 
-    // Set fields
-    client_channel->pid = -1;
-    client_channel->pty = -1;
-
-    // Create data channel helper instance
-    // Note: In this case we need to reference the channel because we have not created it
-    data_channel_helper_create_from_channel(&channel_helper, mem_ref(channel), arg, client_channel);
-    mem_deref(client_channel);
+    // Set fields & push
+    message->client = client;
+    message->buffer = buffer;
+    EOR(mqueue_push(queue, type, message));
+}
 
-    // Add to list
-    list_append(&client->data_channels, &channel_helper->le, channel_helper);
+/*
+ * Stop all sessions of the worker (worker thread).
+ */
+static void worker_stop_sessions(
+        struct terminal_worker* const worker
+) {
+    struct le* le;
 
-    // Set handler argument & handlers
-    EOE(rawrtc_data_channel_set_arg(channel, channel_helper));
-    EOE(rawrtc_data_channel_set_open_handler(channel, data_channel_open_handler));
-    EOE(rawrtc_data_channel_set_buffered_amount_low_handler(
-            channel, default_data_channel_buffered_amount_low_handler));
-    EOE(rawrtc_data_channel_set_error_handler(channel, data_channel_error_handler));
-    EOE(rawrtc_data_channel_set_close_handler(channel, data_channel_close_handler));
-    EOE(rawrtc_data_channel_set_message_handler(channel, data_channel_message_handler));
+    // Stop sessions
+    // Note: The sessions will be un-referenced by the acceptor thread.
+    while ((le = list_head(&worker->sessions))) {
+        struct terminal_client* const client = le->data;
+        tmr_cancel(&client->teardown_timer);
+        client_stop(client);
+        list_unlink(&client->worker_le);
+    }
 }
 
-static void client_init(
-        struct terminal_client* const client
+/*
+ * Print the latency histograms of all sessions of the worker and the
+ * worker's trace ring.
+ */
+static void worker_dump(
+        struct terminal_worker* const worker
 ) {
-    struct rawrtc_certificate* certificates[1];
-
-    if (client->ws_uri) {
-        // Create DNS client
-        EOR(dnsc_alloc(&client->dns_client, NULL, NULL, 0));
+    struct le* le;
+    for (le = list_head(&worker->sessions); le != NULL; le = le->next) {
+        client_print_latency(le->data);
+    }
+    if (worker->trace) {
+        DEBUG_INFO("(W%"PRIu32") Trace: %H", worker->id, trace_ring_debug, worker->trace);
+    }
+}
 
-        // Create HTTP client
-        EOR(http_client_alloc(&client->http_client, client->dns_client));
+/*
+ * Hand snapshots of all sessions of the worker to the acceptor.
+ */
+static void worker_collect_metrics(
+        struct terminal_worker* const worker
+) {
+    struct mbuf* samples;
+    struct le* le;
 
-        // Create WS Socket
-        EOR(websock_alloc(&client->ws_socket, NULL, client));
+    // Allocate
+    samples = mbuf_alloc(sizeof(struct metrics_session) * (list_count(&worker->sessions) + 1));
+    if (!samples) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
     }
 
-    // Generate certificates
-    EOE(rawrtc_certificate_generate(&client->certificate, NULL));
-    certificates[0] = client->certificate;
+    // Collect & hand over
+    for (le = list_head(&worker->sessions); le != NULL; le = le->next) {
+        client_collect_metrics(le->data, samples);
+    }
+    worker_message_push(worker->server->mqueue, WORKER_MESSAGE_METRICS, NULL, samples);
+}
 
-    // Create ICE gatherer
-    EOE(rawrtc_ice_gatherer_create(
-            &client->gatherer, client->gather_options,
-            default_ice_gatherer_state_change_handler, default_ice_gatherer_error_handler,
-            ice_gatherer_local_candidate_handler, client));
+/*
+ * Handle a message from the acceptor thread (worker thread).
+ */
+static void worker_message_handler(
+        int id,
+        void* data,
+        void* arg
+) {
+    struct terminal_worker* const worker = arg;
+    struct worker_message* const message = data;
+    struct terminal_client* const client = message->client;
+
+    switch ((enum worker_message_type) id) {
+        case WORKER_MESSAGE_SESSION_START:
+            // Setup client, start gathering & hand local parameters to the acceptor
+            // Note: Candidates are handed over as they are being gathered
+            client_set_shared_settings(
+                    client, worker->gather_options, worker->certificate, worker->buffer_pool,
+                    worker->shell_pool, worker->trace, worker->scheduler);
+            list_append(&worker->sessions, &client->worker_le, client);
+            client_init(client);
+            client_start_gathering(client);
+            client_start_signalling(client);
+            break;
+        case WORKER_MESSAGE_REMOTE_SIGNALLING:
+            // Handle signalling message (tear down if invalid)
+            if (!client->stopping) {
+                bool const complete = client->remote_candidates_complete;
+                if (!client_handle_signalling_buffer(client, message->buffer)) {
+                    client_schedule_teardown(client);
+                } else if (!complete && client->remote_candidates_complete) {
+                    // Tell acceptor that the remote peer is done
+                    worker_message_push(
+                            worker->server->mqueue, WORKER_MESSAGE_REMOTE_COMPLETE, client, NULL);
+                }
+            }
+            break;
+        case WORKER_MESSAGE_WS_CLOSED:
+            // Remote peer gave up
+            client_schedule_teardown(client);
+            break;
+        case WORKER_MESSAGE_SESSION_RELEASE:
+            // Acceptor is done with the session
+            mem_deref(client);
+            break;
+        case WORKER_MESSAGE_DUMP:
+            // Print latency histograms of all sessions & the trace ring
+            worker_dump(worker);
+            break;
+        case WORKER_MESSAGE_COLLECT_METRICS:
+            // Hand snapshots of all sessions to the acceptor
+            worker_collect_metrics(worker);
+            break;
+        case WORKER_MESSAGE_STOP:
+            // Stop sessions & event loop
+            worker_stop_sessions(worker);
+            re_cancel();
+            break;
+        default:
+            DEBUG_WARNING("(W%"PRIu32") Unexpected message type: %d\n", worker->id, id);
+            break;
+    }
 
-    // Create ICE transport
-    EOE(rawrtc_ice_transport_create(
-            &client->ice_transport, client->gatherer,
-            default_ice_transport_state_change_handler,
-            default_ice_transport_candidate_pair_change_handler, client));
+    // Un-reference
+    mem_deref(message);
+}
 
-    // Create DTLS transport
-    EOE(rawrtc_dtls_transport_create(
-            &client->dtls_transport, client->ice_transport, certificates, ARRAY_SIZE(certificates),
-            default_dtls_transport_state_change_handler, default_dtls_transport_error_handler,
-            client));
+/*
+ * Handle a message from a worker thread (acceptor thread).
+ */
+static void server_message_handler(
+        int id,
+        void* data,
+        void* arg
+) {
+    struct terminal_server* const server = arg;
+    struct worker_message* const message = data;
+    struct terminal_client* const client = message->client;
+
+    switch ((enum worker_message_type) id) {
+        case WORKER_MESSAGE_LOCAL_SIGNALLING:
+        case WORKER_MESSAGE_LOCAL_SIGNALLING_LAST:
+            // Send signalling message (if the WS connection is still open)
+            client_ws_send(client, message->buffer, id == WORKER_MESSAGE_LOCAL_SIGNALLING_LAST);
+            break;
+        case WORKER_MESSAGE_REMOTE_COMPLETE:
+            // Close WS connection (if signalling is complete)
+            client->ws_remote_done = true;
+            client_close_ws_if_done(client);
+            break;
+        case WORKER_MESSAGE_SESSION_STOPPED:
+            // Close WS connection & remove session
+            // Note: The worker releases the session once all pending messages have been handled.
+            if (client->ws_connection) {
+                EOR(websock_close(client->ws_connection, WEBSOCK_GOING_AWAY, NULL));
+            }
+            client->ws_connection = mem_deref(client->ws_connection);
+            list_unlink(&client->le);
+            --client->worker->n_sessions;
+            worker_message_push(
+                    client->worker->mqueue, WORKER_MESSAGE_SESSION_RELEASE, client, NULL);
+
+            // Print statistics
+            server_print_statistics(server);
+            break;
+        case WORKER_MESSAGE_METRICS:
+            // Add snapshots of a worker's sessions (if still being exposed)
+            if (server->metrics) {
+                metrics_exporter_add_samples(server->metrics, message->buffer);
+            }
+            break;
+        default:
+            DEBUG_WARNING("Unexpected message type: %d\n", id);
+            break;
+    }
 
-    // Create SCTP transport
-    EOE(rawrtc_sctp_transport_create(
-            &client->sctp_transport, client->dtls_transport,
-            client->local_parameters.sctp_parameters.port,
-            data_channel_handler, default_sctp_transport_state_change_handler, client));
+    // Un-reference
+    mem_deref(message);
+}
 
-    // Get data transport
-    EOE(rawrtc_sctp_transport_get_data_transport(
-            &client->data_transport, client->sctp_transport));
+/*
+ * Run a worker's event loop (worker thread).
+ */
+static void* worker_run(
+        void* arg
+) {
+    struct terminal_worker* const worker = arg;
+    struct terminal_server* const server = worker->server;
+    struct terminal_options const* const options = server->prototype->options;
+
+    // Initialise event loop of this thread
+    EOR(re_thread_init());
+
+    // Create settings shared by all sessions of this worker
+    create_gather_options(&worker->gather_options);
+    EOE(certificate_from_pem(
+            &worker->certificate, server->certificate_pem, server->certificate_pem_length,
+            options->certificate_key_type));
+    EOE(buffer_pool_create(&worker->buffer_pool, options->buffer_pool_size, options->buffer_size));
+    if (options->shell_pool_size > 0) {
+        EOE(shell_pool_create(
+                &worker->shell_pool, server->prototype->shell, options->shell_pool_size));
+    }
+    if (options->trace_ring_size > 0) {
+        EOE(trace_ring_create(&worker->trace, options->trace_ring_size));
+    }
+    EOE(output_scheduler_create(
+            &worker->scheduler, options->output_drain_limit, options->output_interactive_window));
+
+    // Create message queue
+    EOR(mqueue_alloc(&worker->mqueue, worker_message_handler, worker));
+
+    // Signal readiness
+    EOR(pthread_mutex_lock(&server->ready_mutex));
+    ++server->n_ready;
+    EOR(pthread_cond_signal(&server->ready_condition));
+    EOR(pthread_mutex_unlock(&server->ready_mutex));
+
+    // Start event loop
+    EOR(re_main(NULL));
+
+    // Print buffer pool statistics & un-reference
+    DEBUG_INFO("(W%"PRIu32") %H\n", worker->id, buffer_pool_debug, worker->buffer_pool);
+    DEBUG_INFO("(W%"PRIu32") %H\n", worker->id, shell_pool_debug, worker->shell_pool);
+    worker->mqueue = mem_deref(worker->mqueue);
+    worker->shell_pool = mem_deref(worker->shell_pool);
+    worker->trace = mem_deref(worker->trace);
+    worker->scheduler = mem_deref(worker->scheduler);
+    worker->buffer_pool = mem_deref(worker->buffer_pool);
+    worker->certificate = mem_deref(worker->certificate);
+    worker->gather_options = mem_deref(worker->gather_options);
+
+    // Close event loop of this thread
+    re_thread_close();
+    return NULL;
 }
 
-static void client_start_gathering(
-        struct terminal_client* const client
+/*
+ * Print the amount of sessions and the output throughput of each worker.
+ */
+static void server_statistics_timer_handler(
+        void* arg
 ) {
-    // Start gathering
-    EOE(rawrtc_ice_gatherer_gather(client->gatherer, NULL));
+    struct terminal_server* const server = arg;
+    uint64_t total = 0;
+    uint32_t i;
+
+    // Print per worker
+    for (i = 0; i < server->n_workers; ++i) {
+        struct terminal_worker* const worker = &server->workers[i];
+        uint64_t output_bytes;
+        uint64_t throughput;
+
+        // Get output since last interval
+        lock_read_get(worker->lock);
+        output_bytes = worker->output_bytes;
+        lock_rel(worker->lock);
+        throughput = (output_bytes - worker->last_output_bytes) * 1000
+                     / WORKER_STATISTICS_INTERVAL;
+        worker->last_output_bytes = output_bytes;
+        total += throughput;
+
+        DEBUG_INFO("(W%"PRIu32") Sessions: %"PRIu32", output: %"PRIu64" KiB/s\n",
+                   worker->id, worker->n_sessions, throughput / 1024);
+    }
+    DEBUG_INFO("Workers: %"PRIu32", total output: %"PRIu64" KiB/s\n",
+               server->n_workers, total / 1024);
+
+    // Restart timer
+    tmr_start(&server->statistics_timer, WORKER_STATISTICS_INTERVAL,
+              server_statistics_timer_handler, server);
 }
 
-static void client_start_transports(
-        struct terminal_client* const client
+/*
+ * Start the worker threads and wait until they are ready to accept
+ * sessions.
+ */
+static void server_start_workers(
+        struct terminal_server* const server,
+        uint32_t const n_workers
 ) {
-    struct parameters* const remote_parameters = &client->remote_parameters;
-    DEBUG_INFO("(%s) Starting transports\n", client->name);
+    uint32_t i;
 
-    // Start ICE transport
-    EOE(rawrtc_ice_transport_start(
-            client->ice_transport, client->gatherer, remote_parameters->ice_parameters,
-            client->role));
+    // Allocate
+    server->workers = mem_zalloc(sizeof(*server->workers) * n_workers, NULL);
+    if (!server->workers) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+    server->n_workers = n_workers;
+
+    // Create message queue
+    EOR(mqueue_alloc(&server->mqueue, server_message_handler, server));
+
+    // Start threads
+    EOR(pthread_mutex_init(&server->ready_mutex, NULL));
+    EOR(pthread_cond_init(&server->ready_condition, NULL));
+    for (i = 0; i < n_workers; ++i) {
+        struct terminal_worker* const worker = &server->workers[i];
+        worker->server = server;
+        worker->id = i;
+        list_init(&worker->sessions);
+        EOR(lock_alloc(&worker->lock));
+        EOR(pthread_create(&worker->thread, NULL, worker_run, worker));
+    }
 
-    // Start DTLS transport
-    EOE(rawrtc_dtls_transport_start(
-            client->dtls_transport, remote_parameters->dtls_parameters));
+    // Wait until ready
+    EOR(pthread_mutex_lock(&server->ready_mutex));
+    while (server->n_ready < n_workers) {
+        EOR(pthread_cond_wait(&server->ready_condition, &server->ready_mutex));
+    }
+    EOR(pthread_mutex_unlock(&server->ready_mutex));
+    DEBUG_INFO("Started %"PRIu32" workers\n", n_workers);
 
-    // Start SCTP transport
-    EOE(rawrtc_sctp_transport_start(
-            client->sctp_transport, remote_parameters->sctp_parameters.capabilities,
-            remote_parameters->sctp_parameters.port));
+    // Start statistics timer
+    tmr_init(&server->statistics_timer);
+    tmr_start(&server->statistics_timer, WORKER_STATISTICS_INTERVAL,
+              server_statistics_timer_handler, server);
 }
 
-static void parameters_destroy(
-        struct parameters* const parameters
+/*
+ * Stop the worker threads and wait until they have stopped.
+ */
+static void server_stop_workers(
+        struct terminal_server* const server
 ) {
+    uint32_t i;
+
+    // Stop statistics timer
+    tmr_cancel(&server->statistics_timer);
+
+    // Stop threads
+    for (i = 0; i < server->n_workers; ++i) {
+        worker_message_push(server->workers[i].mqueue, WORKER_MESSAGE_STOP, NULL, NULL);
+    }
+    for (i = 0; i < server->n_workers; ++i) {
+        EOR(pthread_join(server->workers[i].thread, NULL));
+        mem_deref(server->workers[i].lock);
+    }
+
     // Un-reference
-    parameters->ice_parameters = mem_deref(parameters->ice_parameters);
-    parameters->ice_candidates = mem_deref(parameters->ice_candidates);
-    parameters->dtls_parameters = mem_deref(parameters->dtls_parameters);
-    if (parameters->sctp_parameters.capabilities) {
-        parameters->sctp_parameters.capabilities =
-                mem_deref(parameters->sctp_parameters.capabilities);
+    EOR(pthread_cond_destroy(&server->ready_condition));
+    EOR(pthread_mutex_destroy(&server->ready_mutex));
+    server->mqueue = mem_deref(server->mqueue);
+    server->workers = mem_deref(server->workers);
+    server->n_workers = 0;
+}
+
+/*
+ * Raise the file descriptor limit as each session requires a couple of
+ * sockets and a PTY per terminal.
+ */
+static void raise_file_descriptor_limit(void) {
+    struct rlimit limit;
+
+    // Get & raise soft limit to hard limit
+    EOP(getrlimit(RLIMIT_NOFILE, &limit));
+    if (limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        EOP(setrlimit(RLIMIT_NOFILE, &limit));
     }
+    DEBUG_PRINTF("File descriptor limit: %llu\n", (unsigned long long) limit.rlim_cur);
 }
 
-static void client_stop(
-        struct terminal_client* const client
+/*
+ * Start the server: Listen for WebSocket connections on `address`.
+ */
+static void server_start(
+        struct terminal_server* const server,
+        struct terminal_client const* const prototype,
+        struct sa const* const address
 ) {
-    DEBUG_INFO("(%s) Stopping transports\n", client->name);
+    // Set fields
+    server->prototype = prototype;
+    list_init(&server->sessions);
+
+    // Raise file descriptor limit
+    raise_file_descriptor_limit();
+
+    // Load or generate certificate shared by all sessions
+    EOE(certificate_load_or_generate(&server->certificate, prototype->options));
+
+    // Start workers (if any)
+    // Note: Workers get their own copy of the certificate as reference counting is not
+    //       thread-safe.
+    if (prototype->options->server_workers > 0) {
+        EOE(rawrtc_certificate_to_pem(
+                &server->certificate_pem, &server->certificate_pem_length, server->certificate,
+                RAWRTC_CERTIFICATE_ENCODE_BOTH));
+        server_start_workers(server, prototype->options->server_workers);
+    }
 
-    // Clear data channels
-    list_flush(&client->data_channels);
+    // Create WS socket & listen for HTTP requests
+    EOR(websock_alloc(&server->ws_socket, NULL, server));
+    EOR(http_listen(&server->http_socket, address, server_http_request_handler, server));
+    DEBUG_INFO("Listening for WebSocket connections on %J\n", address);
 
-    // Stop all transports & gatherer
-    EOE(rawrtc_sctp_transport_stop(client->sctp_transport));
-    EOE(rawrtc_dtls_transport_stop(client->dtls_transport));
-    EOE(rawrtc_ice_transport_stop(client->ice_transport));
-    EOE(rawrtc_ice_gatherer_close(client->gatherer));
+    // Get baseline memory
+    if (get_resident_memory(&server->baseline_memory)) {
+        server->baseline_memory = 0;
+    }
+}
 
-    // Close WS connection
-    if (client->ws_connection) {
-        EOR(websock_close(client->ws_connection, WEBSOCK_GOING_AWAY, NULL));
+/*
+ * Stop all sessions and the server.
+ */
+static void server_stop(
+        struct terminal_server* const server
+) {
+    struct le* le;
+
+    // Stop workers
+    // Note: This stops the sessions handed off to workers.
+    if (server->n_workers > 0) {
+        server_stop_workers(server);
     }
 
-    // Stop listening on STDIN
-    fd_close(STDIN_FILENO);
+    // Stop remaining sessions & un-reference
+    while ((le = list_head(&server->sessions))) {
+        struct terminal_client* const client = le->data;
+        if (client->worker) {
+            client->ws_connection = mem_deref(client->ws_connection);
+        } else {
+            client_stop(client);
+        }
+        mem_deref(client);
+    }
 
-    // Un-reference & close
-    parameters_destroy(&client->remote_parameters);
-    parameters_destroy(&client->local_parameters);
-    client->ws_connection = mem_deref(client->ws_connection);
-    client->data_transport = mem_deref(client->data_transport);
-    client->sctp_transport = mem_deref(client->sctp_transport);
-    client->dtls_transport = mem_deref(client->dtls_transport);
-    client->ice_transport = mem_deref(client->ice_transport);
-    client->gatherer = mem_deref(client->gatherer);
-    client->certificate = mem_deref(client->certificate);
-    client->ws_socket = mem_deref(client->ws_socket);
-    client->http_client = mem_deref(client->http_client);
-    client->dns_client = mem_deref(client->dns_client);
-    client->gather_options = mem_deref(client->gather_options);
-    client->ws_uri = mem_deref(client->ws_uri);
-    client->shell = mem_deref(client->shell);
+    // Un-reference
+    server->http_socket = mem_deref(server->http_socket);
+    server->ws_socket = mem_deref(server->ws_socket);
+    server->certificate_pem = mem_deref(server->certificate_pem);
+    server->certificate = mem_deref(server->certificate);
 }
 
-static void client_apply_parameters(
-        struct terminal_client* const client
+/*
+ * Print the latency histograms of all sessions and the trace ring.
+ * Workers print their sessions and their trace ring themselves.
+ */
+static void server_dump(
+        struct terminal_server* const server
 ) {
-    struct parameters* const remote_parameters = &client->remote_parameters;
-    DEBUG_INFO("(%s) Applying remote parameters\n", client->name);
+    struct le* le;
+    uint32_t i;
+
+    // Ask workers to print
+    for (i = 0; i < server->n_workers; ++i) {
+        worker_message_push(server->workers[i].mqueue, WORKER_MESSAGE_DUMP, NULL, NULL);
+    }
 
-    // Set remote ICE candidates
-    EOE(rawrtc_ice_transport_set_remote_candidates(
-            client->ice_transport, remote_parameters->ice_candidates->candidates,
-            remote_parameters->ice_candidates->n_candidates));
+    // Print sessions running on this thread
+    for (le = list_head(&server->sessions); le != NULL; le = le->next) {
+        struct terminal_client* const client = le->data;
+        if (!client->worker) {
+            client_print_latency(client);
+        }
+    }
+    if (server->prototype->trace) {
+        DEBUG_INFO("Trace: %H", trace_ring_debug, server->prototype->trace);
+    }
 }
 
-static enum rawrtc_code client_decode_parameters(
-        struct parameters* const parametersp,
-        struct odict* const dict,
-        struct terminal_client* const client
+/*
+ * Collect snapshots of the sessions running on this thread and ask the
+ * workers for theirs.
+ */
+static uint32_t server_metrics_collect_handler(
+        struct mbuf* const samples,
+        void* const arg
 ) {
-    enum rawrtc_code error = RAWRTC_CODE_SUCCESS;
-    struct odict* node;
-    struct parameters parameters = {0};
-
-    // Decode nodes
-    error |= dict_get_entry(&node, dict, "iceParameters", ODICT_OBJECT, true);
-    error |= get_ice_parameters(&parameters.ice_parameters, node);
-    error |= dict_get_entry(&node, dict, "iceCandidates", ODICT_ARRAY, true);
-    error |= get_ice_candidates(&parameters.ice_candidates, node, (struct client* const) client);
-    error |= dict_get_entry(&node, dict, "dtlsParameters", ODICT_OBJECT, true);
-    error |= get_dtls_parameters(&parameters.dtls_parameters, node);
-    error |= dict_get_entry(&node, dict, "sctpParameters", ODICT_OBJECT, true);
-    error |= get_sctp_parameters(&parameters.sctp_parameters, node);
+    struct terminal_server* const server = arg;
+    struct le* le;
+    uint32_t i;
 
-    // Ok?
-    if (error) {
-        DEBUG_WARNING("(%s) Invalid remote parameters\n", client->name);
-        goto out;
+    // Ask workers to collect
+    for (i = 0; i < server->n_workers; ++i) {
+        worker_message_push(server->workers[i].mqueue, WORKER_MESSAGE_COLLECT_METRICS, NULL, NULL);
     }
 
-out:
-    if (error) {
-        // Un-reference
-        mem_deref(parameters.sctp_parameters.capabilities);
-        mem_deref(parameters.dtls_parameters);
-        mem_deref(parameters.ice_candidates);
-        mem_deref(parameters.ice_parameters);
-    } else {
-        // Copy parameters
-        memcpy(parametersp, &parameters, sizeof(parameters));
+    // Collect sessions running on this thread
+    for (le = list_head(&server->sessions); le != NULL; le = le->next) {
+        struct terminal_client* const client = le->data;
+        if (!client->worker) {
+            client_collect_metrics(client, samples);
+        }
     }
-
-    return error;
+    return server->n_workers;
 }
 
-static void client_get_parameters(
-        struct terminal_client* const client
+/*
+ * Collect a snapshot of the client.
+ */
+static uint32_t client_metrics_collect_handler(
+        struct mbuf* const samples,
+        void* const arg
 ) {
-    struct parameters* const local_parameters = &client->local_parameters;
+    client_collect_metrics(arg, samples);
+    return 0;
+}
 
-    // Get local ICE parameters
-    EOE(rawrtc_ice_gatherer_get_local_parameters(
-            &local_parameters->ice_parameters, client->gatherer));
+// Note: The benchmark includes this file to drive the client's functions and provides its own
+//       entry point.
+#ifndef RAWRTC_TERMINAL_NO_MAIN
+// Self-pipe used to move SIGUSR1 onto the event loop
+static int dump_signal_pipe[2] = {-1, -1};
 
-    // Get local ICE candidates
-    EOE(rawrtc_ice_gatherer_get_local_candidates(
-            &local_parameters->ice_candidates, client->gatherer));
+/*
+ * Handle SIGUSR1 (async-signal-safe): Wake up the event loop.
+ */
+static void dump_signal_handler(
+        int signal
+) {
+    int const saved_errno = errno;
+    ssize_t length;
+    (void) signal;
 
-    // Get local DTLS parameters
-    EOE(rawrtc_dtls_transport_get_local_parameters(
-            &local_parameters->dtls_parameters, client->dtls_transport));
+    // Note: If the pipe is full, a dump is pending anyway.
+    length = write(dump_signal_pipe[1], "", 1);
+    (void) length;
+    errno = saved_errno;
+}
 
-    // Get local SCTP parameters
-    EOE(rawrtc_sctp_transport_get_capabilities(
-            &local_parameters->sctp_parameters.capabilities));
-    EOE(rawrtc_sctp_transport_get_port(
-            &local_parameters->sctp_parameters.port, client->sctp_transport));
+/*
+ * Drain the self-pipe.
+ */
+static void drain_dump_signal_pipe(void) {
+    uint8_t buffer[64];
+    while (read(dump_signal_pipe[0], buffer, sizeof(buffer)) > 0) {}
 }
 
-static struct odict* client_encode_parameters(
-        struct terminal_client* const client
+/*
+ * Print the latency histograms of the client and the trace ring on
+ * SIGUSR1.
+ */
+static void client_dump_signal_handler(
+        int flags,
+        void* arg
 ) {
-    struct odict* dict;
-    struct odict* node;
+    struct terminal_client* const client = arg;
+    (void) flags;
+    drain_dump_signal_pipe();
+    client_print_latency(client);
+    if (client->trace) {
+        DEBUG_INFO("(%s) Trace: %H", client->name, trace_ring_debug, client->trace);
+    }
+}
 
-    // Get local parameters
-    client_get_parameters(client);
+/*
+ * Print the latency histograms of all sessions and the trace rings on
+ * SIGUSR1.
+ */
+static void server_dump_signal_handler(
+        int flags,
+        void* arg
+) {
+    struct terminal_server* const server = arg;
+    (void) flags;
+    drain_dump_signal_pipe();
+    server_dump(server);
+}
 
-    // Create dict
-    EOR(odict_alloc(&dict, 16));
+/*
+ * Install the SIGUSR1 handler which prints the latency histograms and
+ * the trace rings.
+ */
+static void listen_dump_signal(
+        fd_h* const handler,
+        void* const arg
+) {
+    struct sigaction action = {0};
+    size_t i;
+
+    // Create non-blocking self-pipe
+    EOP(pipe(dump_signal_pipe));
+    for (i = 0; i < 2; ++i) {
+        EOP(fcntl(dump_signal_pipe[i], F_SETFL,
+                  fcntl(dump_signal_pipe[i], F_GETFL) | O_NONBLOCK));
+        EOP(fcntl(dump_signal_pipe[i], F_SETFD, FD_CLOEXEC));
+    }
 
-    // Create nodes
-    EOR(odict_alloc(&node, 16));
-    set_ice_parameters(client->local_parameters.ice_parameters, node);
-    EOR(odict_entry_add(dict, "iceParameters", ODICT_OBJECT, node));
-    mem_deref(node);
-    EOR(odict_alloc(&node, 16));
-    set_ice_candidates(client->local_parameters.ice_candidates, node);
-    EOR(odict_entry_add(dict, "iceCandidates", ODICT_ARRAY, node));
-    mem_deref(node);
-    EOR(odict_alloc(&node, 16));
-    set_dtls_parameters(client->local_parameters.dtls_parameters, node);
-    EOR(odict_entry_add(dict, "dtlsParameters", ODICT_OBJECT, node));
-    mem_deref(node);
-    EOR(odict_alloc(&node, 16));
-    set_sctp_parameters(client->sctp_transport, &client->local_parameters.sctp_parameters, node);
-    EOR(odict_entry_add(dict, "sctpParameters", ODICT_OBJECT, node));
-    mem_deref(node);
+    // Listen on the read end
+    EOR(fd_listen(dump_signal_pipe[0], FD_READ, handler, arg));
 
-    // Done
-    return dict;
+    // Install signal handler
+    action.sa_handler = dump_signal_handler;
+    action.sa_flags = SA_RESTART;
+    EOP(sigemptyset(&action.sa_mask));
+    EOP(sigaction(SIGUSR1, &action, NULL));
+    DEBUG_PRINTF("Send SIGUSR1 to print keystroke latency histograms and traces\n");
+}
+
+/*
+ * Uninstall the SIGUSR1 handler and close the self-pipe.
+ */
+static void close_dump_signal(void) {
+    struct sigaction action = {0};
+    size_t i;
+
+    // Restore default action
+    action.sa_handler = SIG_DFL;
+    EOP(sigaction(SIGUSR1, &action, NULL));
+
+    // Close self-pipe
+    fd_close(dump_signal_pipe[0]);
+    for (i = 0; i < 2; ++i) {
+        EOP(close(dump_signal_pipe[i]));
+        dump_signal_pipe[i] = -1;
+    }
 }
 
 static void exit_with_usage(char* program) {
-    DEBUG_WARNING("Usage: %s <0|1 (ice-role)> [<ws-uri>] [<shell>] [<sctp-port>] "
-                  "[<ice-candidate-type> ...]", program);
+    DEBUG_WARNING("Usage: %s <0|1 (ice-role)> [<ws-uri>|listen:<ip>:<port>] [<shell>] "
+                  "[<sctp-port>] [<ice-candidate-type> ...]", program);
     exit(1);
 }
 
@@ -802,10 +5064,15 @@ int main(int argc, char* argv[argc + 1]) {
     size_t n_ice_candidate_types = 0;
     enum rawrtc_ice_role role;
     struct rawrtc_ice_gather_options* gather_options;
-    char* const stun_google_com_urls[] = {"stun:stun.l.google.com:19302",
-                                          "stun:stun1.l.google.com:19302"};
-    char* const turn_threema_ch_urls[] = {"turn:turn.threema.ch:443"};
+    struct terminal_options options;
+    struct buffer_pool* buffer_pool;
+    struct setup_timing_log* setup_log = NULL;
+    struct metrics_exporter* metrics = NULL;
+    enum rawrtc_code error;
     struct terminal_client client = {0};
+    struct terminal_server server = {0};
+    struct sa listen_address;
+    bool server_mode = false;
     (void) client.ice_candidate_types; (void) client.n_ice_candidate_types;
 
     // Initialise
@@ -815,6 +5082,10 @@ int main(int argc, char* argv[argc + 1]) {
     dbg_init(DBG_DEBUG, DBG_ALL);
     DEBUG_PRINTF("Init\n");
 
+    // Load options
+    terminal_options_load(&options);
+    DEBUG_PRINTF("Options:\n%H", terminal_options_debug, &options);
+
     // Check arguments length
     if (argc < 2) {
         exit_with_usage(argv[0]);
@@ -829,6 +5100,12 @@ int main(int argc, char* argv[argc + 1]) {
     if (argc >= 3 && re_regex(argv[2], strlen(argv[2]), ws_uri_regex, NULL) == 0) {
         EOE(rawrtc_sdprintf(&client.ws_uri, argv[2]));
         DEBUG_PRINTF("Using mode: WebSocket\n");
+    } else if (argc >= 3 && re_regex(argv[2], strlen(argv[2]), listen_regex, NULL) == 0) {
+        if (sa_decode(&listen_address, argv[2] + 7, strlen(argv[2]) - 7)) {
+            exit_with_usage(argv[0]);
+        }
+        server_mode = true;
+        DEBUG_PRINTF("Using mode: Server\n");
     } else {
         DEBUG_PRINTF("Using mode: Copy & Paste\n");
     }
@@ -853,16 +5130,37 @@ int main(int argc, char* argv[argc + 1]) {
     }
 
     // Create ICE gather options
-    EOE(rawrtc_ice_gather_options_create(&gather_options, RAWRTC_ICE_GATHER_POLICY_ALL));
+    create_gather_options(&gather_options);
 
-    // Add ICE servers to ICE gather options
-    EOE(rawrtc_ice_gather_options_add_server(
-            gather_options, stun_google_com_urls, ARRAY_SIZE(stun_google_com_urls),
-            NULL, NULL, RAWRTC_ICE_CREDENTIAL_TYPE_NONE));
-    EOE(rawrtc_ice_gather_options_add_server(
-            gather_options, turn_threema_ch_urls, ARRAY_SIZE(turn_threema_ch_urls),
-            "threema-angular", "Uv0LcCq3kyx6EiRwQW5jVigkhzbp70CjN2CJqzmRxG3UGIdJHSJV6tpo7Gj7YnGB",
-            RAWRTC_ICE_CREDENTIAL_TYPE_PASSWORD));
+    // Create buffer pool for PTY output
+    EOE(buffer_pool_create(&buffer_pool, options.buffer_pool_size, options.buffer_size));
+
+    // Open setup timing record & trace files (if configured)
+    error = setup_timing_log_open(&setup_log, &options);
+    if (error != RAWRTC_CODE_NO_VALUE) {
+        EOE(error);
+    }
+
+    // Create pool of warm shells (if enabled)
+    // Note: Workers create their own pool.
+    if (options.shell_pool_size > 0 && !(server_mode && options.server_workers > 0)) {
+        EOE(shell_pool_create(&client.shell_pool, client.shell, options.shell_pool_size));
+    }
+
+    // Create trace ring for per-message events (if enabled)
+    // Note: Workers create their own ring.
+    if (options.trace_ring_size > 0 && !(server_mode && options.server_workers > 0)) {
+        EOE(trace_ring_create(&client.trace, options.trace_ring_size));
+    }
+
+    // Create scheduler for PTY output
+    // Note: Workers create their own scheduler.
+    EOE(output_scheduler_create(
+            &client.scheduler, options.output_drain_limit, options.output_interactive_window));
+
+    // Create store for detached processes
+    // Note: Also used when restarting ICE, so it's created even if detaching is disabled.
+    EOE(detached_shells_create(&client.detached_shells));
 
     // Set client fields
     client.name = "A";
@@ -870,23 +5168,90 @@ int main(int argc, char* argv[argc + 1]) {
     client.n_ice_candidate_types = n_ice_candidate_types;
     client.gather_options = gather_options;
     client.role = role;
+    client.options = &options;
+    client.buffer_pool = buffer_pool; // transfer ownership
+    client.setup_log = setup_log;
     list_init(&client.data_channels);
+    list_init(&client.mux_channels);
+    list_init(&client.control_channels);
+
+    // Server mode?
+    if (server_mode) {
+        // Start server (the client serves as a prototype for sessions)
+        server_start(&server, &client, &listen_address);
+    } else {
+        // Setup client
+        setup_timing_start(&client.timing, 0);
+        client_init(&client);
 
-    // Setup client
-    client_init(&client);
+        // Start gathering & signalling
+        client_start_gathering(&client);
+        client_start_signalling(&client);
 
-    // Start gathering
-    client_start_gathering(&client);
+        // Listen on stdin
+        EOR(fd_listen(STDIN_FILENO, FD_READ, stdin_receive_handler, &client));
+    }
+
+    // Expose metrics on localhost (if enabled)
+    if (options.metrics_port > 0) {
+        if (server_mode) {
+            EOE(metrics_exporter_create(
+                    &metrics, (uint16_t) options.metrics_port, server_metrics_collect_handler,
+                    &server));
+            server.metrics = metrics;
+        } else {
+            EOE(metrics_exporter_create(
+                    &metrics, (uint16_t) options.metrics_port, client_metrics_collect_handler,
+                    &client));
+        }
+    }
 
-    // Listen on stdin
-    EOR(fd_listen(STDIN_FILENO, FD_READ, stdin_receive_handler, &client));
+    // Print latency histograms & trace rings on SIGUSR1 (if enabled)
+    if (options.latency_tracking || options.trace_ring_size > 0) {
+        if (server_mode) {
+            listen_dump_signal(server_dump_signal_handler, &server);
+        } else {
+            listen_dump_signal(client_dump_signal_handler, &client);
+        }
+    }
 
     // Start main loop
     // TODO: Wrap re_main?
     EOR(re_main(default_signal_handler));
 
-    // Stop client & bye
-    client_stop(&client);
+    // Stop exposing metrics
+    server.metrics = NULL;
+    metrics = mem_deref(metrics);
+
+    // Stop listening for SIGUSR1
+    if (options.latency_tracking || options.trace_ring_size > 0) {
+        close_dump_signal();
+    }
+
+    // Stop server or client & bye
+    if (server_mode) {
+        server_stop(&server);
+
+        // Un-reference prototype settings
+        DEBUG_INFO("%H\n", buffer_pool_debug, client.buffer_pool);
+        client.buffer_pool = mem_deref(client.buffer_pool);
+        client.shell_pool = mem_deref(client.shell_pool);
+        client.trace = mem_deref(client.trace);
+        client.scheduler = mem_deref(client.scheduler);
+        client.gather_options = mem_deref(client.gather_options);
+        client.shell = mem_deref(client.shell);
+    } else {
+        fd_close(STDIN_FILENO);
+        client_stop(&client);
+    }
+
+    // Terminate detached processes
+    if (client.detached_shells) {
+        DEBUG_INFO("%H", detached_shells_debug, client.detached_shells);
+        client.detached_shells = mem_deref(client.detached_shells);
+    }
+    mem_deref(setup_log);
     before_exit();
     return 0;
 }
+#endif
@@ -0,0 +1,248 @@
+#include <string.h> // memset
+#include <rawrtc.h>
+#include "helper/common.h"
+#include "helper/utils.h"
+#include "latency.h"
+#include "scheduler.h"
+
+#define DEBUG_MODULE "rawrtc-terminal-scheduler"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+/*
+ * Return whether the entry received input within the interactive
+ * window.
+ */
+static bool is_interactive(
+        struct output_scheduler const* const scheduler,
+        struct output_scheduler_entry const* const entry
+) {
+    return scheduler->interactive_window > 0 && entry->last_input != 0
+           && tmr_jiffies() - entry->last_input < scheduler->interactive_window;
+}
+
+/*
+ * Append an entry to the run queue of its class.
+ */
+static void enqueue(
+        struct output_scheduler* const scheduler,
+        struct output_scheduler_entry* const entry
+) {
+    struct list* const queue =
+            is_interactive(scheduler, entry) ? &scheduler->interactive : &scheduler->bulk;
+    list_append(queue, &entry->le, entry);
+    entry->queued = true;
+}
+
+/*
+ * Queue an entry that has been served in the current round again once
+ * the round is over.
+ */
+static void requeue(
+        struct output_scheduler* const scheduler,
+        struct output_scheduler_entry* const entry
+) {
+    list_append(&scheduler->next, &entry->le, entry);
+    entry->queued = true;
+    entry->ready_time = get_monotonic_time_us();
+}
+
+/*
+ * Serve each entry of a run queue once. Entries that still have output
+ * pending are queued again once the round is over, so no entry is
+ * served twice in one round (even if it changed its class).
+ */
+static void serve_queue(
+        struct output_scheduler* const scheduler,
+        struct list* const queue
+) {
+    struct le* le;
+
+    // Note: Entries may be removed while being served, so the head is being fetched each time.
+    while ((le = list_head(queue))) {
+        struct output_scheduler_entry* const entry = le->data;
+        uint64_t now;
+        size_t consumed = 0;
+
+        // Dequeue
+        list_unlink(&entry->le);
+        entry->queued = false;
+
+        // Credit quantum (skip if still in debt from overshooting the previous budget)
+        entry->deficit += (int64_t) scheduler->quantum;
+        if (entry->deficit <= 0) {
+            requeue(scheduler, entry);
+            continue;
+        }
+
+        // Record scheduling delay
+        now = get_monotonic_time_us();
+        entry->last_delay = now - entry->ready_time;
+        entry->total_delay += entry->last_delay;
+        latency_histogram_record(&entry->delays, entry->last_delay);
+        if (queue == &scheduler->interactive) {
+            ++entry->n_interactive;
+        }
+
+        // Serve
+        // Note: The entry may be gone unless output is pending.
+        if (!entry->service_handler(&consumed, (size_t) entry->deficit, entry->arg)) {
+            continue;
+        }
+
+        // Charge what has been read & queue for the next round
+        entry->deficit -= (int64_t) consumed;
+        requeue(scheduler, entry);
+    }
+}
+
+/*
+ * Run a round: Serve interactive entries first, then bulk entries.
+ */
+static void output_scheduler_round_handler(
+        void* arg
+) {
+    struct output_scheduler* const scheduler = arg;
+    struct le* le;
+
+    // Serve
+    ++scheduler->n_rounds;
+    serve_queue(scheduler, &scheduler->interactive);
+    serve_queue(scheduler, &scheduler->bulk);
+
+    // Queue served entries for the next round (by their current class)
+    while ((le = list_head(&scheduler->next))) {
+        struct output_scheduler_entry* const entry = le->data;
+        list_unlink(&entry->le);
+        enqueue(scheduler, entry);
+    }
+
+    // Schedule next round (if any entry is still pending)
+    if (!list_isempty(&scheduler->interactive) || !list_isempty(&scheduler->bulk)) {
+        tmr_start(&scheduler->timer, 0, output_scheduler_round_handler, scheduler);
+    }
+}
+
+static void output_scheduler_destroy(
+        void* arg
+) {
+    struct output_scheduler* const scheduler = arg;
+
+    // Stop running rounds
+    tmr_cancel(&scheduler->timer);
+}
+
+/*
+ * Create an output scheduler crediting `quantum` bytes per round.
+ */
+enum rawrtc_code output_scheduler_create(
+        struct output_scheduler** const schedulerp, // de-referenced
+        size_t const quantum,
+        uint32_t const interactive_window // in milliseconds
+) {
+    struct output_scheduler* scheduler;
+
+    // Check arguments
+    if (!schedulerp || quantum == 0 || quantum > INT64_MAX) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    scheduler = mem_zalloc(sizeof(*scheduler), output_scheduler_destroy);
+    if (!scheduler) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields
+    list_init(&scheduler->interactive);
+    list_init(&scheduler->bulk);
+    list_init(&scheduler->next);
+    tmr_init(&scheduler->timer);
+    scheduler->quantum = quantum;
+    scheduler->interactive_window = interactive_window;
+
+    // Set pointer & done
+    *schedulerp = scheduler;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Initialise an entry.
+ */
+void output_scheduler_entry_init(
+        struct output_scheduler_entry* const entry,
+        output_scheduler_service_handler* const service_handler,
+        void* const arg
+) {
+    memset(entry, 0, sizeof(*entry));
+    entry->service_handler = service_handler;
+    entry->arg = arg;
+}
+
+/*
+ * Queue an entry whose source has become readable (unless already
+ * queued).
+ */
+void output_scheduler_ready(
+        struct output_scheduler* const scheduler,
+        struct output_scheduler_entry* const entry
+) {
+    // Already queued?
+    if (entry->queued) {
+        return;
+    }
+
+    // Queue with a fresh deficit (the source has been drained before)
+    entry->deficit = 0;
+    enqueue(scheduler, entry);
+    entry->ready_time = get_monotonic_time_us();
+
+    // Run a round (unless one is already scheduled)
+    if (!tmr_isrunning(&scheduler->timer)) {
+        tmr_start(&scheduler->timer, 0, output_scheduler_round_handler, scheduler);
+    }
+}
+
+/*
+ * Remove an entry from its run queue (if queued).
+ */
+void output_scheduler_remove(
+        struct output_scheduler_entry* const entry
+) {
+    if (entry->queued) {
+        list_unlink(&entry->le);
+        entry->queued = false;
+    }
+}
+
+/*
+ * Note that the entry's owner received input, making it interactive
+ * for the duration of the interactive window.
+ */
+void output_scheduler_input(
+        struct output_scheduler_entry* const entry
+) {
+    entry->last_input = tmr_jiffies();
+}
+
+/*
+ * Print the scheduling delay statistics of an entry.
+ */
+int output_scheduler_entry_debug(
+        struct re_printf* const pf,
+        struct output_scheduler_entry const* const entry
+) {
+    struct latency_histogram const* const delays = &entry->delays;
+    int err = 0;
+
+    err |= re_hprintf(pf, "served %"PRIu64" times (%"PRIu64" while interactive)",
+                      delays->n, entry->n_interactive);
+    if (delays->n > 0) {
+        err |= re_hprintf(pf, ", scheduling delay: mean=%"PRIu64"us p50=%"PRIu64"us "
+                              "p99=%"PRIu64"us max=%"PRIu64"us",
+                          entry->total_delay / delays->n,
+                          latency_histogram_percentile(delays, 50.0),
+                          latency_histogram_percentile(delays, 99.0), delays->max);
+    }
+    return err;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <rawrtc.h>
+#include "latency.h"
+
+/*
+ * Read up to `budget` bytes of output and set `*consumedp` to the amount
+ * of bytes that have been read. Return whether more output is pending
+ * (i.e. the budget has been exhausted).
+ * Note: The entry may have been destroyed in case `false` is returned.
+ */
+typedef bool (output_scheduler_service_handler)(
+    size_t* const consumedp, // de-referenced
+    size_t const budget,
+    void* const arg
+);
+
+/*
+ * Source of output (e.g. a PTY) that is being served by the output
+ * scheduler. Embedded into the owner which must remove it before it is
+ * being destroyed.
+ */
+struct output_scheduler_entry {
+    struct le le;
+    output_scheduler_service_handler* service_handler;
+    void* arg;
+    bool queued;
+    int64_t deficit; // in bytes
+    uint64_t ready_time; // in microseconds, while queued
+    uint64_t last_input; // in milliseconds, 0: none
+    uint64_t last_delay; // of the most recent service, in microseconds
+    uint64_t n_interactive; // services while being interactive
+    uint64_t total_delay; // in microseconds
+    struct latency_histogram delays; // in microseconds
+};
+
+/*
+ * Serves readable sources of output of one event loop in deficit round
+ * robin fashion: Each round, every queued entry is credited the quantum
+ * and may read as many bytes as it has been credited. Entries that
+ * received input within the interactive window are served ahead of bulk
+ * entries. Rounds run on a zero timer, so other events are being handled
+ * in between.
+ * Note: Not thread-safe, each thread owns its own scheduler.
+ */
+struct output_scheduler {
+    struct list interactive; // run queue of entries with recent input
+    struct list bulk; // run queue of all other entries
+    struct list next; // entries served in the current round, queued again after it
+    struct tmr timer;
+    size_t quantum;
+    uint32_t interactive_window; // in milliseconds, 0: no prioritisation
+    uint64_t n_rounds;
+};
+
+/*
+ * Create an output scheduler crediting `quantum` bytes per round.
+ */
+enum rawrtc_code output_scheduler_create(
+    struct output_scheduler** const schedulerp, // de-referenced
+    size_t const quantum,
+    uint32_t const interactive_window // in milliseconds
+);
+
+/*
+ * Initialise an entry.
+ */
+void output_scheduler_entry_init(
+    struct output_scheduler_entry* const entry,
+    output_scheduler_service_handler* const service_handler,
+    void* const arg
+);
+
+/*
+ * Queue an entry whose source has become readable (unless already
+ * queued).
+ */
+void output_scheduler_ready(
+    struct output_scheduler* const scheduler,
+    struct output_scheduler_entry* const entry
+);
+
+/*
+ * Remove an entry from its run queue (if queued).
+ */
+void output_scheduler_remove(
+    struct output_scheduler_entry* const entry
+);
+
+/*
+ * Note that the entry's owner received input, making it interactive
+ * for the duration of the interactive window.
+ */
+void output_scheduler_input(
+    struct output_scheduler_entry* const entry
+);
+
+/*
+ * Print the scheduling delay statistics of an entry.
+ */
+int output_scheduler_entry_debug(
+    struct re_printf* const pf,
+    struct output_scheduler_entry const* const entry
+);
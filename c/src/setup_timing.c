@@ -0,0 +1,338 @@
+#include <string.h> // memset
+#include <unistd.h> // getpid, write, close
+#include <fcntl.h> // open, O_*
+#include <errno.h> // errno
+#include <time.h> // clock_gettime, CLOCK_REALTIME
+#include <sys/stat.h> // fstat
+#include <rawrtc.h>
+#include "helper/common.h"
+#include "helper/utils.h"
+#include "setup_timing.h"
+
+#define DEBUG_MODULE "rawrtc-terminal-setup-timing"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+enum {
+    SETUP_TIMING_RECORD_SIZE = 2048,
+};
+
+static char const* const phase_names[SETUP_PHASE_MAX] = {
+    "session_start",
+    "certificate_start",
+    "certificate_ready",
+    "gathering_start",
+    "first_local_candidate",
+    "gathering_complete",
+    "local_parameters_sent",
+    "remote_parameters_received",
+    "remote_candidates_complete",
+    "ice_checking",
+    "ice_connected",
+    "dtls_connecting",
+    "dtls_connected",
+    "sctp_connecting",
+    "sctp_connected",
+    "data_channel_open",
+    "first_output_sent",
+};
+
+/*
+ * Spans shown in the trace. Each span lasts from one phase to another.
+ */
+static struct {
+    char const* name;
+    enum setup_phase from;
+    enum setup_phase to;
+} const spans[] = {
+    {"certificate", SETUP_PHASE_CERTIFICATE_START, SETUP_PHASE_CERTIFICATE_READY},
+    {"gathering", SETUP_PHASE_GATHERING_START, SETUP_PHASE_GATHERING_COMPLETE},
+    {"signalling", SETUP_PHASE_LOCAL_PARAMETERS_SENT, SETUP_PHASE_REMOTE_PARAMETERS_RECEIVED},
+    {"ice checks", SETUP_PHASE_ICE_CHECKING, SETUP_PHASE_ICE_CONNECTED},
+    {"dtls handshake", SETUP_PHASE_DTLS_CONNECTING, SETUP_PHASE_DTLS_CONNECTED},
+    {"sctp association", SETUP_PHASE_SCTP_CONNECTING, SETUP_PHASE_SCTP_CONNECTED},
+    {"data channel", SETUP_PHASE_SCTP_CONNECTED, SETUP_PHASE_DATA_CHANNEL_OPEN},
+    {"first output", SETUP_PHASE_DATA_CHANNEL_OPEN, SETUP_PHASE_FIRST_OUTPUT_SENT},
+};
+
+/*
+ * Get the wall clock time in milliseconds since the epoch.
+ */
+static uint64_t get_wall_clock_time_ms(void) {
+    struct timespec now;
+    EOP(clock_gettime(CLOCK_REALTIME, &now));
+    return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+/*
+ * Open a file for appending records.
+ */
+static int open_append(
+        char const* const path
+) {
+    int const fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        EWE("Cannot open '%s': %m\n", path, errno);
+    }
+    return fd;
+}
+
+/*
+ * Write a record with a single call (so records of different threads
+ * don't interleave).
+ */
+static void write_record(
+        int const fd,
+        struct mbuf* const buffer
+) {
+    ssize_t const length = write(fd, buffer->buf, buffer->end);
+    if (length != (ssize_t) buffer->end) {
+        DEBUG_WARNING("Could not write setup timing record, reason: %m\n",
+                      length == -1 ? errno : EIO);
+    }
+}
+
+static void setup_timing_log_destroy(
+        void* arg
+) {
+    struct setup_timing_log* const log = arg;
+
+    // Close files
+    if (log->record_fd != -1) {
+        EOP(close(log->record_fd));
+    }
+    if (log->trace_fd != -1) {
+        EOP(close(log->trace_fd));
+    }
+}
+
+/*
+ * Open the setup timing record and trace files that have been
+ * configured. Return `RAWRTC_CODE_NO_VALUE` in case none have been
+ * configured.
+ */
+enum rawrtc_code setup_timing_log_open(
+        struct setup_timing_log** const logp, // de-referenced
+        struct terminal_options const* const options
+) {
+    struct setup_timing_log* log;
+    struct stat status;
+
+    // Check arguments
+    if (!logp || !options) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Configured?
+    if (options->setup_record_path[0] == '\0' && options->setup_trace_path[0] == '\0') {
+        return RAWRTC_CODE_NO_VALUE;
+    }
+
+    // Allocate
+    log = mem_zalloc(sizeof(*log), setup_timing_log_destroy);
+    if (!log) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+    log->record_fd = -1;
+    log->trace_fd = -1;
+
+    // Open record file
+    if (options->setup_record_path[0] != '\0') {
+        log->record_fd = open_append(options->setup_record_path);
+    }
+
+    // Open trace file (start the JSON array if new)
+    // Note: The trace event format allows omitting the closing bracket, so events of
+    //       subsequent runs can be appended.
+    if (options->setup_trace_path[0] != '\0') {
+        log->trace_fd = open_append(options->setup_trace_path);
+        EOP(fstat(log->trace_fd, &status));
+        if (status.st_size == 0) {
+            EOP(write(log->trace_fd, "[\n", 2));
+        }
+    }
+
+    // Set pointer & done
+    *logp = log;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Start timing the setup of a session.
+ */
+void setup_timing_start(
+        struct setup_timing* const timing,
+        uint32_t const id
+) {
+    memset(timing, 0, sizeof(*timing));
+    timing->id = id;
+    timing->wall_clock_start = get_wall_clock_time_ms();
+    timing->timestamps[SETUP_PHASE_SESSION_START] = get_monotonic_time_us();
+}
+
+/*
+ * Record the time a phase has been reached (unless already recorded).
+ */
+void setup_timing_mark(
+        struct setup_timing* const timing,
+        enum setup_phase const phase
+) {
+    if (timing->timestamps[phase] == 0) {
+        timing->timestamps[phase] = get_monotonic_time_us();
+    }
+}
+
+/*
+ * Encode the setup timing as a JSON line. Timestamps are relative to the
+ * start of the session.
+ */
+static int encode_record(
+        struct mbuf* const buffer,
+        struct setup_timing const* const timing,
+        char const* const session,
+        int32_t const worker,
+        bool const complete
+) {
+    uint64_t const start = timing->timestamps[SETUP_PHASE_SESSION_START];
+    bool first = true;
+    int err = 0;
+    size_t i;
+
+    err |= mbuf_printf(buffer, "{\"session\":\"%s\",", session);
+    if (worker >= 0) {
+        err |= mbuf_printf(buffer, "\"worker\":%"PRId32",", worker);
+    }
+    err |= mbuf_printf(buffer, "\"start_ms\":%"PRIu64",\"complete\":%s,\"phases_us\":{",
+                       timing->wall_clock_start, complete ? "true" : "false");
+    for (i = 0; i < SETUP_PHASE_MAX; ++i) {
+        if (timing->timestamps[i] == 0) {
+            continue;
+        }
+        err |= mbuf_printf(buffer, "%s\"%s\":%"PRIu64, first ? "" : ",",
+                           phase_names[i], timing->timestamps[i] - start);
+        first = false;
+    }
+    err |= mbuf_printf(buffer, "}}\n");
+    return err;
+}
+
+/*
+ * Encode the setup timing as Chrome trace events: One span per setup
+ * step and an instant event per phase. Each session is shown as a
+ * thread of its own.
+ */
+static int encode_trace(
+        struct mbuf* const buffer,
+        struct setup_timing const* const timing,
+        char const* const session
+) {
+    uint64_t const* const timestamps = timing->timestamps;
+    int const pid = getpid();
+    uint32_t const tid = timing->id;
+    int err = 0;
+    size_t i;
+
+    // Name the thread after the session
+    err |= mbuf_printf(
+            buffer, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%"PRIu32","
+            "\"args\":{\"name\":\"%s\"}},\n", pid, tid, session);
+
+    // Spans
+    for (i = 0; i < ARRAY_SIZE(spans); ++i) {
+        uint64_t const from = timestamps[spans[i].from];
+        uint64_t const to = timestamps[spans[i].to];
+        if (from == 0 || to < from) {
+            continue;
+        }
+        err |= mbuf_printf(
+                buffer, "{\"name\":\"%s\",\"cat\":\"setup\",\"ph\":\"X\",\"ts\":%"PRIu64","
+                "\"dur\":%"PRIu64",\"pid\":%d,\"tid\":%"PRIu32"},\n",
+                spans[i].name, from, to - from, pid, tid);
+    }
+
+    // Phases
+    for (i = 0; i < SETUP_PHASE_MAX; ++i) {
+        if (timestamps[i] == 0) {
+            continue;
+        }
+        err |= mbuf_printf(
+                buffer, "{\"name\":\"%s\",\"cat\":\"setup\",\"ph\":\"i\",\"s\":\"t\","
+                "\"ts\":%"PRIu64",\"pid\":%d,\"tid\":%"PRIu32"},\n",
+                phase_names[i], timestamps[i], pid, tid);
+    }
+    return err;
+}
+
+/*
+ * Emit the setup timing record (once). `worker` is -1 if the session
+ * does not run on a worker.
+ */
+void setup_timing_emit(
+        struct setup_timing_log* const log, // nullable
+        struct setup_timing* const timing,
+        char const* const session,
+        int32_t const worker,
+        bool const complete
+) {
+    struct mbuf* buffer;
+
+    // Already emitted?
+    if (timing->emitted) {
+        return;
+    }
+    timing->emitted = true;
+
+    // Print
+    DEBUG_INFO("(%s) Setup %s: %H", session, complete ? "complete" : "aborted",
+               setup_timing_debug, timing);
+
+    // Anything to write to?
+    if (!log) {
+        return;
+    }
+
+    // Allocate
+    buffer = mbuf_alloc(SETUP_TIMING_RECORD_SIZE);
+    if (!buffer) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+
+    // Write record
+    if (log->record_fd != -1) {
+        EOR(encode_record(buffer, timing, session, worker, complete));
+        write_record(log->record_fd, buffer);
+    }
+
+    // Write trace events
+    if (log->trace_fd != -1) {
+        mbuf_rewind(buffer);
+        EOR(encode_trace(buffer, timing, session));
+        write_record(log->trace_fd, buffer);
+    }
+
+    // Un-reference
+    mem_deref(buffer);
+}
+
+/*
+ * Print the setup phases that have been reached.
+ */
+int setup_timing_debug(
+        struct re_printf* const pf,
+        struct setup_timing const* const timing
+) {
+    uint64_t const start = timing->timestamps[SETUP_PHASE_SESSION_START];
+    int err = 0;
+    size_t i;
+
+    for (i = 1; i < SETUP_PHASE_MAX; ++i) {
+        if (timing->timestamps[i] == 0) {
+            continue;
+        }
+        err |= re_hprintf(pf, " %s=%"PRIu64"ms", phase_names[i],
+                          (timing->timestamps[i] - start) / 1000);
+    }
+    err |= re_hprintf(pf, "\n");
+    return err;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <rawrtc.h>
+#include "options.h"
+
+/*
+ * Phases of a session's connection setup in the order they usually
+ * occur.
+ */
+enum setup_phase {
+    SETUP_PHASE_SESSION_START,
+    SETUP_PHASE_CERTIFICATE_START,
+    SETUP_PHASE_CERTIFICATE_READY,
+    SETUP_PHASE_GATHERING_START,
+    SETUP_PHASE_FIRST_LOCAL_CANDIDATE,
+    SETUP_PHASE_GATHERING_COMPLETE,
+    SETUP_PHASE_LOCAL_PARAMETERS_SENT,
+    SETUP_PHASE_REMOTE_PARAMETERS_RECEIVED,
+    SETUP_PHASE_REMOTE_CANDIDATES_COMPLETE,
+    SETUP_PHASE_ICE_CHECKING,
+    SETUP_PHASE_ICE_CONNECTED,
+    SETUP_PHASE_DTLS_CONNECTING,
+    SETUP_PHASE_DTLS_CONNECTED,
+    SETUP_PHASE_SCTP_CONNECTING,
+    SETUP_PHASE_SCTP_CONNECTED,
+    SETUP_PHASE_DATA_CHANNEL_OPEN,
+    SETUP_PHASE_FIRST_OUTPUT_SENT,
+    SETUP_PHASE_MAX,
+};
+
+/*
+ * Monotonic timestamps (in microseconds) of a session's setup phases.
+ * A timestamp of 0 means that the phase has not been reached.
+ */
+struct setup_timing {
+    uint32_t id;
+    uint64_t wall_clock_start; // in milliseconds since the epoch
+    uint64_t timestamps[SETUP_PHASE_MAX];
+    bool emitted;
+};
+
+/*
+ * Destinations of setup timing records. Can be shared across threads
+ * as each record is written with a single `write` call.
+ */
+struct setup_timing_log {
+    int record_fd; // JSON lines, -1: disabled
+    int trace_fd; // Chrome trace events, -1: disabled
+};
+
+/*
+ * Open the setup timing record and trace files that have been
+ * configured. Return `RAWRTC_CODE_NO_VALUE` in case none have been
+ * configured.
+ */
+enum rawrtc_code setup_timing_log_open(
+    struct setup_timing_log** const logp, // de-referenced
+    struct terminal_options const* const options
+);
+
+/*
+ * Start timing the setup of a session.
+ */
+void setup_timing_start(
+    struct setup_timing* const timing,
+    uint32_t const id
+);
+
+/*
+ * Record the time a phase has been reached (unless already recorded).
+ */
+void setup_timing_mark(
+    struct setup_timing* const timing,
+    enum setup_phase const phase
+);
+
+/*
+ * Emit the setup timing record (once). `worker` is -1 if the session
+ * does not run on a worker.
+ */
+void setup_timing_emit(
+    struct setup_timing_log* const log, // nullable
+    struct setup_timing* const timing,
+    char const* const session,
+    int32_t const worker,
+    bool const complete
+);
+
+/*
+ * Print the setup phases that have been reached.
+ */
+int setup_timing_debug(
+    struct re_printf* const pf,
+    struct setup_timing const* const timing
+);
@@ -0,0 +1,260 @@
+#include <unistd.h> // close, execvp
+#include <fcntl.h> // fcntl, F_GETFD, F_SETFD, FD_CLOEXEC
+#include <signal.h> // SIGKILL, kill
+#include <stdlib.h> // setenv
+#include <sys/wait.h> // waitpid, WNOHANG
+#include <pty.h> // forkpty
+#include <rawrtc.h>
+#include "helper/common.h"
+#include "shell_pool.h"
+
+#define DEBUG_MODULE "rawrtc-terminal-shell-pool"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+enum {
+    SHELL_POOL_REFILL_DELAY = 10, // in milliseconds
+};
+
+/*
+ * Warm shell waiting to be adopted.
+ */
+struct warm_shell {
+    struct le le;
+    pid_t pid;
+    int pty;
+};
+
+static void warm_shell_destroy(
+        void* arg
+) {
+    struct warm_shell* const shell = arg;
+
+    // Remove from list
+    list_unlink(&shell->le);
+
+    // Close PTY & terminate process (if not adopted)
+    // Note: Warm shells have no state worth a graceful exit, so they are being killed and can be
+    //       reaped right away.
+    if (shell->pty != -1) {
+        EOP(close(shell->pty));
+    }
+    if (shell->pid != -1) {
+        EOP(kill(shell->pid, SIGKILL));
+        while (waitpid(shell->pid, NULL, 0) == -1) {
+            if (errno != EINTR) {
+                DEBUG_WARNING("Cannot reap warm shell (pid=%d): %m\n", shell->pid, errno);
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Start `shell` on a new pseudo-terminal.
+ */
+enum rawrtc_code shell_start(
+        pid_t* const pidp, // de-referenced
+        int* const ptyp, // de-referenced
+        char const* const shell
+) {
+    pid_t pid;
+    int pty;
+
+    // Check arguments
+    if (!pidp || !ptyp || !shell) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Fork to pseudo-terminal
+    // TODO: Check bounds (PID_MAX < INT_MAX...)
+    pid = (pid_t) forkpty(&pty, NULL, NULL, NULL);
+    if (pid == -1) {
+        return rawrtc_error_to_code(errno);
+    }
+
+    // Child process
+    if (pid == 0) {
+        char* const args[] = {(char*) shell, NULL};
+
+        // Make it colourful!
+        EOP(setenv("TERM", "xterm-256color", 1));
+
+        // Run terminal
+        EOP(execvp(args[0], args));
+        EWE("Child process returned!\n");
+    }
+
+    // Set pointers
+    *pidp = pid;
+    *ptyp = pty;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Start warm shells until the pool is full.
+ * Note: One shell per tick, so the event loop stays responsive.
+ */
+static void shell_pool_refill_handler(
+        void* arg
+) {
+    struct shell_pool* const pool = arg;
+    struct warm_shell* shell;
+
+    // Full?
+    if (list_count(&pool->shells) >= pool->capacity) {
+        return;
+    }
+
+    // Allocate
+    shell = mem_zalloc(sizeof(*shell), warm_shell_destroy);
+    if (!shell) {
+        EOE(RAWRTC_CODE_NO_MEMORY);
+        return;
+    }
+    shell->pid = -1;
+    shell->pty = -1;
+
+    // Start shell
+    EOE(shell_start(&shell->pid, &shell->pty, pool->shell));
+
+    // Don't leak the PTY into processes forked later on
+    EOP(fcntl(shell->pty, F_SETFD, fcntl(shell->pty, F_GETFD) | FD_CLOEXEC));
+
+    // Add to pool
+    list_append(&pool->shells, &shell->le, shell);
+    DEBUG_PRINTF("Started warm shell (pid=%d, %u/%"PRIu32")\n",
+                 shell->pid, list_count(&pool->shells), pool->capacity);
+
+    // Continue filling
+    tmr_start(&pool->refill_timer, SHELL_POOL_REFILL_DELAY, shell_pool_refill_handler, pool);
+}
+
+static void shell_pool_destroy(
+        void* arg
+) {
+    struct shell_pool* const pool = arg;
+
+    // Stop filling & terminate warm shells
+    tmr_cancel(&pool->refill_timer);
+    list_flush(&pool->shells);
+
+    // Un-reference
+    mem_deref(pool->shell);
+}
+
+/*
+ * Create a shell pool holding up to `capacity` warm instances of
+ * `shell`. The pool is being filled in the background.
+ */
+enum rawrtc_code shell_pool_create(
+        struct shell_pool** const poolp, // de-referenced
+        char const* const shell,
+        uint32_t const capacity
+) {
+    struct shell_pool* pool;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!poolp || !shell) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    pool = mem_zalloc(sizeof(*pool), shell_pool_destroy);
+    if (!pool) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields
+    error = rawrtc_sdprintf(&pool->shell, "%s", shell);
+    if (error) {
+        mem_deref(pool);
+        return error;
+    }
+    pool->capacity = capacity;
+    list_init(&pool->shells);
+    tmr_init(&pool->refill_timer);
+
+    // Start filling
+    tmr_start(&pool->refill_timer, 0, shell_pool_refill_handler, pool);
+
+    // Set pointer
+    *poolp = pool;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Take a warm shell from the pool. Return `RAWRTC_CODE_NO_VALUE` in
+ * case the pool is exhausted.
+ * The caller owns the process and its PTY.
+ */
+enum rawrtc_code shell_pool_take(
+        pid_t* const pidp, // de-referenced
+        int* const ptyp, // de-referenced
+        struct shell_pool* const pool
+) {
+    struct le* le;
+
+    // Check arguments
+    if (!pidp || !ptyp || !pool) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Refill in the background
+    tmr_start(&pool->refill_timer, SHELL_POOL_REFILL_DELAY, shell_pool_refill_handler, pool);
+
+    // Take the first shell that is still alive
+    while ((le = list_head(&pool->shells))) {
+        struct warm_shell* const shell = le->data;
+        pid_t const reaped = waitpid(shell->pid, NULL, WNOHANG);
+
+        // Died while waiting? (reaps the process)
+        if (reaped > 0) {
+            DEBUG_NOTICE("Warm shell (pid=%d) died, discarding\n", shell->pid);
+            ++pool->died;
+            shell->pid = -1;
+            mem_deref(shell);
+            continue;
+        }
+
+        // Cannot tell? (e.g. reaped elsewhere, so the process ID may have been reused already)
+        if (reaped == -1) {
+            DEBUG_WARNING("Cannot check warm shell (pid=%d), discarding: %m\n", shell->pid, errno);
+            ++pool->died;
+            shell->pid = -1;
+            mem_deref(shell);
+            continue;
+        }
+
+        // Hand over process & PTY
+        *pidp = shell->pid;
+        *ptyp = shell->pty;
+        shell->pid = -1;
+        shell->pty = -1;
+        mem_deref(shell);
+        ++pool->hits;
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Exhausted
+    ++pool->misses;
+    return RAWRTC_CODE_NO_VALUE;
+}
+
+/*
+ * Print shell pool statistics.
+ */
+int shell_pool_debug(
+        struct re_printf* const pf,
+        struct shell_pool const* const pool
+) {
+    if (!pool) {
+        return 0;
+    }
+
+    return re_hprintf(
+            pf, "shell pool: capacity=%"PRIu32", warm=%u, hits=%"PRIu64", misses=%"PRIu64""
+                ", died=%"PRIu64"",
+            pool->capacity, list_count(&pool->shells), pool->hits, pool->misses, pool->died);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <sys/types.h> // pid_t
+#include <rawrtc.h>
+
+/*
+ * Pool of warm shells: Processes that have already been started on a
+ * pseudo-terminal and wait to be adopted by a data channel. Adopted
+ * shells are replaced in the background.
+ *
+ * The PTYs of warm shells are not being read from, so any output the
+ * shell produces on startup (e.g. its prompt) stays buffered in the PTY
+ * until the shell has been adopted.
+ */
+struct shell_pool {
+    char* shell;
+    uint32_t capacity;
+    struct list shells;
+    struct tmr refill_timer;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t died;
+};
+
+/*
+ * Start `shell` on a new pseudo-terminal.
+ */
+enum rawrtc_code shell_start(
+    pid_t* const pidp, // de-referenced
+    int* const ptyp, // de-referenced
+    char const* const shell
+);
+
+/*
+ * Create a shell pool holding up to `capacity` warm instances of
+ * `shell`. The pool is being filled in the background.
+ */
+enum rawrtc_code shell_pool_create(
+    struct shell_pool** const poolp, // de-referenced
+    char const* const shell,
+    uint32_t const capacity
+);
+
+/*
+ * Take a warm shell from the pool. Return `RAWRTC_CODE_NO_VALUE` in
+ * case the pool is exhausted.
+ * The caller owns the process and its PTY.
+ */
+enum rawrtc_code shell_pool_take(
+    pid_t* const pidp, // de-referenced
+    int* const ptyp, // de-referenced
+    struct shell_pool* const pool
+);
+
+/*
+ * Print shell pool statistics.
+ */
+int shell_pool_debug(
+    struct re_printf* const pf,
+    struct shell_pool const* const pool
+);
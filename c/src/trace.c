@@ -0,0 +1,121 @@
+#include <rawrtc.h>
+#include "helper/common.h"
+#include "helper/utils.h"
+#include "trace.h"
+
+#define DEBUG_MODULE "rawrtc-terminal-trace"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+static char const* const event_names[TRACE_EVENT_MAX] = {
+    "input-received",
+    "input-written",
+    "input-queued",
+    "input-discarded",
+    "input-paused",
+    "input-resumed",
+    "control-received",
+    "output-read",
+    "output-sent",
+    "output-throttled",
+    "output-resumed",
+    "output-scheduled",
+};
+
+static void trace_ring_destroy(
+        void* arg
+) {
+    struct trace_ring* const ring = arg;
+
+    // Un-reference
+    mem_deref(ring->events);
+}
+
+/*
+ * Create a trace ring holding the most recent `capacity` events. The
+ * capacity is rounded up to a power of two.
+ */
+enum rawrtc_code trace_ring_create(
+        struct trace_ring** const ringp, // de-referenced
+        size_t const capacity
+) {
+    struct trace_ring* ring;
+    size_t size = 1;
+
+    // Check arguments
+    if (!ringp || capacity == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Round up capacity
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    // Allocate
+    ring = mem_zalloc(sizeof(*ring), trace_ring_destroy);
+    if (!ring) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+    ring->events = mem_zalloc(sizeof(*ring->events) * size, NULL);
+    if (!ring->events) {
+        mem_deref(ring);
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+    ring->mask = size - 1;
+
+    // Set pointer & done
+    *ringp = ring;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Record an event.
+ */
+void trace_ring_record(
+        struct trace_ring* const ring, // nullable
+        uint32_t const session,
+        enum trace_event_type const type,
+        uint64_t const value
+) {
+    struct trace_event* event;
+
+    // Enabled?
+    if (!ring) {
+        return;
+    }
+
+    // Overwrite oldest event
+    event = &ring->events[ring->n_events & ring->mask];
+    event->timestamp = get_monotonic_time_us();
+    event->session = session;
+    event->value = (uint32_t) MIN(value, UINT32_MAX);
+    event->type = (uint16_t) type;
+    ++ring->n_events;
+}
+
+/*
+ * Print the recorded events (oldest first).
+ */
+int trace_ring_debug(
+        struct re_printf* const pf,
+        struct trace_ring const* const ring
+) {
+    uint64_t const capacity = ring->mask + 1;
+    uint64_t const start = ring->n_events > capacity ? ring->n_events - capacity : 0;
+    uint64_t previous = 0;
+    int err = 0;
+    uint64_t i;
+
+    err |= re_hprintf(pf, "%"PRIu64" of %"PRIu64" events (delta in us):\n",
+                      ring->n_events - start, ring->n_events);
+    for (i = start; i < ring->n_events; ++i) {
+        struct trace_event const* const event = &ring->events[i & ring->mask];
+        err |= re_hprintf(pf, "  +%"PRIu64" S%"PRIu32" %s %"PRIu32"\n",
+                          previous ? event->timestamp - previous : 0, event->session,
+                          event->type < TRACE_EVENT_MAX ? event_names[event->type] : "?",
+                          event->value);
+        previous = event->timestamp;
+    }
+    return err;
+}
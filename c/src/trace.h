@@ -0,0 +1,84 @@
+#pragma once
+#include <rawrtc.h>
+
+/*
+ * Debug level of statements on the per-message hot path. Statements
+ * above this level are compiled out (but still type-checked).
+ * Set via the `HOT_PATH_DEBUG_LEVEL` CMake cache variable.
+ */
+#ifndef HOT_PATH_DEBUG_LEVEL
+#define HOT_PATH_DEBUG_LEVEL 0
+#endif
+
+#if (HOT_PATH_DEBUG_LEVEL >= 7)
+#define HOT_PATH_DEBUG_PRINTF(...) DEBUG_PRINTF(__VA_ARGS__)
+#else
+#define HOT_PATH_DEBUG_PRINTF(...) do { if (0) { DEBUG_PRINTF(__VA_ARGS__); } } while (0)
+#endif
+
+/*
+ * Per-message events recorded into the trace ring.
+ */
+enum trace_event_type {
+    TRACE_EVENT_INPUT_RECEIVED, // value: bytes
+    TRACE_EVENT_INPUT_WRITTEN, // value: bytes
+    TRACE_EVENT_INPUT_QUEUED, // value: bytes queued in total
+    TRACE_EVENT_INPUT_DISCARDED, // value: bytes
+    TRACE_EVENT_INPUT_PAUSED, // value: bytes queued in total
+    TRACE_EVENT_INPUT_RESUMED, // value: bytes queued in total
+    TRACE_EVENT_CONTROL_RECEIVED, // value: control message type
+    TRACE_EVENT_OUTPUT_READ, // value: bytes drained
+    TRACE_EVENT_OUTPUT_SENT, // value: bytes
+    TRACE_EVENT_OUTPUT_THROTTLED, // value: buffered amount
+    TRACE_EVENT_OUTPUT_RESUMED, // value: buffered amount
+    TRACE_EVENT_OUTPUT_SCHEDULED, // value: scheduling delay in microseconds
+    TRACE_EVENT_MAX,
+};
+
+/*
+ * Binary trace event.
+ */
+struct trace_event {
+    uint64_t timestamp; // monotonic, in microseconds
+    uint32_t session;
+    uint32_t value;
+    uint16_t type;
+};
+
+/*
+ * Fixed-size ring of the most recent trace events. Recording an event
+ * does not format anything, events are only decoded when being printed.
+ * Note: Not thread-safe, each thread owns its own ring.
+ */
+struct trace_ring {
+    struct trace_event* events;
+    size_t mask; // capacity - 1
+    uint64_t n_events; // recorded in total
+};
+
+/*
+ * Create a trace ring holding the most recent `capacity` events. The
+ * capacity is rounded up to a power of two.
+ */
+enum rawrtc_code trace_ring_create(
+    struct trace_ring** const ringp, // de-referenced
+    size_t const capacity
+);
+
+/*
+ * Record an event.
+ */
+void trace_ring_record(
+    struct trace_ring* const ring, // nullable
+    uint32_t const session,
+    enum trace_event_type const type,
+    uint64_t const value
+);
+
+/*
+ * Print the recorded events (oldest first).
+ */
+int trace_ring_debug(
+    struct re_printf* const pf,
+    struct trace_ring const* const ring
+);
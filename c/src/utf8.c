@@ -0,0 +1,471 @@
+#include <string.h> // memcpy
+#include <rawrtc.h>
+#include "utf8.h"
+
+// Vectorised validators (selected at runtime)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTF8_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Error bits of the vectorised validator. Each pair of adjacent bytes is
+ * classified by looking up the high nibble of the first byte, the low
+ * nibble of the first byte and the high nibble of the second byte. An
+ * error is present if a bit is set in all three lookups.
+ * See: Keiser, Lemire: "Validating UTF-8 In Less Than One Instruction
+ * Per Byte" (2021).
+ */
+enum {
+    UTF8_TOO_SHORT = 1 << 0, // lead byte not followed by a continuation
+    UTF8_TOO_LONG = 1 << 1, // ASCII followed by a continuation
+    UTF8_OVERLONG_3 = 1 << 2,
+    UTF8_TOO_LARGE = 1 << 3,
+    UTF8_SURROGATE = 1 << 4,
+    UTF8_OVERLONG_2 = 1 << 5,
+    UTF8_TOO_LARGE_1000 = 1 << 6,
+    UTF8_OVERLONG_4 = 1 << 6,
+    UTF8_TWO_CONTINUATIONS = 1 << 7, // unless part of a 3 or 4 byte character
+    UTF8_CARRY = UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTINUATIONS,
+};
+
+#define UTF8_BYTE_1_HIGH \
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, \
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, \
+    UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, \
+    UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, \
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2, \
+    UTF8_TOO_SHORT, \
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE, \
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+
+#define UTF8_BYTE_1_LOW \
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4, \
+    UTF8_CARRY | UTF8_OVERLONG_2, \
+    UTF8_CARRY, \
+    UTF8_CARRY, \
+    UTF8_CARRY | UTF8_TOO_LARGE, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+
+#define UTF8_BYTE_2_HIGH \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 \
+        | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 \
+        | UTF8_TOO_LARGE, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE \
+        | UTF8_TOO_LARGE, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE \
+        | UTF8_TOO_LARGE, \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+
+/*
+ * Get the length of the valid UTF-8 sequence at the beginning of `data`.
+ * Return 0 in case it is invalid (or truncated).
+ */
+static size_t utf8_sequence_length(
+        uint8_t const* const data,
+        size_t const left
+) {
+    uint8_t const lead = data[0];
+    uint8_t min = 0x80;
+    uint8_t max = 0xBF;
+    size_t length;
+    size_t i;
+
+    // Determine length & the range of the second byte
+    if (lead < 0x80) {
+        return 1;
+    } else if (lead < 0xC2) {
+        // Continuation or overlong
+        return 0;
+    } else if (lead < 0xE0) {
+        length = 2;
+    } else if (lead < 0xF0) {
+        length = 3;
+        if (lead == 0xE0) {
+            min = 0xA0; // overlong
+        } else if (lead == 0xED) {
+            max = 0x9F; // surrogate
+        }
+    } else if (lead < 0xF5) {
+        length = 4;
+        if (lead == 0xF0) {
+            min = 0x90; // overlong
+        } else if (lead == 0xF4) {
+            max = 0x8F; // above U+10FFFF
+        }
+    } else {
+        return 0;
+    }
+
+    // Check continuation bytes
+    if (left < length || data[1] < min || data[1] > max) {
+        return 0;
+    }
+    for (i = 2; i < length; ++i) {
+        if ((data[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+static bool utf8_validate_scalar(
+        uint8_t const* const data,
+        size_t const length
+) {
+    size_t i = 0;
+
+    while (i < length) {
+        size_t sequence_length;
+
+        // Skip ASCII, eight bytes at a time
+        if (length - i >= 8) {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            if ((word & UINT64_C(0x8080808080808080)) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+
+        // Check sequence
+        sequence_length = utf8_sequence_length(data + i, length - i);
+        if (sequence_length == 0) {
+            return false;
+        }
+        i += sequence_length;
+    }
+    return true;
+}
+
+#ifdef UTF8_X86
+__attribute__((target("ssse3")))
+static inline __m128i utf8_ssse3_high_nibbles(
+        __m128i const input
+) {
+    return _mm_and_si128(_mm_srli_epi16(input, 4), _mm_set1_epi8(0x0F));
+}
+
+/*
+ * Get the errors of a 16 byte block that follows `previous`.
+ */
+__attribute__((target("ssse3")))
+static inline __m128i utf8_ssse3_check_block(
+        __m128i const input,
+        __m128i const previous
+) {
+    __m128i const previous_1 = _mm_alignr_epi8(input, previous, 15);
+    __m128i const previous_2 = _mm_alignr_epi8(input, previous, 14);
+    __m128i const previous_3 = _mm_alignr_epi8(input, previous, 13);
+    __m128i special_cases;
+    __m128i must_be_continuation;
+
+    // Look up errors of each pair of bytes
+    special_cases = _mm_and_si128(
+            _mm_and_si128(
+                    _mm_shuffle_epi8(_mm_setr_epi8(UTF8_BYTE_1_HIGH),
+                                     utf8_ssse3_high_nibbles(previous_1)),
+                    _mm_shuffle_epi8(_mm_setr_epi8(UTF8_BYTE_1_LOW),
+                                     _mm_and_si128(previous_1, _mm_set1_epi8(0x0F)))),
+            _mm_shuffle_epi8(_mm_setr_epi8(UTF8_BYTE_2_HIGH), utf8_ssse3_high_nibbles(input)));
+
+    // Third and fourth bytes of a character are expected to be continuations
+    must_be_continuation = _mm_cmpgt_epi8(
+            _mm_or_si128(_mm_subs_epu8(previous_2, _mm_set1_epi8((char) (0xE0 - 1))),
+                         _mm_subs_epu8(previous_3, _mm_set1_epi8((char) (0xF0 - 1)))),
+            _mm_setzero_si128());
+    return _mm_xor_si128(
+            _mm_and_si128(must_be_continuation, _mm_set1_epi8((char) 0x80)), special_cases);
+}
+
+/*
+ * Get whether a block ends with an incomplete character (non-zero).
+ */
+__attribute__((target("ssse3")))
+static inline __m128i utf8_ssse3_incomplete(
+        __m128i const input
+) {
+    return _mm_subs_epu8(input, _mm_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            (char) (0xF0 - 1), (char) (0xE0 - 1), (char) (0xC0 - 1)));
+}
+
+__attribute__((target("ssse3")))
+static bool utf8_validate_ssse3(
+        uint8_t const* const data,
+        size_t const length
+) {
+    __m128i error = _mm_setzero_si128();
+    __m128i previous = _mm_setzero_si128();
+    __m128i previous_incomplete = _mm_setzero_si128();
+    uint8_t last[16] = {0};
+    size_t i;
+
+    for (i = 0; i < length; i += 16) {
+        __m128i input;
+
+        // Load block (the last one is padded with ASCII)
+        if (length - i >= 16) {
+            input = _mm_loadu_si128((__m128i const*) (data + i));
+        } else {
+            memcpy(last, data + i, length - i);
+            input = _mm_loadu_si128((__m128i const*) last);
+        }
+
+        // ASCII only? Only the previous block may be erroneous.
+        if (_mm_movemask_epi8(input) == 0) {
+            error = _mm_or_si128(error, previous_incomplete);
+        } else {
+            error = _mm_or_si128(error, utf8_ssse3_check_block(input, previous));
+            previous_incomplete = utf8_ssse3_incomplete(input);
+        }
+        previous = input;
+    }
+
+    // Note: A padded last block cannot be incomplete.
+    error = _mm_or_si128(error, previous_incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i utf8_avx2_high_nibbles(
+        __m256i const input
+) {
+    return _mm256_and_si256(_mm256_srli_epi16(input, 4), _mm256_set1_epi8(0x0F));
+}
+
+/*
+ * Get the errors of a 32 byte block that follows `previous`.
+ */
+__attribute__((target("avx2")))
+static inline __m256i utf8_avx2_check_block(
+        __m256i const input,
+        __m256i const previous
+) {
+    // Note: Shuffles and byte shifts work on 128 bit lanes only.
+    __m256i const carried = _mm256_permute2x128_si256(previous, input, 0x21);
+    __m256i const previous_1 = _mm256_alignr_epi8(input, carried, 15);
+    __m256i const previous_2 = _mm256_alignr_epi8(input, carried, 14);
+    __m256i const previous_3 = _mm256_alignr_epi8(input, carried, 13);
+    __m256i special_cases;
+    __m256i must_be_continuation;
+
+    // Look up errors of each pair of bytes
+    special_cases = _mm256_and_si256(
+            _mm256_and_si256(
+                    _mm256_shuffle_epi8(
+                            _mm256_setr_epi8(UTF8_BYTE_1_HIGH, UTF8_BYTE_1_HIGH),
+                            utf8_avx2_high_nibbles(previous_1)),
+                    _mm256_shuffle_epi8(
+                            _mm256_setr_epi8(UTF8_BYTE_1_LOW, UTF8_BYTE_1_LOW),
+                            _mm256_and_si256(previous_1, _mm256_set1_epi8(0x0F)))),
+            _mm256_shuffle_epi8(_mm256_setr_epi8(UTF8_BYTE_2_HIGH, UTF8_BYTE_2_HIGH),
+                                utf8_avx2_high_nibbles(input)));
+
+    // Third and fourth bytes of a character are expected to be continuations
+    must_be_continuation = _mm256_cmpgt_epi8(
+            _mm256_or_si256(
+                    _mm256_subs_epu8(previous_2, _mm256_set1_epi8((char) (0xE0 - 1))),
+                    _mm256_subs_epu8(previous_3, _mm256_set1_epi8((char) (0xF0 - 1)))),
+            _mm256_setzero_si256());
+    return _mm256_xor_si256(
+            _mm256_and_si256(must_be_continuation, _mm256_set1_epi8((char) 0x80)),
+            special_cases);
+}
+
+/*
+ * Get whether a block ends with an incomplete character (non-zero).
+ */
+__attribute__((target("avx2")))
+static inline __m256i utf8_avx2_incomplete(
+        __m256i const input
+) {
+    return _mm256_subs_epu8(input, _mm256_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            (char) (0xF0 - 1), (char) (0xE0 - 1), (char) (0xC0 - 1)));
+}
+
+__attribute__((target("avx2")))
+static bool utf8_validate_avx2(
+        uint8_t const* const data,
+        size_t const length
+) {
+    __m256i error = _mm256_setzero_si256();
+    __m256i previous = _mm256_setzero_si256();
+    __m256i previous_incomplete = _mm256_setzero_si256();
+    uint8_t last[32] = {0};
+    size_t i;
+
+    for (i = 0; i < length; i += 32) {
+        __m256i input;
+
+        // Load block (the last one is padded with ASCII)
+        if (length - i >= 32) {
+            input = _mm256_loadu_si256((__m256i const*) (data + i));
+        } else {
+            memcpy(last, data + i, length - i);
+            input = _mm256_loadu_si256((__m256i const*) last);
+        }
+
+        // ASCII only? Only the previous block may be erroneous.
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, previous_incomplete);
+        } else {
+            error = _mm256_or_si256(error, utf8_avx2_check_block(input, previous));
+            previous_incomplete = utf8_avx2_incomplete(input);
+        }
+        previous = input;
+    }
+
+    // Note: A padded last block cannot be incomplete.
+    error = _mm256_or_si256(error, previous_incomplete);
+    return _mm256_testz_si256(error, error) != 0;
+}
+#endif
+
+/*
+ * Return whether an implementation of the UTF-8 validator is supported by
+ * the CPU (and the compiler).
+ */
+bool utf8_validator_supported(
+        enum utf8_validator const validator
+) {
+    switch (validator) {
+        case UTF8_VALIDATOR_SCALAR:
+            return true;
+#ifdef UTF8_X86
+        case UTF8_VALIDATOR_SSSE3:
+            return __builtin_cpu_supports("ssse3");
+        case UTF8_VALIDATOR_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+/*
+ * Get the fastest implementation of the UTF-8 validator that is
+ * supported by the CPU.
+ */
+enum utf8_validator utf8_validator_best(void) {
+    if (utf8_validator_supported(UTF8_VALIDATOR_AVX2)) {
+        return UTF8_VALIDATOR_AVX2;
+    }
+    if (utf8_validator_supported(UTF8_VALIDATOR_SSSE3)) {
+        return UTF8_VALIDATOR_SSSE3;
+    }
+    return UTF8_VALIDATOR_SCALAR;
+}
+
+/*
+ * Get the name of an implementation of the UTF-8 validator.
+ */
+char const* utf8_validator_name(
+        enum utf8_validator const validator
+) {
+    switch (validator) {
+        case UTF8_VALIDATOR_SCALAR:
+            return "scalar";
+        case UTF8_VALIDATOR_SSSE3:
+            return "ssse3";
+        case UTF8_VALIDATOR_AVX2:
+            return "avx2";
+        default:
+            return "???";
+    }
+}
+
+/*
+ * Return whether `data` is valid UTF-8 (without a truncated character at
+ * the end) using a specific implementation that MUST be supported.
+ */
+bool utf8_validate(
+        enum utf8_validator const validator,
+        uint8_t const* const data,
+        size_t const length
+) {
+    switch (validator) {
+#ifdef UTF8_X86
+        case UTF8_VALIDATOR_SSSE3:
+            return utf8_validate_ssse3(data, length);
+        case UTF8_VALIDATOR_AVX2:
+            return utf8_validate_avx2(data, length);
+#endif
+        default:
+            return utf8_validate_scalar(data, length);
+    }
+}
+
+/*
+ * Return the amount of bytes at the end of `data` that form the beginning
+ * of a character that has not been completed, yet (0 to 3 bytes).
+ */
+size_t utf8_incomplete_length(
+        uint8_t const* const data,
+        size_t const length
+) {
+    size_t i;
+
+    // Find the last lead byte within the last three bytes
+    for (i = 1; i <= 3 && i <= length; ++i) {
+        uint8_t const byte = data[length - i];
+        size_t expected;
+
+        // Continuation
+        if ((byte & 0xC0) == 0x80) {
+            continue;
+        }
+
+        // Complete?
+        expected = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 1;
+        return expected > i ? i : 0;
+    }
+    return 0;
+}
+
+/*
+ * Replace each byte that is not part of a valid UTF-8 sequence with
+ * '?' (keeping the length). Return the amount of replaced bytes.
+ * Note: Valid data is being detected using the fastest validator, only
+ *       invalid data is being scanned byte by byte.
+ */
+size_t utf8_sanitize(
+        uint8_t* const data,
+        size_t const length
+) {
+    size_t replaced = 0;
+    size_t i = 0;
+
+    // Valid?
+    if (utf8_validate(utf8_validator_best(), data, length)) {
+        return 0;
+    }
+
+    // Replace invalid bytes
+    while (i < length) {
+        size_t const sequence_length = utf8_sequence_length(data + i, length - i);
+        if (sequence_length == 0) {
+            data[i] = '?';
+            ++replaced;
+            ++i;
+        } else {
+            i += sequence_length;
+        }
+    }
+    return replaced;
+}
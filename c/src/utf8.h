@@ -0,0 +1,62 @@
+#pragma once
+#include <rawrtc.h>
+
+/*
+ * Implementations of the UTF-8 validator.
+ */
+enum utf8_validator {
+    UTF8_VALIDATOR_SCALAR,
+    UTF8_VALIDATOR_SSSE3, // 16 bytes per step
+    UTF8_VALIDATOR_AVX2, // 32 bytes per step
+};
+
+/*
+ * Return whether an implementation of the UTF-8 validator is supported by
+ * the CPU (and the compiler).
+ */
+bool utf8_validator_supported(
+    enum utf8_validator const validator
+);
+
+/*
+ * Get the fastest implementation of the UTF-8 validator that is
+ * supported by the CPU.
+ */
+enum utf8_validator utf8_validator_best(void);
+
+/*
+ * Get the name of an implementation of the UTF-8 validator.
+ */
+char const* utf8_validator_name(
+    enum utf8_validator const validator
+);
+
+/*
+ * Return whether `data` is valid UTF-8 (without a truncated character at
+ * the end) using a specific implementation that MUST be supported.
+ */
+bool utf8_validate(
+    enum utf8_validator const validator,
+    uint8_t const* const data,
+    size_t const length
+);
+
+/*
+ * Return the amount of bytes at the end of `data` that form the beginning
+ * of a character that has not been completed, yet (0 to 3 bytes).
+ */
+size_t utf8_incomplete_length(
+    uint8_t const* const data,
+    size_t const length
+);
+
+/*
+ * Replace each byte that is not part of a valid UTF-8 sequence with
+ * '?' (keeping the length). Return the amount of replaced bytes.
+ * Note: Valid data is being detected using the fastest validator, only
+ *       invalid data is being scanned byte by byte.
+ */
+size_t utf8_sanitize(
+    uint8_t* const data,
+    size_t const length
+);
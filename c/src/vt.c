@@ -0,0 +1,1284 @@
+#include <string.h> // memcpy, memmove, memcmp
+#include <rawrtc.h>
+#include "vt.h"
+
+// Parser states
+enum {
+    VT_STATE_GROUND,
+    VT_STATE_ESCAPE,
+    VT_STATE_ESCAPE_DESIGNATE, // character set designation, consumes one byte
+    VT_STATE_CSI,
+    VT_STATE_STRING, // OSC, DCS, APC, PM and SOS, ignored until terminated
+    VT_STATE_STRING_ESCAPE,
+};
+
+enum {
+    VT_MAX_PARAMETER_VALUE = 65535,
+    VT_TAB_WIDTH = 8,
+};
+
+static uint32_t const default_modes = VT_MODE_AUTOWRAP | VT_MODE_CURSOR_VISIBLE;
+
+/*
+ * DEC private modes that are being tracked (and synchronised).
+ * Note: The alternate screen is handled separately.
+ */
+static struct {
+    uint16_t number;
+    uint32_t mode;
+} const private_modes[] = {
+    {1, VT_MODE_CURSOR_KEYS},
+    {6, VT_MODE_ORIGIN},
+    {7, VT_MODE_AUTOWRAP},
+    {9, VT_MODE_MOUSE_X10},
+    {25, VT_MODE_CURSOR_VISIBLE},
+    {1000, VT_MODE_MOUSE_NORMAL},
+    {1002, VT_MODE_MOUSE_BUTTON},
+    {1003, VT_MODE_MOUSE_ANY},
+    {1004, VT_MODE_FOCUS},
+    {1006, VT_MODE_MOUSE_SGR},
+    {2004, VT_MODE_BRACKETED_PASTE},
+};
+
+/*
+ * Get the amount of columns a character occupies.
+ * Note: This is a coarse approximation of `wcwidth` that does not depend
+ *       on the locale. It covers combining marks and the common wide
+ *       ranges (CJK, Hangul, full-width forms and emoji).
+ */
+static uint_fast8_t vt_character_width(
+        uint32_t const codepoint
+) {
+    // Combining marks & zero width characters
+    if ((codepoint >= 0x0300 && codepoint <= 0x036F)
+            || (codepoint >= 0x1AB0 && codepoint <= 0x1AFF)
+            || (codepoint >= 0x1DC0 && codepoint <= 0x1DFF)
+            || (codepoint >= 0x200B && codepoint <= 0x200F)
+            || (codepoint >= 0x20D0 && codepoint <= 0x20FF)
+            || (codepoint >= 0xFE00 && codepoint <= 0xFE0F)
+            || (codepoint >= 0xFE20 && codepoint <= 0xFE2F)) {
+        return 0;
+    }
+
+    // Wide characters
+    if ((codepoint >= 0x1100 && codepoint <= 0x115F)
+            || (codepoint >= 0x2E80 && codepoint <= 0x303E)
+            || (codepoint >= 0x3041 && codepoint <= 0x33FF)
+            || (codepoint >= 0x3400 && codepoint <= 0x4DBF)
+            || (codepoint >= 0x4E00 && codepoint <= 0x9FFF)
+            || (codepoint >= 0xA000 && codepoint <= 0xA4CF)
+            || (codepoint >= 0xAC00 && codepoint <= 0xD7A3)
+            || (codepoint >= 0xF900 && codepoint <= 0xFAFF)
+            || (codepoint >= 0xFE30 && codepoint <= 0xFE4F)
+            || (codepoint >= 0xFF00 && codepoint <= 0xFF60)
+            || (codepoint >= 0xFFE0 && codepoint <= 0xFFE6)
+            || (codepoint >= 0x1F300 && codepoint <= 0x1F64F)
+            || (codepoint >= 0x1F900 && codepoint <= 0x1F9FF)
+            || (codepoint >= 0x20000 && codepoint <= 0x3FFFD)) {
+        return 2;
+    }
+    return 1;
+}
+
+static struct vt_cell* vt_row(
+        struct vt_screen* const screen,
+        uint_fast16_t const row
+) {
+    return &screen->cells[row * screen->columns];
+}
+
+/*
+ * Get a blank cell that has the background of the current attributes.
+ */
+static struct vt_cell vt_erased_cell(
+        struct vt_screen const* const screen
+) {
+    struct vt_cell cell = {0};
+    cell.attributes.background = screen->pen.background;
+    return cell;
+}
+
+static void vt_erase(
+        struct vt_screen* const screen,
+        uint_fast16_t const row,
+        uint_fast16_t const start, // inclusive
+        uint_fast16_t const end // exclusive
+) {
+    struct vt_cell const cell = vt_erased_cell(screen);
+    struct vt_cell* const cells = vt_row(screen, row);
+    uint_fast16_t column;
+    for (column = start; column < end && column < screen->columns; ++column) {
+        cells[column] = cell;
+    }
+}
+
+static void vt_erase_rows(
+        struct vt_screen* const screen,
+        uint_fast16_t const start, // inclusive
+        uint_fast16_t const end // exclusive
+) {
+    uint_fast16_t row;
+    for (row = start; row < end && row < screen->rows; ++row) {
+        vt_erase(screen, row, 0, screen->columns);
+    }
+}
+
+/*
+ * Scroll the lines between `top` and the bottom of the scrolling region
+ * up by `n` lines.
+ */
+static void vt_scroll_up(
+        struct vt_screen* const screen,
+        uint_fast16_t const top,
+        uint_fast16_t n
+) {
+    uint_fast16_t const bottom = screen->scroll_bottom;
+    if (top > bottom) {
+        return;
+    }
+    n = MIN(n, bottom - top + 1);
+    memmove(vt_row(screen, top), vt_row(screen, top + n),
+            (bottom - top + 1 - n) * screen->columns * sizeof(struct vt_cell));
+    vt_erase_rows(screen, bottom + 1 - n, bottom + 1);
+}
+
+/*
+ * Scroll the lines between `top` and the bottom of the scrolling region
+ * down by `n` lines.
+ */
+static void vt_scroll_down(
+        struct vt_screen* const screen,
+        uint_fast16_t const top,
+        uint_fast16_t n
+) {
+    uint_fast16_t const bottom = screen->scroll_bottom;
+    if (top > bottom) {
+        return;
+    }
+    n = MIN(n, bottom - top + 1);
+    memmove(vt_row(screen, top + n), vt_row(screen, top),
+            (bottom - top + 1 - n) * screen->columns * sizeof(struct vt_cell));
+    vt_erase_rows(screen, top, top + n);
+}
+
+static void vt_move_cursor(
+        struct vt_screen* const screen,
+        int_fast32_t row,
+        int_fast32_t column
+) {
+    int_fast32_t top = 0;
+    int_fast32_t bottom = screen->rows - 1;
+
+    // Confine to scrolling region (if origin mode)
+    if (screen->modes & VT_MODE_ORIGIN) {
+        top = screen->scroll_top;
+        bottom = screen->scroll_bottom;
+    }
+
+    // Clamp
+    screen->cursor_row = (uint16_t) MAX(top, MIN(row, bottom));
+    screen->cursor_column = (uint16_t) MAX(0, MIN(column, screen->columns - 1));
+    screen->wrap_pending = false;
+}
+
+static void vt_line_feed(
+        struct vt_screen* const screen
+) {
+    if (screen->cursor_row == screen->scroll_bottom) {
+        vt_scroll_up(screen, screen->scroll_top, 1);
+    } else if (screen->cursor_row < screen->rows - 1) {
+        ++screen->cursor_row;
+    }
+    screen->wrap_pending = false;
+}
+
+static void vt_reverse_line_feed(
+        struct vt_screen* const screen
+) {
+    if (screen->cursor_row == screen->scroll_top) {
+        vt_scroll_down(screen, screen->scroll_top, 1);
+    } else if (screen->cursor_row > 0) {
+        --screen->cursor_row;
+    }
+    screen->wrap_pending = false;
+}
+
+static void vt_save_cursor(
+        struct vt_screen* const screen
+) {
+    screen->saved_row = screen->cursor_row;
+    screen->saved_column = screen->cursor_column;
+    screen->saved_pen = screen->pen;
+}
+
+static void vt_restore_cursor(
+        struct vt_screen* const screen
+) {
+    screen->pen = screen->saved_pen;
+    screen->cursor_row = MIN(screen->saved_row, screen->rows - 1);
+    screen->cursor_column = MIN(screen->saved_column, screen->columns - 1);
+    screen->wrap_pending = false;
+}
+
+static void vt_reset(
+        struct vt_screen* const screen
+) {
+    screen->main_cells = mem_deref(screen->main_cells);
+    memset(&screen->pen, 0, sizeof(screen->pen));
+    vt_erase_rows(screen, 0, screen->rows);
+    screen->cursor_row = 0;
+    screen->cursor_column = 0;
+    screen->wrap_pending = false;
+    screen->scroll_top = 0;
+    screen->scroll_bottom = screen->rows - 1;
+    screen->modes = default_modes;
+    vt_save_cursor(screen);
+}
+
+/*
+ * Clear the other half of a wide character that is about to be
+ * overwritten.
+ */
+static void vt_split_wide_character(
+        struct vt_screen* const screen,
+        uint_fast16_t const column
+) {
+    struct vt_cell* const cells = vt_row(screen, screen->cursor_row);
+    if (cells[column].codepoint == VT_WIDE_CONTINUATION && column > 0) {
+        cells[column - 1].codepoint = 0;
+    }
+    if (column + 1 < screen->columns && cells[column + 1].codepoint == VT_WIDE_CONTINUATION) {
+        cells[column + 1].codepoint = 0;
+    }
+}
+
+static void vt_print(
+        struct vt_screen* const screen,
+        uint32_t const codepoint
+) {
+    uint_fast8_t const width = vt_character_width(codepoint);
+    bool const autowrap = screen->modes & VT_MODE_AUTOWRAP;
+    struct vt_cell* cells;
+
+    // Combining marks are not being tracked
+    if (width == 0) {
+        return;
+    }
+
+    // Wrap (if pending or a wide character does not fit)
+    if (autowrap && (screen->wrap_pending
+            || (width == 2 && screen->cursor_column == screen->columns - 1))) {
+        screen->cursor_column = 0;
+        vt_line_feed(screen);
+    }
+    if (width == 2 && screen->cursor_column == screen->columns - 1) {
+        if (screen->columns < 2) {
+            return;
+        }
+        --screen->cursor_column;
+    }
+
+    // Put character
+    cells = vt_row(screen, screen->cursor_row);
+    vt_split_wide_character(screen, screen->cursor_column);
+    cells[screen->cursor_column].codepoint = codepoint;
+    cells[screen->cursor_column].attributes = screen->pen;
+    if (width == 2) {
+        vt_split_wide_character(screen, screen->cursor_column + 1);
+        cells[screen->cursor_column + 1].codepoint = VT_WIDE_CONTINUATION;
+        cells[screen->cursor_column + 1].attributes = screen->pen;
+    }
+
+    // Advance (the cursor stays on the last column until the next character wraps)
+    if (screen->cursor_column + width < screen->columns) {
+        screen->cursor_column += width;
+    } else {
+        screen->cursor_column = screen->columns - 1;
+        screen->wrap_pending = autowrap;
+    }
+}
+
+static void vt_execute(
+        struct vt_screen* const screen,
+        uint8_t const byte
+) {
+    switch (byte) {
+        case '\b':
+            if (screen->cursor_column > 0) {
+                --screen->cursor_column;
+            }
+            screen->wrap_pending = false;
+            break;
+        case '\t':
+            vt_move_cursor(screen, screen->cursor_row,
+                           (screen->cursor_column / VT_TAB_WIDTH + 1) * VT_TAB_WIDTH);
+            break;
+        case '\n':
+        case '\v':
+        case '\f':
+            vt_line_feed(screen);
+            break;
+        case '\r':
+            screen->cursor_column = 0;
+            screen->wrap_pending = false;
+            break;
+        default:
+            // Bell, shift in/out, ...
+            break;
+    }
+}
+
+/*
+ * Get a parameter or its default value (if omitted or zero).
+ */
+static uint32_t vt_parameter(
+        struct vt_screen const* const screen,
+        uint_fast8_t const index,
+        uint32_t const default_value
+) {
+    if (index >= screen->n_parameters || screen->parameters[index] == 0) {
+        return default_value;
+    }
+    return screen->parameters[index];
+}
+
+/*
+ * Parse an extended colour (`5;<index>` or `2;<r>;<g>;<b>`) starting at
+ * `*indexp` and advance the index past it.
+ */
+static uint32_t vt_extended_color(
+        struct vt_screen const* const screen,
+        uint_fast8_t* const indexp
+) {
+    uint_fast8_t const index = *indexp;
+    if (index + 1 < screen->n_parameters && screen->parameters[index] == 5) {
+        *indexp = index + 1;
+        return MIN(screen->parameters[index + 1], 255) + 1;
+    }
+    if (index + 3 < screen->n_parameters && screen->parameters[index] == 2) {
+        *indexp = index + 3;
+        return VT_COLOR_RGB | (MIN(screen->parameters[index + 1], 255) << 16)
+               | (MIN(screen->parameters[index + 2], 255) << 8)
+               | MIN(screen->parameters[index + 3], 255);
+    }
+    *indexp = screen->n_parameters;
+    return 0;
+}
+
+static void vt_select_graphic_rendition(
+        struct vt_screen* const screen
+) {
+    struct vt_attributes* const pen = &screen->pen;
+    uint_fast8_t i;
+
+    // No parameters: Reset
+    if (screen->n_parameters == 0) {
+        memset(pen, 0, sizeof(*pen));
+        return;
+    }
+
+    for (i = 0; i < screen->n_parameters; ++i) {
+        uint32_t const parameter = screen->parameters[i];
+        switch (parameter) {
+            case 0:
+                memset(pen, 0, sizeof(*pen));
+                break;
+            case 1:
+                pen->flags |= VT_ATTRIBUTE_BOLD;
+                break;
+            case 2:
+                pen->flags |= VT_ATTRIBUTE_DIM;
+                break;
+            case 3:
+                pen->flags |= VT_ATTRIBUTE_ITALIC;
+                break;
+            case 4:
+                pen->flags |= VT_ATTRIBUTE_UNDERLINE;
+                break;
+            case 5:
+                pen->flags |= VT_ATTRIBUTE_BLINK;
+                break;
+            case 7:
+                pen->flags |= VT_ATTRIBUTE_INVERSE;
+                break;
+            case 8:
+                pen->flags |= VT_ATTRIBUTE_HIDDEN;
+                break;
+            case 9:
+                pen->flags |= VT_ATTRIBUTE_STRIKETHROUGH;
+                break;
+            case 21:
+            case 22:
+                pen->flags &= ~(VT_ATTRIBUTE_BOLD | VT_ATTRIBUTE_DIM);
+                break;
+            case 23:
+                pen->flags &= ~VT_ATTRIBUTE_ITALIC;
+                break;
+            case 24:
+                pen->flags &= ~VT_ATTRIBUTE_UNDERLINE;
+                break;
+            case 25:
+                pen->flags &= ~VT_ATTRIBUTE_BLINK;
+                break;
+            case 27:
+                pen->flags &= ~VT_ATTRIBUTE_INVERSE;
+                break;
+            case 28:
+                pen->flags &= ~VT_ATTRIBUTE_HIDDEN;
+                break;
+            case 29:
+                pen->flags &= ~VT_ATTRIBUTE_STRIKETHROUGH;
+                break;
+            case 38:
+                ++i;
+                pen->foreground = vt_extended_color(screen, &i);
+                break;
+            case 39:
+                pen->foreground = 0;
+                break;
+            case 48:
+                ++i;
+                pen->background = vt_extended_color(screen, &i);
+                break;
+            case 49:
+                pen->background = 0;
+                break;
+            default:
+                if (parameter >= 30 && parameter <= 37) {
+                    pen->foreground = parameter - 30 + 1;
+                } else if (parameter >= 40 && parameter <= 47) {
+                    pen->background = parameter - 40 + 1;
+                } else if (parameter >= 90 && parameter <= 97) {
+                    pen->foreground = parameter - 90 + 8 + 1;
+                } else if (parameter >= 100 && parameter <= 107) {
+                    pen->background = parameter - 100 + 8 + 1;
+                }
+                break;
+        }
+    }
+}
+
+static void vt_set_alternate_screen(
+        struct vt_screen* const screen,
+        bool const enable,
+        bool const save_cursor
+) {
+    size_t const size = (size_t) screen->rows * screen->columns * sizeof(struct vt_cell);
+
+    if (enable && !(screen->modes & VT_MODE_ALTERNATE_SCREEN)) {
+        // Save main screen & clear
+        screen->main_cells = mem_alloc(size, NULL);
+        if (!screen->main_cells) {
+            return;
+        }
+        memcpy(screen->main_cells, screen->cells, size);
+        if (save_cursor) {
+            vt_save_cursor(screen);
+        }
+        vt_erase_rows(screen, 0, screen->rows);
+        screen->modes |= VT_MODE_ALTERNATE_SCREEN;
+    } else if (!enable && (screen->modes & VT_MODE_ALTERNATE_SCREEN)) {
+        // Restore main screen
+        if (screen->main_cells) {
+            memcpy(screen->cells, screen->main_cells, size);
+            screen->main_cells = mem_deref(screen->main_cells);
+        }
+        if (save_cursor) {
+            vt_restore_cursor(screen);
+        }
+        screen->modes &= ~VT_MODE_ALTERNATE_SCREEN;
+    }
+}
+
+static void vt_set_modes(
+        struct vt_screen* const screen,
+        bool const enable
+) {
+    uint_fast8_t i;
+    size_t j;
+
+    // Only DEC private modes are being tracked
+    if (screen->prefix != '?') {
+        return;
+    }
+
+    for (i = 0; i < screen->n_parameters; ++i) {
+        uint32_t const number = screen->parameters[i];
+        switch (number) {
+            case 47:
+            case 1047:
+                vt_set_alternate_screen(screen, enable, false);
+                break;
+            case 1049:
+                vt_set_alternate_screen(screen, enable, true);
+                break;
+            default:
+                for (j = 0; j < ARRAY_SIZE(private_modes); ++j) {
+                    if (private_modes[j].number == number) {
+                        if (enable) {
+                            screen->modes |= private_modes[j].mode;
+                        } else {
+                            screen->modes &= ~private_modes[j].mode;
+                        }
+                    }
+                }
+
+                // Origin mode homes the cursor
+                if (number == 6) {
+                    vt_move_cursor(screen, (screen->modes & VT_MODE_ORIGIN)
+                                           ? screen->scroll_top : 0, 0);
+                }
+                break;
+        }
+    }
+}
+
+static void vt_dispatch_csi(
+        struct vt_screen* const screen,
+        uint8_t const final
+) {
+    uint32_t const n = vt_parameter(screen, 0, 1);
+    int_fast32_t const row = screen->cursor_row;
+    int_fast32_t const column = screen->cursor_column;
+    int_fast32_t const origin = (screen->modes & VT_MODE_ORIGIN) ? screen->scroll_top : 0;
+    struct vt_cell* const cells = vt_row(screen, screen->cursor_row);
+    uint_fast16_t count;
+
+    // Sequences with intermediates (e.g. cursor style) do not affect the screen
+    if (screen->intermediate != '\0') {
+        return;
+    }
+
+    // Private sequences other than setting modes are ignored
+    if (screen->prefix != '\0' && final != 'h' && final != 'l') {
+        return;
+    }
+
+    switch (final) {
+        case '@':
+            // Insert blank characters
+            count = (uint_fast16_t) MIN(n, (uint32_t) (screen->columns - column));
+            memmove(&cells[column + count], &cells[column],
+                    (screen->columns - column - count) * sizeof(struct vt_cell));
+            vt_erase(screen, screen->cursor_row, column, column + count);
+            screen->wrap_pending = false;
+            break;
+        case 'A':
+            vt_move_cursor(screen, MAX(row - (int_fast32_t) n,
+                                       row >= screen->scroll_top ? screen->scroll_top : 0),
+                           column);
+            break;
+        case 'B':
+        case 'e':
+            vt_move_cursor(screen, MIN(row + (int_fast32_t) n,
+                                       row <= screen->scroll_bottom
+                                       ? screen->scroll_bottom : screen->rows - 1),
+                           column);
+            break;
+        case 'C':
+        case 'a':
+            vt_move_cursor(screen, row, column + (int_fast32_t) n);
+            break;
+        case 'D':
+            vt_move_cursor(screen, row, column - (int_fast32_t) n);
+            break;
+        case 'E':
+            vt_move_cursor(screen, row + (int_fast32_t) n, 0);
+            break;
+        case 'F':
+            vt_move_cursor(screen, row - (int_fast32_t) n, 0);
+            break;
+        case 'G':
+        case '`':
+            vt_move_cursor(screen, row, (int_fast32_t) n - 1);
+            break;
+        case 'H':
+        case 'f':
+            vt_move_cursor(screen, origin + (int_fast32_t) n - 1,
+                           (int_fast32_t) vt_parameter(screen, 1, 1) - 1);
+            break;
+        case 'd':
+            vt_move_cursor(screen, origin + (int_fast32_t) n - 1, column);
+            break;
+        case 'J':
+            // Erase in display
+            switch (vt_parameter(screen, 0, 0)) {
+                case 0:
+                    vt_erase(screen, screen->cursor_row, column, screen->columns);
+                    vt_erase_rows(screen, screen->cursor_row + 1, screen->rows);
+                    break;
+                case 1:
+                    vt_erase_rows(screen, 0, screen->cursor_row);
+                    vt_erase(screen, screen->cursor_row, 0, column + 1);
+                    break;
+                default:
+                    vt_erase_rows(screen, 0, screen->rows);
+                    break;
+            }
+            screen->wrap_pending = false;
+            break;
+        case 'K':
+            // Erase in line
+            switch (vt_parameter(screen, 0, 0)) {
+                case 0:
+                    vt_erase(screen, screen->cursor_row, column, screen->columns);
+                    break;
+                case 1:
+                    vt_erase(screen, screen->cursor_row, 0, column + 1);
+                    break;
+                default:
+                    vt_erase(screen, screen->cursor_row, 0, screen->columns);
+                    break;
+            }
+            screen->wrap_pending = false;
+            break;
+        case 'L':
+            // Insert lines
+            if (row >= screen->scroll_top && row <= screen->scroll_bottom) {
+                vt_scroll_down(screen, screen->cursor_row, n);
+                vt_move_cursor(screen, row, 0);
+            }
+            break;
+        case 'M':
+            // Delete lines
+            if (row >= screen->scroll_top && row <= screen->scroll_bottom) {
+                vt_scroll_up(screen, screen->cursor_row, n);
+                vt_move_cursor(screen, row, 0);
+            }
+            break;
+        case 'P':
+            // Delete characters
+            count = (uint_fast16_t) MIN(n, (uint32_t) (screen->columns - column));
+            memmove(&cells[column], &cells[column + count],
+                    (screen->columns - column - count) * sizeof(struct vt_cell));
+            vt_erase(screen, screen->cursor_row, screen->columns - count, screen->columns);
+            screen->wrap_pending = false;
+            break;
+        case 'S':
+            vt_scroll_up(screen, screen->scroll_top, n);
+            break;
+        case 'T':
+            vt_scroll_down(screen, screen->scroll_top, n);
+            break;
+        case 'X':
+            // Erase characters
+            vt_erase(screen, screen->cursor_row, column, column + n);
+            screen->wrap_pending = false;
+            break;
+        case 'h':
+            vt_set_modes(screen, true);
+            break;
+        case 'l':
+            vt_set_modes(screen, false);
+            break;
+        case 'm':
+            vt_select_graphic_rendition(screen);
+            break;
+        case 'r': {
+            // Set scrolling region
+            uint32_t const top = vt_parameter(screen, 0, 1) - 1;
+            uint32_t const bottom = vt_parameter(screen, 1, screen->rows) - 1;
+            if (top < bottom && bottom < screen->rows) {
+                screen->scroll_top = (uint16_t) top;
+                screen->scroll_bottom = (uint16_t) bottom;
+                vt_move_cursor(screen, (screen->modes & VT_MODE_ORIGIN) ? top : 0, 0);
+            }
+            break;
+        }
+        case 's':
+            vt_save_cursor(screen);
+            break;
+        case 'u':
+            vt_restore_cursor(screen);
+            break;
+        default:
+            // Reports, tab stops, ...
+            break;
+    }
+}
+
+static void vt_dispatch_escape(
+        struct vt_screen* const screen,
+        uint8_t const final
+) {
+    switch (final) {
+        case '7':
+            vt_save_cursor(screen);
+            break;
+        case '8':
+            vt_restore_cursor(screen);
+            break;
+        case 'D':
+            vt_line_feed(screen);
+            break;
+        case 'E':
+            screen->cursor_column = 0;
+            vt_line_feed(screen);
+            break;
+        case 'M':
+            vt_reverse_line_feed(screen);
+            break;
+        case 'c':
+            vt_reset(screen);
+            break;
+        case '=':
+            screen->modes |= VT_MODE_KEYPAD;
+            break;
+        case '>':
+            screen->modes &= ~VT_MODE_KEYPAD;
+            break;
+        default:
+            break;
+    }
+}
+
+static void vt_feed_escape(
+        struct vt_screen* const screen,
+        uint8_t const byte
+) {
+    switch (byte) {
+        case '[':
+            screen->state = VT_STATE_CSI;
+            screen->n_parameters = 0;
+            screen->prefix = '\0';
+            screen->intermediate = '\0';
+            break;
+        case ']':
+        case 'P':
+        case 'X':
+        case '^':
+        case '_':
+            screen->state = VT_STATE_STRING;
+            break;
+        case '(':
+        case ')':
+        case '*':
+        case '+':
+        case '#':
+        case '%':
+        case ' ':
+            screen->state = VT_STATE_ESCAPE_DESIGNATE;
+            break;
+        default:
+            vt_dispatch_escape(screen, byte);
+            screen->state = VT_STATE_GROUND;
+            break;
+    }
+}
+
+static void vt_feed_csi(
+        struct vt_screen* const screen,
+        uint8_t const byte
+) {
+    if (byte >= '0' && byte <= '9') {
+        // Digit
+        uint32_t* parameter;
+        if (screen->n_parameters == 0) {
+            screen->n_parameters = 1;
+            screen->parameters[0] = 0;
+        }
+        parameter = &screen->parameters[screen->n_parameters - 1];
+        *parameter = MIN(*parameter * 10 + (byte - '0'), VT_MAX_PARAMETER_VALUE);
+    } else if (byte == ';' || byte == ':') {
+        // Separator (sub-parameters are treated like parameters)
+        if (screen->n_parameters == 0) {
+            screen->n_parameters = 1;
+            screen->parameters[0] = 0;
+        }
+        if (screen->n_parameters < VT_MAX_PARAMETERS) {
+            screen->parameters[screen->n_parameters++] = 0;
+        }
+    } else if (byte >= '<' && byte <= '?') {
+        // Private marker
+        screen->prefix = (char) byte;
+    } else if (byte >= 0x20 && byte <= 0x2F) {
+        // Intermediate
+        screen->intermediate = (char) byte;
+    } else if (byte >= 0x40 && byte <= 0x7E) {
+        // Final
+        vt_dispatch_csi(screen, byte);
+        screen->state = VT_STATE_GROUND;
+    } else {
+        // Invalid
+        screen->state = VT_STATE_GROUND;
+    }
+}
+
+/*
+ * Decode UTF-8 and print the resulting character (if complete).
+ */
+static void vt_feed_utf8(
+        struct vt_screen* const screen,
+        uint8_t const byte
+) {
+    // Continuation
+    if ((byte & 0xC0) == 0x80) {
+        if (screen->utf8_remaining == 0) {
+            vt_print(screen, 0xFFFD);
+            return;
+        }
+        screen->codepoint = (screen->codepoint << 6) | (byte & 0x3F);
+        if (--screen->utf8_remaining == 0) {
+            // C1 controls are ignored
+            if (screen->codepoint >= 0xA0) {
+                vt_print(screen, screen->codepoint);
+            }
+        }
+        return;
+    }
+
+    // Interrupted sequence
+    if (screen->utf8_remaining > 0) {
+        screen->utf8_remaining = 0;
+        vt_print(screen, 0xFFFD);
+    }
+
+    // Start of a sequence
+    if ((byte & 0xE0) == 0xC0) {
+        screen->codepoint = byte & 0x1F;
+        screen->utf8_remaining = 1;
+    } else if ((byte & 0xF0) == 0xE0) {
+        screen->codepoint = byte & 0x0F;
+        screen->utf8_remaining = 2;
+    } else if ((byte & 0xF8) == 0xF0) {
+        screen->codepoint = byte & 0x07;
+        screen->utf8_remaining = 3;
+    } else {
+        vt_print(screen, 0xFFFD);
+    }
+}
+
+/*
+ * Feed output of the process into the screen.
+ */
+void vt_screen_write(
+        struct vt_screen* const screen,
+        uint8_t const* const data,
+        size_t const length
+) {
+    size_t i;
+
+    for (i = 0; i < length; ++i) {
+        uint8_t const byte = data[i];
+
+        // Strings are terminated by BEL or ST (ESC \)
+        if (screen->state == VT_STATE_STRING) {
+            if (byte == 0x07) {
+                screen->state = VT_STATE_GROUND;
+            } else if (byte == 0x1B) {
+                screen->state = VT_STATE_STRING_ESCAPE;
+            }
+            continue;
+        }
+        if (screen->state == VT_STATE_STRING_ESCAPE) {
+            screen->state = byte == '\\' ? VT_STATE_GROUND : VT_STATE_STRING;
+            continue;
+        }
+
+        // Escape & cancel abort any sequence
+        if (byte == 0x1B) {
+            screen->state = VT_STATE_ESCAPE;
+            screen->utf8_remaining = 0;
+            continue;
+        }
+        if (byte == 0x18 || byte == 0x1A) {
+            screen->state = VT_STATE_GROUND;
+            continue;
+        }
+
+        // Control characters are executed within sequences, too
+        if (byte < 0x20 || byte == 0x7F) {
+            vt_execute(screen, byte);
+            continue;
+        }
+
+        switch (screen->state) {
+            case VT_STATE_ESCAPE:
+                vt_feed_escape(screen, byte);
+                break;
+            case VT_STATE_ESCAPE_DESIGNATE:
+                screen->state = VT_STATE_GROUND;
+                break;
+            case VT_STATE_CSI:
+                vt_feed_csi(screen, byte);
+                break;
+            default:
+                if (byte < 0x80 && screen->utf8_remaining == 0) {
+                    vt_print(screen, byte);
+                } else {
+                    vt_feed_utf8(screen, byte);
+                }
+                break;
+        }
+    }
+}
+
+/*
+ * Return whether the parser is outside of any control sequence or
+ * character (i.e. whether output can be cut off at this point).
+ */
+bool vt_screen_idle(
+        struct vt_screen const* const screen
+) {
+    return screen->state == VT_STATE_GROUND && screen->utf8_remaining == 0;
+}
+
+static void vt_screen_destroy(
+        void* arg
+) {
+    struct vt_screen* const screen = arg;
+
+    // Un-reference
+    mem_deref(screen->main_cells);
+    mem_deref(screen->cells);
+}
+
+/*
+ * Create a blank screen.
+ */
+enum rawrtc_code vt_screen_create(
+        struct vt_screen** const screenp, // de-referenced
+        uint16_t const columns,
+        uint16_t const rows
+) {
+    struct vt_screen* screen;
+
+    // Check arguments
+    if (!screenp || columns == 0 || rows == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    screen = mem_zalloc(sizeof(*screen), vt_screen_destroy);
+    if (!screen) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+    screen->cells = mem_zalloc((size_t) rows * columns * sizeof(struct vt_cell), NULL);
+    if (!screen->cells) {
+        mem_deref(screen);
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields
+    screen->columns = columns;
+    screen->rows = rows;
+    vt_reset(screen);
+
+    // Set pointer & done
+    *screenp = screen;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Resize the screen. Lines above the cursor are dropped in case it would
+ * end up below the bottom line.
+ */
+enum rawrtc_code vt_screen_resize(
+        struct vt_screen* const screen,
+        uint16_t const columns,
+        uint16_t const rows
+) {
+    struct vt_cell* cells;
+    uint_fast16_t const shift =
+            screen->cursor_row >= rows ? (uint_fast16_t) (screen->cursor_row + 1 - rows) : 0;
+    uint_fast16_t row;
+
+    // Check arguments
+    if (columns == 0 || rows == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Unchanged?
+    if (columns == screen->columns && rows == screen->rows) {
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Copy the remaining cells
+    cells = mem_zalloc((size_t) rows * columns * sizeof(struct vt_cell), NULL);
+    if (!cells) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+    for (row = 0; row < rows && row + shift < screen->rows; ++row) {
+        memcpy(&cells[row * columns], vt_row(screen, row + shift),
+               MIN(columns, screen->columns) * sizeof(struct vt_cell));
+    }
+
+    // Apply
+    // Note: The saved main screen is dropped, it will be blank once the alternate screen
+    //       is left.
+    mem_deref(screen->cells);
+    screen->cells = cells;
+    screen->main_cells = mem_deref(screen->main_cells);
+    screen->columns = columns;
+    screen->rows = rows;
+    screen->scroll_top = 0;
+    screen->scroll_bottom = rows - 1;
+    screen->cursor_row = (uint16_t) MIN(screen->cursor_row - shift, rows - 1);
+    screen->cursor_column = MIN(screen->cursor_column, columns - 1);
+    screen->saved_row = MIN(screen->saved_row, rows - 1);
+    screen->saved_column = MIN(screen->saved_column, columns - 1);
+    screen->wrap_pending = false;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Copy the screen state (excluding the parser state) into `*copyp`.
+ * An existing copy of the same size will be reused.
+ */
+enum rawrtc_code vt_screen_copy(
+        struct vt_screen** const copyp, // de-referenced, nullable
+        struct vt_screen const* const screen
+) {
+    struct vt_screen* copy;
+    struct vt_cell* cells;
+
+    // Check arguments
+    if (!copyp || !screen) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+    copy = *copyp;
+
+    // Create copy (if none or the size differs)
+    if (!copy || copy->columns != screen->columns || copy->rows != screen->rows) {
+        enum rawrtc_code const error = vt_screen_create(&copy, screen->columns, screen->rows);
+        if (error) {
+            return error;
+        }
+        mem_deref(*copyp);
+        *copyp = copy;
+    }
+
+    // Copy state (but keep the copy's cells)
+    // Note: The saved main screen is not needed for repainting.
+    cells = copy->cells;
+    copy->main_cells = mem_deref(copy->main_cells);
+    *copy = *screen;
+    copy->cells = cells;
+    copy->main_cells = NULL;
+    memcpy(copy->cells, screen->cells,
+           (size_t) screen->rows * screen->columns * sizeof(struct vt_cell));
+    return RAWRTC_CODE_SUCCESS;
+}
+
+static bool vt_cell_equal(
+        struct vt_cell const* const a,
+        struct vt_cell const* const b
+) {
+    return a->codepoint == b->codepoint
+           && a->attributes.foreground == b->attributes.foreground
+           && a->attributes.background == b->attributes.background
+           && a->attributes.flags == b->attributes.flags;
+}
+
+static bool vt_attributes_equal(
+        struct vt_attributes const* const a,
+        struct vt_attributes const* const b
+) {
+    return a->foreground == b->foreground && a->background == b->background
+           && a->flags == b->flags;
+}
+
+static bool vt_cell_blank(
+        struct vt_cell const* const cell
+) {
+    return (cell->codepoint == 0 || cell->codepoint == ' ')
+           && cell->attributes.foreground == 0 && cell->attributes.background == 0
+           && cell->attributes.flags == 0;
+}
+
+static int vt_write_color(
+        struct mbuf* const buffer,
+        uint32_t const color,
+        unsigned const base, // 30 or 40
+        unsigned const bright_base // 90 or 100
+) {
+    if (color == 0) {
+        return 0;
+    }
+    if (color & VT_COLOR_RGB) {
+        return mbuf_printf(buffer, ";%u;2;%u;%u;%u", base + 8, (color >> 16) & 0xFF,
+                           (color >> 8) & 0xFF, color & 0xFF);
+    }
+    if (color <= 8) {
+        return mbuf_printf(buffer, ";%u", base + color - 1);
+    }
+    if (color <= 16) {
+        return mbuf_printf(buffer, ";%u", bright_base + color - 9);
+    }
+    return mbuf_printf(buffer, ";%u;5;%u", base + 8, color - 1);
+}
+
+static int vt_write_attributes(
+        struct mbuf* const buffer,
+        struct vt_attributes const* const attributes
+) {
+    static uint8_t const codes[] = {1, 2, 3, 4, 5, 7, 8, 9}; // in order of VT_ATTRIBUTE_*
+    int err = mbuf_write_str(buffer, "\x1b[0");
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(codes); ++i) {
+        if (attributes->flags & (1 << i)) {
+            err |= mbuf_printf(buffer, ";%u", codes[i]);
+        }
+    }
+    err |= vt_write_color(buffer, attributes->foreground, 30, 90);
+    err |= vt_write_color(buffer, attributes->background, 40, 100);
+    err |= mbuf_write_u8(buffer, 'm');
+    return err;
+}
+
+static int vt_write_codepoint(
+        struct mbuf* const buffer,
+        uint32_t const codepoint
+) {
+    if (codepoint < 0x80) {
+        return mbuf_write_u8(buffer, (uint8_t) codepoint);
+    } else if (codepoint < 0x800) {
+        return mbuf_write_u8(buffer, (uint8_t) (0xC0 | (codepoint >> 6)))
+               | mbuf_write_u8(buffer, (uint8_t) (0x80 | (codepoint & 0x3F)));
+    } else if (codepoint < 0x10000) {
+        return mbuf_write_u8(buffer, (uint8_t) (0xE0 | (codepoint >> 12)))
+               | mbuf_write_u8(buffer, (uint8_t) (0x80 | ((codepoint >> 6) & 0x3F)))
+               | mbuf_write_u8(buffer, (uint8_t) (0x80 | (codepoint & 0x3F)));
+    } else {
+        return mbuf_write_u8(buffer, (uint8_t) (0xF0 | (codepoint >> 18)))
+               | mbuf_write_u8(buffer, (uint8_t) (0x80 | ((codepoint >> 12) & 0x3F)))
+               | mbuf_write_u8(buffer, (uint8_t) (0x80 | ((codepoint >> 6) & 0x3F)))
+               | mbuf_write_u8(buffer, (uint8_t) (0x80 | (codepoint & 0x3F)));
+    }
+}
+
+/*
+ * Repaint a line from the first cell that differs.
+ */
+static int vt_write_row(
+        struct mbuf* const buffer,
+        struct vt_attributes* const pen, // in/out, attributes of the remote terminal
+        struct vt_cell const* const from, // nullable, blank if NULL
+        struct vt_cell const* const to,
+        uint_fast16_t const row,
+        uint_fast16_t const columns
+) {
+    struct vt_attributes const default_attributes = {0};
+    uint_fast16_t start = 0;
+    uint_fast16_t end = columns;
+    uint_fast16_t column;
+    int err = 0;
+
+    // Find first cell that differs
+    if (from) {
+        while (start < columns && vt_cell_equal(&from[start], &to[start])) {
+            ++start;
+        }
+        if (start == columns) {
+            return 0;
+        }
+    }
+    if (start > 0 && to[start].codepoint == VT_WIDE_CONTINUATION) {
+        --start;
+    }
+
+    // Trailing blank cells will be erased
+    while (end > start && vt_cell_blank(&to[end - 1])) {
+        --end;
+    }
+    if (!from && end == 0) {
+        return 0;
+    }
+
+    // Move cursor & write cells
+    err |= mbuf_printf(buffer, "\x1b[%u;%uH", (unsigned) row + 1, (unsigned) start + 1);
+    for (column = start; column < end; ++column) {
+        struct vt_cell const* const cell = &to[column];
+        if (cell->codepoint == VT_WIDE_CONTINUATION) {
+            continue;
+        }
+        if (!vt_attributes_equal(pen, &cell->attributes)) {
+            err |= vt_write_attributes(buffer, &cell->attributes);
+            *pen = cell->attributes;
+        }
+        err |= vt_write_codepoint(buffer, cell->codepoint ? cell->codepoint : ' ');
+    }
+
+    // Erase the rest of the line (with the default background)
+    if (end < columns) {
+        if (!vt_attributes_equal(pen, &default_attributes)) {
+            err |= mbuf_write_str(buffer, "\x1b[0m");
+            *pen = default_attributes;
+        }
+        if (end > start) {
+            err |= mbuf_printf(buffer, "\x1b[%u;%uH", (unsigned) row + 1, (unsigned) end + 1);
+        }
+        err |= mbuf_write_str(buffer, "\x1b[K");
+    }
+    return err;
+}
+
+/*
+ * Append control sequences that turn a terminal displaying `from` into
+ * displaying `to`. Only lines that differ are being repainted (or all of
+ * them in case the size or the active screen differ).
+ */
+enum rawrtc_code vt_screen_diff(
+        struct mbuf* const buffer,
+        struct vt_screen const* const from,
+        struct vt_screen const* const to
+) {
+    bool const repaint = from->columns != to->columns || from->rows != to->rows
+            || ((from->modes ^ to->modes) & VT_MODE_ALTERNATE_SCREEN);
+    struct vt_attributes pen = {0};
+    uint_fast16_t row;
+    size_t i;
+    int err;
+
+    // Check arguments
+    if (!buffer || !from || !to) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Abort a sequence the remote terminal may have been left in (CAN), hide cursor while
+    // repainting & reset attributes and scrolling region
+    err = mbuf_write_str(buffer, "\x18\x1b[?25l\x1b[0m\x1b[r");
+
+    // Switch screen & clear (if repainting everything)
+    if (repaint) {
+        if ((from->modes ^ to->modes) & VT_MODE_ALTERNATE_SCREEN) {
+            err |= mbuf_printf(buffer, "\x1b[?1049%c",
+                               (to->modes & VT_MODE_ALTERNATE_SCREEN) ? 'h' : 'l');
+        }
+        err |= mbuf_write_str(buffer, "\x1b[H\x1b[2J");
+    }
+
+    // Repaint lines that differ
+    for (row = 0; row < to->rows; ++row) {
+        err |= vt_write_row(buffer, &pen, repaint ? NULL : &from->cells[row * from->columns],
+                            &to->cells[row * to->columns], row, to->columns);
+    }
+
+    // Apply modes
+    for (i = 0; i < ARRAY_SIZE(private_modes); ++i) {
+        uint32_t const mode = private_modes[i].mode;
+        if (mode != VT_MODE_CURSOR_VISIBLE && ((from->modes ^ to->modes) & mode)) {
+            err |= mbuf_printf(buffer, "\x1b[?%u%c", (unsigned) private_modes[i].number,
+                               (to->modes & mode) ? 'h' : 'l');
+        }
+    }
+    if ((from->modes ^ to->modes) & VT_MODE_KEYPAD) {
+        err |= mbuf_write_str(buffer, (to->modes & VT_MODE_KEYPAD) ? "\x1b=" : "\x1b>");
+    }
+
+    // Restore scrolling region, cursor, attributes & cursor visibility
+    if (to->scroll_top != 0 || to->scroll_bottom != to->rows - 1) {
+        err |= mbuf_printf(buffer, "\x1b[%u;%ur", (unsigned) to->scroll_top + 1,
+                           (unsigned) to->scroll_bottom + 1);
+    }
+    err |= mbuf_printf(buffer, "\x1b[%u;%uH",
+                       (unsigned) (to->cursor_row + 1 - ((to->modes & VT_MODE_ORIGIN)
+                                                         ? to->scroll_top : 0)),
+                       (unsigned) to->cursor_column + 1);
+    err |= vt_write_attributes(buffer, &to->pen);
+    if (to->modes & VT_MODE_CURSOR_VISIBLE) {
+        err |= mbuf_write_str(buffer, "\x1b[?25h");
+    }
+    return rawrtc_error_to_code(err);
+}
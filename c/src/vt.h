@@ -0,0 +1,140 @@
+#pragma once
+#include <rawrtc.h>
+
+enum {
+    VT_MAX_PARAMETERS = 16,
+    VT_WIDE_CONTINUATION = 0xFFFFFFFF, // right half of a wide character
+    VT_COLOR_RGB = 0x1000000, // | 0xRRGGBB
+};
+
+// Attribute flags
+enum {
+    VT_ATTRIBUTE_BOLD = 1 << 0,
+    VT_ATTRIBUTE_DIM = 1 << 1,
+    VT_ATTRIBUTE_ITALIC = 1 << 2,
+    VT_ATTRIBUTE_UNDERLINE = 1 << 3,
+    VT_ATTRIBUTE_BLINK = 1 << 4,
+    VT_ATTRIBUTE_INVERSE = 1 << 5,
+    VT_ATTRIBUTE_HIDDEN = 1 << 6,
+    VT_ATTRIBUTE_STRIKETHROUGH = 1 << 7,
+};
+
+// Modes that change how the remote terminal behaves
+enum {
+    VT_MODE_CURSOR_KEYS = 1 << 0,
+    VT_MODE_ORIGIN = 1 << 1,
+    VT_MODE_AUTOWRAP = 1 << 2,
+    VT_MODE_CURSOR_VISIBLE = 1 << 3,
+    VT_MODE_ALTERNATE_SCREEN = 1 << 4,
+    VT_MODE_KEYPAD = 1 << 5,
+    VT_MODE_MOUSE_X10 = 1 << 6,
+    VT_MODE_MOUSE_NORMAL = 1 << 7,
+    VT_MODE_MOUSE_BUTTON = 1 << 8,
+    VT_MODE_MOUSE_ANY = 1 << 9,
+    VT_MODE_FOCUS = 1 << 10,
+    VT_MODE_MOUSE_SGR = 1 << 11,
+    VT_MODE_BRACKETED_PASTE = 1 << 12,
+};
+
+/*
+ * Attributes of a cell.
+ * Colours are 0 (default), the palette index + 1 or `VT_COLOR_RGB`
+ * combined with the true colour value.
+ */
+struct vt_attributes {
+    uint32_t foreground;
+    uint32_t background;
+    uint16_t flags;
+};
+
+struct vt_cell {
+    uint32_t codepoint; // 0: blank
+    struct vt_attributes attributes;
+};
+
+/*
+ * Screen state of a VT100/xterm compatible terminal that is being fed
+ * with a process' output. Covers what is needed to repaint the screen of
+ * a remote terminal: The visible cells, the cursor, the current
+ * attributes, the scrolling region and the modes. Scrollback is not kept.
+ */
+struct vt_screen {
+    uint16_t columns;
+    uint16_t rows;
+    struct vt_cell* cells; // rows * columns
+    struct vt_cell* main_cells; // saved while the alternate screen is active, nullable
+    uint16_t cursor_row;
+    uint16_t cursor_column;
+    bool wrap_pending;
+    struct vt_attributes pen;
+    uint16_t scroll_top; // inclusive
+    uint16_t scroll_bottom; // inclusive
+    uint32_t modes;
+    uint16_t saved_row;
+    uint16_t saved_column;
+    struct vt_attributes saved_pen;
+    // Parser
+    uint_fast8_t state;
+    uint32_t parameters[VT_MAX_PARAMETERS];
+    uint_fast8_t n_parameters;
+    char prefix; // private marker of a control sequence, '\0' if none
+    char intermediate; // '\0' if none
+    uint32_t codepoint; // partially decoded UTF-8
+    uint_fast8_t utf8_remaining;
+};
+
+/*
+ * Create a blank screen.
+ */
+enum rawrtc_code vt_screen_create(
+    struct vt_screen** const screenp, // de-referenced
+    uint16_t const columns,
+    uint16_t const rows
+);
+
+/*
+ * Resize the screen. Lines above the cursor are dropped in case it would
+ * end up below the bottom line.
+ */
+enum rawrtc_code vt_screen_resize(
+    struct vt_screen* const screen,
+    uint16_t const columns,
+    uint16_t const rows
+);
+
+/*
+ * Feed output of the process into the screen.
+ */
+void vt_screen_write(
+    struct vt_screen* const screen,
+    uint8_t const* const data,
+    size_t const length
+);
+
+/*
+ * Return whether the parser is outside of any control sequence or
+ * character (i.e. whether output can be cut off at this point).
+ */
+bool vt_screen_idle(
+    struct vt_screen const* const screen
+);
+
+/*
+ * Copy the screen state (excluding the parser state) into `*copyp`.
+ * An existing copy of the same size will be reused.
+ */
+enum rawrtc_code vt_screen_copy(
+    struct vt_screen** const copyp, // de-referenced, nullable
+    struct vt_screen const* const screen
+);
+
+/*
+ * Append control sequences that turn a terminal displaying `from` into
+ * displaying `to`. Only lines that differ are being repainted (or all of
+ * them in case the size or the active screen differ).
+ */
+enum rawrtc_code vt_screen_diff(
+    struct mbuf* const buffer,
+    struct vt_screen const* const from,
+    struct vt_screen const* const to
+);
@@ -4,9 +4,63 @@
 window.addEventListener('load', (event) => {
     // Control message types
     let messageType = {
-        'windowSize': 0
+        'windowSize': 0,
+        'pauseInput': 1,
+        'resumeInput': 2,
+        'sessionToken': 3,
+        'replay': 4,
+        'signal': 5,
+        'compression': 6,
+        'compressedOutput': 7,
+        'outputFormat': 8,
+        'output': 9,
+        'credit': 10
     };
 
+    // Compression algorithms of the output
+    let compressionAlgorithm = {
+        'none': 0,
+        'deflate': 1
+    };
+
+    // Formats of uncompressed output
+    let outputFormat = {
+        'text': 0,
+        'binary': 1
+    };
+
+    // Control characters that are being sent as signal requests on the control channel
+    let signalType = {
+        '\x03': 0, // interrupt
+        '\x1c': 1, // quit
+        '\x1a': 2 // suspend
+    };
+
+    // Frame types of the multiplexed data channel
+    let frameType = {
+        'data': 0,
+        'control': 1,
+        'open': 2,
+        'close': 3
+    };
+    let frameHeaderLength = 7;
+
+    // Share a single data channel between all terminals (if requested)
+    let multiplex = new URLSearchParams(window.location.search).has('mux');
+
+    // Request compressed output (if requested and supported by the browser)
+    let compress = new URLSearchParams(window.location.search).has('compress')
+        && typeof DecompressionStream !== 'undefined';
+
+    // Output the server may send before the terminal processed it
+    let outputCredit = 262144; // in bytes
+
+    // Time to wait for a disconnected ICE connection to recover before restarting ICE
+    let iceRestartDelay = 3000; // in milliseconds
+
+    // Count UTF-8 bytes of received output (used as sequence number when reattaching)
+    let encoder = new TextEncoder();
+
     // DOM elements
     let status = document.getElementById('status-bar');
     let content = document.getElementById('content');
@@ -18,10 +72,171 @@ window.addEventListener('load', (event) => {
     let remoteParameters = document.getElementById('remote-parameters');
     let pasteInnerText = paste.innerText;
 
+    // Stream of a multiplexed data channel. Mimics the parts of the data channel interface that
+    // are being used by the terminals.
+    class MuxStream {
+        constructor(mux, id, protocol) {
+            this.mux = mux;
+            this.id = id;
+            this.label = mux.dc.label + '/' + id;
+            this.protocol = protocol || '';
+            this.readyState = 'connecting';
+            this.binaryType = 'arraybuffer';
+            this.decoder = new TextDecoder();
+            this.onopen = null;
+            this.onclose = null;
+            this.onmessage = null;
+        }
+
+        send(data) {
+            // Strings are terminal input, anything else is a control message
+            if (typeof data === 'string') {
+                this.mux.sendFrame(this.id, frameType.data, encoder.encode(data));
+            } else {
+                this.mux.sendFrame(this.id, frameType.control, new Uint8Array(data));
+            }
+        }
+
+        handleOpen() {
+            // Open stream (with attach request, if any)
+            this.mux.sendFrame(this.id, frameType.open, encoder.encode(this.protocol));
+            this.readyState = 'open';
+            if (this.onopen) {
+                this.onopen({});
+            }
+        }
+
+        handleClose() {
+            if (this.readyState === 'closed') {
+                return;
+            }
+            this.readyState = 'closed';
+            if (this.onclose) {
+                this.onclose({});
+            }
+        }
+
+        handleFrame(type, payload) {
+            switch (type) {
+                case frameType.data:
+                    // Note: A character may be split across frames
+                    if (this.onmessage) {
+                        this.onmessage({data: this.decoder.decode(payload, {stream: true})});
+                    }
+                    break;
+                case frameType.control:
+                    if (this.onmessage) {
+                        this.onmessage({data: payload.slice().buffer});
+                    }
+                    break;
+                case frameType.close:
+                    this.mux.streams.delete(this.id);
+                    this.handleClose();
+                    break;
+                default:
+                    console.warn('Unknown frame type:', type);
+                    break;
+            }
+        }
+    }
+
+    // Data channel carrying the framed streams of many terminals
+    class MuxChannel {
+        constructor(dc) {
+            this.dc = dc;
+            this.streams = new Map();
+            this.nextId = 0;
+
+            // Bind data channel events
+            dc.binaryType = 'arraybuffer';
+            //noinspection JSUnusedLocalSymbols
+            dc.onopen = (event) => {
+                console.log('Multiplexed data channel "' + dc.label + '" open');
+                for (let stream of this.streams.values()) {
+                    stream.handleOpen();
+                }
+            };
+            //noinspection JSUnusedLocalSymbols
+            dc.onclose = (event) => {
+                console.log('Multiplexed data channel "' + dc.label + '" closed');
+                let streams = Array.from(this.streams.values());
+                this.streams.clear();
+                for (let stream of streams) {
+                    stream.handleClose();
+                }
+            };
+            dc.onmessage = (event) => {
+                this.receive(event.data);
+            };
+        }
+
+        createStream(protocol) {
+            let stream = new MuxStream(this, this.nextId++, protocol);
+            this.streams.set(stream.id, stream);
+
+            // Open once the stream's events have been bound (if the data channel is open already)
+            if (this.dc.readyState === 'open') {
+                setTimeout(() => {
+                    stream.handleOpen();
+                }, 0);
+            }
+            return stream;
+        }
+
+        sendFrame(id, type, payload) {
+            // Prepend header
+            let frame = new Uint8Array(frameHeaderLength + payload.length);
+            let view = new DataView(frame.buffer);
+            view.setUint16(0, id);
+            view.setUint8(2, type);
+            view.setUint32(3, payload.length);
+            frame.set(payload, frameHeaderLength);
+
+            // Send over data channel
+            this.dc.send(frame.buffer);
+        }
+
+        receive(buffer) {
+            let view = new DataView(buffer);
+            let offset = 0;
+
+            // Dispatch each frame to its stream
+            while (offset < buffer.byteLength) {
+                if (buffer.byteLength - offset < frameHeaderLength
+                        || buffer.byteLength - offset - frameHeaderLength <
+                        view.getUint32(offset + 3)) {
+                    console.warn('Discarding truncated frame');
+                    return;
+                }
+                let id = view.getUint16(offset);
+                let type = view.getUint8(offset + 2);
+                let length = view.getUint32(offset + 3);
+                let payload = new Uint8Array(buffer, offset + frameHeaderLength, length);
+                offset += frameHeaderLength + length;
+
+                // Find stream
+                let stream = this.streams.get(id);
+                if (!stream) {
+                    console.warn('Discarding frame of unknown stream', id);
+                    continue;
+                }
+                stream.handleFrame(type, payload);
+            }
+        }
+    }
+
     class WebTerminalPeer {
-        constructor(resetEventHandler) {
+        constructor(resetEventHandler, detachedTerminals) {
             this.terminals = [];
+            this.detachedTerminals = detachedTerminals || [];
+            this.wsUri = null;
+            this.restartToken = null;
+            this.restarting = false;
+            this.restartTimeout = null;
             this.peer = null;
+            this.previousPeer = null; // replaced by restarting ICE, closed once replaced remotely
+            this.mux = null;
+            this.control = null;
             this.connected = false;
             this.previousPasteEventHandler = null;
             this.createPeerConnection();
@@ -73,7 +288,22 @@ window.addEventListener('load', (event) => {
             }
         }
 
-        static sendResizeMessage(dc, geometry) {
+        sendControlMessage(dc, buffer) {
+            // Send on the control channel (if open), so it's not stuck behind output
+            let control = this.control;
+            if (control && control.readyState === 'open') {
+                let label = encoder.encode(dc.label);
+                let message = new Uint8Array(1 + label.length + buffer.byteLength);
+                message[0] = label.length;
+                message.set(label, 1);
+                message.set(new Uint8Array(buffer), 1 + label.length);
+                control.send(message.buffer);
+            } else {
+                dc.send(buffer);
+            }
+        }
+
+        sendResizeMessage(dc, geometry) {
             console.log('Resize to cols: ' + geometry.cols + ', rows: ' + geometry.rows);
 
             // Prepare control message
@@ -84,7 +314,107 @@ window.addEventListener('load', (event) => {
             view.setUint16(3, geometry.rows);
 
             // Send control message
-            dc.send(buffer);
+            this.sendControlMessage(dc, buffer);
+        }
+
+        sendSignalMessage(dc, type) {
+            console.log('Requesting signal', type, 'for data channel "' + dc.label + '"');
+
+            // Prepare control message
+            let buffer = new ArrayBuffer(2);
+            let view = new DataView(buffer);
+            view.setUint8(0, messageType.signal);
+            view.setUint8(1, type);
+
+            // Send control message
+            this.sendControlMessage(dc, buffer);
+        }
+
+        sendCompressionMessage(dc, algorithm) {
+            console.log('Requesting compression', algorithm, 'for data channel "' +
+                dc.label + '"');
+
+            // Prepare control message
+            let buffer = new ArrayBuffer(2);
+            let view = new DataView(buffer);
+            view.setUint8(0, messageType.compression);
+            view.setUint8(1, algorithm);
+
+            // Send control message
+            this.sendControlMessage(dc, buffer);
+        }
+
+        sendOutputFormatMessage(dc, format) {
+            console.log('Requesting output format', format, 'for data channel "' +
+                dc.label + '"');
+
+            // Prepare control message
+            let buffer = new ArrayBuffer(2);
+            let view = new DataView(buffer);
+            view.setUint8(0, messageType.outputFormat);
+            view.setUint8(1, format);
+
+            // Send control message
+            this.sendControlMessage(dc, buffer);
+        }
+
+        sendCreditMessage(dc, credit) {
+            // Prepare control message
+            let buffer = new ArrayBuffer(5);
+            let view = new DataView(buffer);
+            view.setUint8(0, messageType.credit);
+            view.setUint32(1, credit);
+
+            // Send control message
+            this.sendControlMessage(dc, buffer);
+        }
+
+        static createDecompressor(onOutput) {
+            let stream = new DecompressionStream('deflate');
+            let reader = stream.readable.getReader();
+            let decoder = new TextDecoder();
+
+            // Hand out decompressed output (in order)
+            let read = () => {
+                reader.read().then(({value, done}) => {
+                    if (done) {
+                        return;
+                    }
+                    onOutput(decoder.decode(value, {stream: true}), value.length);
+                    read();
+                }).catch((error) => {
+                    console.warn('Decompressing output stopped:', error);
+                });
+            };
+            read();
+            return stream.writable.getWriter();
+        }
+
+        writeOutput(entry, output, length) {
+            entry.terminal.write(output);
+            entry.unprocessed += length;
+
+            // Return the credit once the terminal processed the output (unless already scheduled)
+            if (!entry.creditScheduled) {
+                entry.creditScheduled = true;
+                this.scheduleCredit(entry);
+            }
+        }
+
+        scheduleCredit(entry) {
+            // Note: xterm parses writes in batches on timeouts, so wait until its write buffer has
+            //       been drained.
+            setTimeout(() => {
+                if (entry.terminal.writeBuffer && entry.terminal.writeBuffer.length > 0) {
+                    this.scheduleCredit(entry);
+                    return;
+                }
+                entry.creditScheduled = false;
+                if (entry.unprocessed > 0 && entry.dc && entry.dc.readyState === 'open') {
+                    this.sendCreditMessage(entry.dc, entry.unprocessed);
+                }
+                entry.unprocessed = 0;
+            }, 0);
         }
 
         static fitTerminal(terminal) {
@@ -115,7 +445,8 @@ window.addEventListener('load', (event) => {
             // Update status
             status.className = 'red';
 
-            // Tear down all terminals
+            // Tear down all terminals (except those that can be reattached)
+            let detachedTerminals = this.detachTerminals();
             this.removeTerminals();
 
             // Reset parameters
@@ -133,7 +464,7 @@ window.addEventListener('load', (event) => {
             // Call handler
             console.info('Reset');
             if (this.resetEventHandler) {
-                this.resetEventHandler();
+                this.resetEventHandler(detachedTerminals);
             }
         }
 
@@ -148,10 +479,20 @@ window.addEventListener('load', (event) => {
                 let state = peer.pc.iceConnectionState;
                 console.log('ICE connection state changed to:', state);
 
+                // Ignore the previous peer connection (if replaced by restarting ICE)
+                if (peer !== this.peer) {
+                    return;
+                }
+
                 // Connected, yay!
                 if (state == 'connected' || state == 'completed') {
                     this.connected = true;
+                    this.restarting = false;
+                    clearTimeout(this.restartTimeout);
                     status.className = 'green';
+
+                    // Reattach terminals of the previous connection (if any)
+                    this.reattachTerminals();
                 }
 
                 // Warn (if disconnected)
@@ -160,10 +501,24 @@ window.addEventListener('load', (event) => {
                     status.className = 'orange';
                 }
 
-                // Reset (if failed)
+                // Restart ICE if the connection does not recover by itself (e.g. after
+                // switching networks)
+                if (state == 'disconnected' && this.restartToken && !this.restarting) {
+                    clearTimeout(this.restartTimeout);
+                    this.restartTimeout = setTimeout(() => {
+                        this.restartIce();
+                    }, iceRestartDelay);
+                }
+
+                // Restart ICE or reset (if failed)
                 if (state == 'failed') {
                     this.connected = false;
-                    this.reset();
+                    clearTimeout(this.restartTimeout);
+                    if (this.restartToken && !this.restarting) {
+                        this.restartIce();
+                    } else {
+                        this.reset();
+                    }
                 }
             };
 
@@ -259,26 +614,95 @@ window.addEventListener('load', (event) => {
                 });
         }
 
-        startWS(uri) {
+        restartIce() {
+            console.info('Restarting ICE');
+            this.restarting = true;
+            this.connected = false;
+            status.className = 'orange';
+
+            // Replace the peer connection as the server replaces its transports as well
+            // Note: The data channels are gone, terminals are reattached once connected. The
+            //       previous peer connection is closed once the server replaced its transports
+            //       (and detached the processes), so closing it does not stop them.
+            this.detachedTerminals = this.detachedTerminals.concat(this.detachTerminals());
+            this.removeTerminals();
+            this.mux = null;
+            this.control = null;
+            this.closePreviousPeer();
+            this.previousPeer = this.peer;
+            this.createPeerConnection();
+
+            // Exchange the new parameters via the session's restart URI
+            let url = new URL(this.wsUri);
+            url.pathname = '/restart/' + this.restartToken;
+            this.startWS(url.href, true);
+        }
+
+        closePreviousPeer() {
+            if (this.previousPeer) {
+                this.previousPeer.pc.close();
+                this.previousPeer = null;
+            }
+        }
+
+        startWS(uri, restart = false) {
             // Beautify local parameters
-            WebTerminalPeer.beautifyParameters(localParameters);
+            if (!restart) {
+                this.wsUri = uri;
+                WebTerminalPeer.beautifyParameters(localParameters);
+            }
 
             // Create WebSocket connection
             let ws = new WebSocket(uri);
 
+            // Close WebSocket connection once both sides have sent all candidates
+            let localComplete = false;
+            let remoteComplete = false;
+            let closeIfDone = () => {
+                if (localComplete && remoteComplete) {
+                    console.log('Signalling complete');
+                    ws.close();
+                }
+            };
+
             // Bind WebSocket events
             //noinspection JSUnusedLocalSymbols
             ws.onopen = (event) => {
                 console.log('WS connection open');
 
-                // Send local parameters
-                this.peer.getLocalParameters().then((parameters) => {
+                // Send local parameters (trickle further candidates as they are being gathered)
+                this.peer.getLocalParameters((candidate) => {
+                    if (ws.readyState !== WebSocket.OPEN) {
+                        return;
+                    }
+                    if (candidate) {
+                        console.info('Sending local candidate');
+                        ws.send(JSON.stringify({iceCandidate: candidate}));
+                    } else {
+                        console.info('Sending end of local candidates');
+                        ws.send(JSON.stringify({iceCandidatesComplete: true}));
+                        localComplete = true;
+                        closeIfDone();
+                    }
+                }).then((parameters) => {
+                    // ICE restart: Tell the server to replace its transports
+                    if (restart) {
+                        parameters.iceRestart = true;
+                    }
+
                     console.info('Sending local parameters');
+                    parameters.trickle = true;
                     ws.send(JSON.stringify(parameters));
                 });
             };
             ws.onerror = (event) => {
                 console.log('WS connection error:', event);
+
+                // Give up (if restarting ICE)
+                if (restart && this.restarting) {
+                    this.closePreviousPeer();
+                    this.reset();
+                }
             };
             //noinspection JSUnusedLocalSymbols
             ws.onclose = (event) => {
@@ -287,31 +711,86 @@ window.addEventListener('load', (event) => {
             ws.onmessage = (event) => {
                 let length = event.data.size || event.data.byteLength || event.data.length;
                 console.log('WS message of', length, 'bytes received');
+                let message = JSON.parse(event.data);
+
+                // Remote parameters
+                if (message.iceParameters) {
+                    if (!restart) {
+                        paste.className = 'green';
+                        paste.classList.remove('orange');
+                        paste.classList.add('green');
+                        paste.innerText = 'Received parameters from WebSocket URI: ' + uri;
+                    }
+                    if (message.restartToken) {
+                        this.restartToken = message.restartToken;
+                    }
+                    if (restart) {
+                        this.closePreviousPeer();
+                    }
+                    this.setRemoteParameters(message);
+                    remoteComplete = !message.trickle;
+                } else if (message.iceCandidate) {
+                    this.peer.addRemoteCandidate(message.iceCandidate);
+                } else if (message.iceCandidatesComplete) {
+                    this.peer.addRemoteCandidate(null);
+                    remoteComplete = true;
+                } else {
+                    console.warn('Unknown signalling message:', message);
+                }
 
-                // Parse remote parameters
-                let parameters = JSON.parse(event.data);
-                paste.className = 'green';
-                paste.classList.remove('orange');
-                paste.classList.add('green');
-                paste.innerText = 'Received parameters from WebSocket URI: ' + uri;
-                this.setRemoteParameters(parameters);
+                // Close WebSocket connection (if done)
+                closeIfDone();
+            };
+        }
+
+        createChannel(label, protocol) {
+            // Create control channel (once per session)
+            // Note: Its own SCTP stream with a high priority, so resize and signal requests
+            //       are not stuck behind input and output of the terminals.
+            if (!this.control) {
+                this.control = this.peer.createDataChannel(this.peer.pc.createDataChannel(
+                    'control', {
+                    ordered: true,
+                    protocol: 'control',
+                    priority: 'high'
+                }));
+                this.control.binaryType = 'arraybuffer';
+            }
 
-                // Close WebSocket connection
-                ws.close();
+            // Multiplexed: Open a stream on the shared data channel
+            if (multiplex) {
+                if (!this.mux) {
+                    this.mux = new MuxChannel(this.peer.createDataChannel(
+                        this.peer.pc.createDataChannel('terminals', {
+                        ordered: true,
+                        protocol: 'mux'
+                    })));
+                }
+                return this.mux.createStream(protocol);
+            }
+
+            // Create terminal data channel
+            let options = {
+                ordered: true
             };
+            if (protocol) {
+                options.protocol = protocol;
+            }
+            return this.peer.createDataChannel(this.peer.pc.createDataChannel(label, options));
         }
 
         createTerminal(dc) {
-            let id = this.terminals.length;
-
             // Create data channel (if needed)
             if (!dc) {
-                // Create terminal data channel
-                dc = this.peer.createDataChannel(this.peer.pc.createDataChannel('terminal-' + id, {
-                    ordered: true,
-                }));
+                dc = this.createChannel('terminal-' + this.terminals.length);
             }
 
+            // Create terminal and bind it to the data channel
+            let terminal = this.createTerminalView(this.terminals.length);
+            this.bindTerminal(terminal, dc);
+        }
+
+        createTerminalView(id) {
             // Update UI
             let parent = newTerminalLabel.parentNode;
 
@@ -338,47 +817,59 @@ window.addEventListener('load', (event) => {
             // Create terminal
             let terminal = new Terminal();
             let resizeTimeout;
-
-            // Bind data channel events
-            //noinspection JSUnusedLocalSymbols
-            dc.onopen = (event) => {
-                console.log('Data channel "' + dc.label + '" open');
-
-                // Open terminal
-                terminal.open(section);
-            };
-            //noinspection JSUnusedLocalSymbols
-            dc.onclose = (event) => {
-                console.log('Data channel "' + dc.label + '" closed');
-
-                // Remove terminal
-                this.removeTerminal(id);
-            };
-            dc.onmessage = (event) => {
-                let length = event.data.size || event.data.byteLength || event.data.length;
-                console.info('Received', length, 'bytes over data channel "' + dc.label + '"');
-
-                // Write to terminal
-                terminal.write(event.data);
+            let entry = {
+                id: id,
+                terminal: terminal,
+                label: label,
+                section: section,
+                dc: null,
+                opened: false,
+                inputPaused: false,
+                pendingInput: [],
+                token: null,
+                received: 0,
+                decompressor: null,
+                decoder: null,
+                unprocessed: 0,
+                creditScheduled: false
             };
 
             // Bind terminal events
             terminal.on('data', (data) => {
+                // Request signals on the control channel (bypassing queued input and output)
+                let signal = signalType[data];
+                if (signal !== undefined && entry.dc && entry.dc.readyState === 'open'
+                        && this.control && this.control.readyState === 'open') {
+                    this.sendSignalMessage(entry.dc, signal);
+                    return;
+                }
+
+                // Hold back while the server asked us to pause (or while reattaching)
+                if (entry.inputPaused || !entry.dc || entry.dc.readyState !== 'open') {
+                    entry.pendingInput.push(data);
+                    return;
+                }
+
                 // Send over data channel
-                console.log('Sending', data.length, 'bytes over data channel "' + dc.label + '"');
-                dc.send(data);
+                console.log('Sending', data.length, 'bytes over data channel "' +
+                    entry.dc.label + '"');
+                entry.dc.send(data);
             });
-            terminal.on('resize', function(geometry) {
+            terminal.on('resize', (geometry) => {
                 clearTimeout(resizeTimeout);
                 resizeTimeout = setTimeout(() => {
-                    WebTerminalPeer.sendResizeMessage(dc, geometry);
+                    if (entry.dc && entry.dc.readyState === 'open') {
+                        this.sendResizeMessage(entry.dc, geometry);
+                    }
                 }, 100);
             });
 
             // Fit terminal on resize
             //noinspection JSUnusedLocalSymbols
             window.addEventListener('resize', (event) => {
-                WebTerminalPeer.fitTerminal(terminal);
+                if (entry.opened) {
+                    WebTerminalPeer.fitTerminal(terminal);
+                }
             });
 
             // Switch to the terminal
@@ -388,12 +879,193 @@ window.addEventListener('load', (event) => {
             }, 1);
 
             // Add to terminals
-            this.terminals.push({
-                id: id,
-                terminal: terminal,
-                label: label,
-                section: section
-            });
+            this.terminals[id] = entry;
+            return entry;
+        }
+
+        bindTerminal(entry, dc) {
+            let terminal = entry.terminal;
+            let requestedToken = entry.token;
+
+            // Receive control messages as array buffers
+            entry.dc = dc;
+            dc.binaryType = 'arraybuffer';
+
+            // Compression is negotiated per data channel
+            if (entry.decompressor) {
+                entry.decompressor.abort().catch(() => {});
+                entry.decompressor = null;
+            }
+
+            // Binary output may split characters across messages
+            entry.decoder = new TextDecoder();
+
+            // Credit is granted per data channel
+            entry.unprocessed = 0;
+
+            // Bind data channel events
+            //noinspection JSUnusedLocalSymbols
+            dc.onopen = (event) => {
+                console.log('Data channel "' + dc.label + '" open');
+
+                // Request binary (or compressed) output & grant credit
+                this.sendOutputFormatMessage(dc, outputFormat.binary);
+                if (compress) {
+                    this.sendCompressionMessage(dc, compressionAlgorithm.deflate);
+                }
+                this.sendCreditMessage(dc, outputCredit);
+
+                // Open terminal (or apply the current window size to the reattached process)
+                if (!entry.opened) {
+                    terminal.open(entry.section);
+                    entry.opened = true;
+                } else {
+                    this.sendResizeMessage(dc, {
+                        cols: terminal.cols,
+                        rows: terminal.rows
+                    });
+                }
+
+                // Send input that has been typed while reattaching
+                if (!entry.inputPaused && entry.pendingInput.length > 0) {
+                    dc.send(entry.pendingInput.join(''));
+                    entry.pendingInput = [];
+                }
+            };
+            //noinspection JSUnusedLocalSymbols
+            dc.onclose = (event) => {
+                console.log('Data channel "' + dc.label + '" closed');
+
+                // Keep terminal (if it is going to be reattached after reconnecting)
+                if (entry.dc !== dc || (entry.token && !this.connected)) {
+                    return;
+                }
+
+                // Remove terminal
+                this.removeTerminal(entry.id);
+            };
+            dc.onmessage = (event) => {
+                let length = event.data.size || event.data.byteLength || event.data.length;
+                console.info('Received', length, 'bytes over data channel "' + dc.label + '"');
+
+                // Handle control message
+                if (event.data instanceof ArrayBuffer) {
+                    let view = new DataView(event.data);
+                    switch (view.getUint8(0)) {
+                        case messageType.pauseInput:
+                            console.log('Pausing input on data channel "' + dc.label + '"');
+                            entry.inputPaused = true;
+                            break;
+                        case messageType.resumeInput:
+                            console.log('Resuming input on data channel "' + dc.label + '"');
+                            entry.inputPaused = false;
+
+                            // Send pending input
+                            if (entry.pendingInput.length > 0) {
+                                dc.send(entry.pendingInput.join(''));
+                                entry.pendingInput = [];
+                            }
+                            break;
+                        case messageType.sessionToken:
+                            entry.token = String.fromCharCode.apply(
+                                null, new Uint8Array(event.data, 1));
+                            console.log('Session token of data channel "' + dc.label + '":',
+                                entry.token);
+
+                            // Previous process expired?
+                            if (requestedToken && entry.token !== requestedToken) {
+                                terminal.write('\r\n[Previous session expired, started a ' +
+                                    'new shell]\r\n');
+                                entry.received = 0;
+                            }
+                            break;
+                        case messageType.replay: {
+                            // Note: Only 53 bits are safe, that's plenty of terminal output.
+                            let sequence = view.getUint32(1) * 4294967296 + view.getUint32(5);
+                            console.log('Replaying output of data channel "' + dc.label +
+                                '" from byte', sequence);
+                            if (sequence > entry.received) {
+                                terminal.write('\r\n[' + (sequence - entry.received) +
+                                    ' bytes of output have been lost]\r\n');
+                            }
+                            entry.received = sequence;
+                            break;
+                        }
+                        case messageType.compression:
+                            console.log('Compression of data channel "' + dc.label + '":',
+                                view.getUint8(1));
+                            if (view.getUint8(1) === compressionAlgorithm.deflate
+                                    && !entry.decompressor) {
+                                entry.decompressor = WebTerminalPeer.createDecompressor(
+                                    (output, length) => {
+                                        entry.received += length;
+                                        this.writeOutput(entry, output, length);
+                                    });
+                            }
+                            break;
+                        case messageType.compressedOutput:
+                            if (entry.decompressor) {
+                                entry.decompressor.write(new Uint8Array(event.data, 1));
+                            }
+                            break;
+                        case messageType.outputFormat:
+                            console.log('Output format of data channel "' + dc.label + '":',
+                                view.getUint8(1));
+                            break;
+                        case messageType.output: {
+                            let output = new Uint8Array(event.data, 1);
+                            entry.received += output.length;
+                            this.writeOutput(
+                                entry, entry.decoder.decode(output, {stream: true}), output.length);
+                            break;
+                        }
+                        default:
+                            console.warn('Unknown control message type:', view.getUint8(0));
+                            break;
+                    }
+                    return;
+                }
+
+                // Write to terminal
+                length = encoder.encode(event.data).length;
+                entry.received += length;
+                this.writeOutput(entry, event.data, length);
+            };
+        }
+
+        detachTerminals() {
+            let detachedTerminals = [];
+
+            // Keep terminals the server handed out a session token for
+            for (let i = 0; i < this.terminals.length; ++i) {
+                let entry = this.terminals[i];
+                if (entry && entry.token) {
+                    console.log('Detaching terminal', entry.id + 1);
+                    entry.dc = null;
+                    entry.inputPaused = false;
+                    detachedTerminals.push(entry);
+                    this.terminals[i] = null;
+                }
+            }
+            return detachedTerminals;
+        }
+
+        reattachTerminals() {
+            let detachedTerminals = this.detachedTerminals;
+            this.detachedTerminals = [];
+
+            // Request to reattach each terminal's process and to replay missed output
+            for (let entry of detachedTerminals) {
+                let id = this.terminals.length;
+                console.log('Reattaching terminal', entry.id + 1, 'from byte', entry.received);
+                entry.id = id;
+                entry.section.id = 'terminal-' + id;
+                entry.label.id = 'l-terminal-' + id;
+                this.terminals[id] = entry;
+                let dc = this.createChannel(
+                    'terminal-' + id, 'attach:' + entry.token + ':' + entry.received);
+                this.bindTerminal(entry, dc);
+            }
         }
 
         removeTerminal(id) {
@@ -436,12 +1108,12 @@ window.addEventListener('load', (event) => {
         }
     }
 
-    let start = () => {
+    let start = (detachedTerminals) => {
         // Create peer and make peer globally available
-        let peer = new WebTerminalPeer(() => {
+        let peer = new WebTerminalPeer((detachedTerminals) => {
             console.info('Restart');
-            start();
-        });
+            start(detachedTerminals);
+        }, detachedTerminals);
         //noinspection JSUndefinedPropertyAssignment
         window.peer = peer;
 
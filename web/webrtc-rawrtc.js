@@ -5,10 +5,13 @@ class Peer {
         this.pc = null;
         this.localMid = null;
         this.localCandidates = [];
+        this.localCandidateHandlers = [];
+        this.gatheringComplete = false;
         this.localParameters = null;
         this.localDescription = null;
         this.remoteParameters = null;
         this.remoteDescription = null;
+        this.pendingRemoteCandidates = [];
         var _waitGatheringComplete = {};
         _waitGatheringComplete.promise = new Promise((resolve, reject) => {
             _waitGatheringComplete.resolve = resolve;
@@ -41,9 +44,18 @@ class Peer {
             if (event.candidate) {
                 console.log('Gathered candidate:', event.candidate);
                 self.localCandidates.push(event.candidate);
+                var candidate = SDPUtils.parseCandidate(event.candidate.candidate);
+                for (var handler of self.localCandidateHandlers) {
+                    handler(candidate);
+                }
             } else {
                 console.log('Gathering complete');
+                self.gatheringComplete = true;
                 self._waitGatheringComplete.resolve();
+                for (var handler of self.localCandidateHandlers) {
+                    handler(null);
+                }
+                self.localCandidateHandlers = [];
             }
         };
         pc.onicecandidateerror = function(event) {
@@ -99,7 +111,14 @@ class Peer {
         return dc;
     }
 
-    getLocalParameters() {
+    /**
+     * Resolves with the local parameters once gathering is complete.
+     *
+     * If `onLocalCandidate` is provided (trickle ICE), resolves right away
+     * with the candidates gathered so far. The handler will be called for
+     * each further candidate and with `null` once gathering is complete.
+     */
+    getLocalParameters(onLocalCandidate = null) {
         return new Promise((resolve, reject) => {
             var error;
             var self = this;
@@ -165,13 +184,29 @@ class Peer {
             parameters.iceParameters.iceLite =
                 SDPUtils.matchPrefix(session, 'a=ice-lite').length > 0;
 
-            // Get ICE candidates
-            this._waitGatheringComplete.promise.then(() => {
-                // Add ICE candidates
+            // Add ICE candidates
+            var addCandidates = () => {
                 for (var sdpCandidate of self.localCandidates) {
                     var candidate = SDPUtils.parseCandidate(sdpCandidate.candidate);
                     parameters.iceCandidates.push(candidate);
                 }
+            };
+
+            // Trickle ICE: Add the candidates we have and hand out the others as they arrive
+            if (onLocalCandidate) {
+                addCandidates();
+                if (this.gatheringComplete) {
+                    setTimeout(() => onLocalCandidate(null), 0);
+                } else {
+                    this.localCandidateHandlers.push(onLocalCandidate);
+                }
+                resolve(parameters);
+                return;
+            }
+
+            // Get ICE candidates
+            this._waitGatheringComplete.promise.then(() => {
+                addCandidates();
 
                 // Add ICE candidate complete sentinel
                 // parameters.iceCandidates.push({complete: true}); // TODO
@@ -262,26 +297,14 @@ class Peer {
                 console.log('Actual remote description:\n' + this.pc.remoteDescription.sdp);
                 this.remoteDescription = this.pc.remoteDescription;
 
-                // Add ICE candidates
+                // Add ICE candidates (including those that have been trickled in meanwhile)
                 for (var iceCandidate of parameters.iceCandidates) {
-                    // Add component which ORTC doesn't have
-                    // Note: We choose RTP as it doesn't actually matter for us
-                    iceCandidate.component = 1; // RTP
-
-                    // Create
-                    var candidate = new RTCIceCandidate({
-                        candidate: SDPUtils.writeCandidate(iceCandidate),
-                        sdpMLineIndex: 0, // TODO: Fix
-                        sdpMid: localMid // TODO: Fix
-                    });
-
-                    // Add
-                    console.log(candidate.candidate);
-                    this.pc.addIceCandidate(candidate)
-                    .then(() => {
-                        console.log('Added remote candidate', candidate);
-                    });
+                    this._addRemoteCandidate(iceCandidate, localMid);
                 }
+                for (var iceCandidate of this.pendingRemoteCandidates) {
+                    this._addRemoteCandidate(iceCandidate, localMid);
+                }
+                this.pendingRemoteCandidates = [];
 
                 // It's trickle ICE, no need to wait for candidates to be added
                 resolve();
@@ -292,11 +315,49 @@ class Peer {
         });
     }
 
+    /**
+     * Add a trickled remote candidate. `null` indicates that the remote
+     * peer has gathered all of its candidates.
+     */
+    addRemoteCandidate(iceCandidate) {
+        if (!iceCandidate) {
+            console.log('Remote candidates complete');
+            return;
+        }
+
+        // Queue until the remote description has been set
+        if (!this.remoteDescription) {
+            this.pendingRemoteCandidates.push(iceCandidate);
+            return;
+        }
+        this._addRemoteCandidate(iceCandidate, this.localMid);
+    }
+
+    _addRemoteCandidate(iceCandidate, localMid) {
+        // Add component which ORTC doesn't have
+        // Note: We choose RTP as it doesn't actually matter for us
+        iceCandidate.component = 1; // RTP
+
+        // Create
+        var candidate = new RTCIceCandidate({
+            candidate: SDPUtils.writeCandidate(iceCandidate),
+            sdpMLineIndex: 0, // TODO: Fix
+            sdpMid: localMid // TODO: Fix
+        });
+
+        // Add
+        console.log(candidate.candidate);
+        this.pc.addIceCandidate(candidate)
+        .then(() => {
+            console.log('Added remote candidate', candidate);
+        });
+    }
+
     start() {}
 }
 
 class ControllingPeer extends Peer {
-    getLocalParameters() {
+    getLocalParameters(onLocalCandidate = null) {
         return new Promise((resolve, reject) => {
             if (!this.pc) {
                 var error = 'Must create RTCPeerConnection instance';
@@ -307,7 +368,7 @@ class ControllingPeer extends Peer {
 
             var getLocalParameters = () => {
                 // Return parameters
-                super.getLocalParameters()
+                super.getLocalParameters(onLocalCandidate)
                 .then((parameters) => {
                     this.localParameters = parameters;
                     resolve(parameters);
@@ -343,7 +404,7 @@ class ControllingPeer extends Peer {
 }
 
 class ControlledPeer extends Peer {
-    getLocalParameters() {
+    getLocalParameters(onLocalCandidate = null) {
         return new Promise((resolve, reject) => {
             var error;
 
@@ -362,7 +423,7 @@ class ControlledPeer extends Peer {
 
             var getLocalParameters = () => {
                 // Return parameters
-                super.getLocalParameters()
+                super.getLocalParameters(onLocalCandidate)
                 .then((parameters) => {
                     resolve(parameters);
                 })